@@ -58,11 +58,11 @@ parse_long_form(int current_arg, struct CommandLine *cl)
   }
   if (value == NULL)
     arg_length = strlen(arg);
-  char *arg_temp = malloc(arg_length + 1);
+  char *arg_temp = SL_MALLOC(arg_length + 1);
   strncpy(arg_temp, arg, arg_length);
   arg_temp[arg_length] = '\0';
   struct CommandLineOption *opt = lookup_by_long_name(arg_temp, cl);
-  free(arg_temp);
+  SL_FREE(arg_temp);
   if (opt == NULL)
     return 1;
   opt->present = TRUE;
@@ -70,7 +70,7 @@ parse_long_form(int current_arg, struct CommandLine *cl)
   {
     if (value == NULL)
       return 1;
-    opt->argument = strdup(value);
+    opt->argument = SL_STRDUP(value);
     return 0;
   }
   else
@@ -107,12 +107,12 @@ parse_short_form(int current_arg, struct CommandLine *cl)
       {
         if (current_arg + 1 >= cl->argc)
           return -1;
-        opt->argument = strdup(cl->argv[current_arg + 1]);
+        opt->argument = SL_STRDUP(cl->argv[current_arg + 1]);
         return 1;
       }
       else
       {
-        opt->argument = strdup(&c[1]);
+        opt->argument = SL_STRDUP(&c[1]);
         return 0;
       }
     }
@@ -123,7 +123,7 @@ parse_short_form(int current_arg, struct CommandLine *cl)
 static int
 add_argument(int current_arg, struct CommandLine *cl)
 {
-  char *arg = strdup(cl->argv[current_arg]);
+  char *arg = SL_STRDUP(cl->argv[current_arg]);
   ARRAY_APPEND(cl->arguments, char *, arg);
 }
 
@@ -186,14 +186,14 @@ parse_command_line(struct CommandLine *cl)
       else
       {
         /* Add this as an argument. */
-        char *argument = strdup(arg);
+        char *argument = SL_STRDUP(arg);
         ARRAY_APPEND(cl->arguments, char *, argument);
       }
     }
     else
     {
       /* Just add this argument to the list of true arguments. */
-      char *argument = strdup(arg);
+      char *argument = SL_STRDUP(arg);
       ARRAY_APPEND(cl->arguments, char *, argument);
     }
   }
@@ -204,7 +204,7 @@ parse_command_line(struct CommandLine *cl)
     struct CommandLineOption *opt = *ARRAY_GET(cl->options,
       struct CommandLineOption *, i);
     if (opt->default_argument != NULL && opt->argument == NULL)
-      opt->argument = strdup(opt->default_argument);
+      opt->argument = SL_STRDUP(opt->default_argument);
   }
 
   /* Verify that all required arguments are filled out. */
@@ -224,14 +224,14 @@ free_command_line(struct CommandLine *cl)
     struct CommandLineOption *opt = *ARRAY_GET(cl->options,
       struct CommandLineOption *, i);
     if (opt->argument != NULL)
-      free(opt->argument);
+      SL_FREE(opt->argument);
   }
   ARRAY_FREE(cl->options);
 
   for (size_t i = 0; i < ARRAY_LENGTH(cl->arguments); ++i)
   {
     char *arg = *ARRAY_GET(cl->arguments, char *, i);
-    free(arg);
+    SL_FREE(arg);
   }
   ARRAY_FREE(cl->arguments);
 }
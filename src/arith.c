@@ -1,230 +1,453 @@
 #include "common.h"
 #include <ctype.h>
+#include <string.h>
 
 /* --- Arbitrary Size Integer Arithmetic. */
-struct sl_Natural {
-  ARR(uint64_t) digits; /* Stored in NBO, so `digits[0]` is the most
-                           significant digit, and so on. */
-};
+typedef unsigned __int128 uint128_t;
 
-int sl_natural_from_string(const char *str, sl_Natural *nat)
+/* Operands with at least this many limbs are multiplied using Karatsuba's
+   method, below it the schoolbook method is faster. */
+#define KARATSUBA_THRESHOLD 32
+
+/* The largest power of ten that fits in a limb. Decimal strings are
+   converted this many digits at a time. */
+#define DECIMAL_CHUNK_DIGITS 19
+#define DECIMAL_CHUNK_BASE 10000000000000000000ULL
+
+/* --- Limb vectors. These work on little-endian arrays of limbs, and leave
+   allocating and normalizing results to their callers. */
+
+static int limbs_compare(const uint64_t *a, size_t an, const uint64_t *b,
+    size_t bn)
+{
+  while (an > 0 && a[an - 1] == 0)
+    --an;
+  while (bn > 0 && b[bn - 1] == 0)
+    --bn;
+  if (an != bn)
+    return (an < bn) ? -1 : 1;
+  for (size_t i = an; i-- > 0;) {
+    if (a[i] != b[i])
+      return (a[i] < b[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+/* r = a + b, for an >= bn. `r` has room for an limbs and may alias `a`.
+   Returns the carry out of the top limb. */
+static uint64_t limbs_add(uint64_t *r, const uint64_t *a, size_t an,
+    const uint64_t *b, size_t bn)
+{
+  uint64_t carry = 0;
+  size_t i;
+  for (i = 0; i < bn; ++i) {
+    uint128_t sum = (uint128_t)a[i] + b[i] + carry;
+    r[i] = (uint64_t)sum;
+    carry = (uint64_t)(sum >> 64);
+  }
+  for (; i < an; ++i) {
+    uint64_t sum = a[i] + carry;
+    carry = (sum < carry);
+    r[i] = sum;
+  }
+  return carry;
+}
+
+/* r = a - b, for an >= bn. `r` has room for an limbs and may alias `a`.
+   Returns the borrow out of the top limb, which is nonzero iff b > a. */
+static uint64_t limbs_subtract(uint64_t *r, const uint64_t *a, size_t an,
+    const uint64_t *b, size_t bn)
+{
+  uint64_t borrow = 0;
+  size_t i;
+  for (i = 0; i < bn; ++i) {
+    uint128_t diff = (uint128_t)a[i] - b[i] - borrow;
+    r[i] = (uint64_t)diff;
+    borrow = (uint64_t)(diff >> 64) != 0;
+  }
+  for (; i < an; ++i) {
+    uint64_t diff = a[i] - borrow;
+    borrow = (a[i] < borrow);
+    r[i] = diff;
+  }
+  return borrow;
+}
+
+static void limbs_multiply(uint64_t *r, const uint64_t *a, size_t an,
+    const uint64_t *b, size_t bn);
+
+/* r = a * b, where `r` has room for an + bn limbs and aliases neither. */
+static void limbs_multiply_schoolbook(uint64_t *r, const uint64_t *a,
+    size_t an, const uint64_t *b, size_t bn)
+{
+  memset(r, 0, sizeof(uint64_t) * (an + bn));
+  for (size_t i = 0; i < an; ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < bn; ++j) {
+      uint128_t t = (uint128_t)a[i] * b[j] + r[i + j] + carry;
+      r[i + j] = (uint64_t)t;
+      carry = (uint64_t)(t >> 64);
+    }
+    r[i + bn] = carry;
+  }
+}
+
+/* For an much larger than bn: multiplies `b` by slices of `a` of bn limbs
+   each, so that every partial product is balanced. */
+static void limbs_multiply_unbalanced(uint64_t *r, const uint64_t *a,
+    size_t an, const uint64_t *b, size_t bn)
+{
+  uint64_t *product = SL_MALLOC(sizeof(uint64_t) * 2 * bn);
+  memset(r, 0, sizeof(uint64_t) * (an + bn));
+  for (size_t offset = 0; offset < an; offset += bn) {
+    size_t n = (an - offset < bn) ? an - offset : bn;
+    limbs_multiply(product, a + offset, n, b, bn);
+    limbs_add(r + offset, r + offset, an + bn - offset, product, n + bn);
+  }
+  SL_FREE(product);
+}
+
+/* Karatsuba's method, for an >= bn > (an + 1) / 2. With a = a1 B^m + a0 and
+   b = b1 B^m + b0, a b = z2 B^2m + z1 B^m + z0 where z0 = a0 b0,
+   z2 = a1 b1, and z1 = (a0 + a1)(b0 + b1) - z0 - z2, which takes three
+   half-size products instead of four. */
+static void limbs_multiply_karatsuba(uint64_t *r, const uint64_t *a,
+    size_t an, const uint64_t *b, size_t bn)
+{
+  size_t m = (an + 1) / 2;
+  size_t zn = 2 * m + 2;
+  uint64_t *scratch = SL_MALLOC(sizeof(uint64_t) * (2 * (m + 1) + zn));
+  uint64_t *sa = scratch;
+  uint64_t *sb = scratch + (m + 1);
+  uint64_t *z1 = scratch + 2 * (m + 1);
+
+  /* z0 goes in the low 2m limbs of the result, z2 in the rest. */
+  limbs_multiply(r, a, m, b, m);
+  limbs_multiply(r + 2 * m, a + m, an - m, b + m, bn - m);
+
+  sa[m] = limbs_add(sa, a, m, a + m, an - m);
+  sb[m] = limbs_add(sb, b, m, b + m, bn - m);
+  limbs_multiply(z1, sa, m + 1, sb, m + 1);
+  limbs_subtract(z1, z1, zn, r, 2 * m);
+  limbs_subtract(z1, z1, zn, r + 2 * m, an + bn - 2 * m);
+
+  /* z1 = a0 b1 + a1 b0 is below B^(an + bn - m), so it fits. */
+  while (zn > 0 && z1[zn - 1] == 0)
+    --zn;
+  limbs_add(r + m, r + m, an + bn - m, z1, zn);
+  SL_FREE(scratch);
+}
+
+/* r = a * b, where `r` has room for an + bn limbs and aliases neither. */
+static void limbs_multiply(uint64_t *r, const uint64_t *a, size_t an,
+    const uint64_t *b, size_t bn)
+{
+  size_t rn = an + bn;
+
+  /* The halves of a split can have leading zeros. */
+  while (an > 0 && a[an - 1] == 0)
+    --an;
+  while (bn > 0 && b[bn - 1] == 0)
+    --bn;
+  if (an < bn) {
+    const uint64_t *tmp = a;
+    size_t tmp_n = an;
+    a = b;
+    an = bn;
+    b = tmp;
+    bn = tmp_n;
+  }
+  if (bn == 0) {
+    memset(r, 0, sizeof(uint64_t) * rn);
+    return;
+  }
+  memset(r + an + bn, 0, sizeof(uint64_t) * (rn - an - bn));
+
+  if (bn < KARATSUBA_THRESHOLD)
+    limbs_multiply_schoolbook(r, a, an, b, bn);
+  else if (bn <= (an + 1) / 2)
+    limbs_multiply_unbalanced(r, a, an, b, bn);
+  else
+    limbs_multiply_karatsuba(r, a, an, b, bn);
+}
+
+/* q = a / d, returning a % d. `q` has room for an limbs, and may alias `a`
+   or be NULL. */
+static uint64_t limbs_divide_single(uint64_t *q, const uint64_t *a,
+    size_t an, uint64_t d)
+{
+  uint64_t remainder = 0;
+  for (size_t i = an; i-- > 0;) {
+    uint128_t n = ((uint128_t)remainder << 64) | a[i];
+    if (q != NULL)
+      q[i] = (uint64_t)(n / d);
+    remainder = (uint64_t)(n % d);
+  }
+  return remainder;
+}
+
+/* Knuth's algorithm D (TAOCP vol. 2, 4.3.1). q = a / b and r = a % b, for
+   an >= bn >= 2 with b[bn - 1] != 0. `q` has room for an - bn + 1 limbs,
+   `r` for bn limbs, and either may be NULL. */
+static void limbs_divide(uint64_t *q, uint64_t *r, const uint64_t *a,
+    size_t an, const uint64_t *b, size_t bn)
+{
+  /* Normalize so that the top bit of the divisor is set, which makes each
+     estimated quotient limb at most two too large. */
+  int shift = __builtin_clzll(b[bn - 1]);
+  uint64_t *v = SL_MALLOC(sizeof(uint64_t) * bn);
+  uint64_t *u = SL_MALLOC(sizeof(uint64_t) * (an + 1));
+  for (size_t i = bn - 1; i > 0; --i)
+    v[i] = (b[i] << shift) | (shift ? b[i - 1] >> (64 - shift) : 0);
+  v[0] = b[0] << shift;
+  u[an] = shift ? a[an - 1] >> (64 - shift) : 0;
+  for (size_t i = an - 1; i > 0; --i)
+    u[i] = (a[i] << shift) | (shift ? a[i - 1] >> (64 - shift) : 0);
+  u[0] = a[0] << shift;
+
+  for (size_t j = an - bn + 1; j-- > 0;) {
+    uint128_t n = ((uint128_t)u[j + bn] << 64) | u[j + bn - 1];
+    uint128_t q_hat = n / v[bn - 1];
+    uint128_t r_hat = n % v[bn - 1];
+    while ((q_hat >> 64) != 0
+        || q_hat * v[bn - 2] > ((r_hat << 64) | u[j + bn - 2])) {
+      q_hat -= 1;
+      r_hat += v[bn - 1];
+      if ((r_hat >> 64) != 0)
+        break;
+    }
+
+    /* Multiply and subtract. */
+    uint64_t carry = 0, borrow = 0;
+    for (size_t i = 0; i < bn; ++i) {
+      uint128_t p = (uint128_t)(uint64_t)q_hat * v[i] + carry;
+      uint64_t p_low = (uint64_t)p;
+      uint64_t digit = u[i + j];
+      carry = (uint64_t)(p >> 64);
+      u[i + j] = digit - p_low - borrow;
+      borrow = (digit < p_low) || (digit - p_low < borrow);
+    }
+    uint64_t top = u[j + bn];
+    u[j + bn] = top - carry - borrow;
+    borrow = (top < carry) || (top - carry < borrow);
+
+    /* The estimate was one too large: add the divisor back. */
+    if (borrow) {
+      q_hat -= 1;
+      u[j + bn] += limbs_add(u + j, u + j, bn, v, bn);
+    }
+    if (q != NULL)
+      q[j] = (uint64_t)q_hat;
+  }
+
+  if (r != NULL) {
+    for (size_t i = 0; i < bn - 1; ++i)
+      r[i] = (u[i] >> shift) | (shift ? u[i + 1] << (64 - shift) : 0);
+    r[bn - 1] = u[bn - 1] >> shift;
+  }
+  SL_FREE(u);
+  SL_FREE(v);
+}
+
+/* --- Natural numbers. */
+static uint64_t *natural_limbs(sl_Natural *nat)
+{
+  return (nat->capacity == 0) ? &nat->data.small : nat->data.limbs;
+}
+
+static const uint64_t *natural_limbs_const(const sl_Natural *nat)
+{
+  return (nat->capacity == 0) ? &nat->data.small : nat->data.limbs;
+}
+
+static void natural_init(sl_Natural *nat)
+{
+  nat->length = 0;
+  nat->capacity = 0;
+  nat->data.small = 0;
+}
+
+/* Initializes `nat` to `length` zero limbs. */
+static void natural_init_zeroed(sl_Natural *nat, size_t length)
+{
+  natural_init(nat);
+  if (length > 1) {
+    nat->data.limbs = SL_MALLOC(sizeof(uint64_t) * length);
+    memset(nat->data.limbs, 0, sizeof(uint64_t) * length);
+    nat->capacity = length;
+  }
+  nat->length = length;
+}
+
+/* Drops leading zero limbs, and moves a number that now fits in one limb
+   back inline. */
+static void natural_normalize(sl_Natural *nat)
+{
+  const uint64_t *limbs = natural_limbs_const(nat);
+  while (nat->length > 0 && limbs[nat->length - 1] == 0)
+    --nat->length;
+  if (nat->capacity > 0 && nat->length <= 1) {
+    uint64_t small = (nat->length == 1) ? limbs[0] : 0;
+    SL_FREE(nat->data.limbs);
+    nat->capacity = 0;
+    nat->data.small = small;
+  }
+}
+
+int sl_natural_from_digits(const char *digits, size_t n_digits,
+  sl_Natural *nat)
 {
   /* TODO: hex? */
-  sl_Natural ten, digit, tmp;
-  int err;
+  uint64_t *limbs;
 
-  err = sl_natural_from_uint64_t(0, nat);
-  PROPAGATE_ERROR(err);
-  err = sl_natural_from_uint64_t(10, &ten);
-  PROPAGATE_ERROR(err);
+  natural_init(nat);
+  if (n_digits == 0)
+    return 1;
 
   /* Make sure every character is a decimal digit. */
-  for (const char *c = str; *c != '\0'; ++c) {
-    if (!isdigit(*c))
+  for (size_t i = 0; i < n_digits; ++i) {
+    if (!isdigit(digits[i]))
       return 1;
   }
 
-  /* Construct the value. */
-  for (const char *c = str; *c != '\0'; ++c) {
-    uint64_t digit_64;
-    digit_64 = *c - '0';
-    err = sl_natural_from_uint64_t(digit_64, &digit);
-    PROPAGATE_ERROR(err);
-
-    /* Multiply the number by ten, then add the next digit. */
-    sl_natural_multiply(*nat, ten, &tmp);
-    sl_natural_free(nat);
-    sl_natural_copy(tmp, nat);
-    sl_natural_free(&tmp);
-    sl_natural_add(*nat, digit, &tmp);
-    sl_natural_free(nat);
-    sl_natural_copy(tmp, nat);
-    sl_natural_free(&tmp);
-
-    sl_natural_free(&digit);
+  /* Each chunk of 19 digits needs less than one limb. */
+  natural_init_zeroed(nat, n_digits / DECIMAL_CHUNK_DIGITS + 1);
+  nat->length = 0;
+  limbs = natural_limbs(nat);
+
+  /* Construct the value a chunk at a time, starting with the leftover
+     digits so that the rest are whole chunks. */
+  const char *c = digits;
+  const char *end = digits + n_digits;
+  size_t chunk_digits = n_digits % DECIMAL_CHUNK_DIGITS;
+  if (chunk_digits == 0)
+    chunk_digits = DECIMAL_CHUNK_DIGITS;
+  while (c != end) {
+    uint64_t chunk = 0, base = 1;
+    for (size_t i = 0; i < chunk_digits; ++i, ++c) {
+      chunk = chunk * 10 + (uint64_t)(*c - '0');
+      base *= 10;
+    }
+    chunk_digits = DECIMAL_CHUNK_DIGITS;
+
+    /* Multiply the number by `base`, then add the chunk. */
+    uint64_t carry = chunk;
+    for (size_t i = 0; i < nat->length; ++i) {
+      uint128_t t = (uint128_t)limbs[i] * base + carry;
+      limbs[i] = (uint64_t)t;
+      carry = (uint64_t)(t >> 64);
+    }
+    if (carry != 0)
+      limbs[nat->length++] = carry;
   }
-
-  sl_natural_free(&ten);
+  natural_normalize(nat);
   return 0;
 }
 
+int sl_natural_from_string(const char *str, sl_Natural *nat)
+{
+  return sl_natural_from_digits(str, strlen(str), nat);
+}
+
 int sl_natural_from_uint64_t(uint64_t n, sl_Natural *nat)
 {
-  ARR_INIT_RESERVE(nat->digits, 1);
-  ARR_APPEND(nat->digits, n);
-  return 0; /* TODO: validate array operations. */
+  natural_init(nat);
+  nat->data.small = n;
+  nat->length = (n != 0) ? 1 : 0;
+  return 0;
 }
 
-int sl_natural_copy(sl_Natural src, sl_Natural *dst)
+int sl_natural_from_limbs(const uint64_t *limbs, size_t length,
+  sl_Natural *nat)
+{
+  natural_init_zeroed(nat, length);
+  if (length > 0)
+    memcpy(natural_limbs(nat), limbs, sizeof(uint64_t) * length);
+  natural_normalize(nat);
+  return 0;
+}
+
+const uint64_t *sl_natural_get_limbs(const sl_Natural *nat)
+{
+  return natural_limbs_const(nat);
+}
+
+char *sl_natural_to_string(sl_Natural nat)
 {
-  ARR_INIT_RESERVE(dst->digits, ARR_LENGTH(src.digits));
-  for (size_t i = 0; i < ARR_LENGTH(src.digits); ++i) {
-    uint64_t digit;
-    digit = *ARR_GET(src.digits, i);
-    ARR_APPEND(dst->digits, digit);
+  size_t n = nat.length;
+  uint64_t *work, *chunks;
+  size_t n_chunks = 0;
+  char *str;
+  int len;
+
+  if (n == 0)
+    return SL_STRDUP("0");
+
+  /* Peel off 19 digits at a time from the bottom. A limb holds at most
+     19.3 digits. */
+  work = SL_MALLOC(sizeof(uint64_t) * n);
+  memcpy(work, natural_limbs_const(&nat), sizeof(uint64_t) * n);
+  chunks = SL_MALLOC(sizeof(uint64_t) * (n * 20 / DECIMAL_CHUNK_DIGITS + 2));
+  while (n > 0) {
+    chunks[n_chunks++] = limbs_divide_single(work, work, n,
+        DECIMAL_CHUNK_BASE);
+    while (n > 0 && work[n - 1] == 0)
+      --n;
   }
+
+  str = SL_MALLOC(n_chunks * DECIMAL_CHUNK_DIGITS + 1);
+  len = sprintf(str, "%llu", (unsigned long long)chunks[n_chunks - 1]);
+  for (size_t i = n_chunks - 1; i > 0; --i)
+    len += sprintf(str + len, "%019llu", (unsigned long long)chunks[i - 1]);
+  SL_FREE(chunks);
+  SL_FREE(work);
+  return str;
+}
+
+int sl_natural_copy(sl_Natural src, sl_Natural *dst)
+{
+  natural_init_zeroed(dst, src.length);
+  if (src.length > 0)
+    memcpy(natural_limbs(dst), natural_limbs_const(&src),
+        sizeof(uint64_t) * src.length);
   return 0;
 }
 
 void sl_natural_free(sl_Natural *nat)
 {
-  ARR_FREE(nat->digits);
+  if (nat->capacity > 0)
+    SL_FREE(nat->data.limbs);
+  natural_init(nat);
+}
+
+static int natural_compare(const sl_Natural *a, const sl_Natural *b)
+{
+  return limbs_compare(natural_limbs_const(a), a->length,
+      natural_limbs_const(b), b->length);
 }
 
 bool sl_natural_equal(sl_Natural a, sl_Natural b)
 {
-  /* It's okay if the number of digits differ, as long as the leading digits
-     are all zero. */
-  if (ARR_LENGTH(a.digits) > ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(a.digits) - ARR_LENGTH(b.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(a.digits, i);
-      if (digit != 0)
-        return FALSE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(b.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i + leading);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit != b_digit)
-        return FALSE;
-    }
-  } else if (ARR_LENGTH(a.digits) < ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(b.digits) - ARR_LENGTH(a.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(b.digits, i);
-      if (digit != 0)
-        return FALSE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i + leading);
-      if (a_digit != b_digit)
-        return FALSE;
-    }
-  } else { /* ARR_LENGTH(a.digits) == ARR_LENGTH(b.digits) */
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit != b_digit)
-        return FALSE;
-    }
-  }
-  return TRUE;
+  return natural_compare(&a, &b) == 0;
+}
+
+uint64_t sl_natural_hash(uint64_t hash, sl_Natural nat)
+{
+  const uint64_t *limbs = natural_limbs_const(&nat);
+  hash = sl_hash_uint64(hash, nat.length);
+  for (size_t i = 0; i < nat.length; ++i)
+    hash = sl_hash_uint64(hash, limbs[i]);
+  return hash;
 }
 
 bool sl_natural_less_than(sl_Natural a, sl_Natural b)
 {
-  if (ARR_LENGTH(a.digits) > ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(a.digits) - ARR_LENGTH(b.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(a.digits, i);
-      if (digit != 0)
-        return FALSE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(b.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i + leading);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit < b_digit)
-        return TRUE;
-      else if (a_digit > b_digit)
-        return FALSE;
-    }
-    return FALSE; /* a == b */
-  } else if (ARR_LENGTH(a.digits) < ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(b.digits) - ARR_LENGTH(a.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(b.digits, i);
-      if (digit != 0)
-          return TRUE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i + leading);
-      if (a_digit < b_digit)
-        return TRUE;
-      if (a_digit > b_digit)
-        return FALSE;
-    }
-    return FALSE; /* a == b */
-  } else { /* ARR_LENGTH(a.digits) == ARR_LENGTH(b.digits) */
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit < b_digit)
-        return TRUE;
-      else if (a_digit > b_digit)
-        return FALSE;
-    }
-    return FALSE; /* a == b */
-  }
+  return natural_compare(&a, &b) < 0;
 }
 
 bool sl_natural_less_than_equal(sl_Natural a, sl_Natural b)
 {
-  if (ARR_LENGTH(a.digits) > ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(a.digits) - ARR_LENGTH(b.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(a.digits, i);
-      if (digit != 0)
-        return FALSE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(b.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i + leading);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit < b_digit)
-        return TRUE;
-      else if (a_digit > b_digit)
-        return FALSE;
-    }
-    return TRUE; /* a == b */
-  } else if (ARR_LENGTH(a.digits) < ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(b.digits) - ARR_LENGTH(a.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(b.digits, i);
-      if (digit != 0)
-          return TRUE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i + leading);
-      if (a_digit < b_digit)
-        return TRUE;
-      if (a_digit > b_digit)
-        return FALSE;
-    }
-    return TRUE; /* a == b */
-  } else { /* ARR_LENGTH(a.digits) == ARR_LENGTH(b.digits) */
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit < b_digit)
-        return TRUE;
-      else if (a_digit > b_digit)
-        return FALSE;
-    }
-    return TRUE; /* a == b */
-  }
+  return natural_compare(&a, &b) <= 0;
 }
 
 bool sl_natural_greater_than(sl_Natural a, sl_Natural b)
@@ -239,106 +462,125 @@ bool sl_natural_greater_than_equal(sl_Natural a, sl_Natural b)
 
 int sl_natural_add(sl_Natural a, sl_Natural b, sl_Natural *result)
 {
-  if (ARR_LENGTH(a.digits) > ARR_LENGTH(b.digits)) {
-    size_t leading;
-    uint64_t carry;
-    sl_Natural sum;
-    int err;
-    err = sl_natural_from_uint64_t(0, &sum);
-    PROPAGATE_ERROR(err);
-    leading = ARR_LENGTH(a.digits) - ARR_LENGTH(b.digits);
-    for (size_t i = 0; i < ARR_LENGTH(b.digits); ++i) {
-      uint64_t a_digit, b_digit, digit_sum, carry;
-      a_digit = *ARR_GET(a.digits, ARR_LENGTH(a.digits) - (i + 1));
-      b_digit = *ARR_GET(b.digits, ARR_LENGTH(b.digits) - (i + 1));
-      digit_sum = a_digit + b_digit;
-      if (digit_sum < a_digit)
-        carry = 1;
-    }
+  if (a.length < b.length) {
+    sl_Natural tmp = a;
+    a = b;
+    b = tmp;
   }
-#if 0
-  if (ARR_LENGTH(a.digits) > ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(a.digits) - ARR_LENGTH(b.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(a.digits, i);
-      if (digit != 0)
-        return FALSE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(b.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i + leading);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit < b_digit)
-        return TRUE;
-      else if (a_digit > b_digit)
-        return FALSE;
-    }
-    return TRUE; /* a == b */
-  } else if (ARR_LENGTH(a.digits) < ARR_LENGTH(b.digits)) {
-    size_t leading;
-    leading = ARR_LENGTH(b.digits) - ARR_LENGTH(a.digits);
-    for (size_t i = 0; i < leading; ++i) {
-      uint64_t digit;
-      digit = *ARR_GET(b.digits, i);
-      if (digit != 0)
-          return TRUE;
-    }
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i + leading);
-      if (a_digit < b_digit)
-        return TRUE;
-      if (a_digit > b_digit)
-        return FALSE;
-    }
-    return TRUE; /* a == b */
-  } else { /* ARR_LENGTH(a.digits) == ARR_LENGTH(b.digits) */
-    for (size_t i = 0; i < ARR_LENGTH(a.digits); ++i) {
-      uint64_t a_digit, b_digit;
-      a_digit = *ARR_GET(a.digits, i);
-      b_digit = *ARR_GET(b.digits, i);
-      if (a_digit < b_digit)
-        return TRUE;
-      else if (a_digit > b_digit)
-        return FALSE;
-    }
-    return TRUE; /* a == b */
+  if (a.length <= 1) {
+    uint128_t sum = (uint128_t)a.data.small + b.data.small;
+    if ((sum >> 64) == 0)
+      return sl_natural_from_uint64_t((uint64_t)sum, result);
   }
-#endif
+
+  natural_init_zeroed(result, a.length + 1);
+  uint64_t *r = natural_limbs(result);
+  r[a.length] = limbs_add(r, natural_limbs_const(&a), a.length,
+      natural_limbs_const(&b), b.length);
+  natural_normalize(result);
+  return 0;
+}
+
+int sl_natural_subtract(sl_Natural a, sl_Natural b, sl_Natural *result)
+{
+  if (natural_compare(&a, &b) < 0) {
+    natural_init(result);
+    return 1;
+  }
+  if (a.length <= 1)
+    return sl_natural_from_uint64_t(a.data.small - b.data.small, result);
+
+  natural_init_zeroed(result, a.length);
+  limbs_subtract(natural_limbs(result), natural_limbs_const(&a), a.length,
+      natural_limbs_const(&b), b.length);
+  natural_normalize(result);
+  return 0;
 }
 
 int sl_natural_multiply(sl_Natural a, sl_Natural b, sl_Natural *result)
 {
+  if (a.length == 0 || b.length == 0)
+    return sl_natural_from_uint64_t(0, result);
+  if (a.length == 1 && b.length == 1) {
+    uint128_t product = (uint128_t)a.data.small * b.data.small;
+    if ((product >> 64) == 0)
+      return sl_natural_from_uint64_t((uint64_t)product, result);
+  }
 
+  natural_init_zeroed(result, a.length + b.length);
+  limbs_multiply(natural_limbs(result), natural_limbs_const(&a), a.length,
+      natural_limbs_const(&b), b.length);
+  natural_normalize(result);
+  return 0;
 }
 
-int sl_natural_divide(sl_Natural a, sl_Natural b, sl_Natural *result)
+int sl_natural_divide_with_remainder(sl_Natural a, sl_Natural b,
+    sl_Natural *quotient, sl_Natural *remainder)
 {
+  if (b.length == 0) {
+    natural_init(quotient);
+    natural_init(remainder);
+    return 1;
+  }
+  if (natural_compare(&a, &b) < 0) {
+    natural_init(quotient);
+    return sl_natural_copy(a, remainder);
+  }
+  if (a.length == 1) {
+    sl_natural_from_uint64_t(a.data.small / b.data.small, quotient);
+    return sl_natural_from_uint64_t(a.data.small % b.data.small, remainder);
+  }
 
+  natural_init_zeroed(quotient, a.length - b.length + 1);
+  if (b.length == 1) {
+    uint64_t r = limbs_divide_single(natural_limbs(quotient),
+        natural_limbs_const(&a), a.length, b.data.small);
+    sl_natural_from_uint64_t(r, remainder);
+  } else {
+    natural_init_zeroed(remainder, b.length);
+    limbs_divide(natural_limbs(quotient), natural_limbs(remainder),
+        natural_limbs_const(&a), a.length, natural_limbs_const(&b), b.length);
+    natural_normalize(remainder);
+  }
+  natural_normalize(quotient);
+  return 0;
 }
 
-int sl_natural_modulo(sl_Natural a, sl_Natural b, sl_Natural *result)
+int sl_natural_divide(sl_Natural a, sl_Natural b, sl_Natural *result)
 {
+  sl_Natural remainder;
+  int err = sl_natural_divide_with_remainder(a, b, result, &remainder);
+  sl_natural_free(&remainder);
+  return err;
+}
 
+int sl_natural_modulo(sl_Natural a, sl_Natural b, sl_Natural *result)
+{
+  sl_Natural quotient;
+  int err = sl_natural_divide_with_remainder(a, b, &quotient, result);
+  sl_natural_free(&quotient);
+  return err;
 }
 
-struct sl_Integer {
-  bool is_positive;
-  sl_Natural absolute_value;
-};
+/* --- Integers. */
+static void integer_fix_sign(sl_Integer *intg)
+{
+  if (intg->absolute_value.length == 0)
+    intg->is_positive = TRUE;
+}
 
 int sl_integer_from_string(const char *str, sl_Integer *intg)
 {
+  int err;
   if (str[0] == '-') {
     intg->is_positive = FALSE;
-    return sl_natural_from_string(&str[1], &intg->absolute_value);
+    err = sl_natural_from_string(&str[1], &intg->absolute_value);
   } else {
     intg->is_positive = TRUE;
-    return sl_natural_from_string(str, &intg->absolute_value);
+    err = sl_natural_from_string(str, &intg->absolute_value);
   }
+  integer_fix_sign(intg);
+  return err;
 }
 
 int sl_integer_from_int64_t(int64_t n, sl_Integer *intg)
@@ -346,7 +588,7 @@ int sl_integer_from_int64_t(int64_t n, sl_Integer *intg)
   uint64_t absolute_value_64;
   if (n < 0) {
     intg->is_positive = FALSE;
-    absolute_value_64 = (uint64_t)(-n);
+    absolute_value_64 = -(uint64_t)n;
   } else {
     intg->is_positive = TRUE;
     absolute_value_64 = (uint64_t)(n);
@@ -360,10 +602,22 @@ int sl_integer_from_natural(sl_Natural nat, sl_Integer *intg)
   return sl_natural_copy(nat, &intg->absolute_value);
 }
 
+char *sl_integer_to_string(sl_Integer intg)
+{
+  char *abs_str = sl_natural_to_string(intg.absolute_value);
+  if (intg.is_positive)
+    return abs_str;
+  char *str = SL_MALLOC(strlen(abs_str) + 2);
+  str[0] = '-';
+  strcpy(str + 1, abs_str);
+  SL_FREE(abs_str);
+  return str;
+}
+
 int sl_integer_copy(sl_Integer src, sl_Integer *dst)
 {
   dst->is_positive = src.is_positive;
-  return sl_natural_copy(dst->absolute_value, &src.absolute_value);
+  return sl_natural_copy(src.absolute_value, &dst->absolute_value);
 }
 
 void sl_integer_free(sl_Integer *intg)
@@ -406,24 +660,39 @@ bool sl_integer_greater_than_equal(sl_Integer a, sl_Integer b)
 
 int sl_integer_add(sl_Integer a, sl_Integer b, sl_Integer *result)
 {
+  int err;
   if (a.is_positive == b.is_positive) {
     result->is_positive = a.is_positive;
-    return sl_natural_add(a.absolute_value, b.absolute_value,
+    err = sl_natural_add(a.absolute_value, b.absolute_value,
+        &result->absolute_value);
+  } else if (sl_natural_less_than(a.absolute_value, b.absolute_value)) {
+    /* The sign is that of the term with the larger absolute value. */
+    result->is_positive = b.is_positive;
+    err = sl_natural_subtract(b.absolute_value, a.absolute_value,
         &result->absolute_value);
   } else {
-
+    result->is_positive = a.is_positive;
+    err = sl_natural_subtract(a.absolute_value, b.absolute_value,
+        &result->absolute_value);
   }
+  integer_fix_sign(result);
+  return err;
 }
 
 int sl_integer_negate(sl_Integer n, sl_Integer *result)
 {
-  result->is_positive = !result->is_positive;
-  return sl_natural_copy(n.absolute_value, &result->absolute_value);
+  result->is_positive = !n.is_positive;
+  int err = sl_natural_copy(n.absolute_value, &result->absolute_value);
+  integer_fix_sign(result);
+  return err;
 }
 
 int sl_integer_subtract(sl_Integer a, sl_Integer b, sl_Integer *result)
 {
-
+  /* Shares the limbs of `b`, so it must not be freed. */
+  sl_Integer negated_b = b;
+  negated_b.is_positive = !b.is_positive;
+  return sl_integer_add(a, negated_b, result);
 }
 
 int sl_integer_multiply(sl_Integer a, sl_Integer b, sl_Integer *result)
@@ -435,6 +704,7 @@ int sl_integer_multiply(sl_Integer a, sl_Integer b, sl_Integer *result)
     result->is_positive = TRUE;
   else
     result->is_positive = FALSE;
+  integer_fix_sign(result);
   return err;
 }
 
@@ -447,10 +717,16 @@ int sl_integer_divide(sl_Integer a, sl_Integer b, sl_Integer *result)
     result->is_positive = TRUE;
   else
     result->is_positive = FALSE;
+  integer_fix_sign(result);
   return err;
 }
 
 int sl_integer_modulo(sl_Integer a, sl_Integer b, sl_Integer *result)
 {
-
+  int err;
+  err = sl_natural_modulo(a.absolute_value, b.absolute_value,
+      &result->absolute_value);
+  result->is_positive = a.is_positive;
+  integer_fix_sign(result);
+  return err;
 }
@@ -0,0 +1,1421 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Symbols
+#include "artifact.h"
+#include "core.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* An artifact is a sequence of little endian words:
+
+     header      "SLCM", the version, the hash of the source, and the hash of
+                 the rest of the artifact (two words each)
+     strings     a count, the number of those that the file added to the
+                 state (which come first), then each string as its length in
+                 bytes followed by its bytes, padded to a whole word
+     references  a count, then for each symbol referred to: its path,
+                 whether it is from elsewhere, and if it is, its fingerprint
+                 (two words)
+     imports     a count, then the string of each import
+     lookups     a count, then for each lookup: the number of paths tried,
+                 the paths, the index of the one that was found (or NO_INDEX),
+                 and whether that one is from elsewhere
+     symbols     a count, then each symbol of the file, in the order in which
+                 they were added
+
+   A path is a count followed by its strings. Everything else refers to
+   strings and symbols by their index in these tables, values included, so
+   that nothing depends on the ids of the state the artifact was written
+   from. */
+#define ARTIFACT_MAGIC 0x4D434C53 /* "SLCM". */
+#define ARTIFACT_VERSION 1
+#define NO_INDEX UINT32_MAX
+
+#define TYPE_ATOMIC 0x01
+#define TYPE_BINDS 0x02
+#define TYPE_DUMMIES 0x04
+#define TYPE_NUMERALS 0x08
+
+typedef ARR(uint32_t) WordArray;
+
+static char *
+artifact_path(const char *source_path)
+{
+  char *path;
+  size_t length = strlen(source_path);
+  if (length > 3 && strcmp(source_path + length - 3, ".sl") == 0)
+    asprintf(&path, "%sc", source_path);
+  else
+    asprintf(&path, "%s.slc", source_path);
+  return path;
+}
+
+/* Reads a whole file into memory. Returns NULL if it cannot be read. */
+static unsigned char *
+read_file(const char *path, size_t *size)
+{
+  FILE *f = fopen(path, "rb");
+  unsigned char *data;
+  long length;
+  if (f == NULL)
+    return NULL;
+  if (fseek(f, 0, SEEK_END) != 0 || (length = ftell(f)) < 0
+      || fseek(f, 0, SEEK_SET) != 0)
+  {
+    fclose(f);
+    return NULL;
+  }
+  data = SL_MALLOC((size_t)length + 1);
+  if (fread(data, 1, (size_t)length, f) != (size_t)length)
+  {
+    SL_FREE(data);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+  *size = (size_t)length;
+  return data;
+}
+
+static bool
+hash_source(const char *source_path, uint64_t *hash)
+{
+  size_t size;
+  unsigned char *data = read_file(source_path, &size);
+  if (data == NULL)
+    return FALSE;
+  *hash = sl_hash_bytes(SL_HASH_INIT, data, size);
+  SL_FREE(data);
+  return TRUE;
+}
+
+/* --- Recording --- */
+struct IdRange
+{
+  uint32_t begin;
+  uint32_t end;
+};
+typedef ARR(struct IdRange) IdRangeArray;
+
+struct RecordedLookup
+{
+  ARR(sl_SymbolPath *) candidates;
+  uint32_t result; /* The index of the candidate found, or NO_INDEX. */
+  uint64_t hash;
+};
+
+struct sl_ModuleRecord
+{
+  bool enabled;
+
+  /* The symbols and strings that the file added itself. */
+  IdRangeArray own_symbols;
+  IdRangeArray own_strings;
+  uint32_t symbols_begin;
+  uint32_t strings_begin;
+
+  ARR(char *) imports;
+
+  /* Most names are looked up many times, so the lookups are also kept in an
+     open addressing set (of their indices plus one, with a power of two
+     capacity) that lets each one be recorded once. */
+  ARR(struct RecordedLookup) lookups;
+  uint32_t *lookup_slots;
+  size_t lookup_capacity;
+};
+
+#define LOOKUP_INITIAL_CAPACITY 256
+
+sl_ModuleRecord *
+sl_new_module_record(const sl_LogicState *state)
+{
+  sl_ModuleRecord *record = SL_NEW(sl_ModuleRecord);
+  if (record == NULL)
+    return NULL;
+  record->enabled = TRUE;
+  ARR_INIT(record->own_symbols);
+  ARR_INIT(record->own_strings);
+  record->symbols_begin = (uint32_t)sl_logic_count_symbols(state);
+  record->strings_begin = (uint32_t)ARR_LENGTH(state->string_table);
+  ARR_INIT(record->imports);
+  ARR_INIT(record->lookups);
+  record->lookup_capacity = LOOKUP_INITIAL_CAPACITY;
+  record->lookup_slots = SL_MALLOC(sizeof(uint32_t) * record->lookup_capacity);
+  memset(record->lookup_slots, 0, sizeof(uint32_t) * record->lookup_capacity);
+  return record;
+}
+
+void
+sl_free_module_record(sl_ModuleRecord *record)
+{
+  if (record == NULL)
+    return;
+  ARR_FREE(record->own_symbols);
+  ARR_FREE(record->own_strings);
+  for (size_t i = 0; i < ARR_LENGTH(record->imports); ++i)
+    SL_FREE(*ARR_GET(record->imports, i));
+  ARR_FREE(record->imports);
+  for (size_t i = 0; i < ARR_LENGTH(record->lookups); ++i)
+  {
+    struct RecordedLookup *lookup = ARR_GET(record->lookups, i);
+    for (size_t j = 0; j < ARR_LENGTH(lookup->candidates); ++j)
+      sl_free_symbol_path(*ARR_GET(lookup->candidates, j));
+    ARR_FREE(lookup->candidates);
+  }
+  ARR_FREE(record->lookups);
+  SL_FREE(record->lookup_slots);
+  SL_FREE(record);
+}
+
+static uint64_t
+hash_lookup(sl_SymbolPath * const *candidates, size_t n, uint32_t result)
+{
+  uint64_t hash = sl_hash_uint64(SL_HASH_INIT, n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    const sl_SymbolPath *path = candidates[i];
+    hash = sl_hash_uint64(hash, ARR_LENGTH(path->segments));
+    hash = sl_hash_bytes(hash, path->segments.data,
+      sizeof(uint32_t) * ARR_LENGTH(path->segments));
+  }
+  return sl_hash_uint64(hash, result);
+}
+
+static bool
+lookup_recorded_as(const struct RecordedLookup *lookup,
+  sl_SymbolPath * const *candidates, size_t n, uint32_t result)
+{
+  if (lookup->result != result || ARR_LENGTH(lookup->candidates) != n)
+    return FALSE;
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (!sl_symbol_paths_equal(*ARR_GET(lookup->candidates, i),
+        candidates[i]))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+grow_lookup_slots(sl_ModuleRecord *record)
+{
+  size_t capacity = 2 * record->lookup_capacity;
+  uint32_t *slots = SL_MALLOC(sizeof(uint32_t) * capacity);
+  memset(slots, 0, sizeof(uint32_t) * capacity);
+  for (size_t i = 0; i < ARR_LENGTH(record->lookups); ++i)
+  {
+    size_t slot = (size_t)ARR_GET(record->lookups, i)->hash & (capacity - 1);
+    while (slots[slot] != 0)
+      slot = (slot + 1) & (capacity - 1);
+    slots[slot] = (uint32_t)i + 1;
+  }
+  SL_FREE(record->lookup_slots);
+  record->lookup_slots = slots;
+  record->lookup_capacity = capacity;
+}
+
+void
+sl_module_record_lookup(sl_ModuleRecord *record,
+  sl_SymbolPath * const *candidates, const sl_SymbolPath *result)
+{
+  size_t n = 0;
+  uint32_t result_index = NO_INDEX;
+  if (!record->enabled)
+    return;
+  for (; candidates[n] != NULL; ++n)
+  {
+    if (result != NULL && result_index == NO_INDEX
+        && sl_symbol_paths_equal(candidates[n], result))
+      result_index = (uint32_t)n;
+  }
+  if (result != NULL && result_index == NO_INDEX)
+  {
+    /* Found somewhere other than where it was looked for. */
+    record->enabled = FALSE;
+    return;
+  }
+
+  uint64_t hash = hash_lookup(candidates, n, result_index);
+  if (2 * (ARR_LENGTH(record->lookups) + 1) > record->lookup_capacity)
+    grow_lookup_slots(record);
+  size_t slot = (size_t)hash & (record->lookup_capacity - 1);
+  while (record->lookup_slots[slot] != 0)
+  {
+    const struct RecordedLookup *lookup = ARR_GET(record->lookups,
+      record->lookup_slots[slot] - 1);
+    if (lookup->hash == hash
+        && lookup_recorded_as(lookup, candidates, n, result_index))
+      return;
+    slot = (slot + 1) & (record->lookup_capacity - 1);
+  }
+
+  struct RecordedLookup lookup;
+  ARR_INIT_RESERVE(lookup.candidates, n);
+  for (size_t i = 0; i < n; ++i)
+    ARR_APPEND(lookup.candidates, sl_copy_symbol_path(candidates[i]));
+  lookup.result = result_index;
+  lookup.hash = hash;
+  ARR_APPEND(record->lookups, lookup);
+  record->lookup_slots[slot] = (uint32_t)ARR_LENGTH(record->lookups);
+}
+
+static void
+close_range(IdRangeArray *ranges, uint32_t begin, uint32_t end)
+{
+  if (end > begin)
+  {
+    struct IdRange range;
+    range.begin = begin;
+    range.end = end;
+    ARR_APPEND(*ranges, range);
+  }
+}
+
+static void
+close_own_ranges(sl_ModuleRecord *record, const sl_LogicState *state)
+{
+  close_range(&record->own_symbols, record->symbols_begin,
+    (uint32_t)sl_logic_count_symbols(state));
+  close_range(&record->own_strings, record->strings_begin,
+    (uint32_t)ARR_LENGTH(state->string_table));
+  sl_module_record_end_import(record, state);
+}
+
+void
+sl_module_record_begin_import(sl_ModuleRecord *record,
+  const sl_LogicState *state, const char *import)
+{
+  close_own_ranges(record, state);
+  ARR_APPEND(record->imports, SL_STRDUP(import));
+}
+
+void
+sl_module_record_end_import(sl_ModuleRecord *record,
+  const sl_LogicState *state)
+{
+  record->symbols_begin = (uint32_t)sl_logic_count_symbols(state);
+  record->strings_begin = (uint32_t)ARR_LENGTH(state->string_table);
+}
+
+void
+sl_module_record_disable(sl_ModuleRecord *record)
+{
+  record->enabled = FALSE;
+}
+
+static bool
+record_owns(const sl_ModuleRecord *record, uint32_t id)
+{
+  for (size_t i = 0; i < ARR_LENGTH(record->own_symbols); ++i)
+  {
+    const struct IdRange *range = ARR_GET(record->own_symbols, i);
+    if (id >= range->begin && id < range->end)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* --- Writing --- */
+struct ArtifactWriter
+{
+  sl_LogicState *state;
+
+  /* The strings and the symbols of the artifact, and for each string and
+     symbol of the state, its index in the artifact (or NO_INDEX). */
+  ARR(const char *) strings;
+  uint32_t *string_index;
+  size_t string_count;
+  ARR(uint32_t) references;
+  uint32_t *reference_index;
+  size_t symbol_count;
+
+  WordArray *out;
+};
+
+static uint32_t
+add_text(struct ArtifactWriter *w, const char *text)
+{
+  ARR_APPEND(w->strings, text);
+  return (uint32_t)ARR_LENGTH(w->strings) - 1;
+}
+
+static uint32_t
+writer_string(void *data, uint32_t id)
+{
+  struct ArtifactWriter *w = (struct ArtifactWriter *)data;
+  if (id >= w->string_count)
+    return NO_INDEX;
+  if (w->string_index[id] == NO_INDEX)
+    w->string_index[id] = add_text(w, logic_state_get_string(w->state, id));
+  return w->string_index[id];
+}
+
+static uint32_t
+writer_symbol(void *data, uint32_t id)
+{
+  struct ArtifactWriter *w = (struct ArtifactWriter *)data;
+  if (id >= w->symbol_count)
+    return NO_INDEX;
+  if (w->reference_index[id] == NO_INDEX)
+  {
+    ARR_APPEND(w->references, id);
+    w->reference_index[id] = (uint32_t)ARR_LENGTH(w->references) - 1;
+  }
+  return w->reference_index[id];
+}
+
+static void
+put(struct ArtifactWriter *w, uint32_t word)
+{
+  ARR_APPEND(*w->out, word);
+}
+
+static void
+put_path(struct ArtifactWriter *w, const sl_SymbolPath *path)
+{
+  put(w, (uint32_t)ARR_LENGTH(path->segments));
+  for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
+    put(w, writer_string(w, *ARR_GET(path->segments, i)));
+}
+
+static void
+put_text(struct ArtifactWriter *w, const char *text)
+{
+  put(w, (text != NULL) ? add_text(w, text) : NO_INDEX);
+}
+
+static void
+put_flat(struct ArtifactWriter *w, const struct FlatValue *flat)
+{
+  struct FlatValueMap map = { &writer_symbol, &writer_string, w };
+  struct FlatValue *copy =
+    SL_MALLOC(sizeof(struct FlatValue) + sizeof(uint32_t) * flat->length);
+  copy->length = flat->length;
+  memcpy(copy->words, flat->words, sizeof(uint32_t) * flat->length);
+  remap_flat_value(copy, &map);
+  put(w, copy->length);
+  for (size_t i = 0; i < copy->length; ++i)
+    put(w, copy->words[i]);
+  free_flat_value(copy);
+}
+
+static void
+put_value(struct ArtifactWriter *w, const Value *value)
+{
+  struct FlatValue *flat = new_flat_value(value);
+  put_flat(w, flat);
+  free_flat_value(flat);
+}
+
+static void
+put_values(struct ArtifactWriter *w, Value * const *values, size_t n)
+{
+  put(w, (uint32_t)n);
+  for (size_t i = 0; i < n; ++i)
+    put_value(w, values[i]);
+}
+
+static void
+put_flat_values(struct ArtifactWriter *w, const FlatValueArray *values)
+{
+  put(w, (uint32_t)ARR_LENGTH(*values));
+  for (size_t i = 0; i < ARR_LENGTH(*values); ++i)
+    put_flat(w, *ARR_GET(*values, i));
+}
+
+static void
+put_parameters(struct ArtifactWriter *w, const struct Parameter *params,
+  size_t n)
+{
+  put(w, (uint32_t)n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    put(w, writer_string(w, params[i].name_id));
+    put(w, writer_symbol(w, params[i].type_id));
+  }
+}
+
+static void
+put_symbol(struct ArtifactWriter *w, const sl_LogicSymbol *sym)
+{
+  put(w, (uint32_t)sym->type);
+  put_path(w, sym->path);
+  switch (sym->type)
+  {
+    case sl_LogicSymbolType_Namespace:
+      break;
+    case sl_LogicSymbolType_Type:
+      {
+        const struct Type *type = (struct Type *)sym->object;
+        put(w, (type->atomic ? TYPE_ATOMIC : 0)
+          | (type->binds ? TYPE_BINDS : 0)
+          | (type->dummies ? TYPE_DUMMIES : 0)
+          | (type->numerals ? TYPE_NUMERALS : 0));
+      }
+      break;
+    case sl_LogicSymbolType_Constant:
+      {
+        const struct Constant *constant = (struct Constant *)sym->object;
+        put(w, writer_symbol(w, constant->type_id));
+        put_text(w, constant->latex_format);
+      }
+      break;
+    case sl_LogicSymbolType_Constspace:
+      put(w, writer_symbol(w, ((struct Constspace *)sym->object)->type_id));
+      break;
+    case sl_LogicSymbolType_Expression:
+      {
+        const struct Expression *expr = (struct Expression *)sym->object;
+        put(w, writer_symbol(w, expr->type_id));
+        put_parameters(w, expr->parameters.data,
+          ARR_LENGTH(expr->parameters));
+        put(w, expr->replace_with != NULL);
+        if (expr->replace_with != NULL)
+          put_value(w, expr->replace_with);
+        put_values(w, expr->bindings.data, ARR_LENGTH(expr->bindings));
+        put(w, expr->has_latex);
+        if (expr->has_latex)
+        {
+          put(w, (uint32_t)ARR_LENGTH(expr->latex.segments));
+          for (size_t i = 0; i < ARR_LENGTH(expr->latex.segments); ++i)
+          {
+            const struct LatexFormatSegment *seg =
+              ARR_GET(expr->latex.segments, i);
+            put(w, seg->is_variable);
+            put_text(w, seg->string);
+          }
+        }
+      }
+      break;
+    case sl_LogicSymbolType_Theorem:
+      {
+        const struct Theorem *thm = (struct Theorem *)sym->object;
+        put(w, thm->is_axiom);
+        put_parameters(w, thm->parameters.data, ARR_LENGTH(thm->parameters));
+        put(w, (uint32_t)ARR_LENGTH(thm->requirements));
+        for (size_t i = 0; i < ARR_LENGTH(thm->requirements); ++i)
+        {
+          const struct Requirement *req = ARR_GET(thm->requirements, i);
+          put(w, (uint32_t)req->type);
+          put_values(w, req->arguments.data, ARR_LENGTH(req->arguments));
+        }
+        put_flat_values(w, &thm->flat_assumptions);
+        put_flat_values(w, &thm->flat_inferences);
+        if (thm->is_axiom)
+          break;
+        put(w, (uint32_t)ARR_LENGTH(thm->steps));
+        for (size_t i = 0; i < ARR_LENGTH(thm->steps); ++i)
+        {
+          const struct TheoremReference *ref = ARR_GET(thm->steps, i);
+          uint32_t theorem_id = NO_INDEX;
+          sl_logic_get_symbol_id(w->state, ref->theorem->path, &theorem_id);
+          put(w, writer_symbol(w, theorem_id));
+          put(w, (uint32_t)ARR_LENGTH(ref->arguments));
+          for (size_t j = 0; j < ARR_LENGTH(ref->arguments); ++j)
+            put_flat(w, *ARR_GET(ref->arguments, j));
+        }
+      }
+      break;
+  }
+}
+
+static uint64_t
+hash_words(uint64_t hash, const uint32_t *words, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    hash = sl_hash_uint64(hash, words[i]);
+  return hash;
+}
+
+static int
+write_words(FILE *f, const WordArray *words)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*words); ++i)
+  {
+    uint32_t word = *ARR_GET(*words, i);
+    unsigned char bytes[4];
+    for (size_t j = 0; j < 4; ++j)
+      bytes[j] = (unsigned char)((word >> (8 * j)) & 0xFF);
+    if (fwrite(bytes, 1, 4, f) != 4)
+      return 1;
+  }
+  return 0;
+}
+
+/* Tells apart the temporary files of the threads of one process. */
+static atomic_uint next_temporary_file = 0;
+
+/* Writes to a temporary file first, so that nothing ever reads an artifact
+   that is only partly written. */
+static int
+write_artifact_file(const char *path, const WordArray *sections,
+  size_t sections_n)
+{
+  char *temporary_path;
+  int err = 0;
+  asprintf(&temporary_path, "%s.%ld.%u.tmp", path, (long)getpid(),
+    atomic_fetch_add(&next_temporary_file, 1));
+  FILE *f = fopen(temporary_path, "wb");
+  if (f == NULL)
+  {
+    SL_FREE(temporary_path);
+    return 1;
+  }
+  for (size_t i = 0; err == 0 && i < sections_n; ++i)
+    err = write_words(f, &sections[i]);
+  if (fclose(f) != 0)
+    err = 1;
+  if (err == 0 && rename(temporary_path, path) != 0)
+    err = 1;
+  if (err != 0)
+    remove(temporary_path);
+  SL_FREE(temporary_path);
+  return err;
+}
+
+int
+sl_module_record_write(sl_ModuleRecord *record, sl_LogicState *state,
+  const char *source_path)
+{
+  struct ArtifactWriter w;
+  WordArray header, strings, references, body;
+  uint64_t source_hash;
+  int err;
+
+  close_own_ranges(record, state);
+  if (!record->enabled || !hash_source(source_path, &source_hash))
+    return 1;
+
+  w.state = state;
+  ARR_INIT(w.strings);
+  w.string_count = ARR_LENGTH(state->string_table);
+  w.string_index = SL_MALLOC(sizeof(uint32_t) * (w.string_count + 1));
+  memset(w.string_index, 0xFF, sizeof(uint32_t) * (w.string_count + 1));
+  ARR_INIT(w.references);
+  w.symbol_count = sl_logic_count_symbols(state);
+  w.reference_index = SL_MALLOC(sizeof(uint32_t) * (w.symbol_count + 1));
+  memset(w.reference_index, 0xFF, sizeof(uint32_t) * (w.symbol_count + 1));
+  ARR_INIT(header);
+  ARR_INIT(strings);
+
+  /* The strings the file added come first, in the order in which it added
+     them, so that adding the artifact to the same state leaves the strings
+     as verifying the file would have. */
+  for (size_t i = 0; i < ARR_LENGTH(record->own_strings); ++i)
+  {
+    const struct IdRange *range = ARR_GET(record->own_strings, i);
+    for (uint32_t id = range->begin; id < range->end; ++id)
+      writer_string(&w, id);
+  }
+  size_t added_strings_n = ARR_LENGTH(w.strings);
+  ARR_INIT(references);
+  ARR_INIT(body);
+
+  /* The body first, since it decides which strings and symbols are in the
+     tables. */
+  w.out = &body;
+  put(&w, (uint32_t)ARR_LENGTH(record->imports));
+  for (size_t i = 0; i < ARR_LENGTH(record->imports); ++i)
+    put_text(&w, *ARR_GET(record->imports, i));
+  put(&w, (uint32_t)ARR_LENGTH(record->lookups));
+  for (size_t i = 0; i < ARR_LENGTH(record->lookups); ++i)
+  {
+    const struct RecordedLookup *lookup = ARR_GET(record->lookups, i);
+    bool elsewhere = FALSE;
+    put(&w, (uint32_t)ARR_LENGTH(lookup->candidates));
+    for (size_t j = 0; j < ARR_LENGTH(lookup->candidates); ++j)
+      put_path(&w, *ARR_GET(lookup->candidates, j));
+    if (lookup->result != NO_INDEX)
+    {
+      uint32_t id;
+      if (sl_logic_get_symbol_id(state,
+          *ARR_GET(lookup->candidates, lookup->result), &id)
+          == sl_LogicError_None)
+        elsewhere = !record_owns(record, id);
+    }
+    put(&w, lookup->result);
+    put(&w, elsewhere);
+  }
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < ARR_LENGTH(record->own_symbols); ++i)
+    {
+      const struct IdRange *range = ARR_GET(record->own_symbols, i);
+      count += range->end - range->begin;
+    }
+    put(&w, (uint32_t)count);
+    for (size_t i = 0; i < ARR_LENGTH(record->own_symbols); ++i)
+    {
+      const struct IdRange *range = ARR_GET(record->own_symbols, i);
+      for (uint32_t id = range->begin; id < range->end; ++id)
+        put_symbol(&w, sl_logic_get_symbol_by_id(state, id));
+    }
+  }
+
+  w.out = &references;
+  put(&w, (uint32_t)ARR_LENGTH(w.references));
+  for (size_t i = 0; i < ARR_LENGTH(w.references); ++i)
+  {
+    uint32_t id = *ARR_GET(w.references, i);
+    bool elsewhere = !record_owns(record, id);
+    put_path(&w, sl_logic_get_symbol_path_by_id(state, id));
+    put(&w, elsewhere);
+    if (elsewhere)
+    {
+      uint64_t fingerprint = sl_logic_symbol_fingerprint(state, id);
+      put(&w, (uint32_t)(fingerprint & 0xFFFFFFFF));
+      put(&w, (uint32_t)(fingerprint >> 32));
+    }
+  }
+
+  w.out = &strings;
+  put(&w, (uint32_t)ARR_LENGTH(w.strings));
+  put(&w, (uint32_t)added_strings_n);
+  for (size_t i = 0; i < ARR_LENGTH(w.strings); ++i)
+  {
+    const char *str = *ARR_GET(w.strings, i);
+    size_t length = strlen(str);
+    put(&w, (uint32_t)length);
+    for (size_t j = 0; j < length; j += 4)
+    {
+      uint32_t word = 0;
+      for (size_t k = 0; k < 4 && j + k < length; ++k)
+        word |= (uint32_t)(unsigned char)str[j + k] << (8 * k);
+      put(&w, word);
+    }
+  }
+
+  uint64_t content_hash = SL_HASH_INIT;
+  content_hash = hash_words(content_hash, strings.data, ARR_LENGTH(strings));
+  content_hash = hash_words(content_hash, references.data,
+    ARR_LENGTH(references));
+  content_hash = hash_words(content_hash, body.data, ARR_LENGTH(body));
+
+  w.out = &header;
+  put(&w, ARTIFACT_MAGIC);
+  put(&w, ARTIFACT_VERSION);
+  put(&w, (uint32_t)(source_hash & 0xFFFFFFFF));
+  put(&w, (uint32_t)(source_hash >> 32));
+  put(&w, (uint32_t)(content_hash & 0xFFFFFFFF));
+  put(&w, (uint32_t)(content_hash >> 32));
+
+  {
+    WordArray sections[] = { header, strings, references, body };
+    char *path = artifact_path(source_path);
+    err = write_artifact_file(path, sections, 4);
+    SL_FREE(path);
+  }
+
+  ARR_FREE(header);
+  ARR_FREE(strings);
+  ARR_FREE(references);
+  ARR_FREE(body);
+  ARR_FREE(w.strings);
+  SL_FREE(w.string_index);
+  ARR_FREE(w.references);
+  SL_FREE(w.reference_index);
+  return err;
+}
+
+/* --- Reading --- */
+struct sl_ModuleArtifact
+{
+  uint32_t *words;
+  size_t length;
+
+  ARR(char *) strings;
+  size_t added_strings_n;
+  ARR(uint32_t) imports; /* Indices of strings. */
+
+  /* Where the sections that are only read when adding to a state begin. */
+  size_t references_at;
+  size_t lookups_at;
+};
+
+struct Cursor
+{
+  const uint32_t *words;
+  size_t length;
+  size_t at;
+  bool failed;
+};
+
+static uint32_t
+next_word(struct Cursor *c)
+{
+  if (c->at >= c->length)
+  {
+    c->failed = TRUE;
+    return 0;
+  }
+  return c->words[c->at++];
+}
+
+/* Moves past `n` words, as long as there are that many left. */
+static void
+skip_words(struct Cursor *c, size_t n)
+{
+  if (n > c->length - c->at)
+  {
+    c->failed = TRUE;
+    c->at = c->length;
+    return;
+  }
+  c->at += n;
+}
+
+static void
+skip_path(struct Cursor *c)
+{
+  skip_words(c, next_word(c));
+}
+
+sl_ModuleArtifact *
+sl_read_module_artifact(const char *source_path)
+{
+  uint64_t source_hash;
+  unsigned char *data;
+  size_t size;
+  struct Cursor c;
+
+  if (!hash_source(source_path, &source_hash))
+    return NULL;
+  {
+    char *path = artifact_path(source_path);
+    data = read_file(path, &size);
+    SL_FREE(path);
+  }
+  if (data == NULL)
+    return NULL;
+  if (size % 4 != 0)
+  {
+    SL_FREE(data);
+    return NULL;
+  }
+
+  sl_ModuleArtifact *artifact = SL_NEW(sl_ModuleArtifact);
+  artifact->length = size / 4;
+  artifact->words = SL_MALLOC(sizeof(uint32_t) * (artifact->length + 1));
+  for (size_t i = 0; i < artifact->length; ++i)
+  {
+    const unsigned char *bytes = data + 4 * i;
+    artifact->words[i] = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8)
+      | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+  }
+  SL_FREE(data);
+  ARR_INIT(artifact->strings);
+  ARR_INIT(artifact->imports);
+
+  c.words = artifact->words;
+  c.length = artifact->length;
+  c.at = 0;
+  c.failed = FALSE;
+  if (next_word(&c) != ARTIFACT_MAGIC || next_word(&c) != ARTIFACT_VERSION
+      || next_word(&c) != (uint32_t)(source_hash & 0xFFFFFFFF)
+      || next_word(&c) != (uint32_t)(source_hash >> 32))
+  {
+    sl_free_module_artifact(artifact);
+    return NULL;
+  }
+  uint64_t content_hash = next_word(&c);
+  content_hash |= (uint64_t)next_word(&c) << 32;
+  if (c.failed || hash_words(SL_HASH_INIT, c.words + c.at, c.length - c.at)
+      != content_hash)
+  {
+    sl_free_module_artifact(artifact);
+    return NULL;
+  }
+
+  size_t strings_n = next_word(&c);
+  artifact->added_strings_n = next_word(&c);
+  if (artifact->added_strings_n > strings_n)
+    c.failed = TRUE;
+  for (size_t i = 0; !c.failed && i < strings_n; ++i)
+  {
+    size_t length = next_word(&c);
+    size_t words_n = length / 4 + (length % 4 != 0);
+    size_t at = c.at;
+    skip_words(&c, words_n);
+    if (c.failed)
+      break;
+    char *str = SL_MALLOC(length + 1);
+    for (size_t j = 0; j < length; ++j)
+      str[j] = (char)((c.words[at + j / 4] >> (8 * (j % 4))) & 0xFF);
+    str[length] = '\0';
+    ARR_APPEND(artifact->strings, str);
+  }
+
+  artifact->references_at = c.at;
+  size_t references_n = next_word(&c);
+  for (size_t i = 0; !c.failed && i < references_n; ++i)
+  {
+    skip_path(&c);
+    if (next_word(&c) != 0)
+      skip_words(&c, 2);
+  }
+
+  size_t imports_n = next_word(&c);
+  for (size_t i = 0; !c.failed && i < imports_n; ++i)
+  {
+    uint32_t import = next_word(&c);
+    if (import >= ARR_LENGTH(artifact->strings))
+      c.failed = TRUE;
+    else
+      ARR_APPEND(artifact->imports, import);
+  }
+  artifact->lookups_at = c.at;
+
+  if (c.failed)
+  {
+    sl_free_module_artifact(artifact);
+    return NULL;
+  }
+  return artifact;
+}
+
+void
+sl_free_module_artifact(sl_ModuleArtifact *artifact)
+{
+  if (artifact == NULL)
+    return;
+  SL_FREE(artifact->words);
+  for (size_t i = 0; i < ARR_LENGTH(artifact->strings); ++i)
+    SL_FREE(*ARR_GET(artifact->strings, i));
+  ARR_FREE(artifact->strings);
+  ARR_FREE(artifact->imports);
+  SL_FREE(artifact);
+}
+
+size_t
+sl_module_artifact_count_imports(const sl_ModuleArtifact *artifact)
+{
+  return ARR_LENGTH(artifact->imports);
+}
+
+const char *
+sl_module_artifact_get_import(const sl_ModuleArtifact *artifact,
+  size_t index)
+{
+  return *ARR_GET(artifact->strings, *ARR_GET(artifact->imports, index));
+}
+
+/* --- Adding to a State --- */
+struct ArtifactLoader
+{
+  const sl_ModuleArtifact *artifact;
+  sl_LogicState *state;
+  struct Cursor c;
+
+  /* For each string of the artifact, its id in the state, or NO_INDEX until
+     it is needed. */
+  uint32_t *string_ids;
+
+  /* For each symbol the artifact refers to, its path, and its id once it
+     has been found (or NO_INDEX). */
+  ARR(sl_SymbolPath *) reference_paths;
+  uint32_t *reference_ids;
+};
+
+static uint32_t
+loader_string(void *data, uint32_t index)
+{
+  struct ArtifactLoader *l = (struct ArtifactLoader *)data;
+  if (index >= ARR_LENGTH(l->artifact->strings))
+    return NO_INDEX;
+  if (l->string_ids[index] == NO_INDEX)
+  {
+    l->string_ids[index] = logic_state_add_string(l->state,
+      *ARR_GET(l->artifact->strings, index));
+  }
+  return l->string_ids[index];
+}
+
+/* The symbols of the file are only found once they have been added, which
+   is always before anything refers to them. */
+static uint32_t
+loader_symbol(void *data, uint32_t index)
+{
+  struct ArtifactLoader *l = (struct ArtifactLoader *)data;
+  if (index >= ARR_LENGTH(l->reference_paths))
+    return NO_INDEX;
+  if (l->reference_ids[index] == NO_INDEX)
+  {
+    uint32_t id;
+    if (sl_logic_get_symbol_id(l->state, *ARR_GET(l->reference_paths, index),
+        &id) != sl_LogicError_None)
+      return NO_INDEX;
+    l->reference_ids[index] = id;
+  }
+  return l->reference_ids[index];
+}
+
+/* The path of a symbol the artifact refers to. Returns NULL, and marks the
+   loader as failed, if there is no such symbol. */
+static const sl_SymbolPath *
+read_reference(struct ArtifactLoader *l)
+{
+  uint32_t id = loader_symbol(l, next_word(&l->c));
+  if (id == NO_INDEX)
+  {
+    l->c.failed = TRUE;
+    return NULL;
+  }
+  return sl_logic_get_symbol_path_by_id(l->state, id);
+}
+
+static const char *
+read_text(struct ArtifactLoader *l)
+{
+  uint32_t index = next_word(&l->c);
+  if (index == NO_INDEX)
+    return NULL;
+  if (index >= ARR_LENGTH(l->artifact->strings))
+  {
+    l->c.failed = TRUE;
+    return NULL;
+  }
+  return *ARR_GET(l->artifact->strings, index);
+}
+
+static sl_SymbolPath *
+read_path(struct ArtifactLoader *l)
+{
+  size_t n = next_word(&l->c);
+  if (l->c.failed || n > l->c.length - l->c.at)
+  {
+    l->c.failed = TRUE;
+    return NULL;
+  }
+  sl_SymbolPath *path = sl_new_symbol_path();
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint32_t id = loader_string(l, next_word(&l->c));
+    if (id == NO_INDEX)
+    {
+      l->c.failed = TRUE;
+      sl_free_symbol_path(path);
+      return NULL;
+    }
+    ARR_APPEND(path->segments, id);
+  }
+  return path;
+}
+
+static Value *
+read_value(struct ArtifactLoader *l)
+{
+  struct FlatValueMap map = { &loader_symbol, &loader_string, l };
+  size_t length = next_word(&l->c);
+  Value *value = NULL;
+  if (l->c.failed || length > l->c.length - l->c.at)
+  {
+    l->c.failed = TRUE;
+    return NULL;
+  }
+  struct FlatValue *flat =
+    SL_MALLOC(sizeof(struct FlatValue) + sizeof(uint32_t) * length);
+  flat->length = (uint32_t)length;
+  memcpy(flat->words, l->c.words + l->c.at, sizeof(uint32_t) * length);
+  l->c.at += length;
+  if (remap_flat_value(flat, &map))
+    value = value_from_flat(l->state, flat);
+  free_flat_value(flat);
+  if (value == NULL)
+    l->c.failed = TRUE;
+  return value;
+}
+
+/* Reads a count and then that many values, into a NULL-terminated list. */
+static void
+read_values(struct ArtifactLoader *l, ValueArray *values)
+{
+  size_t n = next_word(&l->c);
+  ARR_INIT(*values);
+  for (size_t i = 0; !l->c.failed && i < n; ++i)
+  {
+    Value *value = read_value(l);
+    if (value != NULL)
+      ARR_APPEND(*values, value);
+  }
+  ARR_APPEND(*values, NULL);
+}
+
+static void
+free_values(ValueArray *values, bool free_contents)
+{
+  for (size_t i = 0; free_contents && i < ARR_LENGTH(*values); ++i)
+  {
+    if (*ARR_GET(*values, i) != NULL)
+      free_value(*ARR_GET(*values, i));
+  }
+  ARR_FREE(*values);
+}
+
+typedef ARR(struct PrototypeParameter) PrototypeParameterArray;
+
+/* Reads parameters into `storage`, and a NULL-terminated list of them into
+   `list`. */
+static void
+read_parameters(struct ArtifactLoader *l, PrototypeParameterArray *storage,
+  struct PrototypeParameter ***list)
+{
+  size_t n = next_word(&l->c);
+  ARR_INIT(*storage);
+  for (size_t i = 0; !l->c.failed && i < n; ++i)
+  {
+    struct PrototypeParameter param;
+    param.name = (char *)read_text(l);
+    const sl_SymbolPath *type = read_reference(l);
+    if (param.name == NULL || type == NULL)
+    {
+      l->c.failed = TRUE;
+      break;
+    }
+    param.type = sl_copy_symbol_path(type);
+    ARR_APPEND(*storage, param);
+  }
+  *list = SL_MALLOC(sizeof(struct PrototypeParameter *)
+    * (ARR_LENGTH(*storage) + 1));
+  for (size_t i = 0; i < ARR_LENGTH(*storage); ++i)
+    (*list)[i] = ARR_GET(*storage, i);
+  (*list)[ARR_LENGTH(*storage)] = NULL;
+}
+
+static void
+free_parameters(PrototypeParameterArray *storage,
+  struct PrototypeParameter **list)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*storage); ++i)
+    sl_free_symbol_path(ARR_GET(*storage, i)->type);
+  ARR_FREE(*storage);
+  SL_FREE(list);
+}
+
+static sl_LogicError
+add_expression_from_artifact(struct ArtifactLoader *l, sl_SymbolPath *path)
+{
+  struct PrototypeExpression proto;
+  PrototypeParameterArray params;
+  ValueArray bindings;
+  ARR(struct PrototypeLatexFormatSegment) segments;
+  ARR(struct PrototypeLatexFormatSegment *) segment_list;
+  sl_LogicError err = sl_LogicError_InvalidArgument;
+
+  const sl_SymbolPath *type = read_reference(l);
+  proto.expression_path = path;
+  proto.expression_type = (type != NULL) ? sl_copy_symbol_path(type) : NULL;
+  read_parameters(l, &params, &proto.parameters);
+  proto.replace_with = NULL;
+  if (next_word(&l->c) != 0)
+    proto.replace_with = read_value(l);
+  read_values(l, &bindings);
+  proto.bindings = bindings.data;
+  ARR_INIT(segments);
+  ARR_INIT(segment_list);
+  proto.latex.segments = NULL;
+  if (next_word(&l->c) != 0)
+  {
+    size_t n = next_word(&l->c);
+    for (size_t i = 0; !l->c.failed && i < n; ++i)
+    {
+      struct PrototypeLatexFormatSegment seg;
+      seg.is_variable = next_word(&l->c) != 0;
+      seg.string = (char *)read_text(l);
+      if (seg.string == NULL)
+        l->c.failed = TRUE;
+      else
+        ARR_APPEND(segments, seg);
+    }
+    for (size_t i = 0; i < ARR_LENGTH(segments); ++i)
+      ARR_APPEND(segment_list, ARR_GET(segments, i));
+    ARR_APPEND(segment_list, NULL);
+    proto.latex.segments = segment_list.data;
+  }
+
+  if (!l->c.failed)
+    err = add_expression(l->state, proto);
+
+  if (proto.expression_type != NULL)
+    sl_free_symbol_path(proto.expression_type);
+  free_parameters(&params, proto.parameters);
+  if (proto.replace_with != NULL)
+    free_value(proto.replace_with);
+  free_values(&bindings, TRUE);
+  ARR_FREE(segments);
+  ARR_FREE(segment_list);
+  return err;
+}
+
+typedef ARR(ValueArray) ValueArrayArray;
+
+static void
+free_value_arrays(ValueArrayArray *arrays, bool free_contents)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*arrays); ++i)
+    free_values(ARR_GET(*arrays, i), free_contents);
+  ARR_FREE(*arrays);
+}
+
+static sl_LogicError
+add_theorem_from_artifact(struct ArtifactLoader *l, sl_SymbolPath *path)
+{
+  struct PrototypeTheorem proto;
+  PrototypeParameterArray params;
+  ARR(struct PrototypeRequirement) requirements;
+  ARR(struct PrototypeRequirement *) requirement_list;
+  ValueArrayArray requirement_args;
+  ValueArray assumptions, inferences;
+  ARR(struct PrototypeProofStep) steps;
+  ARR(struct PrototypeProofStep *) step_list;
+  ValueArrayArray step_args;
+  sl_LogicError err = sl_LogicError_InvalidArgument;
+  bool taken = FALSE;
+
+  bool is_axiom = next_word(&l->c) != 0;
+  proto.theorem_path = path;
+  read_parameters(l, &params, &proto.parameters);
+
+  ARR_INIT(requirements);
+  ARR_INIT(requirement_list);
+  ARR_INIT(requirement_args);
+  size_t requirements_n = next_word(&l->c);
+  for (size_t i = 0; !l->c.failed && i < requirements_n; ++i)
+  {
+    struct PrototypeRequirement req;
+    ValueArray args;
+    uint32_t type = next_word(&l->c);
+    if (type > RequirementTypeSuccessor)
+      l->c.failed = TRUE;
+    req.require = (char *)requirement_type_name((enum RequirementType)type);
+    req.arguments = NULL;
+    ARR_APPEND(requirements, req);
+    read_values(l, &args);
+    ARR_APPEND(requirement_args, args);
+  }
+  for (size_t i = 0; i < ARR_LENGTH(requirements); ++i)
+  {
+    ARR_GET(requirements, i)->arguments = ARR_GET(requirement_args, i)->data;
+    ARR_APPEND(requirement_list, ARR_GET(requirements, i));
+  }
+  ARR_APPEND(requirement_list, NULL);
+  proto.requirements = requirement_list.data;
+
+  read_values(l, &assumptions);
+  proto.assumptions = assumptions.data;
+  read_values(l, &inferences);
+  proto.inferences = inferences.data;
+
+  ARR_INIT(steps);
+  ARR_INIT(step_list);
+  ARR_INIT(step_args);
+  if (!is_axiom)
+  {
+    size_t steps_n = next_word(&l->c);
+    for (size_t i = 0; !l->c.failed && i < steps_n; ++i)
+    {
+      struct PrototypeProofStep step;
+      ValueArray args;
+      const sl_SymbolPath *theorem = read_reference(l);
+      step.theorem_path = (theorem != NULL)
+        ? sl_copy_symbol_path(theorem) : NULL;
+      read_values(l, &args);
+      step.arguments = NULL;
+      step.arguments_n = ARR_LENGTH(args) - 1;
+      ARR_APPEND(steps, step);
+      ARR_APPEND(step_args, args);
+    }
+  }
+  for (size_t i = 0; i < ARR_LENGTH(steps); ++i)
+  {
+    ARR_GET(steps, i)->arguments = ARR_GET(step_args, i)->data;
+    ARR_APPEND(step_list, ARR_GET(steps, i));
+  }
+  ARR_APPEND(step_list, NULL);
+  proto.steps = step_list.data;
+
+  if (!l->c.failed)
+  {
+    err = is_axiom ? add_axiom_take(l->state, proto)
+      : add_proven_theorem_take(l->state, proto);
+    taken = TRUE;
+  }
+
+  free_parameters(&params, proto.parameters);
+  free_value_arrays(&requirement_args, !taken);
+  ARR_FREE(requirements);
+  ARR_FREE(requirement_list);
+  free_values(&assumptions, !taken);
+  free_values(&inferences, !taken);
+  free_value_arrays(&step_args, !taken);
+  for (size_t i = 0; i < ARR_LENGTH(steps); ++i)
+  {
+    if (ARR_GET(steps, i)->theorem_path != NULL)
+      sl_free_symbol_path(ARR_GET(steps, i)->theorem_path);
+  }
+  ARR_FREE(steps);
+  ARR_FREE(step_list);
+  return err;
+}
+
+static sl_LogicError
+add_symbol_from_artifact(struct ArtifactLoader *l)
+{
+  sl_LogicSymbolType type = (sl_LogicSymbolType)next_word(&l->c);
+  sl_SymbolPath *path = read_path(l);
+  sl_LogicError err = sl_LogicError_InvalidArgument;
+  if (path == NULL)
+    return err;
+  switch (type)
+  {
+    case sl_LogicSymbolType_Namespace:
+      err = sl_logic_make_namespace(l->state, path);
+      break;
+    case sl_LogicSymbolType_Type:
+      {
+        uint32_t flags = next_word(&l->c);
+        if (!l->c.failed)
+        {
+          err = sl_logic_make_type(l->state, path,
+            (flags & TYPE_ATOMIC) != 0, (flags & TYPE_BINDS) != 0,
+            (flags & TYPE_DUMMIES) != 0, (flags & TYPE_NUMERALS) != 0);
+        }
+      }
+      break;
+    case sl_LogicSymbolType_Constant:
+      {
+        const sl_SymbolPath *type_path = read_reference(l);
+        const char *latex = read_text(l);
+        if (!l->c.failed)
+          err = sl_logic_make_constant(l->state, path, type_path, latex);
+      }
+      break;
+    case sl_LogicSymbolType_Constspace:
+      {
+        const sl_SymbolPath *type_path = read_reference(l);
+        if (!l->c.failed)
+          err = sl_logic_make_constspace(l->state, path, type_path);
+      }
+      break;
+    case sl_LogicSymbolType_Expression:
+      err = add_expression_from_artifact(l, path);
+      break;
+    case sl_LogicSymbolType_Theorem:
+      err = add_theorem_from_artifact(l, path);
+      break;
+    default:
+      l->c.failed = TRUE;
+      break;
+  }
+  sl_free_symbol_path(path);
+  return err;
+}
+
+/* Every name the file looked up must resolve as it did: none of the paths
+   tried before the one that was found may have been taken since, and a
+   symbol from elsewhere must still be there. The file's own symbols are
+   added in the same order as before, so looking up one of those cannot
+   come out differently once the rest holds. */
+static void
+check_lookups(struct ArtifactLoader *l)
+{
+  size_t n = next_word(&l->c);
+  ARR(sl_SymbolPath *) candidates;
+  ARR_INIT(candidates);
+  for (size_t i = 0; !l->c.failed && i < n; ++i)
+  {
+    size_t candidates_n = next_word(&l->c);
+    for (size_t j = 0; !l->c.failed && j < candidates_n; ++j)
+    {
+      sl_SymbolPath *path = read_path(l);
+      if (path != NULL)
+        ARR_APPEND(candidates, path);
+    }
+    uint32_t result = next_word(&l->c);
+    bool elsewhere = next_word(&l->c) != 0;
+    if (!l->c.failed && result != NO_INDEX && result >= candidates_n)
+      l->c.failed = TRUE;
+    size_t unoccupied_n = (result == NO_INDEX) ? candidates_n : result;
+    for (size_t j = 0; !l->c.failed && j < unoccupied_n; ++j)
+    {
+      if (logic_state_path_occupied(l->state, *ARR_GET(candidates, j)))
+        l->c.failed = TRUE;
+    }
+    if (!l->c.failed && result != NO_INDEX && elsewhere
+        && !logic_state_path_occupied(l->state, *ARR_GET(candidates, result)))
+      l->c.failed = TRUE;
+    for (size_t j = 0; j < ARR_LENGTH(candidates); ++j)
+      sl_free_symbol_path(*ARR_GET(candidates, j));
+    candidates.length = 0;
+  }
+  ARR_FREE(candidates);
+}
+
+int
+sl_module_artifact_add_to_state(const sl_ModuleArtifact *artifact,
+  sl_LogicState *state)
+{
+  struct ArtifactLoader l;
+  sl_LogicCheckpoint checkpoint;
+  sl_logic_checkpoint(state, &checkpoint);
+
+  l.artifact = artifact;
+  l.state = state;
+  l.c.words = artifact->words;
+  l.c.length = artifact->length;
+  l.c.at = artifact->references_at;
+  l.c.failed = FALSE;
+  l.string_ids =
+    SL_MALLOC(sizeof(uint32_t) * (ARR_LENGTH(artifact->strings) + 1));
+  for (size_t i = 0; i < ARR_LENGTH(artifact->strings); ++i)
+  {
+    l.string_ids[i] = (i < artifact->added_strings_n)
+      ? logic_state_add_string(state, *ARR_GET(artifact->strings, i))
+      : NO_INDEX;
+  }
+
+  /* The symbols from elsewhere must be as they were. */
+  size_t references_n = next_word(&l.c);
+  ARR_INIT(l.reference_paths);
+  l.reference_ids = SL_MALLOC(sizeof(uint32_t) * (references_n + 1));
+  for (size_t i = 0; !l.c.failed && i < references_n; ++i)
+  {
+    sl_SymbolPath *path = read_path(&l);
+    if (path == NULL)
+      break;
+    ARR_APPEND(l.reference_paths, path);
+    l.reference_ids[i] = NO_INDEX;
+    if (next_word(&l.c) == 0)
+      continue;
+    uint64_t fingerprint = next_word(&l.c);
+    fingerprint |= (uint64_t)next_word(&l.c) << 32;
+    uint32_t id;
+    if (sl_logic_get_symbol_id(state, path, &id) != sl_LogicError_None
+        || sl_logic_symbol_fingerprint(state, id) != fingerprint)
+      l.c.failed = TRUE;
+    else
+      l.reference_ids[i] = id;
+  }
+
+  skip_words(&l.c, next_word(&l.c)); /* The imports. */
+  check_lookups(&l);
+
+  size_t symbols_n = next_word(&l.c);
+  for (size_t i = 0; !l.c.failed && i < symbols_n; ++i)
+  {
+    if (add_symbol_from_artifact(&l) != sl_LogicError_None)
+      l.c.failed = TRUE;
+  }
+
+  for (size_t i = 0; i < ARR_LENGTH(l.reference_paths); ++i)
+    sl_free_symbol_path(*ARR_GET(l.reference_paths, i));
+  ARR_FREE(l.reference_paths);
+  SL_FREE(l.reference_ids);
+  SL_FREE(l.string_ids);
+
+  if (l.c.failed)
+  {
+    sl_logic_rollback(state, &checkpoint);
+    return 1;
+  }
+  return 0;
+}
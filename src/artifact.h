@@ -0,0 +1,85 @@
+#ifndef ARTIFACT_H
+#define ARTIFACT_H
+
+#include "logic.h"
+
+/* Module artifacts: what an imported file added to a logic state once it was
+   verified, saved next to it (`prop.slc` for `prop.sl`) so that later runs
+   can add the same symbols without lexing, parsing or checking any proofs.
+
+   An artifact is only used while its source file is unchanged, and while the
+   state it is added to still fits it. The file's imports are loaded first,
+   each from its own artifact if it can be, and then the artifact is checked
+   against the state: every name the file looked up must still resolve to the
+   same path, and every symbol from elsewhere that its symbols refer to must
+   have the same fingerprint. If anything differs, the artifact is passed
+   over and the file is verified from source, which writes a new one. */
+
+/* What the verifier notes while it verifies a file from source, in order to
+   write its artifact afterwards. The symbols added from the moment the
+   record is made belong to the file, except for those added by its
+   imports. */
+typedef struct sl_ModuleRecord sl_ModuleRecord;
+
+sl_ModuleRecord *
+sl_new_module_record(const sl_LogicState *state);
+
+void
+sl_free_module_record(sl_ModuleRecord *record);
+
+/* Notes that the file looked up a name by trying each of `candidates` (a
+   NULL-terminated list) in turn, and found `result`, or nothing if it is
+   NULL. */
+void
+sl_module_record_lookup(sl_ModuleRecord *record,
+  sl_SymbolPath * const *candidates, const sl_SymbolPath *result);
+
+/* Called around the loading of each file the file imports, with the import
+   as it was written. */
+void
+sl_module_record_begin_import(sl_ModuleRecord *record,
+  const sl_LogicState *state, const char *import);
+
+void
+sl_module_record_end_import(sl_ModuleRecord *record,
+  const sl_LogicState *state);
+
+/* For a file whose symbols depend on more than its imports and the names it
+   looks up, such as one that imports a file inside a namespace. No artifact
+   is written for it. */
+void
+sl_module_record_disable(sl_ModuleRecord *record);
+
+/* Writes the artifact of the file at `source_path`, which must have been
+   verified without errors. Returns 0 on success. */
+int
+sl_module_record_write(sl_ModuleRecord *record, sl_LogicState *state,
+  const char *source_path);
+
+/* An artifact read back from a file. */
+typedef struct sl_ModuleArtifact sl_ModuleArtifact;
+
+/* Returns NULL if the file at `source_path` has no artifact, or has changed
+   since its artifact was written. */
+sl_ModuleArtifact *
+sl_read_module_artifact(const char *source_path);
+
+void
+sl_free_module_artifact(sl_ModuleArtifact *artifact);
+
+/* The imports of the file, as they were written, in order. */
+size_t
+sl_module_artifact_count_imports(const sl_ModuleArtifact *artifact);
+
+const char *
+sl_module_artifact_get_import(const sl_ModuleArtifact *artifact,
+  size_t index);
+
+/* Adds the symbols of the artifact to `state`, whose imports must already be
+   loaded. Returns 0 on success. Otherwise, if the state does not fit the
+   artifact or the artifact is damaged, the state is left as it was. */
+int
+sl_module_artifact_add_to_state(const sl_ModuleArtifact *artifact,
+  sl_LogicState *state);
+
+#endif
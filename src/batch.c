@@ -0,0 +1,239 @@
+#include "batch.h"
+#include "parse.h"
+#include "proof_cache.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct BatchFile
+{
+  char *path;
+  bool valid;
+  uint64_t verify_ns;
+
+  /* Allocated by the C library. */
+  char *output;
+  size_t output_size;
+};
+
+struct sl_Batch
+{
+  const sl_LogicState *base;
+  ARR(struct BatchFile) files;
+
+  atomic_size_t next_file;
+  /* The settings of the thread that verifies the batch, which are per
+     thread, for the workers to take on. */
+  bool use_module_artifacts;
+  sl_ProofCache *proof_cache;
+  unsigned int jobs;
+  uint64_t verify_ns;
+};
+
+sl_Batch *
+sl_new_batch(const sl_LogicState *base)
+{
+  sl_Batch *batch = SL_NEW(sl_Batch);
+  if (batch == NULL)
+    return NULL;
+  batch->base = base;
+  ARR_INIT(batch->files);
+  atomic_init(&batch->next_file, 0);
+  batch->use_module_artifacts = FALSE;
+  batch->proof_cache = NULL;
+  batch->jobs = 0;
+  batch->verify_ns = 0;
+  return batch;
+}
+
+void
+sl_free_batch(sl_Batch *batch)
+{
+  if (batch == NULL)
+    return;
+  for (size_t i = 0; i < ARR_LENGTH(batch->files); ++i)
+  {
+    struct BatchFile *file = ARR_GET(batch->files, i);
+    SL_FREE(file->path);
+    free(file->output);
+  }
+  ARR_FREE(batch->files);
+  SL_FREE(batch);
+}
+
+void
+sl_batch_add_file(sl_Batch *batch, const char *path)
+{
+  struct BatchFile file;
+  file.path = SL_STRDUP(path);
+  file.valid = FALSE;
+  file.verify_ns = 0;
+  file.output = NULL;
+  file.output_size = 0;
+  ARR_APPEND(batch->files, file);
+}
+
+static const char *
+message_type_name(sl_MessageType type)
+{
+  switch (type)
+  {
+    case sl_MessageType_Warning:
+      return "Warning";
+    case sl_MessageType_Note:
+      return "Note";
+    default:
+      return "Error";
+  }
+}
+
+/* Messages are written to the same stream as the log, so that the two stay
+   in the order in which they were printed. */
+static void
+collect_message(const char *source, size_t line, size_t column,
+  const char *message, sl_MessageType type, void *user_data)
+{
+  FILE *out = (FILE *)user_data;
+  if (out == NULL)
+    return;
+  fprintf(out, "%s in '%s' at (%zu, %zu): %s\n", message_type_name(type),
+    source != NULL ? source : "(input)", line, column, message);
+}
+
+static void
+verify_file(const sl_Batch *batch, struct BatchFile *file)
+{
+  FILE *out = open_memstream(&file->output, &file->output_size);
+  sl_LogicState *state = sl_logic_state_fork(batch->base, out);
+  uint64_t start = sl_wall_clock_ns();
+
+  sl_trace_begin("batch", file->path);
+  sl_set_message_handler(&collect_message, out);
+  file->valid = (sl_verify_and_add_file(file->path, state) == 0);
+  sl_set_message_handler(NULL, NULL);
+  sl_trace_end();
+
+  file->verify_ns = sl_wall_clock_ns() - start;
+  sl_free_logic_state(state);
+  if (out != NULL)
+    fclose(out);
+}
+
+static void *
+verify_files(void *userdata)
+{
+  sl_Batch *batch = (sl_Batch *)userdata;
+  sl_set_use_module_artifacts(batch->use_module_artifacts);
+  sl_set_active_proof_cache(batch->proof_cache);
+  while (1)
+  {
+    size_t i = atomic_fetch_add(&batch->next_file, 1);
+    if (i >= ARR_LENGTH(batch->files))
+      break;
+    verify_file(batch, ARR_GET(batch->files, i));
+  }
+  return NULL;
+}
+
+int
+sl_batch_verify(sl_Batch *batch, unsigned int jobs)
+{
+  uint64_t start = sl_wall_clock_ns();
+  atomic_store(&batch->next_file, 0);
+  batch->use_module_artifacts = sl_get_use_module_artifacts();
+  batch->proof_cache = sl_get_active_proof_cache();
+
+  if (jobs == 0)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = (cpus > 0) ? (unsigned int)cpus : 1;
+  }
+  if (jobs > ARR_LENGTH(batch->files))
+    jobs = ARR_LENGTH(batch->files);
+
+  if (jobs <= 1)
+  {
+    verify_files(batch);
+    jobs = 1;
+  }
+  else
+  {
+    pthread_t *threads = SL_MALLOC(sizeof(pthread_t) * jobs);
+    unsigned int started = 0;
+    for (; started < jobs; ++started)
+    {
+      if (pthread_create(&threads[started], NULL, &verify_files,
+          batch) != 0)
+        break;
+    }
+    /* If no thread could be started, verify everything here. */
+    if (started == 0)
+      verify_files(batch);
+    for (unsigned int i = 0; i < started; ++i)
+      pthread_join(threads[i], NULL);
+    SL_FREE(threads);
+    jobs = (started > 0) ? started : 1;
+  }
+  batch->jobs = jobs;
+  batch->verify_ns = sl_wall_clock_ns() - start;
+
+  for (size_t i = 0; i < ARR_LENGTH(batch->files); ++i)
+  {
+    if (!ARR_GET(batch->files, i)->valid)
+      return 1;
+  }
+  return 0;
+}
+
+size_t
+sl_batch_count_files(const sl_Batch *batch)
+{
+  return ARR_LENGTH(batch->files);
+}
+
+const char *
+sl_batch_get_path(const sl_Batch *batch, size_t index)
+{
+  return ARR_GET(batch->files, index)->path;
+}
+
+bool
+sl_batch_file_valid(const sl_Batch *batch, size_t index)
+{
+  return ARR_GET(batch->files, index)->valid;
+}
+
+const char *
+sl_batch_get_output(const sl_Batch *batch, size_t index)
+{
+  const struct BatchFile *file = ARR_GET(batch->files, index);
+  return (file->output != NULL) ? file->output : "";
+}
+
+uint64_t
+sl_batch_get_verify_ns(const sl_Batch *batch, size_t index)
+{
+  return ARR_GET(batch->files, index)->verify_ns;
+}
+
+void
+sl_batch_print_report(const sl_Batch *batch, FILE *out)
+{
+  size_t valid = 0;
+  for (size_t i = 0; i < ARR_LENGTH(batch->files); ++i)
+  {
+    const struct BatchFile *file = ARR_GET(batch->files, i);
+    if (file->output_size > 0)
+      fputs(file->output, out);
+    fprintf(out, "File '%s' %s (%.1f ms).\n", file->path,
+      file->valid ? "valid" : "invalid", (double)file->verify_ns / 1e6);
+    if (file->valid)
+      valid += 1;
+  }
+  fprintf(out, "Verified %zu file(s) on %u thread(s) in %.1f ms: "
+    "%zu valid, %zu invalid.\n", ARR_LENGTH(batch->files), batch->jobs,
+    (double)batch->verify_ns / 1e6, valid, ARR_LENGTH(batch->files) - valid);
+}
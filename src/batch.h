@@ -0,0 +1,55 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "logic.h"
+#include <stdio.h>
+
+/* Verifies many independent files against a frozen base. Each file is
+   verified in its own fork of the base (see `sl_logic_state_fork`), so the
+   files cannot see each other's symbols, and the forks are verified on
+   worker threads. Whatever a file prints is collected, and reported with its
+   result once all of the files have been verified.
+
+   The workers use module artifacts, and the active proof cache, if the
+   thread that verifies the batch does.
+
+   The base must not change while the batch is being verified. */
+typedef struct sl_Batch sl_Batch;
+
+/* The batch does not own the base. */
+sl_Batch *
+sl_new_batch(const sl_LogicState *base);
+
+void
+sl_free_batch(sl_Batch *batch);
+
+void
+sl_batch_add_file(sl_Batch *batch, const char *path);
+
+/* Verifies the files on `jobs` threads, or one per processor if `jobs` is 0.
+   Returns 0 if they are all valid. */
+int
+sl_batch_verify(sl_Batch *batch, unsigned int jobs);
+
+size_t
+sl_batch_count_files(const sl_Batch *batch);
+
+const char *
+sl_batch_get_path(const sl_Batch *batch, size_t index);
+
+bool
+sl_batch_file_valid(const sl_Batch *batch, size_t index);
+
+/* The messages and log of the file, or an empty string. */
+const char *
+sl_batch_get_output(const sl_Batch *batch, size_t index);
+
+uint64_t
+sl_batch_get_verify_ns(const sl_Batch *batch, size_t index);
+
+/* Writes what each file printed and whether it is valid, in the order the
+   files were added, followed by a summary. */
+void
+sl_batch_print_report(const sl_Batch *batch, FILE *out);
+
+#endif
@@ -1,5 +1,10 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Strings
 #include "common.h"
 #include <string.h>
+#include <time.h>
+#ifdef SL_MEMORY_STATS
+#include <stdatomic.h>
+#endif
 
 #define SL_COPY_FILE_BUFFER_SIZE 4096
 
@@ -32,6 +37,202 @@ int sl_copy_file(const char *dst_path, const char *src_path)
   return 0;
 }
 
+uint64_t sl_wall_clock_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t sl_cpu_clock_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Allocation accounting. Each counted block is preceded by a header that
+   records its size and tag, so that freeing it can be attributed. */
+static const char *memory_tag_names[] = {
+  "other",
+  "values",
+  "paths",
+  "strings",
+  "source",
+  "ast",
+  "symbols",
+  "renderer"
+};
+
+#ifdef SL_MEMORY_STATS
+#define SL_MEMORY_MAGIC 0x51a110c5
+
+struct MemoryHeader
+{
+  size_t size;
+  uint32_t tag;
+  uint32_t magic;
+} __attribute__((aligned(16)));
+
+struct MemoryStats
+{
+  atomic_uint_fast64_t live;
+  atomic_uint_fast64_t peak;
+  atomic_uint_fast64_t allocations;
+  atomic_uint_fast64_t bytes_allocated;
+};
+
+static struct MemoryStats memory_stats[sl_MemoryTag_Count];
+static struct MemoryStats memory_total;
+
+static void
+count_allocation(struct MemoryStats *stats, size_t size)
+{
+  uint64_t live = atomic_fetch_add(&stats->live, size) + size;
+  uint64_t peak = atomic_load(&stats->peak);
+  while (live > peak && !atomic_compare_exchange_weak(&stats->peak, &peak,
+    live)) { }
+  atomic_fetch_add(&stats->allocations, 1);
+  atomic_fetch_add(&stats->bytes_allocated, size);
+}
+
+static void
+count_free(struct MemoryStats *stats, size_t size)
+{
+  atomic_fetch_sub(&stats->live, size);
+}
+
+static struct MemoryHeader *
+header_of(void *ptr)
+{
+  struct MemoryHeader *header = (struct MemoryHeader *)ptr - 1;
+  if (header->magic != SL_MEMORY_MAGIC)
+  {
+    fprintf(stderr, "sl: freeing memory that was not allocated by SL_MALLOC.\n");
+    abort();
+  }
+  return header;
+}
+
+void *
+sl_mem_alloc(enum sl_MemoryTag tag, size_t size)
+{
+  struct MemoryHeader *header = malloc(sizeof(struct MemoryHeader) + size);
+  if (header == NULL)
+    return NULL;
+  header->size = size;
+  header->tag = tag;
+  header->magic = SL_MEMORY_MAGIC;
+  count_allocation(&memory_stats[tag], size);
+  count_allocation(&memory_total, size);
+  return header + 1;
+}
+
+void *
+sl_mem_realloc(enum sl_MemoryTag tag, void *ptr, size_t size)
+{
+  struct MemoryHeader *header, *resized;
+  size_t old_size;
+  if (ptr == NULL)
+    return sl_mem_alloc(tag, size);
+  header = header_of(ptr);
+  old_size = header->size;
+  resized = realloc(header, sizeof(struct MemoryHeader) + size);
+  if (resized == NULL)
+    return NULL;
+
+  /* A resized block stays with the subsystem that first allocated it. */
+  count_free(&memory_stats[resized->tag], old_size);
+  count_free(&memory_total, old_size);
+  resized->size = size;
+  count_allocation(&memory_stats[resized->tag], size);
+  count_allocation(&memory_total, size);
+  return resized + 1;
+}
+
+char *
+sl_mem_strdup(enum sl_MemoryTag tag, const char *str)
+{
+  size_t size = strlen(str) + 1;
+  char *dup = sl_mem_alloc(tag, size);
+  if (dup == NULL)
+    return NULL;
+  memcpy(dup, str, size);
+  return dup;
+}
+
+void
+sl_mem_free(void *ptr)
+{
+  struct MemoryHeader *header;
+  if (ptr == NULL)
+    return;
+  header = header_of(ptr);
+  count_free(&memory_stats[header->tag], header->size);
+  count_free(&memory_total, header->size);
+  header->magic = 0;
+  free(header);
+}
+
+static int
+compare_tags_by_peak(const void *a, const void *b)
+{
+  uint64_t x = atomic_load(&memory_stats[*(const int *)a].peak);
+  uint64_t y = atomic_load(&memory_stats[*(const int *)b].peak);
+  if (x != y)
+    return (x < y) ? 1 : -1;
+  return 0;
+}
+
+static void
+print_memory_stats_row(FILE *out, const char *name,
+  struct MemoryStats *stats)
+{
+  fprintf(out, "  %-10s %14llu %14llu %12llu %16llu\n", name,
+    (unsigned long long)atomic_load(&stats->peak),
+    (unsigned long long)atomic_load(&stats->live),
+    (unsigned long long)atomic_load(&stats->allocations),
+    (unsigned long long)atomic_load(&stats->bytes_allocated));
+}
+
+bool
+sl_memory_stats_enabled()
+{
+  return TRUE;
+}
+
+void
+sl_memory_print_report(FILE *out)
+{
+  int tags[sl_MemoryTag_Count];
+  for (int i = 0; i < sl_MemoryTag_Count; ++i)
+    tags[i] = i;
+  qsort(tags, sl_MemoryTag_Count, sizeof(int), &compare_tags_by_peak);
+
+  fprintf(out, "Memory (bytes; peaks are per subsystem, not simultaneous):\n");
+  fprintf(out, "  %-10s %14s %14s %12s %16s\n", "subsystem", "peak", "live",
+    "allocations", "bytes allocated");
+  for (int i = 0; i < sl_MemoryTag_Count; ++i)
+    print_memory_stats_row(out, memory_tag_names[tags[i]],
+      &memory_stats[tags[i]]);
+  print_memory_stats_row(out, "total", &memory_total);
+}
+#else
+bool
+sl_memory_stats_enabled()
+{
+  return FALSE;
+}
+
+void
+sl_memory_print_report(FILE *out)
+{
+  (void)memory_tag_names;
+  fprintf(out, "Memory statistics are not available; "
+    "build with -DSL_MEMORY_STATS=ON.\n");
+}
+#endif
+
 int
 strslicecmp(const struct sl_StringSlice a, const struct sl_StringSlice b)
 {
@@ -55,7 +256,7 @@ strslicecmp2(const struct sl_StringSlice a, const char *b)
 char *
 slice_to_string(struct sl_StringSlice slice)
 {
-  char *str = malloc(slice.length + 1);
+  char *str = SL_MALLOC(slice.length + 1);
   if (str == NULL)
     return NULL;
   strncpy(str, slice.begin, slice.length);
@@ -63,6 +264,131 @@ slice_to_string(struct sl_StringSlice slice)
   return str;
 }
 
+void
+sl_write_json_string(FILE *out, const char *str)
+{
+  fputc('"', out);
+  for (const char *c = str; *c != '\0'; ++c)
+  {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if ((unsigned char)*c < 0x20)
+      fprintf(out, "\\u%04x", (unsigned char)*c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+void
+sl_string_builder_init(sl_StringBuilder *builder)
+{
+  builder->out = NULL;
+  builder->data = NULL;
+  builder->length = 0;
+  builder->capacity = 0;
+}
+
+void
+sl_string_builder_init_file(sl_StringBuilder *builder, FILE *out)
+{
+  sl_string_builder_init(builder);
+  builder->out = out;
+}
+
+/* Makes room for `length` more characters and a terminator. */
+static void
+string_builder_reserve(sl_StringBuilder *builder, size_t length)
+{
+  size_t needed = builder->length + length + 1;
+  if (needed <= builder->capacity)
+    return;
+  size_t capacity = (builder->capacity == 0) ? 64 : builder->capacity;
+  while (capacity < needed)
+    capacity *= 2;
+  builder->data = SL_REALLOC(builder->data, capacity);
+  builder->capacity = capacity;
+}
+
+void
+sl_string_builder_append_length(sl_StringBuilder *builder, const char *str,
+  size_t length)
+{
+  if (builder->out != NULL)
+  {
+    fwrite(str, 1, length, builder->out);
+    return;
+  }
+  string_builder_reserve(builder, length);
+  memcpy(builder->data + builder->length, str, length);
+  builder->length += length;
+  builder->data[builder->length] = '\0';
+}
+
+void
+sl_string_builder_append(sl_StringBuilder *builder, const char *str)
+{
+  sl_string_builder_append_length(builder, str, strlen(str));
+}
+
+void
+sl_string_builder_append_char(sl_StringBuilder *builder, char c)
+{
+  if (builder->out != NULL)
+  {
+    fputc(c, builder->out);
+    return;
+  }
+  string_builder_reserve(builder, 1);
+  builder->data[builder->length] = c;
+  builder->length += 1;
+  builder->data[builder->length] = '\0';
+}
+
+void
+sl_string_builder_printf(sl_StringBuilder *builder, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  if (builder->out != NULL)
+  {
+    vfprintf(builder->out, fmt, args);
+    va_end(args);
+    return;
+  }
+  va_list args_copy;
+  va_copy(args_copy, args);
+  int length = vsnprintf(NULL, 0, fmt, args_copy);
+  va_end(args_copy);
+  if (length > 0)
+  {
+    string_builder_reserve(builder, length);
+    vsnprintf(builder->data + builder->length, length + 1, fmt, args);
+    builder->length += length;
+  }
+  va_end(args);
+}
+
+char *
+sl_string_builder_finish(sl_StringBuilder *builder)
+{
+  char *str;
+  if (builder->out != NULL)
+    return NULL;
+  str = builder->data;
+  if (str == NULL)
+    str = SL_STRDUP("");
+  sl_string_builder_init(builder);
+  return str;
+}
+
+void
+sl_string_builder_free(sl_StringBuilder *builder)
+{
+  SL_FREE(builder->data);
+  sl_string_builder_init(builder);
+}
+
 /* From http://www.cse.yorku.ca/~oz/hash.html */
 uint32_t
 hash(char *str)
@@ -76,16 +402,43 @@ hash(char *str)
   return hash;
 }
 
+uint64_t
+sl_hash_bytes(uint64_t hash, const void *data, size_t length)
+{
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < length; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint64_t
+sl_hash_string(uint64_t hash, const char *str)
+{
+  return sl_hash_bytes(hash, str, strlen(str) + 1);
+}
+
+uint64_t
+sl_hash_uint64(uint64_t hash, uint64_t value)
+{
+  unsigned char bytes[8];
+  for (size_t i = 0; i < 8; ++i)
+    bytes[i] = (unsigned char)(value >> (8 * i));
+  return sl_hash_bytes(hash, bytes, 8);
+}
+
 char *
 strndup(const char *str, size_t n)
 {
   if (strlen(str) <= n)
   {
-    return strdup(str);
+    return SL_STRDUP(str);
   }
   else
   {
-    char *result = malloc(n + 1);
+    char *result = SL_MALLOC(n + 1);
     if (result == NULL)
       return NULL;
     strncpy(result, str, n);
@@ -113,7 +466,7 @@ vasprintf(char **str, const char *fmt, va_list vlist)
   va_end(vlist_copy);
   if (result < 0)
     return result;
-  *str = malloc(result + 1);
+  *str = SL_MALLOC(result + 1);
   result = vsprintf(*str, fmt, vlist);
   return result;
 }
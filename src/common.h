@@ -19,6 +19,10 @@ typedef int bool;
 /* File helper */
 int sl_copy_file(const char *dst_path, const char *src_path);
 
+/* Clocks, in nanoseconds. */
+uint64_t sl_wall_clock_ns();
+uint64_t sl_cpu_clock_ns(); /* CPU time used by the calling thread. */
+
 /* Misc helpers */
 #define PROPAGATE_ERROR(err) \
 do { \
@@ -29,8 +33,54 @@ while(0)
 
 #include <stdlib.h>
 /* Memory helpers */
-#define SL_NEW(type) malloc(sizeof(type))
+
+/* Subsystems that memory is accounted to when built with SL_MEMORY_STATS.
+   Allocations are tagged with the value of SL_MEMORY_TAG where the
+   allocating macro is used, so a source file (or a section of one) can
+   redefine it to attribute its allocations. */
+enum sl_MemoryTag
+{
+  sl_MemoryTag_Other = 0,
+  sl_MemoryTag_Values,
+  sl_MemoryTag_Paths,
+  sl_MemoryTag_Strings,
+  sl_MemoryTag_Source,
+  sl_MemoryTag_AST,
+  sl_MemoryTag_Symbols,
+  sl_MemoryTag_Renderer,
+  sl_MemoryTag_Count
+};
+
+#ifndef SL_MEMORY_TAG
+#define SL_MEMORY_TAG sl_MemoryTag_Other
+#endif
+
+#ifdef SL_MEMORY_STATS
+/* Memory obtained from these must be released with `sl_mem_free`. */
+void *sl_mem_alloc(enum sl_MemoryTag tag, size_t size);
+void *sl_mem_realloc(enum sl_MemoryTag tag, void *ptr, size_t size);
+char *sl_mem_strdup(enum sl_MemoryTag tag, const char *str);
+void sl_mem_free(void *ptr);
+
+#define SL_MALLOC(size) sl_mem_alloc(SL_MEMORY_TAG, size)
+#define SL_REALLOC(ptr, size) sl_mem_realloc(SL_MEMORY_TAG, ptr, size)
+#define SL_STRDUP(str) sl_mem_strdup(SL_MEMORY_TAG, str)
+#define SL_FREE(ptr) sl_mem_free(ptr)
+#else
+#define SL_MALLOC(size) malloc(size)
+#define SL_REALLOC(ptr, size) realloc(ptr, size)
+#define SL_STRDUP(str) strdup(str)
 #define SL_FREE(ptr) free(ptr)
+#endif
+
+#define SL_NEW(type) SL_MALLOC(sizeof(type))
+
+/* Whether allocations are being counted (i.e. built with SL_MEMORY_STATS). */
+bool sl_memory_stats_enabled();
+
+/* Prints peak and live bytes and allocation counts for each subsystem,
+   largest peak first. */
+void sl_memory_print_report(FILE *out);
 
 /* Array helpers */
 struct DynamicArray
@@ -46,7 +96,7 @@ typedef struct DynamicArray Array;
 
 #define ARRAY_INIT(array, type) \
 do { \
-  (array).data = malloc(sizeof(type)); \
+  (array).data = SL_MALLOC(sizeof(type)); \
   (array).element_size = sizeof(type); \
   (array).length = 0; \
   (array).reserved = 1; \
@@ -55,7 +105,7 @@ while (0)
 
 #define ARRAY_INIT_WITH_RESERVED(array, type, to_reserve) \
 do { \
-  (array).data = malloc(sizeof(type) * to_reserve); \
+  (array).data = SL_MALLOC(sizeof(type) * to_reserve); \
   (array).element_size = sizeof(type); \
   (array).length = 0; \
   (array).reserved = to_reserve; \
@@ -71,7 +121,7 @@ do { \
   if ((array).reserved < (array).length + 1) \
   { \
     (array).reserved = (array).reserved * 2; \
-    (array).data = realloc((array).data, (array).element_size * (array).reserved); \
+    (array).data = SL_REALLOC((array).data, (array).element_size * (array).reserved); \
   } \
   ((type *)(array).data)[(array).length] = item; \
   (array).length += 1; \
@@ -86,7 +136,7 @@ while (0)
 
 #define ARRAY_FREE(array) \
 do { \
-  free((array).data); \
+  SL_FREE((array).data); \
   (array).element_size = 0; \
   (array).length = 0; \
   (array).reserved = 0; \
@@ -98,7 +148,7 @@ do { \
   (dst).length = (src).length; \
   (dst).element_size = (src).element_size; \
   (dst).reserved = (src).reserved; \
-  (dst).data = malloc((src).element_size * (src).reserved); \
+  (dst).data = SL_MALLOC((src).element_size * (src).reserved); \
   memcpy((dst).data, (src).data, (src).element_size * (src).length); \
 } \
 while (0)
@@ -113,7 +163,7 @@ struct \
 
 #define MANAGED_ARRAY_INIT(array) \
 do { \
-  (array).data = malloc(sizeof(*(array).data)); \
+  (array).data = SL_MALLOC(sizeof(*(array).data)); \
   (array).length = 0; \
   (array).reserved = 1; \
 } \
@@ -121,7 +171,7 @@ while (0)
 
 #define MANAGED_ARRAY_INIT_RESERVED(array, to_reserve) \
 do { \
-  (array).data = malloc(sizeof(*(array).data) * (to_reserve)); \
+  (array).data = SL_MALLOC(sizeof(*(array).data) * (to_reserve)); \
   (array).length = 0; \
   (array).reserved = to_reserve; \
 } \
@@ -129,14 +179,14 @@ while (0)
 
 #define MANAGED_ARRAY_LENGTH(array) (array).length
 
-#define MANAGED_ARRAY_GET(array, index) &((array).data[index])
+#define MANAGED_ARRAY_GET(array, index) (&((array).data[index]))
 
 #define MANAGED_ARRAY_APPEND(array, item) \
 do { \
   if ((array).reserved < (array).length + 1) \
   { \
     (array).reserved = (array).reserved * 2; \
-    (array).data = realloc((array).data, sizeof(*(array).data) * (array).reserved); \
+    (array).data = SL_REALLOC((array).data, sizeof(*(array).data) * (array).reserved); \
   } \
   (array).data[(array).length] = item; \
   (array).length += 1; \
@@ -151,7 +201,7 @@ while (0)
 
 #define MANAGED_ARRAY_FREE(array) \
 do { \
-  free((array).data); \
+  SL_FREE((array).data); \
   (array).length = 0; \
   (array).reserved = 0; \
 } \
@@ -168,27 +218,69 @@ while (0)
 #define ARR_FREE(array) MANAGED_ARRAY_FREE(array)
 
 /* --- Arbitrary Size Integer Arithmetic. --- */
+
+/* Natural numbers are stored as little-endian 64-bit limbs, without leading
+   zero limbs (so zero has no limbs). Numbers that fit in a single limb are
+   stored inline and never allocate.
+
+   Every function producing a number initializes its result, which must be
+   freed with `sl_natural_free`; results are not freed before being written.
+   Functions returning `int` return 0 on success, and nonzero on invalid
+   input (e.g. a division by zero). */
+struct sl_Natural
+{
+  size_t length; /* Limbs in use. */
+  size_t capacity; /* Allocated limbs, or 0 when stored inline. */
+  union
+  {
+    uint64_t small;
+    uint64_t *limbs;
+  } data;
+};
 typedef struct sl_Natural sl_Natural;
 
 int sl_natural_from_string(const char *str, sl_Natural *nat);
+/* Reads exactly `n_digits` decimal digits, which need not be terminated. */
+int sl_natural_from_digits(const char *digits, size_t n_digits,
+  sl_Natural *nat);
 int sl_natural_from_uint64_t(uint64_t n, sl_Natural *nat);
+/* Reads `length` limbs, least significant first. */
+int sl_natural_from_limbs(const uint64_t *limbs, size_t length,
+  sl_Natural *nat);
+/* The limbs in use, least significant first; there are `nat->length`. */
+const uint64_t *sl_natural_get_limbs(const sl_Natural *nat);
+char *sl_natural_to_string(sl_Natural nat);
 int sl_natural_copy(sl_Natural src, sl_Natural *dst);
 void sl_natural_free(sl_Natural *nat);
 bool sl_natural_equal(sl_Natural a, sl_Natural b);
+/* Feeds the limbs into a content hash (see `sl_hash_bytes`). */
+uint64_t sl_natural_hash(uint64_t hash, sl_Natural nat);
 bool sl_natural_less_than(sl_Natural a, sl_Natural b);
 bool sl_natural_less_than_equal(sl_Natural a, sl_Natural b);
 bool sl_natural_greater_than(sl_Natural a, sl_Natural b);
 bool sl_natural_greater_than_equal(sl_Natural a, sl_Natural b);
 int sl_natural_add(sl_Natural a, sl_Natural b, sl_Natural *result);
+/* Fails if `b` is greater than `a`. */
+int sl_natural_subtract(sl_Natural a, sl_Natural b, sl_Natural *result);
 int sl_natural_multiply(sl_Natural a, sl_Natural b, sl_Natural *result);
 int sl_natural_divide(sl_Natural a, sl_Natural b, sl_Natural *result);
 int sl_natural_modulo(sl_Natural a, sl_Natural b, sl_Natural *result);
+int sl_natural_divide_with_remainder(sl_Natural a, sl_Natural b,
+  sl_Natural *quotient, sl_Natural *remainder);
 
+/* Zero is always positive. Division truncates towards zero, and the
+   remainder has the sign of the dividend, as in C. */
+struct sl_Integer
+{
+  bool is_positive;
+  sl_Natural absolute_value;
+};
 typedef struct sl_Integer sl_Integer;
 
 int sl_integer_from_string(const char *str, sl_Integer *intg);
 int sl_integer_from_int64_t(int64_t n, sl_Integer *intg);
 int sl_integer_from_natural(sl_Natural nat, sl_Integer *intg);
+char *sl_integer_to_string(sl_Integer intg);
 int sl_integer_copy(sl_Integer src, sl_Integer *dst);
 void sl_integer_free(sl_Integer *intg);
 bool sl_integer_equal(sl_Integer a, sl_Integer b);
@@ -222,6 +314,64 @@ slice_to_string(struct sl_StringSlice slice);
 uint32_t
 hash(char *str);
 
+/* 64-bit FNV-1a, for content hashes. Start from SL_HASH_INIT and feed the
+   result of each call into the next. */
+#define SL_HASH_INIT 0xcbf29ce484222325ULL
+
+uint64_t
+sl_hash_bytes(uint64_t hash, const void *data, size_t length);
+
+/* Includes the terminator, so consecutive strings cannot run together. */
+uint64_t
+sl_hash_string(uint64_t hash, const char *str);
+
+uint64_t
+sl_hash_uint64(uint64_t hash, uint64_t value);
+
+/* Writes `str` as a quoted, escaped JSON string. */
+void
+sl_write_json_string(FILE *out, const char *str);
+
+/* Text that is built piece by piece, either into a growable buffer or, when
+   `out` is set, written straight to a file. Functions that produce text
+   append to a builder, so that callers can choose between the two without
+   any intermediate strings. */
+struct sl_StringBuilder
+{
+  FILE *out;
+  char *data;
+  size_t length;
+  size_t capacity;
+};
+typedef struct sl_StringBuilder sl_StringBuilder;
+
+void
+sl_string_builder_init(sl_StringBuilder *builder);
+
+void
+sl_string_builder_init_file(sl_StringBuilder *builder, FILE *out);
+
+void
+sl_string_builder_append(sl_StringBuilder *builder, const char *str);
+
+void
+sl_string_builder_append_length(sl_StringBuilder *builder, const char *str,
+  size_t length);
+
+void
+sl_string_builder_append_char(sl_StringBuilder *builder, char c);
+
+void
+sl_string_builder_printf(sl_StringBuilder *builder, const char *fmt, ...);
+
+/* Returns the text in the buffer, which the caller now owns, and empties the
+   builder. Returns NULL for a builder writing to a file. */
+char *
+sl_string_builder_finish(sl_StringBuilder *builder);
+
+void
+sl_string_builder_free(sl_StringBuilder *builder);
+
 char *
 strndup(const char *str, size_t n);
 
@@ -29,6 +29,8 @@ struct Parameter
   uint32_t type_id;
 };
 
+uint32_t logic_state_add_string(sl_LogicState *state, const char *str);
+
 const char * logic_state_get_string(const sl_LogicState *state,
     uint32_t index);
 
@@ -38,9 +40,18 @@ sl_LogicError sl_logic_get_symbol_id(const sl_LogicState *state,
 sl_LogicSymbol * sl_logic_get_symbol_by_id(sl_LogicState *state,
     uint32_t id);
 
+/* Like `sl_logic_get_symbol_by_id`, for a state that is only read. */
+const sl_LogicSymbol * sl_logic_get_const_symbol_by_id(
+    const sl_LogicState *state, uint32_t id);
+
 const sl_SymbolPath * sl_logic_get_symbol_path_by_id(
     const sl_LogicState *state, uint32_t id);
 
+/* A hash of the contents of a symbol, and of the symbols it refers to, so
+   that it changes whenever anything the symbol depends on does. For a
+   theorem, this only covers its statement. */
+uint64_t sl_logic_symbol_fingerprint(sl_LogicState *state, uint32_t id);
+
 struct Type
 {
   uint32_t id;
@@ -49,12 +60,18 @@ struct Type
   bool atomic;
   bool binds;
   bool dummies;
+  bool numerals;
 };
 
 struct LatexFormatSegment
 {
   bool is_variable;
   char *string;
+
+  /* Compiled when the expression is added: the parameter a variable segment
+     stands for (-1 for literal text), and the segment rendered as LaTeX. */
+  int argument_index;
+  char *latex;
 };
 
 struct LatexFormat
@@ -93,6 +110,9 @@ struct Expression
   uint32_t type_id;
   ARR(struct Parameter) parameters;
   ARR(Value *) bindings;
+  /* For each binding, the index of the parameter it is, or -1 if it is
+     something other than one of the parameters. */
+  ARR(int32_t) binders;
   Value *replace_with;
 
   bool has_latex;
@@ -104,7 +124,8 @@ enum ValueType
   ValueTypeConstant,
   ValueTypeVariable,
   ValueTypeComposition,
-  ValueTypeDummy
+  ValueTypeDummy,
+  ValueTypeNumeral
 };
 
 typedef ARR(Value *) ValueArray;
@@ -126,9 +147,51 @@ struct Value
       uint32_t expression_id;
       ValueArray arguments;
     } composition;
+    sl_Natural numeral;
   } content;
 };
 
+/* Walking a value with a stack of its own rather than the call stack, since
+   machine-generated formulas can be nested far deeper than recursion
+   allows. Each frame is a node being visited and the next of its arguments
+   to visit. The first frames are kept inline, so that walking a shallow
+   value allocates nothing. */
+#define VALUE_WALK_INLINE_FRAMES 32
+
+struct ValueFrame
+{
+  const Value *value;
+  const Value *other; /* The node of a second value, walked alongside. */
+  Value *target; /* The node being built from this one. */
+  size_t next;
+};
+
+struct ValueWalk
+{
+  struct ValueFrame *frames;
+  size_t length;
+  size_t capacity;
+  struct ValueFrame inline_frames[VALUE_WALK_INLINE_FRAMES];
+};
+
+void
+init_value_walk(struct ValueWalk *walk);
+
+void
+free_value_walk(struct ValueWalk *walk);
+
+/* Returns the new frame. Frames pushed before it may have moved. */
+struct ValueFrame *
+push_value_frame(struct ValueWalk *walk, const Value *value);
+
+#define VALUE_WALK_TOP(walk) (&(walk)->frames[(walk)->length - 1])
+#define VALUE_WALK_POP(walk) ((walk)->length -= 1)
+
+#define VALUE_ARITY(value) ((value)->value_type == ValueTypeComposition \
+  ? ARR_LENGTH((value)->content.composition.arguments) : 0)
+#define VALUE_ARGUMENT(value, index) \
+  (*ARR_GET((value)->content.composition.arguments, (index)))
+
 struct Argument
 {
   uint32_t name_id;
@@ -152,6 +215,68 @@ Value * reduce_expressions(const sl_LogicState *state, const Value *value);
 Value *
 instantiate_value(const Value *src, ArgumentArray args);
 
+/* One-way matching: extends `bindings` with the variables of `pattern` that
+   it does not bind yet, so that instantiating `pattern` with them gives
+   `target`. The variables of `target` are only equal to themselves. The
+   values bound point into `target` rather than being copied. If there is no
+   match, `bindings` is left as it was and FALSE is returned. */
+bool
+match_value(const Value *pattern, const Value *target,
+  ArgumentArray *bindings);
+
+/* A value stored flat, for statements that are kept for a long time but
+   rarely worked on: its nodes in prefix order, in a single array of words
+   with no pointers. Each node is a word holding its kind and a count (the
+   arguments of a composition, the path segments of a constant, or the limbs
+   of a numeral), followed by its type id and then the node's own data. Two
+   flat values are equal exactly when their words are, and they can be
+   written out and read back as they are. */
+struct FlatValue
+{
+  uint32_t length; /* In words. */
+  uint32_t words[];
+};
+typedef ARR(struct FlatValue *) FlatValueArray;
+
+struct FlatValue *
+new_flat_value(const Value *value);
+
+void
+free_flat_value(struct FlatValue *flat);
+
+/* The number of words `value` takes up when stored flat. */
+size_t
+flat_value_length(const Value *value);
+
+bool
+flat_values_equal(const struct FlatValue *a, const struct FlatValue *b);
+
+uint64_t
+hash_flat_value(uint64_t hash, const struct FlatValue *flat);
+
+/* Rebuilds the value that was stored, or returns NULL if `flat` refers to
+   a constant that `state` does not have. */
+Value *
+value_from_flat(sl_LogicState *state, const struct FlatValue *flat);
+
+/* Translates the ids in a flat value, for moving it between logic states:
+   each symbol id is replaced by what `symbol` returns for it, and each string
+   id by what `string` does. They return UINT32_MAX for an id they cannot
+   translate. */
+struct FlatValueMap
+{
+  uint32_t (* symbol)(void *data, uint32_t id);
+  uint32_t (* string)(void *data, uint32_t id);
+  void *data;
+};
+
+/* Rewrites the ids of `flat` in place. Returns FALSE, leaving it partly
+   rewritten, if an id cannot be translated or if the words do not make up
+   exactly one value, so that flat values read from a file can be checked
+   before they are used. */
+bool
+remap_flat_value(struct FlatValue *flat, const struct FlatValueMap *map);
+
 enum RequirementType
 {
   RequirementTypeDistinct,
@@ -160,7 +285,8 @@ enum RequirementType
   RequirementTypeCoverFree,
   RequirementTypeSubstitution,
   RequirementTypeFullSubstitution,
-  RequirementTypeUnused
+  RequirementTypeUnused,
+  RequirementTypeSuccessor
 };
 
 struct Requirement
@@ -174,7 +300,7 @@ struct Theorem;
 struct TheoremReference
 {
   struct Theorem *theorem;
-  ValueArray arguments;
+  FlatValueArray arguments; /* One for each parameter, in order. */
 };
 
 struct Theorem
@@ -187,6 +313,11 @@ struct Theorem
   ARR(struct Requirement) requirements;
   ValueArray assumptions;
   ValueArray inferences;
+  /* The same statements stored flat, for hashing, comparing and writing
+     them out without walking the trees. The trees are kept as well, since
+     every step that uses the theorem instantiates them. */
+  FlatValueArray flat_assumptions;
+  FlatValueArray flat_inferences;
   ARR(struct TheoremReference) steps;
 };
 
@@ -195,6 +326,7 @@ struct ProofEnvironment
   ARR(struct Parameter) parameters;
   ARR(struct Requirement) requirements;
   ValueArray proven;
+  size_t proven_scanned; /* Statements compared by `statement_proven`. */
 };
 
 struct ProofEnvironment *
@@ -209,13 +341,76 @@ struct sl_LogicSymbol
   uint32_t id;
   sl_LogicSymbolType type;
   void *object;
+  uint64_t fingerprint; /* 0 until computed, see `symbol_fingerprint`. */
+};
+
+/* Flags in the symbol tables. */
+#define SYMBOL_ATOMIC 0x01 /* A type whose values are terminal. */
+#define SYMBOL_BINDS 0x02 /* A type whose values can be bound. */
+#define SYMBOL_DUMMIES 0x04
+#define SYMBOL_NUMERALS 0x08
+#define SYMBOL_LATEX 0x10 /* An expression with a LaTeX format. */
+
+/* What hot loops need to know about symbols, in dense tables parallel to the
+   symbol table, so that they can read it without following the symbol's
+   `object` to a separate allocation. The pointers borrow from the symbol's
+   object. Entries that do not apply to a kind of symbol are 0 or NULL. */
+struct SymbolTables
+{
+  ARR(uint8_t) flags;
+  ARR(uint32_t) arity; /* Of an expression. */
+  ARR(const struct Parameter *) parameters; /* `arity` of them. */
+  ARR(const Value *) definition; /* An expression's `replace_with`. */
+  ARR(uint32_t) binder_count;
+  ARR(const int32_t *) binders; /* See `struct Expression`. */
+};
+
+#define SYMBOL_FLAGS(state, id) (*ARR_GET((state)->tables.flags, (id)))
+#define SYMBOL_ARITY(state, id) (*ARR_GET((state)->tables.arity, (id)))
+#define SYMBOL_PARAMETERS(state, id) \
+  (*ARR_GET((state)->tables.parameters, (id)))
+#define SYMBOL_DEFINITION(state, id) \
+  (*ARR_GET((state)->tables.definition, (id)))
+#define SYMBOL_BINDER_COUNT(state, id) \
+  (*ARR_GET((state)->tables.binder_count, (id)))
+#define SYMBOL_BINDERS(state, id) (*ARR_GET((state)->tables.binders, (id)))
+
+/* A hash index over a table that only ever grows or shrinks at its end,
+   by open addressing: each slot holds the position of an entry plus one, or
+   0 if it is empty. Entries are inserted in the order of the table, so the
+   last one can always be removed by emptying its slot, without disturbing
+   the probe sequences of the others. */
+struct TableIndex
+{
+  uint32_t *slots;
+  size_t capacity; /* A power of two. */
+  ARR(uint32_t) hashes; /* Of each entry, parallel to the table. */
+};
+
+/* Why a theorem could not be added, see `sl_logic_get_theorem_failure`. */
+struct TheoremFailure
+{
+  char *message; /* NULL if the last theorem was added. */
+  size_t step;
+  size_t inference;
 };
 
 struct sl_LogicState
 {
   ARR(char *) string_table;
   ARR(sl_LogicSymbol) symbol_table;
+  struct SymbolTables tables;
+  struct TableIndex string_index; /* By contents. */
+  struct TableIndex symbol_index; /* By path. */
   uint32_t next_id;
+  uint32_t numeral_type_id; /* 0 (the root namespace) if there is none. */
+  ARR(char *) loaded_files; /* Absolute paths. */
+
+  /* For a fork, the extent of the base, whose strings, symbols and files
+     are borrowed and never freed or rolled back. Empty otherwise. */
+  sl_LogicCheckpoint shared;
+
+  struct TheoremFailure failure;
 
   FILE *log_out;
 };
@@ -232,6 +427,15 @@ int
 make_requirement(sl_LogicState *state,
   struct Requirement *dst, const struct PrototypeRequirement *src);
 
+/* Moves the arguments of `src` into `dst` instead of copying them. They are
+   freed if the requirement cannot be made. */
+int
+make_requirement_take(sl_LogicState *state,
+  struct Requirement *dst, struct PrototypeRequirement *src);
+
+const char *
+requirement_type_name(enum RequirementType type);
+
 bool
 evaluate_requirement(sl_LogicState *state, const struct Requirement *req,
   ArgumentArray environment_args, const struct ProofEnvironment *env);
@@ -0,0 +1,334 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Values
+#include "core.h"
+#include <string.h>
+
+/* The first word of a node: its kind in the low bits, and a count above. */
+#define FLAT_KIND_BITS 3
+#define FLAT_KIND_MASK ((1 << FLAT_KIND_BITS) - 1)
+
+static uint32_t
+flat_node_header(enum ValueType kind, size_t count)
+{
+  return (uint32_t)kind | ((uint32_t)count << FLAT_KIND_BITS);
+}
+
+/* The number of words of the node alone. */
+static size_t
+flat_node_length(const Value *value)
+{
+  switch (value->value_type)
+  {
+    case ValueTypeConstant:
+      return 2 + ARR_LENGTH(value->content.constant.constant_path->segments);
+    case ValueTypeVariable:
+    case ValueTypeDummy:
+    case ValueTypeComposition:
+      return 3;
+    case ValueTypeNumeral:
+      return 2 + 2 * value->content.numeral.length;
+  }
+  return 0;
+}
+
+size_t
+flat_value_length(const Value *value)
+{
+  struct ValueWalk walk;
+  size_t length = 0;
+  init_value_walk(&walk);
+  push_value_frame(&walk, value);
+  while (walk.length > 0)
+  {
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    length += flat_node_length(node);
+    for (size_t i = 0; i < VALUE_ARITY(node); ++i)
+      push_value_frame(&walk, VALUE_ARGUMENT(node, i));
+  }
+  free_value_walk(&walk);
+  return length;
+}
+
+/* Writes the node alone at `words`, returning the word after. */
+static uint32_t *
+write_flat_node(const Value *value, uint32_t *words)
+{
+  switch (value->value_type)
+  {
+    case ValueTypeConstant:
+      {
+        const sl_SymbolPath *path = value->content.constant.constant_path;
+        *words++ = flat_node_header(ValueTypeConstant,
+          ARR_LENGTH(path->segments));
+        *words++ = value->type_id;
+        for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
+          *words++ = *ARR_GET(path->segments, i);
+      }
+      break;
+    case ValueTypeVariable:
+      *words++ = flat_node_header(ValueTypeVariable, 0);
+      *words++ = value->type_id;
+      *words++ = value->content.variable_name_id;
+      break;
+    case ValueTypeDummy:
+      *words++ = flat_node_header(ValueTypeDummy, 0);
+      *words++ = value->type_id;
+      *words++ = value->content.dummy_id;
+      break;
+    case ValueTypeComposition:
+      *words++ = flat_node_header(ValueTypeComposition,
+        ARR_LENGTH(value->content.composition.arguments));
+      *words++ = value->type_id;
+      *words++ = value->content.composition.expression_id;
+      break;
+    case ValueTypeNumeral:
+      {
+        const uint64_t *limbs = sl_natural_get_limbs(&value->content.numeral);
+        *words++ = flat_node_header(ValueTypeNumeral,
+          value->content.numeral.length);
+        *words++ = value->type_id;
+        for (size_t i = 0; i < value->content.numeral.length; ++i)
+        {
+          *words++ = (uint32_t)(limbs[i] & 0xFFFFFFFF);
+          *words++ = (uint32_t)(limbs[i] >> 32);
+        }
+      }
+      break;
+  }
+  return words;
+}
+
+/* Writes the nodes of `value` in prefix order from `words` on. */
+static void
+write_flat_nodes(const Value *value, uint32_t *words)
+{
+  struct ValueWalk walk;
+  words = write_flat_node(value, words);
+  init_value_walk(&walk);
+  push_value_frame(&walk, value);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next++);
+      words = write_flat_node(arg, words);
+      if (VALUE_ARITY(arg) > 0)
+        push_value_frame(&walk, arg);
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+}
+
+struct FlatValue *
+new_flat_value(const Value *value)
+{
+  size_t length = flat_value_length(value);
+  struct FlatValue *flat =
+    SL_MALLOC(sizeof(struct FlatValue) + sizeof(uint32_t) * length);
+  flat->length = (uint32_t)length;
+  write_flat_nodes(value, flat->words);
+  return flat;
+}
+
+void
+free_flat_value(struct FlatValue *flat)
+{
+  SL_FREE(flat);
+}
+
+bool
+flat_values_equal(const struct FlatValue *a, const struct FlatValue *b)
+{
+  return a->length == b->length
+    && memcmp(a->words, b->words, sizeof(uint32_t) * a->length) == 0;
+}
+
+uint64_t
+hash_flat_value(uint64_t hash, const struct FlatValue *flat)
+{
+  hash = sl_hash_uint64(hash, flat->length);
+  return sl_hash_bytes(hash, flat->words, sizeof(uint32_t) * flat->length);
+}
+
+/* Reads the node at `*at` alone, advancing `*at` past it. A composition
+   is left without its arguments, of which there are `*count`. */
+static Value *
+read_flat_node(sl_LogicState *state, const uint32_t **at, size_t *count)
+{
+  const uint32_t *words = *at;
+  enum ValueType kind = (enum ValueType)(words[0] & FLAT_KIND_MASK);
+  Value *value;
+  *count = words[0] >> FLAT_KIND_BITS;
+
+  switch (kind)
+  {
+    case ValueTypeConstant:
+      {
+        /* Constants keep their LaTeX, which is looked up again. */
+        sl_SymbolPath *path = sl_new_symbol_path();
+        for (size_t i = 0; i < *count; ++i)
+          ARR_APPEND(path->segments, words[2 + i]);
+        value = new_constant_value(state, path);
+        sl_free_symbol_path(path);
+        *at = words + 2 + *count;
+      }
+      return value;
+    case ValueTypeVariable:
+    case ValueTypeDummy:
+      value = SL_NEW(Value);
+      value->value_type = kind;
+      value->type_id = words[1];
+      value->parent = NULL;
+      if (kind == ValueTypeVariable)
+        value->content.variable_name_id = words[2];
+      else
+        value->content.dummy_id = words[2];
+      *at = words + 3;
+      return value;
+    case ValueTypeComposition:
+      value = SL_NEW(Value);
+      value->value_type = ValueTypeComposition;
+      value->type_id = words[1];
+      value->parent = NULL;
+      value->content.composition.expression_id = words[2];
+      ARR_INIT_RESERVE(value->content.composition.arguments,
+        (*count > 0) ? *count : 1);
+      *at = words + 3;
+      return value;
+    case ValueTypeNumeral:
+      {
+        uint64_t *limbs = SL_MALLOC(sizeof(uint64_t) * (*count + 1));
+        for (size_t i = 0; i < *count; ++i)
+        {
+          limbs[i] = (uint64_t)words[2 + 2 * i]
+            | ((uint64_t)words[3 + 2 * i] << 32);
+        }
+        value = SL_NEW(Value);
+        value->value_type = ValueTypeNumeral;
+        value->type_id = words[1];
+        value->parent = NULL;
+        sl_natural_from_limbs(limbs, *count, &value->content.numeral);
+        SL_FREE(limbs);
+        *at = words + 2 + 2 * *count;
+      }
+      return value;
+  }
+  return NULL;
+}
+
+/* The nodes are read in prefix order, each composition taking the nodes
+   that follow as its arguments until it has all of them. */
+Value *
+value_from_flat(sl_LogicState *state, const struct FlatValue *flat)
+{
+  struct ValueWalk walk;
+  const uint32_t *at = flat->words;
+  size_t count;
+  Value *value = read_flat_node(state, &at, &count);
+  if (value == NULL || count == 0 || value->value_type != ValueTypeComposition)
+    return value;
+  init_value_walk(&walk);
+  push_value_frame(&walk, value)->next = count;
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    Value *parent = (Value *)top->value;
+    if (top->next == 0)
+    {
+      VALUE_WALK_POP(&walk);
+      continue;
+    }
+    top->next -= 1;
+    Value *arg = read_flat_node(state, &at, &count);
+    if (arg == NULL)
+    {
+      free_value(value);
+      value = NULL;
+      break;
+    }
+    arg->parent = parent;
+    ARR_APPEND(parent->content.composition.arguments, arg);
+    if (arg->value_type == ValueTypeComposition && count > 0)
+      push_value_frame(&walk, arg)->next = count;
+  }
+  free_value_walk(&walk);
+  return value;
+}
+
+/* Rewrites the node at `*at` alone, advancing `*at` past it and adding the
+   number of its arguments to `*pending`. */
+static bool
+remap_flat_node(uint32_t *words, size_t length, size_t *at,
+  const struct FlatValueMap *map, size_t *pending)
+{
+  if (*at + 2 > length)
+    return FALSE;
+  uint32_t *node = words + *at;
+  enum ValueType kind = (enum ValueType)(node[0] & FLAT_KIND_MASK);
+  size_t count = node[0] >> FLAT_KIND_BITS;
+
+  node[1] = map->symbol(map->data, node[1]);
+  if (node[1] == UINT32_MAX)
+    return FALSE;
+  switch (kind)
+  {
+    case ValueTypeConstant:
+      if (count > length - *at - 2)
+        return FALSE;
+      for (size_t i = 0; i < count; ++i)
+      {
+        node[2 + i] = map->string(map->data, node[2 + i]);
+        if (node[2 + i] == UINT32_MAX)
+          return FALSE;
+      }
+      *at += 2 + count;
+      return TRUE;
+    case ValueTypeVariable:
+    case ValueTypeDummy:
+      if (*at + 3 > length)
+        return FALSE;
+      if (kind == ValueTypeVariable)
+      {
+        node[2] = map->string(map->data, node[2]);
+        if (node[2] == UINT32_MAX)
+          return FALSE;
+      }
+      *at += 3;
+      return TRUE;
+    case ValueTypeComposition:
+      if (*at + 3 > length)
+        return FALSE;
+      node[2] = map->symbol(map->data, node[2]);
+      if (node[2] == UINT32_MAX)
+        return FALSE;
+      *at += 3;
+      *pending += count;
+      return TRUE;
+    case ValueTypeNumeral:
+      if (count > (length - *at - 2) / 2)
+        return FALSE;
+      *at += 2 + 2 * count;
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* Every node takes up at least two words, so a count that runs past the
+   end is caught without walking the value as a tree. */
+bool
+remap_flat_value(struct FlatValue *flat, const struct FlatValueMap *map)
+{
+  size_t at = 0, pending = 1;
+  while (pending > 0)
+  {
+    pending -= 1;
+    if (!remap_flat_node(flat->words, flat->length, &at, map, &pending))
+      return FALSE;
+  }
+  return at == flat->length;
+}
@@ -1,3 +1,4 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Source
 #include "parse.h"
 #include <string.h>
 
@@ -5,6 +6,7 @@
 
 struct sl_TextInput {
   void *data;
+  char *name;
 
   void (* free_data)(void *);
   bool (* at_end)(void *);
@@ -46,9 +48,9 @@ sl_input_make_line_buffer(size_t main_buffer_size)
   buf = SL_NEW(sl_TextInputLineBuffer);
   if (buf == NULL)
     return NULL;
-  buf->main_buffer = malloc(main_buffer_size);
+  buf->main_buffer = SL_MALLOC(main_buffer_size);
   if (buf->main_buffer == NULL) {
-    free(buf);
+    SL_FREE(buf);
     return NULL;
   }
   buf->main_buffer_size = main_buffer_size;
@@ -63,10 +65,10 @@ sl_input_free_line_buffer(sl_TextInputLineBuffer *buffer)
   if (buffer == NULL)
     return;
   if (buffer->main_buffer != NULL)
-    free(buffer->main_buffer);
+    SL_FREE(buffer->main_buffer);
   if (buffer->overflow_buffer != NULL)
-    free(buffer->overflow_buffer);
-  free(buffer);
+    SL_FREE(buffer->overflow_buffer);
+  SL_FREE(buffer);
 }
 
 const char *
@@ -80,7 +82,7 @@ sl_input_get_line(sl_TextInput *input, sl_TextInputLineBuffer *buffer)
 {
   char *result;
   if (buffer->overflow_buffer != NULL)
-    free(buffer->overflow_buffer);
+    SL_FREE(buffer->overflow_buffer);
   if (sl_input_at_end(input)) {
     buffer->active_buffer = NULL;
     return 0;
@@ -94,7 +96,7 @@ sl_input_get_line(sl_TextInput *input, sl_TextInputLineBuffer *buffer)
   /* If the result doesn't end in a newline, copy this into the overflow
      buffer and keep consuming until we get to a newline. */
   if (buffer->main_buffer[strlen(buffer->main_buffer) - 1] != '\n') {
-    buffer->overflow_buffer = strdup(buffer->main_buffer);
+    buffer->overflow_buffer = SL_STRDUP(buffer->main_buffer);
     if (buffer->overflow_buffer == NULL) {
       buffer->active_buffer = NULL;
       return 1;
@@ -104,14 +106,14 @@ sl_input_get_line(sl_TextInput *input, sl_TextInputLineBuffer *buffer)
       result = sl_input_gets(buffer->main_buffer, buffer->main_buffer_size,
           input);
       if (result == NULL) {
-        free(buffer->overflow_buffer);
+        SL_FREE(buffer->overflow_buffer);
         buffer->overflow_buffer = NULL;
         return 1;
       }
-      reallocated = realloc(buffer->overflow_buffer,
+      reallocated = SL_REALLOC(buffer->overflow_buffer,
           strlen(buffer->main_buffer) + strlen(buffer->overflow_buffer) + 1);
       if (reallocated == NULL) {
-        free(buffer->overflow_buffer);
+        SL_FREE(buffer->overflow_buffer);
         buffer->active_buffer = NULL;
         return 1;
       }
@@ -187,10 +189,11 @@ sl_input_from_file(const char *file_path)
   FILE *f = fopen(file_path, "r");
   if (f == NULL)
   {
-    free(input);
+    SL_FREE(input);
     return NULL;
   }
   input->data = f;
+  input->name = SL_STRDUP(file_path);
   input->free_data = &file_free;
   input->at_end = &file_at_end;
   input->gets = &file_gets;
@@ -210,7 +213,7 @@ static void
 string_free(void *data)
 {
   struct StringInputData *input = (struct StringInputData *)data;
-  free(input);
+  SL_FREE(input);
 }
 
 static bool
@@ -235,19 +238,22 @@ string_gets(char *dst, size_t n, void *data)
     input->reached_end = TRUE;
     return NULL;
   }
-  /* Iterate and try to find a line break in [at, at + n - 1]. */
-  for (end = input->at; end < input->at + n; ++end)
+  /* Like `fgets`, read up to and including a line break, but no more than
+   n - 1 characters, so that there is room for the NULL. */
+  for (end = input->at; end < input->at + n - 1; ++end)
   {
     if (input->str[end] == '\n')
+    {
+      ++end;
       break;
+    }
     else if (input->str[end] == '\0')
       break;
   }
   /* Copy the data, add a NULL at the end, and then advance the pointer. */
-  result = strncpy(dst, &input->str[input->at], end - input->at + 1);
-  if (result != NULL)
-    result[(end - input->at) + 1] = '\0';
-  input->at += (end - input->at) + 1;
+  result = memcpy(dst, &input->str[input->at], end - input->at);
+  result[end - input->at] = '\0';
+  input->at = end;
   return result;
 }
 
@@ -289,7 +295,7 @@ sl_input_from_string(const char *string)
     struct StringInputData *string_data = SL_NEW(struct StringInputData);
     if (string_data == NULL)
     {
-      free(input);
+      SL_FREE(input);
       return NULL;
     }
     string_data->str = string;
@@ -297,6 +303,7 @@ sl_input_from_string(const char *string)
     string_data->reached_end = FALSE;
     input->data = string_data;
   }
+  input->name = NULL;
   input->free_data = &string_free;
   input->at_end = &string_at_end;
   input->gets = &string_gets;
@@ -312,7 +319,52 @@ sl_input_free(sl_TextInput *input)
     return;
   if (input->free_data != NULL)
     input->free_data(input->data);
-  free(input);
+  if (input->name != NULL)
+    SL_FREE(input->name);
+  SL_FREE(input);
+}
+
+void
+sl_input_set_name(sl_TextInput *input, const char *name)
+{
+  if (input == NULL)
+    return;
+  if (input->name != NULL)
+    SL_FREE(input->name);
+  input->name = (name != NULL) ? SL_STRDUP(name) : NULL;
+}
+
+const char *
+sl_input_get_name(const sl_TextInput *input)
+{
+  if (input == NULL)
+    return NULL;
+  return input->name;
+}
+
+/* Each thread has its own handler, so that threads verifying files at the
+   same time can collect their messages separately. */
+static _Thread_local sl_MessageHandler message_handler = NULL;
+static _Thread_local void *message_handler_data = NULL;
+
+void
+sl_set_message_handler(sl_MessageHandler handler, void *user_data)
+{
+  message_handler = handler;
+  message_handler_data = user_data;
+}
+
+void
+sl_show_file_message(const char *source, const char *message,
+  sl_MessageType type)
+{
+  if (message_handler != NULL)
+  {
+    message_handler(source, 0, 0, message, type, message_handler_data);
+    return;
+  }
+  printf("Error in '%s': %s\n\n", source != NULL ? source : "(input)",
+    message);
 }
 
 void
@@ -323,6 +375,12 @@ sl_input_show_message(sl_TextInput *input, size_t line, size_t column,
 
   if (input == NULL)
     return;
+  if (message_handler != NULL)
+  {
+    message_handler(input->name, line, column, message, type,
+      message_handler_data);
+    return;
+  }
   if (input->get_line == NULL)
     return;
 
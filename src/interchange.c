@@ -31,7 +31,24 @@ static size_t get_symbol_path_storage_size(const sl_SymbolPath *path)
 
 static size_t get_value_storage_size(const Value *value)
 {
-  return 4;
+  /* 4 bytes for the number of words, and then the value stored flat. */
+  return 4 * (1 + flat_value_length(value));
+}
+
+static size_t get_values_storage_size(const ValueArray *values)
+{
+  size_t size = 4; /* Count. */
+  for (size_t i = 0; i < ARR_LENGTH(*values); ++i)
+    size += get_value_storage_size(*ARR_GET(*values, i));
+  return size;
+}
+
+static size_t get_flat_values_storage_size(const FlatValueArray *values)
+{
+  size_t size = 4; /* Count. */
+  for (size_t i = 0; i < ARR_LENGTH(*values); ++i)
+    size += 4 * (1 + (*ARR_GET(*values, i))->length);
+  return size;
 }
 
 static size_t get_symbol_storage_size(const sl_LogicSymbol *sym)
@@ -60,14 +77,34 @@ static size_t get_symbol_storage_size(const sl_LogicSymbol *sym)
         expr = (struct Expression *)sym->object;
         size = get_symbol_path_storage_size(sym->path);
         size += 4; /* Type ID */
-        size += 8 * ARR_LENGTH(expr->parameters);
+        size += 4 + 8 * ARR_LENGTH(expr->parameters);
         size += 1; /* Flags. */
-        if (expr->replace_with == NULL) {
+        if (expr->replace_with != NULL) {
           size += get_value_storage_size(expr->replace_with);
         }
         return size;
       }
       break;
+    case sl_LogicSymbolType_Theorem:
+      /* The size of the path, flags, parameters, requirements, and
+         statements. */
+      {
+        const struct Theorem *thm;
+        size_t size;
+        thm = (struct Theorem *)sym->object;
+        size = get_symbol_path_storage_size(sym->path);
+        size += 1; /* Flags. */
+        size += 4 + 8 * ARR_LENGTH(thm->parameters);
+        size += 4; /* Requirement count. */
+        for (size_t i = 0; i < ARR_LENGTH(thm->requirements); ++i) {
+          const struct Requirement *req = ARR_GET(thm->requirements, i);
+          size += 4 + get_values_storage_size(&req->arguments);
+        }
+        size += get_flat_values_storage_size(&thm->flat_assumptions);
+        size += get_flat_values_storage_size(&thm->flat_inferences);
+        return size;
+      }
+      break;
     default:
       return 4;
       break;
@@ -108,6 +145,8 @@ static int write_interchange_header(const sl_LogicState *state, FILE *f)
   }
 
   /* Symbol table header. */
+  err = write_uint32_t((uint32_t)ARR_LENGTH(state->symbol_table), f);
+  PROPAGATE_ERROR(err);
   for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i) {
     const sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
     err = write_uint32_t((uint32_t)offset, f);
@@ -145,9 +184,65 @@ static int write_path(const sl_SymbolPath *path, FILE *f)
   return 0;
 }
 
+/* Values are written flat (see `struct FlatValue`), word by word. */
+static int write_flat_value(const Value *value, FILE *f)
+{
+  int err;
+  struct FlatValue *flat;
+  flat = new_flat_value(value);
+  err = write_uint32_t(flat->length, f);
+  for (size_t i = 0; err == 0 && i < flat->length; ++i)
+    err = write_uint32_t(flat->words[i], f);
+  free_flat_value(flat);
+  return err;
+}
+
+static int write_flat_values(const FlatValueArray *values, FILE *f)
+{
+  int err;
+  err = write_uint32_t((uint32_t)ARR_LENGTH(*values), f);
+  PROPAGATE_ERROR(err);
+  for (size_t i = 0; i < ARR_LENGTH(*values); ++i) {
+    const struct FlatValue *flat = *ARR_GET(*values, i);
+    err = write_uint32_t(flat->length, f);
+    for (size_t j = 0; err == 0 && j < flat->length; ++j)
+      err = write_uint32_t(flat->words[j], f);
+    PROPAGATE_ERROR(err);
+  }
+  return 0;
+}
+
+static int write_values(const ValueArray *values, FILE *f)
+{
+  int err;
+  err = write_uint32_t((uint32_t)ARR_LENGTH(*values), f);
+  PROPAGATE_ERROR(err);
+  for (size_t i = 0; i < ARR_LENGTH(*values); ++i) {
+    err = write_flat_value(*ARR_GET(*values, i), f);
+    PROPAGATE_ERROR(err);
+  }
+  return 0;
+}
+
+static int write_parameters(const struct Parameter *params, size_t n,
+    FILE *f)
+{
+  int err;
+  err = write_uint32_t((uint32_t)n, f);
+  PROPAGATE_ERROR(err);
+  for (size_t i = 0; i < n; ++i) {
+    err = write_uint32_t(params[i].name_id, f);
+    PROPAGATE_ERROR(err);
+    err = write_uint32_t(params[i].type_id, f);
+    PROPAGATE_ERROR(err);
+  }
+  return 0;
+}
+
 #define TYPE_ATOMIC 0x01
 #define TYPE_BINDS 0x02
 #define TYPE_DUMMIES 0x04
+#define TYPE_NUMERALS 0x08
 
 static unsigned char get_type_flag_byte(const struct Type *type)
 {
@@ -159,6 +254,9 @@ static unsigned char get_type_flag_byte(const struct Type *type)
     byte |= TYPE_BINDS;
   if (type->dummies)
     byte |= TYPE_DUMMIES;
+  if (type->numerals)
+    byte |= TYPE_NUMERALS;
+  return byte;
 }
 
 static int write_type(const sl_LogicSymbol *sym, FILE *f)
@@ -192,12 +290,54 @@ static int write_constspace(const sl_LogicSymbol *sym, FILE *f)
   return err;
 }
 
+#define EXPRESSION_REPLACES 0x01
+
 static int write_expression(const sl_LogicSymbol *sym, FILE *f)
 {
   int err;
+  const struct Expression *expr;
+  expr = (struct Expression *)sym->object;
   err = write_path(sym->path, f);
   PROPAGATE_ERROR(err);
-  err = write_uint32_t(((struct Expression *)sym->object)->type_id, f);
+  err = write_uint32_t(expr->type_id, f);
+  PROPAGATE_ERROR(err);
+  err = write_parameters(expr->parameters.data,
+    ARR_LENGTH(expr->parameters), f);
+  PROPAGATE_ERROR(err);
+  PUTC_AND_PROPAGATE_ERROR(
+    (expr->replace_with != NULL) ? EXPRESSION_REPLACES : 0, f);
+  if (expr->replace_with != NULL) {
+    err = write_flat_value(expr->replace_with, f);
+    PROPAGATE_ERROR(err);
+  }
+  return err;
+}
+
+#define THEOREM_AXIOM 0x01
+
+static int write_theorem(const sl_LogicSymbol *sym, FILE *f)
+{
+  int err;
+  const struct Theorem *thm;
+  thm = (struct Theorem *)sym->object;
+  err = write_path(sym->path, f);
+  PROPAGATE_ERROR(err);
+  PUTC_AND_PROPAGATE_ERROR(thm->is_axiom ? THEOREM_AXIOM : 0, f);
+  err = write_parameters(thm->parameters.data,
+    ARR_LENGTH(thm->parameters), f);
+  PROPAGATE_ERROR(err);
+  err = write_uint32_t((uint32_t)ARR_LENGTH(thm->requirements), f);
+  PROPAGATE_ERROR(err);
+  for (size_t i = 0; i < ARR_LENGTH(thm->requirements); ++i) {
+    const struct Requirement *req = ARR_GET(thm->requirements, i);
+    err = write_uint32_t((uint32_t)req->type, f);
+    PROPAGATE_ERROR(err);
+    err = write_values(&req->arguments, f);
+    PROPAGATE_ERROR(err);
+  }
+  err = write_flat_values(&thm->flat_assumptions, f);
+  PROPAGATE_ERROR(err);
+  err = write_flat_values(&thm->flat_inferences, f);
   PROPAGATE_ERROR(err);
   return err;
 }
@@ -218,6 +358,12 @@ static int write_symbol(const sl_LogicSymbol *sym, FILE *f)
     case sl_LogicSymbolType_Constspace:
       err = write_constspace(sym, f);
       break;
+    case sl_LogicSymbolType_Expression:
+      err = write_expression(sym, f);
+      break;
+    case sl_LogicSymbolType_Theorem:
+      err = write_theorem(sym, f);
+      break;
     default:
       err = write_uint32_t(0xDEADBEEF, f);
       break;
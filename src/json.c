@@ -0,0 +1,549 @@
+#include "json.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+struct JsonMember
+{
+  char *name;
+  sl_JsonValue *value;
+};
+
+struct sl_JsonValue
+{
+  sl_JsonType type;
+  union
+  {
+    bool boolean;
+    double number;
+    char *string;
+    ARR(sl_JsonValue *) elements;
+    ARR(struct JsonMember) members;
+  } content;
+};
+
+/* Deeper documents are rejected, rather than risk running out of stack. */
+#define JSON_MAX_DEPTH 256
+
+struct JsonParser
+{
+  const char *at;
+  const char *end;
+  unsigned int depth;
+};
+
+static sl_JsonValue *
+parse_value(struct JsonParser *parser);
+
+static void
+skip_whitespace(struct JsonParser *parser)
+{
+  while (parser->at < parser->end && (*parser->at == ' '
+      || *parser->at == '\t' || *parser->at == '\n' || *parser->at == '\r'))
+    ++parser->at;
+}
+
+static bool
+consume_literal(struct JsonParser *parser, const char *literal)
+{
+  size_t length = strlen(literal);
+  if ((size_t)(parser->end - parser->at) < length
+      || memcmp(parser->at, literal, length) != 0)
+    return FALSE;
+  parser->at += length;
+  return TRUE;
+}
+
+static sl_JsonValue *
+new_json_value(sl_JsonType type)
+{
+  sl_JsonValue *value = SL_NEW(sl_JsonValue);
+  memset(value, 0, sizeof(sl_JsonValue));
+  value->type = type;
+  return value;
+}
+
+static int
+parse_hex4(struct JsonParser *parser, uint32_t *code)
+{
+  *code = 0;
+  if (parser->end - parser->at < 4)
+    return 1;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    char c = *parser->at++;
+    *code <<= 4;
+    if (c >= '0' && c <= '9')
+      *code |= (uint32_t)(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      *code |= (uint32_t)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      *code |= (uint32_t)(c - 'A' + 10);
+    else
+      return 1;
+  }
+  return 0;
+}
+
+static void
+append_utf8(sl_StringBuilder *builder, uint32_t code)
+{
+  if (code < 0x80)
+  {
+    sl_string_builder_append_char(builder, (char)code);
+  }
+  else if (code < 0x800)
+  {
+    sl_string_builder_append_char(builder, (char)(0xC0 | (code >> 6)));
+    sl_string_builder_append_char(builder, (char)(0x80 | (code & 0x3F)));
+  }
+  else if (code < 0x10000)
+  {
+    sl_string_builder_append_char(builder, (char)(0xE0 | (code >> 12)));
+    sl_string_builder_append_char(builder,
+      (char)(0x80 | ((code >> 6) & 0x3F)));
+    sl_string_builder_append_char(builder, (char)(0x80 | (code & 0x3F)));
+  }
+  else
+  {
+    sl_string_builder_append_char(builder, (char)(0xF0 | (code >> 18)));
+    sl_string_builder_append_char(builder,
+      (char)(0x80 | ((code >> 12) & 0x3F)));
+    sl_string_builder_append_char(builder,
+      (char)(0x80 | ((code >> 6) & 0x3F)));
+    sl_string_builder_append_char(builder, (char)(0x80 | (code & 0x3F)));
+  }
+}
+
+/* Reads a string, starting at its opening quote. */
+static char *
+parse_string(struct JsonParser *parser)
+{
+  sl_StringBuilder builder;
+  if (parser->at >= parser->end || *parser->at != '"')
+    return NULL;
+  ++parser->at;
+  sl_string_builder_init(&builder);
+  while (parser->at < parser->end && *parser->at != '"')
+  {
+    char c = *parser->at++;
+    if ((unsigned char)c < 0x20)
+    {
+      sl_string_builder_free(&builder);
+      return NULL;
+    }
+    if (c != '\\')
+    {
+      sl_string_builder_append_char(&builder, c);
+      continue;
+    }
+    if (parser->at >= parser->end)
+      break;
+    c = *parser->at++;
+    switch (c)
+    {
+      case '"': case '\\': case '/':
+        sl_string_builder_append_char(&builder, c);
+        break;
+      case 'b': sl_string_builder_append_char(&builder, '\b'); break;
+      case 'f': sl_string_builder_append_char(&builder, '\f'); break;
+      case 'n': sl_string_builder_append_char(&builder, '\n'); break;
+      case 'r': sl_string_builder_append_char(&builder, '\r'); break;
+      case 't': sl_string_builder_append_char(&builder, '\t'); break;
+      case 'u':
+        {
+          uint32_t code, low;
+          if (parse_hex4(parser, &code) != 0)
+          {
+            sl_string_builder_free(&builder);
+            return NULL;
+          }
+          /* Characters outside the basic plane come as surrogate pairs. */
+          if (code >= 0xD800 && code < 0xDC00)
+          {
+            if (!consume_literal(parser, "\\u")
+                || parse_hex4(parser, &low) != 0
+                || low < 0xDC00 || low >= 0xE000)
+            {
+              sl_string_builder_free(&builder);
+              return NULL;
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          }
+          else if (code >= 0xDC00 && code < 0xE000)
+          {
+            sl_string_builder_free(&builder);
+            return NULL;
+          }
+          append_utf8(&builder, code);
+        }
+        break;
+      default:
+        sl_string_builder_free(&builder);
+        return NULL;
+    }
+  }
+  if (parser->at >= parser->end)
+  {
+    sl_string_builder_free(&builder);
+    return NULL;
+  }
+  ++parser->at;
+  return sl_string_builder_finish(&builder);
+}
+
+static sl_JsonValue *
+parse_number(struct JsonParser *parser)
+{
+  const char *begin = parser->at;
+  char buffer[64];
+  if (parser->at < parser->end && *parser->at == '-')
+    ++parser->at;
+  if (parser->at >= parser->end || !isdigit((unsigned char)*parser->at))
+    return NULL;
+  if (*parser->at == '0')
+    ++parser->at;
+  else
+  {
+    while (parser->at < parser->end && isdigit((unsigned char)*parser->at))
+      ++parser->at;
+  }
+  if (parser->at < parser->end && *parser->at == '.')
+  {
+    ++parser->at;
+    if (parser->at >= parser->end || !isdigit((unsigned char)*parser->at))
+      return NULL;
+    while (parser->at < parser->end && isdigit((unsigned char)*parser->at))
+      ++parser->at;
+  }
+  if (parser->at < parser->end && (*parser->at == 'e' || *parser->at == 'E'))
+  {
+    ++parser->at;
+    if (parser->at < parser->end && (*parser->at == '+' || *parser->at == '-'))
+      ++parser->at;
+    if (parser->at >= parser->end || !isdigit((unsigned char)*parser->at))
+      return NULL;
+    while (parser->at < parser->end && isdigit((unsigned char)*parser->at))
+      ++parser->at;
+  }
+  if ((size_t)(parser->at - begin) >= sizeof(buffer))
+    return NULL;
+  memcpy(buffer, begin, parser->at - begin);
+  buffer[parser->at - begin] = '\0';
+
+  sl_JsonValue *value = new_json_value(sl_JsonType_Number);
+  value->content.number = strtod(buffer, NULL);
+  return value;
+}
+
+static sl_JsonValue *
+parse_array(struct JsonParser *parser)
+{
+  sl_JsonValue *array = new_json_value(sl_JsonType_Array);
+  ARR_INIT(array->content.elements);
+  ++parser->at;
+  skip_whitespace(parser);
+  if (parser->at < parser->end && *parser->at == ']')
+  {
+    ++parser->at;
+    return array;
+  }
+  while (TRUE)
+  {
+    sl_JsonValue *element = parse_value(parser);
+    if (element == NULL)
+      break;
+    ARR_APPEND(array->content.elements, element);
+    skip_whitespace(parser);
+    if (parser->at >= parser->end)
+      break;
+    if (*parser->at == ']')
+    {
+      ++parser->at;
+      return array;
+    }
+    if (*parser->at != ',')
+      break;
+    ++parser->at;
+  }
+  sl_json_free(array);
+  return NULL;
+}
+
+static sl_JsonValue *
+parse_object(struct JsonParser *parser)
+{
+  sl_JsonValue *object = new_json_value(sl_JsonType_Object);
+  ARR_INIT(object->content.members);
+  ++parser->at;
+  skip_whitespace(parser);
+  if (parser->at < parser->end && *parser->at == '}')
+  {
+    ++parser->at;
+    return object;
+  }
+  while (TRUE)
+  {
+    struct JsonMember member;
+    skip_whitespace(parser);
+    member.name = parse_string(parser);
+    if (member.name == NULL)
+      break;
+    skip_whitespace(parser);
+    if (parser->at >= parser->end || *parser->at != ':')
+    {
+      SL_FREE(member.name);
+      break;
+    }
+    ++parser->at;
+    member.value = parse_value(parser);
+    if (member.value == NULL)
+    {
+      SL_FREE(member.name);
+      break;
+    }
+    ARR_APPEND(object->content.members, member);
+    skip_whitespace(parser);
+    if (parser->at >= parser->end)
+      break;
+    if (*parser->at == '}')
+    {
+      ++parser->at;
+      return object;
+    }
+    if (*parser->at != ',')
+      break;
+    ++parser->at;
+  }
+  sl_json_free(object);
+  return NULL;
+}
+
+static sl_JsonValue *
+parse_value(struct JsonParser *parser)
+{
+  sl_JsonValue *value = NULL;
+  skip_whitespace(parser);
+  if (parser->at >= parser->end || parser->depth >= JSON_MAX_DEPTH)
+    return NULL;
+  parser->depth += 1;
+  switch (*parser->at)
+  {
+    case '{':
+      value = parse_object(parser);
+      break;
+    case '[':
+      value = parse_array(parser);
+      break;
+    case '"':
+      {
+        char *str = parse_string(parser);
+        if (str != NULL)
+        {
+          value = new_json_value(sl_JsonType_String);
+          value->content.string = str;
+        }
+      }
+      break;
+    case 't':
+    case 'f':
+      if (consume_literal(parser, "true"))
+      {
+        value = new_json_value(sl_JsonType_Bool);
+        value->content.boolean = TRUE;
+      }
+      else if (consume_literal(parser, "false"))
+      {
+        value = new_json_value(sl_JsonType_Bool);
+        value->content.boolean = FALSE;
+      }
+      break;
+    case 'n':
+      if (consume_literal(parser, "null"))
+        value = new_json_value(sl_JsonType_Null);
+      break;
+    default:
+      value = parse_number(parser);
+      break;
+  }
+  parser->depth -= 1;
+  return value;
+}
+
+sl_JsonValue *
+sl_json_parse(const char *text, size_t length)
+{
+  struct JsonParser parser;
+  parser.at = text;
+  parser.end = text + length;
+  parser.depth = 0;
+  sl_JsonValue *value = parse_value(&parser);
+  if (value == NULL)
+    return NULL;
+  skip_whitespace(&parser);
+  if (parser.at != parser.end)
+  {
+    sl_json_free(value);
+    return NULL;
+  }
+  return value;
+}
+
+void
+sl_json_free(sl_JsonValue *value)
+{
+  if (value == NULL)
+    return;
+  switch (value->type)
+  {
+    case sl_JsonType_String:
+      SL_FREE(value->content.string);
+      break;
+    case sl_JsonType_Array:
+      for (size_t i = 0; i < ARR_LENGTH(value->content.elements); ++i)
+        sl_json_free(*ARR_GET(value->content.elements, i));
+      ARR_FREE(value->content.elements);
+      break;
+    case sl_JsonType_Object:
+      for (size_t i = 0; i < ARR_LENGTH(value->content.members); ++i)
+      {
+        struct JsonMember *member = ARR_GET(value->content.members, i);
+        SL_FREE(member->name);
+        sl_json_free(member->value);
+      }
+      ARR_FREE(value->content.members);
+      break;
+    default:
+      break;
+  }
+  SL_FREE(value);
+}
+
+sl_JsonType
+sl_json_get_type(const sl_JsonValue *value)
+{
+  return value->type;
+}
+
+bool
+sl_json_get_bool(const sl_JsonValue *value)
+{
+  return value->type == sl_JsonType_Bool && value->content.boolean;
+}
+
+double
+sl_json_get_number(const sl_JsonValue *value)
+{
+  if (value->type != sl_JsonType_Number)
+    return 0.0;
+  return value->content.number;
+}
+
+const char *
+sl_json_get_string(const sl_JsonValue *value)
+{
+  if (value == NULL || value->type != sl_JsonType_String)
+    return NULL;
+  return value->content.string;
+}
+
+size_t
+sl_json_get_length(const sl_JsonValue *value)
+{
+  if (value->type == sl_JsonType_Array)
+    return ARR_LENGTH(value->content.elements);
+  else if (value->type == sl_JsonType_Object)
+    return ARR_LENGTH(value->content.members);
+  return 0;
+}
+
+const sl_JsonValue *
+sl_json_get_element(const sl_JsonValue *array, size_t index)
+{
+  if (array->type != sl_JsonType_Array
+      || index >= ARR_LENGTH(array->content.elements))
+    return NULL;
+  return *ARR_GET(array->content.elements, index);
+}
+
+const char *
+sl_json_get_member_name(const sl_JsonValue *object, size_t index)
+{
+  if (object->type != sl_JsonType_Object
+      || index >= ARR_LENGTH(object->content.members))
+    return NULL;
+  return ARR_GET(object->content.members, index)->name;
+}
+
+const sl_JsonValue *
+sl_json_get_member(const sl_JsonValue *object, const char *name)
+{
+  if (object == NULL || object->type != sl_JsonType_Object)
+    return NULL;
+  for (size_t i = 0; i < ARR_LENGTH(object->content.members); ++i)
+  {
+    const struct JsonMember *member = ARR_GET(object->content.members, i);
+    if (strcmp(member->name, name) == 0)
+      return member->value;
+  }
+  return NULL;
+}
+
+const char *
+sl_json_get_member_string(const sl_JsonValue *object, const char *name)
+{
+  return sl_json_get_string(sl_json_get_member(object, name));
+}
+
+void
+sl_json_write(FILE *out, const sl_JsonValue *value)
+{
+  switch (value->type)
+  {
+    case sl_JsonType_Null:
+      fputs("null", out);
+      break;
+    case sl_JsonType_Bool:
+      fputs(value->content.boolean ? "true" : "false", out);
+      break;
+    case sl_JsonType_Number:
+      {
+        double number = value->content.number;
+        if (!isfinite(number))
+          fputs("null", out);
+        else if (number > -9007199254740992.0 && number < 9007199254740992.0
+            && number == (double)(int64_t)number)
+          fprintf(out, "%" PRId64, (int64_t)number);
+        else
+          fprintf(out, "%.17g", number);
+      }
+      break;
+    case sl_JsonType_String:
+      sl_write_json_string(out, value->content.string);
+      break;
+    case sl_JsonType_Array:
+      fputc('[', out);
+      for (size_t i = 0; i < ARR_LENGTH(value->content.elements); ++i)
+      {
+        if (i > 0)
+          fputc(',', out);
+        sl_json_write(out, *ARR_GET(value->content.elements, i));
+      }
+      fputc(']', out);
+      break;
+    case sl_JsonType_Object:
+      fputc('{', out);
+      for (size_t i = 0; i < ARR_LENGTH(value->content.members); ++i)
+      {
+        const struct JsonMember *member = ARR_GET(value->content.members, i);
+        if (i > 0)
+          fputc(',', out);
+        sl_write_json_string(out, member->name);
+        fputc(':', out);
+        sl_json_write(out, member->value);
+      }
+      fputc('}', out);
+      break;
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "common.h"
+#include <stdio.h>
+
+/* A small reader for JSON documents, for the requests that tools send to
+   the verifier. Documents are parsed into a tree that is owned by its root.
+   Strings are decoded to UTF-8 and numbers are read as doubles. */
+typedef struct sl_JsonValue sl_JsonValue;
+
+enum sl_JsonType
+{
+  sl_JsonType_Null = 0,
+  sl_JsonType_Bool,
+  sl_JsonType_Number,
+  sl_JsonType_String,
+  sl_JsonType_Array,
+  sl_JsonType_Object
+};
+typedef enum sl_JsonType sl_JsonType;
+
+/* Returns NULL if `text` (of `length` bytes) is not a single JSON value,
+   optionally surrounded by whitespace. */
+sl_JsonValue *
+sl_json_parse(const char *text, size_t length);
+
+void
+sl_json_free(sl_JsonValue *value);
+
+sl_JsonType
+sl_json_get_type(const sl_JsonValue *value);
+
+bool
+sl_json_get_bool(const sl_JsonValue *value);
+
+double
+sl_json_get_number(const sl_JsonValue *value);
+
+/* NULL unless `value` is a string. */
+const char *
+sl_json_get_string(const sl_JsonValue *value);
+
+/* The number of elements of an array, or members of an object. */
+size_t
+sl_json_get_length(const sl_JsonValue *value);
+
+const sl_JsonValue *
+sl_json_get_element(const sl_JsonValue *array, size_t index);
+
+const char *
+sl_json_get_member_name(const sl_JsonValue *object, size_t index);
+
+/* NULL if `object` is not an object or has no member called `name`. */
+const sl_JsonValue *
+sl_json_get_member(const sl_JsonValue *object, const char *name);
+
+/* The string member called `name`, or NULL if there is none. */
+const char *
+sl_json_get_member_string(const sl_JsonValue *object, const char *name);
+
+/* Writes `value` back out as compact JSON. */
+void
+sl_json_write(FILE *out, const sl_JsonValue *value);
+
+#endif
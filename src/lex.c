@@ -1,5 +1,7 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Source
 #include "parse.h"
 #include "common.h"
+#include "profile.h"
 #include <string.h>
 
 #define BUFFER_SIZE 16384
@@ -65,10 +67,10 @@ sl_lexer_new_state_with_input(sl_TextInput *input)
   if (state == NULL)
     return NULL;
   state->input = input;
-  state->buffer = malloc(BUFFER_SIZE);
+  state->buffer = SL_MALLOC(BUFFER_SIZE);
   if (state->buffer == NULL)
   {
-    free(state);
+    SL_FREE(state);
     return NULL;
   }
   state->buffer[0] = '\0';
@@ -88,18 +90,22 @@ sl_lexer_free_state(sl_LexerState *state)
   if (state == NULL)
     return;
   if (state->buffer != NULL)
-    free(state->buffer);
+    SL_FREE(state->buffer);
   if (state->overflow_buffer != NULL)
-    free(state->overflow_buffer);
-  free(state);
+    SL_FREE(state->overflow_buffer);
+  SL_FREE(state);
 }
 
 static int
 fetch_next_line(sl_LexerState *state)
 {
   char *result;
+  size_t length, capacity;
   if (state->overflow_buffer != NULL)
-    free(state->overflow_buffer);
+  {
+    SL_FREE(state->overflow_buffer);
+    state->overflow_buffer = NULL;
+  }
   if (sl_input_at_end(state->input))
   {
     state->read_buffer = NULL;
@@ -114,36 +120,49 @@ fetch_next_line(sl_LexerState *state)
   }
 
   /* If the result doesn't end in a newline, copy this into the overflow
-     buffer and keep consuming until we get to a newline. */
-  if (state->buffer[strlen(state->buffer) - 1] != '\n')
+     buffer and keep consuming until we get to a newline. The buffer doubles
+     as it fills, so that even a very long line is read in linear time. */
+  length = strlen(state->buffer);
+  if (length > 0 && state->buffer[length - 1] != '\n')
   {
-    state->overflow_buffer = strdup(state->buffer);
+    capacity = 2 * BUFFER_SIZE;
+    state->overflow_buffer = SL_MALLOC(capacity);
     if (state->overflow_buffer == NULL)
     {
       state->read_buffer = NULL;
       return 1;
     }
+    memcpy(state->overflow_buffer, state->buffer, length + 1);
     do {
-      char *reallocated;
+      size_t chunk_length;
       result = sl_input_gets(state->buffer, BUFFER_SIZE, state->input);
       if (result == NULL)
       {
-        free(state->overflow_buffer);
+        SL_FREE(state->overflow_buffer);
+        state->overflow_buffer = NULL;
         state->read_buffer = NULL;
         return 1;
       }
-      reallocated = realloc(state->overflow_buffer,
-        strlen(state->buffer) + strlen(state->overflow_buffer) + 1);
-      if (reallocated == NULL)
+      chunk_length = strlen(state->buffer);
+      if (length + chunk_length + 1 > capacity)
       {
-        free(state->overflow_buffer);
-        state->read_buffer = NULL;
-        return 1;
+        char *reallocated;
+        while (length + chunk_length + 1 > capacity)
+          capacity *= 2;
+        reallocated = SL_REALLOC(state->overflow_buffer, capacity);
+        if (reallocated == NULL)
+        {
+          SL_FREE(state->overflow_buffer);
+          state->overflow_buffer = NULL;
+          state->read_buffer = NULL;
+          return 1;
+        }
+        state->overflow_buffer = reallocated;
       }
-      state->overflow_buffer = reallocated;
-      strcat(state->overflow_buffer, state->buffer);
-    } while (state->overflow_buffer[strlen(state->overflow_buffer) - 1]
-      != '\n');
+      memcpy(state->overflow_buffer + length, state->buffer,
+        chunk_length + 1);
+      length += chunk_length;
+    } while (state->overflow_buffer[length - 1] != '\n');
     state->read_buffer = state->overflow_buffer;
   }
   else
@@ -162,8 +181,8 @@ is_space_non_newline(char c)
   return FALSE;
 }
 
-int
-sl_lexer_advance(sl_LexerState *state)
+static int
+lexer_advance(sl_LexerState *state)
 {
   /* If we're at the end of the file, return 1. */
   if (sl_input_at_end(state->input) != 0)
@@ -254,6 +273,16 @@ sl_lexer_advance(sl_LexerState *state)
   return 0;
 }
 
+int
+sl_lexer_advance(sl_LexerState *state)
+{
+  int err;
+  sl_profile_begin(sl_ProfilePhase_Lex);
+  err = lexer_advance(state);
+  sl_profile_end();
+  return err;
+}
+
 bool
 sl_lexer_done(sl_LexerState *state)
 {
@@ -280,7 +309,8 @@ sl_lexer_get_current_token_string_value(const sl_LexerState *state)
     slice.begin = state->token_begin + 1;
     slice.length = state->token_length - 2;
   }
-  else if (state->token_type == sl_LexerTokenType_Identifier)
+  else if (state->token_type == sl_LexerTokenType_Identifier
+    || state->token_type == sl_LexerTokenType_Number)
   {
     slice.begin = state->token_begin;
     slice.length = state->token_length;
@@ -288,38 +318,14 @@ sl_lexer_get_current_token_string_value(const sl_LexerState *state)
   return slice;
 }
 
-struct sl_LexerNumber
-sl_lexer_get_current_token_numerical_value(const sl_LexerState *state)
+int
+sl_lexer_get_current_token_numerical_value(const sl_LexerState *state,
+  sl_Natural *value)
 {
-  struct sl_LexerNumber number;
-  number.is_number = FALSE;
-  number.value = 0;
-  if (state == NULL)
-    return number;
-  if (state->token_type == sl_LexerTokenType_Number)
-  {
-    char buffer[64];
-    char *overflow;
-    number.is_number = TRUE;
-    if (state->token_length > 63)
-    {
-      overflow = strndup(state->token_begin, state->token_length);
-      if (overflow == NULL)
-      {
-        number.is_number = FALSE;
-        return number;
-      }
-      number.value = atoi(overflow);
-      free(overflow);
-    }
-    else
-    {
-      strncpy(buffer, state->token_begin, state->token_length);
-      buffer[state->token_length] = '\0';
-      number.value = atoi(buffer);
-    }
-  }
-  return number;
+  if (state == NULL || state->token_type != sl_LexerTokenType_Number)
+    return 1;
+  return sl_natural_from_digits(state->token_begin, state->token_length,
+    value);
 }
 
 uint32_t
@@ -1,22 +1,126 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Strings
 #include "logic.h"
 #include "parse.h"
+#include "render.h"
 #include <string.h>
 
 #include "core.h"
+#include "profile.h"
+#include "proof_cache.h"
+#include "trace.h"
 
-static uint32_t logic_state_add_string(sl_LogicState *state, const char *str)
+/* Table indices */
+#define TABLE_INDEX_INITIAL_CAPACITY 64
+
+static void
+init_table_index(struct TableIndex *index)
 {
-  uint32_t index;
+  index->capacity = TABLE_INDEX_INITIAL_CAPACITY;
+  index->slots = SL_MALLOC(sizeof(uint32_t) * index->capacity);
+  memset(index->slots, 0, sizeof(uint32_t) * index->capacity);
+  ARR_INIT(index->hashes);
+}
+
+static void
+copy_table_index(struct TableIndex *dst, const struct TableIndex *src)
+{
+  dst->capacity = src->capacity;
+  dst->slots = SL_MALLOC(sizeof(uint32_t) * dst->capacity);
+  memcpy(dst->slots, src->slots, sizeof(uint32_t) * dst->capacity);
+  ARR_INIT_RESERVE(dst->hashes, ARR_LENGTH(src->hashes) + 1);
+  memcpy(dst->hashes.data, src->hashes.data,
+    sizeof(uint32_t) * ARR_LENGTH(src->hashes));
+  dst->hashes.length = ARR_LENGTH(src->hashes);
+}
+
+static void
+free_table_index(struct TableIndex *index)
+{
+  SL_FREE(index->slots);
+  ARR_FREE(index->hashes);
+}
+
+static void
+place_in_table_index(struct TableIndex *index, uint32_t position)
+{
+  size_t mask = index->capacity - 1;
+  size_t slot = *ARR_GET(index->hashes, position) & mask;
+  while (index->slots[slot] != 0)
+    slot = (slot + 1) & mask;
+  index->slots[slot] = position + 1;
+}
+
+/* Indexes the entry just appended to the table. */
+static void
+append_to_table_index(struct TableIndex *index, uint32_t hash)
+{
+  ARR_APPEND(index->hashes, hash);
+  if (2 * ARR_LENGTH(index->hashes) > index->capacity)
+  {
+    SL_FREE(index->slots);
+    index->capacity *= 2;
+    index->slots = SL_MALLOC(sizeof(uint32_t) * index->capacity);
+    memset(index->slots, 0, sizeof(uint32_t) * index->capacity);
+    for (size_t i = 0; i < ARR_LENGTH(index->hashes); ++i)
+      place_in_table_index(index, i);
+  }
+  else
+  {
+    place_in_table_index(index, ARR_LENGTH(index->hashes) - 1);
+  }
+}
+
+/* Forgets the last entry of the table. */
+static void
+pop_from_table_index(struct TableIndex *index)
+{
+  size_t mask = index->capacity - 1;
+  uint32_t position = ARR_LENGTH(index->hashes) - 1;
+  size_t slot = *ARR_GET(index->hashes, position) & mask;
+  while (index->slots[slot] != position + 1)
+    slot = (slot + 1) & mask;
+  index->slots[slot] = 0;
+  ARR_POP(index->hashes);
+}
+
+/* Finds the entries whose hash is `hash`, in turn: `*slot` starts out as
+   SIZE_MAX, and UINT32_MAX is returned when there are no more. */
+static uint32_t
+next_in_table_index(const struct TableIndex *index, uint32_t hash,
+  size_t *slot)
+{
+  size_t mask = index->capacity - 1;
+  *slot = (*slot == SIZE_MAX) ? (hash & mask) : ((*slot + 1) & mask);
+  for (; index->slots[*slot] != 0; *slot = (*slot + 1) & mask)
+  {
+    uint32_t position = index->slots[*slot] - 1;
+    if (*ARR_GET(index->hashes, position) == hash)
+      return position;
+  }
+  return UINT32_MAX;
+}
+
+static uint32_t
+string_index_hash(const char *str)
+{
+  return (uint32_t)sl_hash_string(SL_HASH_INIT, str);
+}
+
+uint32_t logic_state_add_string(sl_LogicState *state, const char *str)
+{
+  uint32_t index, hash;
+  size_t slot = SIZE_MAX;
   if (state == NULL || str == NULL)
     return 0;
-  /* TODO: binary search with alphabetical order? */
-  for (size_t i = 0; i < ARR_LENGTH(state->string_table); ++i) {
-    const char *stored = *ARR_GET(state->string_table, i);
-    if (strcmp(str, stored) == 0)
-      return i;
+  hash = string_index_hash(str);
+  while ((index = next_in_table_index(&state->string_index, hash, &slot))
+    != UINT32_MAX) {
+    if (strcmp(str, *ARR_GET(state->string_table, index)) == 0)
+      return index;
   }
   index = ARR_LENGTH(state->string_table);
-  ARR_APPEND(state->string_table, strdup(str));
+  ARR_APPEND(state->string_table, SL_STRDUP(str));
+  append_to_table_index(&state->string_index, hash);
   return index;
 }
 
@@ -30,6 +134,8 @@ const char * logic_state_get_string(const sl_LogicState *state, uint32_t index)
 }
 
 /* Paths */
+#undef SL_MEMORY_TAG
+#define SL_MEMORY_TAG sl_MemoryTag_Paths
 sl_SymbolPath *
 sl_new_symbol_path()
 {
@@ -52,8 +158,10 @@ sl_copy_symbol_path(const sl_SymbolPath *src)
 void
 sl_free_symbol_path(sl_SymbolPath *path)
 {
+  if (path == NULL)
+    return;
   ARR_FREE(path->segments);
-  free(path);
+  SL_FREE(path);
 }
 
 int
@@ -81,29 +189,22 @@ char *
 sl_string_from_symbol_path(const sl_LogicState *state,
   const sl_SymbolPath *path)
 {
-  if (ARR_LENGTH(path->segments) == 0)
-    return strdup("");
-  size_t str_len = ARR_LENGTH(path->segments);
-  for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
-  {
-    const char *segment = sl_get_symbol_path_segment(state, path, i);
-    str_len += strlen(segment);
-  }
-  char *str = malloc(str_len);
-  char *c = str;
+  sl_StringBuilder builder;
+  sl_string_builder_init(&builder);
+  sl_write_symbol_path(state, path, &builder);
+  return sl_string_builder_finish(&builder);
+}
+
+void
+sl_write_symbol_path(const sl_LogicState *state, const sl_SymbolPath *path,
+  sl_StringBuilder *out)
+{
   for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
   {
     if (i > 0)
-    {
-      *c = '.';
-      ++c;
-    }
-    const char *segment = sl_get_symbol_path_segment(state, path, i);
-    strcpy(c, segment);
-    c += strlen(segment);
+      sl_string_builder_append_char(out, '.');
+    sl_string_builder_append(out, sl_get_symbol_path_segment(state, path, i));
   }
-  *c = '\0';
-  return str;
 }
 
 void
@@ -148,6 +249,8 @@ sl_symbol_paths_equal(const sl_SymbolPath *a, const sl_SymbolPath *b)
 }
 
 /* Types */
+#undef SL_MEMORY_TAG
+#define SL_MEMORY_TAG sl_MemoryTag_Symbols
 static void
 free_type(struct Type *type)
 {
@@ -165,11 +268,13 @@ free_expression(struct Expression *expr)
     free_value(binding);
   }
   ARR_FREE(expr->bindings);
+  ARR_FREE(expr->binders);
   if (expr->has_latex) {
     for (size_t i = 0; i < ARR_LENGTH(expr->latex.segments); ++i) {
       struct LatexFormatSegment *seg;
       seg = ARR_GET(expr->latex.segments, i);
-      free(seg->string);
+      SL_FREE(seg->string);
+      SL_FREE(seg->latex);
     }
     ARR_FREE(expr->latex.segments);
   }
@@ -177,110 +282,36 @@ free_expression(struct Expression *expr)
     free_value(expr->replace_with);
 }
 
-static char *
-string_from_expression(const sl_LogicState *state,
-  const struct Expression *expr)
-{
-  size_t len = 5; /* two pairs of parentheses "()" and terminator. */
-  char *path = sl_string_from_symbol_path(state, expr->path);
-  const sl_SymbolPath *type_path =
-      sl_logic_get_symbol_path_by_id(state, expr->type_id);
-  char *type = sl_string_from_symbol_path(state, type_path);
-  len += strlen(path) + strlen(type) + 3; /* '[NAME] : [TYPE]' */
-
-  if (ARR_LENGTH(expr->parameters) == 0)
-  {
-    char *str = malloc(len);
-    char *c = str;
-    *c = '(';
-    ++c;
-    strcpy(c, path);
-    c += strlen(path);
-    strcpy(c, " : ");
-    c += 3;
-    strcpy(c, type);
-    c += strlen(type);
-    *c = ')';
-    ++c;
-    strcpy(c, "()");
-    c += 2;
-    *c = '\0';
-    free(path);
-    free(type);
-    return str;
-  }
-  else
+/* Writes the signature of the expression, '(NAME : TYPE)(PARAM : TYPE, ...)'. */
+static void
+write_expression(const sl_LogicState *state, const struct Expression *expr,
+  sl_StringBuilder *out)
+{
+  sl_string_builder_append_char(out, '(');
+  sl_write_symbol_path(state, expr->path, out);
+  sl_string_builder_append(out, " : ");
+  sl_write_symbol_path(state,
+    sl_logic_get_symbol_path_by_id(state, expr->type_id), out);
+  sl_string_builder_append(out, ")(");
+  for (size_t i = 0; i < ARR_LENGTH(expr->parameters); ++i)
   {
-    bool first_param = TRUE;
-    ARR(char *) param_types;
-    ARR_INIT(param_types);
-    for (size_t i = 0; i < ARR_LENGTH(expr->parameters); ++i)
-    {
-      if (!first_param)
-        len += 2;
-      if (first_param)
-        first_param = FALSE;
-      const struct Parameter *param = ARR_GET(expr->parameters, i);
-      const sl_SymbolPath *type_path =
-          sl_logic_get_symbol_path_by_id(state, param->type_id);
-      const char *param_name = logic_state_get_string(state, param->name_id);
-      char *param_type = sl_string_from_symbol_path(state, type_path);
-      len += strlen(param_name) + strlen(param_type) + 3; /* '[NAME] : [TYPE]' */
-      ARR_APPEND(param_types, param_type);
-    }
-
-    char *str = malloc(len);
-    char *c = str;
-    *c = '(';
-    ++c;
-    strcpy(c, path);
-    c += strlen(path);
-    strcpy(c, " : ");
-    c += 3;
-    strcpy(c, type);
-    c += strlen(type);
-    *c = ')';
-    ++c;
-    *c = '(';
-    ++c;
-    first_param = TRUE;
-    for (size_t i = 0; i < ARR_LENGTH(expr->parameters); ++i)
-    {
-      if (!first_param)
-      {
-        strcpy(c, ", ");
-        c += 2;
-      }
-      if (first_param)
-        first_param = FALSE;
-      const struct Parameter *param = ARR_GET(expr->parameters, i);
-      char *param_type = *ARRAY_GET(param_types, char *, i);
-      const sl_SymbolPath *type_path =
-          sl_logic_get_symbol_path_by_id(state, param->type_id);
-      const char *param_name = logic_state_get_string(state, param->name_id);
-      strcpy(c, param_name);
-      c += strlen(param_name);
-      strcpy(c, " : ");
-      c += 3;
-      strcpy(c, param_type);
-      c += strlen(param_type);
-      free(param_type);
-    }
-    *c = ')';
-    ++c;
-    *c = '\0';
-    free(path);
-    free(type);
-    ARR_FREE(param_types);
-    return str;
-  }
+    const struct Parameter *param = ARR_GET(expr->parameters, i);
+    if (i > 0)
+      sl_string_builder_append(out, ", ");
+    sl_string_builder_append(out,
+      logic_state_get_string(state, param->name_id));
+    sl_string_builder_append(out, " : ");
+    sl_write_symbol_path(state,
+      sl_logic_get_symbol_path_by_id(state, param->type_id), out);
+  }
+  sl_string_builder_append_char(out, ')');
 }
 
 static void
 free_constant(struct Constant *c)
 {
   if (c->latex_format != NULL)
-    free(c->latex_format);
+    SL_FREE(c->latex_format);
 }
 
 /* Theorems. */
@@ -313,13 +344,18 @@ free_theorem(struct Theorem *thm)
   }
   ARR_FREE(thm->inferences);
 
+  for (size_t i = 0; i < ARR_LENGTH(thm->flat_assumptions); ++i)
+    free_flat_value(*ARR_GET(thm->flat_assumptions, i));
+  ARR_FREE(thm->flat_assumptions);
+  for (size_t i = 0; i < ARR_LENGTH(thm->flat_inferences); ++i)
+    free_flat_value(*ARR_GET(thm->flat_inferences, i));
+  ARR_FREE(thm->flat_inferences);
+
   if (!thm->is_axiom) {
     for (size_t i = 0; i < ARR_LENGTH(thm->steps); ++i) {
       struct TheoremReference *step = ARR_GET(thm->steps, i);
-      for (size_t j = 0; j < ARR_LENGTH(step->arguments); ++j) {
-        Value *arg = *ARR_GET(step->arguments, j);
-        free_value(arg);
-      }
+      for (size_t j = 0; j < ARR_LENGTH(step->arguments); ++j)
+        free_flat_value(*ARR_GET(step->arguments, j));
       ARR_FREE(step->arguments);
     }
     ARR_FREE(thm->steps);
@@ -348,7 +384,83 @@ free_symbol(sl_LogicSymbol *sym)
       free_theorem((struct Theorem *)sym->object);
       break;
   }
-  free(sym->object);
+  SL_FREE(sym->object);
+}
+
+/* Symbol tables */
+static void
+init_symbol_tables(struct SymbolTables *tables)
+{
+  ARR_INIT(tables->flags);
+  ARR_INIT(tables->arity);
+  ARR_INIT(tables->parameters);
+  ARR_INIT(tables->definition);
+  ARR_INIT(tables->binder_count);
+  ARR_INIT(tables->binders);
+}
+
+static void
+free_symbol_tables(struct SymbolTables *tables)
+{
+  ARR_FREE(tables->flags);
+  ARR_FREE(tables->arity);
+  ARR_FREE(tables->parameters);
+  ARR_FREE(tables->definition);
+  ARR_FREE(tables->binder_count);
+  ARR_FREE(tables->binders);
+}
+
+static void
+truncate_symbol_tables(struct SymbolTables *tables, size_t length)
+{
+  if (length >= ARR_LENGTH(tables->flags))
+    return;
+  tables->flags.length = length;
+  tables->arity.length = length;
+  tables->parameters.length = length;
+  tables->definition.length = length;
+  tables->binder_count.length = length;
+  tables->binders.length = length;
+}
+
+static void
+append_symbol_tables(struct SymbolTables *tables, const sl_LogicSymbol *sym)
+{
+  uint8_t flags = 0;
+  uint32_t arity = 0;
+  const struct Parameter *parameters = NULL;
+  const Value *definition = NULL;
+  uint32_t binder_count = 0;
+  const int32_t *binders = NULL;
+  if (sym->type == sl_LogicSymbolType_Type)
+  {
+    const struct Type *type = (const struct Type *)sym->object;
+    if (type->atomic)
+      flags |= SYMBOL_ATOMIC;
+    if (type->binds)
+      flags |= SYMBOL_BINDS;
+    if (type->dummies)
+      flags |= SYMBOL_DUMMIES;
+    if (type->numerals)
+      flags |= SYMBOL_NUMERALS;
+  }
+  else if (sym->type == sl_LogicSymbolType_Expression)
+  {
+    const struct Expression *expr = (const struct Expression *)sym->object;
+    if (expr->has_latex)
+      flags |= SYMBOL_LATEX;
+    arity = (uint32_t)ARR_LENGTH(expr->parameters);
+    parameters = expr->parameters.data;
+    definition = expr->replace_with;
+    binder_count = (uint32_t)ARR_LENGTH(expr->binders);
+    binders = expr->binders.data;
+  }
+  ARR_APPEND(tables->flags, flags);
+  ARR_APPEND(tables->arity, arity);
+  ARR_APPEND(tables->parameters, parameters);
+  ARR_APPEND(tables->definition, definition);
+  ARR_APPEND(tables->binder_count, binder_count);
+  ARR_APPEND(tables->binders, binders);
 }
 
 /* Core Logic */
@@ -360,7 +472,14 @@ sl_new_logic_state(FILE *log_out)
     return NULL;
   ARR_INIT(state->string_table);
   ARR_INIT(state->symbol_table);
+  init_symbol_tables(&state->tables);
+  init_table_index(&state->string_index);
+  init_table_index(&state->symbol_index);
   state->next_id = 0;
+  state->numeral_type_id = 0;
+  ARR_INIT(state->loaded_files);
+  memset(&state->shared, 0, sizeof(state->shared));
+  state->failure.message = NULL;
   state->log_out = log_out;
   {
     sl_SymbolPath *base = sl_new_symbol_path();
@@ -370,34 +489,203 @@ sl_new_logic_state(FILE *log_out)
   return state;
 }
 
+/* The tables of a fork start out as copies of the base's, so that lookups
+   in a fork work exactly as they do in any other state. They are arrays of
+   pointers and words (symbols are small structs of pointers), so the copy
+   is a memcpy per table, but it is linear in the size of the base. */
+#define COPY_SHARED_TABLE(dst, src) \
+do { \
+  ARR_INIT_RESERVE(dst, ARR_LENGTH(src) + 1); \
+  memcpy((dst).data, (src).data, sizeof(*(src).data) * ARR_LENGTH(src)); \
+  (dst).length = ARR_LENGTH(src); \
+} \
+while (0)
+
+sl_LogicState *
+sl_logic_state_fork(const sl_LogicState *base, FILE *log_out)
+{
+  sl_LogicState *state = SL_NEW(sl_LogicState);
+  if (state == NULL)
+    return NULL;
+  COPY_SHARED_TABLE(state->string_table, base->string_table);
+  COPY_SHARED_TABLE(state->symbol_table, base->symbol_table);
+  COPY_SHARED_TABLE(state->tables.flags, base->tables.flags);
+  COPY_SHARED_TABLE(state->tables.arity, base->tables.arity);
+  COPY_SHARED_TABLE(state->tables.parameters, base->tables.parameters);
+  COPY_SHARED_TABLE(state->tables.definition, base->tables.definition);
+  COPY_SHARED_TABLE(state->tables.binder_count, base->tables.binder_count);
+  COPY_SHARED_TABLE(state->tables.binders, base->tables.binders);
+  COPY_SHARED_TABLE(state->loaded_files, base->loaded_files);
+  copy_table_index(&state->string_index, &base->string_index);
+  copy_table_index(&state->symbol_index, &base->symbol_index);
+  state->next_id = base->next_id;
+  state->numeral_type_id = base->numeral_type_id;
+  sl_logic_checkpoint(base, &state->shared);
+  state->failure.message = NULL;
+  state->log_out = log_out;
+  return state;
+}
+
 void
 sl_free_logic_state(sl_LogicState *state)
 {
-  for (size_t i = 0; i < ARR_LENGTH(state->string_table); ++i) {
+  for (size_t i = state->shared.strings;
+    i < ARR_LENGTH(state->string_table); ++i) {
     char *str = *ARR_GET(state->string_table, i);
-    free(str);
+    SL_FREE(str);
   }
   ARR_FREE(state->string_table);
-  for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i)
+  for (size_t i = state->shared.symbols;
+    i < ARR_LENGTH(state->symbol_table); ++i)
   {
     sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
     free_symbol(sym);
   }
   ARR_FREE(state->symbol_table);
-  free(state);
+  free_symbol_tables(&state->tables);
+  free_table_index(&state->string_index);
+  free_table_index(&state->symbol_index);
+  for (size_t i = state->shared.loaded_files;
+    i < ARR_LENGTH(state->loaded_files); ++i)
+    SL_FREE(*ARR_GET(state->loaded_files, i));
+  ARR_FREE(state->loaded_files);
+  if (state->failure.message != NULL)
+    SL_FREE(state->failure.message);
+  SL_FREE(state);
 }
 
-sl_LogicSymbol *
-sl_logic_get_symbol(sl_LogicState *state, const sl_SymbolPath *path)
+FILE *
+sl_logic_set_log_out(sl_LogicState *state, FILE *log_out)
+{
+  FILE *old = state->log_out;
+  state->log_out = log_out;
+  return old;
+}
+
+bool
+sl_logic_file_loaded(const sl_LogicState *state, const char *path)
 {
-  /* TODO: Optimize. */
-  for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i)
+  for (size_t i = 0; i < ARR_LENGTH(state->loaded_files); ++i)
   {
-    sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
-    if (sl_symbol_paths_equal(sym->path, path))
-      return sym;
+    if (strcmp(*ARR_GET(state->loaded_files, i), path) == 0)
+      return TRUE;
   }
-  return NULL;
+  return FALSE;
+}
+
+void
+sl_logic_add_loaded_file(sl_LogicState *state, const char *path)
+{
+  ARR_APPEND(state->loaded_files, SL_STRDUP(path));
+}
+
+void
+sl_logic_checkpoint(const sl_LogicState *state,
+  sl_LogicCheckpoint *checkpoint)
+{
+  checkpoint->strings = ARR_LENGTH(state->string_table);
+  checkpoint->symbols = ARR_LENGTH(state->symbol_table);
+  checkpoint->loaded_files = ARR_LENGTH(state->loaded_files);
+  checkpoint->next_id = state->next_id;
+  checkpoint->numeral_type_id = state->numeral_type_id;
+}
+
+void
+sl_logic_rollback(sl_LogicState *state, const sl_LogicCheckpoint *checkpoint)
+{
+  if (checkpoint->symbols < state->shared.symbols)
+    checkpoint = &state->shared;
+
+  /* Everything is appended, and nothing before the checkpoint refers to
+     anything after it, so it is enough to drop the tails. */
+  while (ARR_LENGTH(state->symbol_table) > checkpoint->symbols)
+  {
+    free_symbol(ARR_GET(state->symbol_table,
+      ARR_LENGTH(state->symbol_table) - 1));
+    ARR_POP(state->symbol_table);
+    pop_from_table_index(&state->symbol_index);
+  }
+  truncate_symbol_tables(&state->tables, checkpoint->symbols);
+  while (ARR_LENGTH(state->string_table) > checkpoint->strings)
+  {
+    SL_FREE(*ARR_GET(state->string_table,
+      ARR_LENGTH(state->string_table) - 1));
+    ARR_POP(state->string_table);
+    pop_from_table_index(&state->string_index);
+  }
+  while (ARR_LENGTH(state->loaded_files) > checkpoint->loaded_files)
+  {
+    SL_FREE(*ARR_GET(state->loaded_files,
+      ARR_LENGTH(state->loaded_files) - 1));
+    ARR_POP(state->loaded_files);
+  }
+  state->next_id = checkpoint->next_id;
+  state->numeral_type_id = checkpoint->numeral_type_id;
+}
+
+/* Symbols are indexed by a hash of their path's segments, which can be
+   computed for a path in a scope without joining the two. */
+static uint64_t
+hash_path_segments(uint64_t hash, const sl_SymbolPath *path)
+{
+  if (path != NULL)
+  {
+    for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
+      hash = sl_hash_uint64(hash, *ARR_GET(path->segments, i));
+  }
+  return hash;
+}
+
+static size_t
+path_length_or_zero(const sl_SymbolPath *path)
+{
+  return (path == NULL) ? 0 : ARR_LENGTH(path->segments);
+}
+
+/* Whether `path` is `scope` followed by `suffix`. */
+static bool
+path_joins(const sl_SymbolPath *path, const sl_SymbolPath *scope,
+  const sl_SymbolPath *suffix)
+{
+  size_t scope_length = path_length_or_zero(scope);
+  size_t suffix_length = path_length_or_zero(suffix);
+  if (ARR_LENGTH(path->segments) != scope_length + suffix_length)
+    return FALSE;
+  return (scope_length == 0 || memcmp(path->segments.data,
+      scope->segments.data, sizeof(uint32_t) * scope_length) == 0)
+    && (suffix_length == 0 || memcmp(path->segments.data + scope_length,
+      suffix->segments.data, sizeof(uint32_t) * suffix_length) == 0);
+}
+
+/* The position in the symbol table of the symbol at `scope` followed by
+   `path`, or UINT32_MAX if there is none. A NULL path is never found. */
+static uint32_t
+find_symbol(const sl_LogicState *state, const sl_SymbolPath *scope,
+  const sl_SymbolPath *path)
+{
+  uint32_t position, hash;
+  size_t slot = SIZE_MAX;
+  if (path == NULL)
+    return UINT32_MAX;
+  hash = (uint32_t)hash_path_segments(hash_path_segments(SL_HASH_INIT, scope),
+    path);
+  while ((position = next_in_table_index(&state->symbol_index, hash, &slot))
+    != UINT32_MAX)
+  {
+    const sl_LogicSymbol *sym = ARR_GET(state->symbol_table, position);
+    if (path_joins(sym->path, scope, path))
+      return position;
+  }
+  return UINT32_MAX;
+}
+
+sl_LogicSymbol *
+sl_logic_get_symbol(sl_LogicState *state, const sl_SymbolPath *path)
+{
+  uint32_t position = find_symbol(state, NULL, path);
+  if (position == UINT32_MAX)
+    return NULL;
+  return ARR_GET(state->symbol_table, position);
 }
 
 sl_LogicSymbolType
@@ -426,13 +714,7 @@ size_t sl_logic_count_symbols_of_type(const sl_LogicState *state,
 bool
 logic_state_path_occupied(const sl_LogicState *state, const sl_SymbolPath *path)
 {
-  for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i)
-  {
-    sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
-    if (sl_symbol_paths_equal(sym->path, path))
-      return TRUE;
-  }
-  return FALSE;
+  return find_symbol(state, NULL, path) != UINT32_MAX;
 }
 
 sl_SymbolPath *
@@ -446,16 +728,20 @@ find_first_occupied_path(const sl_LogicState *state, sl_SymbolPath **paths)
   return NULL;
 }
 
+sl_SymbolPath *
+find_occupied_path_in(const sl_LogicState *state, const sl_SymbolPath *scope,
+  const sl_SymbolPath *path)
+{
+  uint32_t position = find_symbol(state, scope, path);
+  if (position == UINT32_MAX)
+    return NULL;
+  return sl_copy_symbol_path(ARR_GET(state->symbol_table, position)->path);
+}
+
 static sl_LogicSymbol *
 locate_symbol(sl_LogicState *state, const sl_SymbolPath *path)
 {
-  for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i)
-  {
-    sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
-    if (sl_symbol_paths_equal(sym->path, path))
-      return sym;
-  }
-  return NULL;
+  return sl_logic_get_symbol(state, path);
 }
 
 static sl_LogicSymbol *
@@ -473,15 +759,11 @@ locate_symbol_with_type(sl_LogicState *state, const sl_SymbolPath *path,
 sl_LogicError sl_logic_get_symbol_id(const sl_LogicState *state,
     const sl_SymbolPath *path, uint32_t *id)
 {
-  for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i) {
-    sl_LogicSymbol *sym;
-    sym = ARR_GET(state->symbol_table, i);
-    if (sl_symbol_paths_equal(sym->path, path)) {
-      *id = i;
-      return sl_LogicError_None;
-    }
-  }
-  return sl_LogicError_NoSymbol;
+  uint32_t position = find_symbol(state, NULL, path);
+  if (position == UINT32_MAX)
+    return sl_LogicError_NoSymbol;
+  *id = position;
+  return sl_LogicError_None;
 }
 
 sl_LogicSymbol * sl_logic_get_symbol_by_id(sl_LogicState *state,
@@ -493,6 +775,15 @@ sl_LogicSymbol * sl_logic_get_symbol_by_id(sl_LogicState *state,
     return ARR_GET(state->symbol_table, id);
 }
 
+const sl_LogicSymbol * sl_logic_get_const_symbol_by_id(
+    const sl_LogicState *state, uint32_t id)
+{
+  if (id >= ARR_LENGTH(state->symbol_table))
+    return NULL;
+  else
+    return ARR_GET(state->symbol_table, id);
+}
+
 const sl_SymbolPath * sl_logic_get_symbol_path_by_id(
     const sl_LogicState *state, uint32_t id)
 {
@@ -504,6 +795,16 @@ const sl_SymbolPath * sl_logic_get_symbol_path_by_id(
   }
 }
 
+/* Symbol ids are indices into the symbol table, so the id taken by a symbol
+   that could not be added is handed out again. */
+static sl_LogicError
+release_unused_id(sl_LogicState *state, sl_LogicError err)
+{
+  if (err != sl_LogicError_None)
+    state->next_id = ARR_LENGTH(state->symbol_table);
+  return err;
+}
+
 static sl_LogicError
 add_symbol(sl_LogicState *state, sl_LogicSymbol sym)
 {
@@ -513,8 +814,8 @@ add_symbol(sl_LogicState *state, sl_LogicSymbol sym)
     path_str = sl_string_from_symbol_path(state, sym.path);
     LOG_NORMAL(state->log_out,
       "Cannot add symbol '%s' because the path is in use.\n", path_str);
-    free(path_str);
-    return sl_LogicError_SymbolAlreadyExists;
+    SL_FREE(path_str);
+    return release_unused_id(state, sl_LogicError_SymbolAlreadyExists);
   }
   else if (sl_get_symbol_path_length(sym.path) > 0)
   {
@@ -530,14 +831,18 @@ add_symbol(sl_LogicState *state, sl_LogicSymbol sym)
       LOG_NORMAL(state->log_out,
         "Cannot add symbol '%s' because there is no parent namespace '%s'.\n",
         path_str, parent_path_str);
-      free(path_str);
-      free(parent_path_str);
+      SL_FREE(path_str);
+      SL_FREE(parent_path_str);
       sl_free_symbol_path(parent_path);
-      return sl_LogicError_NoParent;
+      return release_unused_id(state, sl_LogicError_NoParent);
     }
     sl_free_symbol_path(parent_path);
   }
+  sym.fingerprint = 0;
   ARR_APPEND(state->symbol_table, sym);
+  append_symbol_tables(&state->tables, &sym);
+  append_to_table_index(&state->symbol_index,
+    (uint32_t)hash_path_segments(SL_HASH_INIT, sym.path));
   return sl_LogicError_None;
 }
 
@@ -562,7 +867,8 @@ sl_logic_make_namespace(sl_LogicState *state,
 }
 
 sl_LogicError sl_logic_make_type(sl_LogicState *state,
-    const sl_SymbolPath *type_path, bool atomic, bool binds, bool dummies)
+    const sl_SymbolPath *type_path, bool atomic, bool binds, bool dummies,
+    bool numerals)
 {
   struct Type *t;
   sl_LogicSymbol sym;
@@ -573,15 +879,25 @@ sl_LogicError sl_logic_make_type(sl_LogicState *state,
     LOG_NORMAL(state->log_out,
         "Cannot add type '%s' because it binds but is not atomic.\n",
         type_str);
-    free(type_str);
+    SL_FREE(type_str);
     return sl_LogicError_CannotBindNonAtomic;
   }
+  if (numerals && state->numeral_type_id != 0) {
+    char *type_str;
+    type_str = sl_string_from_symbol_path(state, type_path);
+    LOG_NORMAL(state->log_out,
+        "Cannot add type '%s' because another type already holds numerals.\n",
+        type_str);
+    SL_FREE(type_str);
+    return sl_LogicError_NumeralTypeExists;
+  }
 
   t = SL_NEW(struct Type);
   t->id = state->next_id++;
   t->atomic = atomic;
   t->binds = binds;
   t->dummies = dummies;
+  t->numerals = numerals;
   sym.path = sl_copy_symbol_path(type_path);
   sym.type = sl_LogicSymbolType_Type;
   sym.object = t;
@@ -589,14 +905,16 @@ sl_LogicError sl_logic_make_type(sl_LogicState *state,
 
   err = add_symbol(state, sym);
   if (err != sl_LogicError_None) {
-    free(t);
+    SL_FREE(t);
     sl_free_symbol_path(sym.path);
     return err;
   } else {
     char *type_str;
+    if (numerals)
+      sl_logic_get_symbol_id(state, type_path, &state->numeral_type_id);
     type_str = sl_string_from_symbol_path(state, type_path);
     LOG_NORMAL(state->log_out, "Successfully added type '%s'.\n", type_str);
-    free(type_str);
+    SL_FREE(type_str);
   }
   return sl_LogicError_None;
 }
@@ -625,8 +943,8 @@ sl_logic_make_constant(sl_LogicState *state, const sl_SymbolPath *constant_path,
     LOG_NORMAL(state->log_out,
       "Cannot add constant '%s' because there is no such type '%s'.\n",
       const_str, type_str);
-    free(const_str);
-    free(type_str);
+    SL_FREE(const_str);
+    SL_FREE(type_str);
     return sl_LogicError_NoType;
   }
 
@@ -634,7 +952,7 @@ sl_logic_make_constant(sl_LogicState *state, const sl_SymbolPath *constant_path,
   c->id = state->next_id++;
   c->type_id = type_id;
   if (latex_format != NULL)
-    c->latex_format = strdup(latex_format);
+    c->latex_format = SL_STRDUP(latex_format);
   else
     c->latex_format = NULL;
   sym.path = sl_copy_symbol_path(constant_path);
@@ -646,7 +964,7 @@ sl_logic_make_constant(sl_LogicState *state, const sl_SymbolPath *constant_path,
   err = add_symbol(state, sym);
   if (err != sl_LogicError_None)
   {
-    free(c);
+    SL_FREE(c);
     sl_free_symbol_path(sym.path);
     return err;
   }
@@ -656,7 +974,7 @@ sl_logic_make_constant(sl_LogicState *state, const sl_SymbolPath *constant_path,
     const_str = sl_string_from_symbol_path(state, sym.path);
     LOG_NORMAL(state->log_out, "Successfully added constant '%s'.\n",
       const_str);
-    free(const_str);
+    SL_FREE(const_str);
   }
   return sl_LogicError_None;
 }
@@ -679,8 +997,8 @@ sl_logic_make_constspace(sl_LogicState *state,
     LOG_NORMAL(state->log_out,
       "Cannot add constspace '%s' because there is no such type '%s'.\n",
       constspace_str, type_str);
-    free(constspace_str);
-    free(type_str);
+    SL_FREE(constspace_str);
+    SL_FREE(type_str);
     return sl_LogicError_NoType;
   }
 
@@ -694,7 +1012,7 @@ sl_logic_make_constspace(sl_LogicState *state,
   err = add_symbol(state, sym);
   if (err != sl_LogicError_None)
   {
-    free(c);
+    SL_FREE(c);
     sl_free_symbol_path(sym.path);
     return err;
   }
@@ -704,7 +1022,7 @@ sl_logic_make_constspace(sl_LogicState *state,
     constspace_str = sl_string_from_symbol_path(state, sym.path);
     LOG_NORMAL(state->log_out, "Successfully created constspace '%s'.\n",
       constspace_str);
-    free(constspace_str);
+    SL_FREE(constspace_str);
   }
   return sl_LogicError_None;
 }
@@ -743,7 +1061,7 @@ sl_LogicError sl_logic_make_block(sl_LogicState *state,
       LOG_NORMAL(state->log_out,
           "Couldn't create a parametrized block because the parameter '%s' refers to a nonexistent type '%s'.\n",
           param->name, type_str);
-      free(type_str);
+      SL_FREE(type_str);
       return sl_LogicError_NoType;
     }
     params_n += 1;
@@ -776,11 +1094,11 @@ void sl_logic_free_block(sl_ParametrizedBlock *block)
   if (block == NULL)
     return;
   ARR_FREE(block->parameters);
-  free(block);
+  SL_FREE(block);
 }
 
-sl_LogicError
-add_expression(sl_LogicState *state, struct PrototypeExpression proto)
+static sl_LogicError
+add_expression_impl(sl_LogicState *state, struct PrototypeExpression proto)
 {
   uint32_t type_id;
   sl_LogicError err;
@@ -789,11 +1107,11 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
     char *expr_str = sl_string_from_symbol_path(state, proto.expression_path);
     LOG_NORMAL(state->log_out,
       "Cannot add expression '%s' because the path is in use.\n", expr_str);
-    free(expr_str);
+    SL_FREE(expr_str);
     return sl_LogicError_SymbolAlreadyExists;
   }
 
-  struct Expression *e = malloc(sizeof(struct Expression));
+  struct Expression *e = SL_MALLOC(sizeof(struct Expression));
   e->id = state->next_id;
   ++state->next_id;
 
@@ -807,9 +1125,9 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
     LOG_NORMAL(state->log_out,
       "Cannot add expression '%s' because there is no such type '%s'.\n",
       expr_str, type_str);
-    free(expr_str);
-    free(type_str);
-    free(e);
+    SL_FREE(expr_str);
+    SL_FREE(type_str);
+    SL_FREE(e);
     return sl_LogicError_SymbolAlreadyExists;
   }
   e->type_id = type_id;
@@ -822,7 +1140,9 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
     {
       struct LatexFormatSegment new_seg;
       new_seg.is_variable = (*seg)->is_variable;
-      new_seg.string = strdup((*seg)->string);
+      new_seg.string = SL_STRDUP((*seg)->string);
+      new_seg.argument_index = -1;
+      new_seg.latex = NULL;
       ARR_APPEND(e->latex.segments, new_seg);
     }
   }
@@ -842,14 +1162,17 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
       LOG_NORMAL(state->log_out,
         "Cannot add expression '%s' because the type '%s' is atomic.\n",
         expr_str, type_str);
-      free(expr_str);
-      free(type_str);
-      free(e);
+      SL_FREE(expr_str);
+      SL_FREE(type_str);
+      SL_FREE(e);
       return sl_LogicError_SymbolAlreadyExists;
     }
   }
 
   ARR_INIT(e->parameters);
+  ARR_INIT(e->bindings);
+  ARR_INIT(e->binders);
+  e->replace_with = NULL;
   for (struct PrototypeParameter **param = proto.parameters;
     *param != NULL; ++param)
   {
@@ -864,10 +1187,10 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
       LOG_NORMAL(state->log_out,
         "Cannot add expression '%s' because there is no such type '%s'.\n",
         expr_str, type_str);
-      free(expr_str);
-      free(type_str);
+      SL_FREE(expr_str);
+      SL_FREE(type_str);
       free_expression(e);
-      free(e);
+      SL_FREE(e);
       return sl_LogicError_SymbolAlreadyExists;
     }
     p.name_id = logic_state_add_string(state, (*param)->name);
@@ -875,7 +1198,30 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
     ARR_APPEND(e->parameters, p);
   }
 
-  ARR_INIT(e->bindings);
+  /* Compile the LaTeX format, so that rendering a composition does not need
+     to look up parameters by name or escape the literal text again. */
+  if (e->has_latex)
+  {
+    for (size_t i = 0; i < ARR_LENGTH(e->latex.segments); ++i)
+    {
+      struct LatexFormatSegment *seg = ARR_GET(e->latex.segments, i);
+      if (seg->is_variable)
+      {
+        for (size_t j = 0; j < ARR_LENGTH(e->parameters); ++j)
+        {
+          const struct Parameter *param = ARR_GET(e->parameters, j);
+          if (strcmp(logic_state_get_string(state, param->name_id),
+              seg->string) == 0)
+          {
+            seg->argument_index = j;
+            break;
+          }
+        }
+      }
+      seg->latex = latex_render_string(seg->string);
+    }
+  }
+
   if (proto.bindings != NULL)
   {
     for (Value **binding = proto.bindings; *binding != NULL; ++binding)
@@ -884,8 +1230,27 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
     }
   }
 
+  /* Most bindings are just one of the parameters, so checking whether a
+     composition binds something only needs to look at that argument. */
+  for (size_t i = 0; i < ARR_LENGTH(e->bindings); ++i)
+  {
+    const Value *binding = *ARR_GET(e->bindings, i);
+    int32_t binder = -1;
+    for (size_t j = 0; binding->value_type == ValueTypeVariable
+        && j < ARR_LENGTH(e->parameters); ++j)
+    {
+      const struct Parameter *param = ARR_GET(e->parameters, j);
+      if (param->name_id == binding->content.variable_name_id
+          && param->type_id == binding->type_id)
+      {
+        binder = (int32_t)j;
+        break;
+      }
+    }
+    ARR_APPEND(e->binders, binder);
+  }
+
   /* Check to see if the expression is defined in terms of something else. */
-  e->replace_with = NULL;
   if (proto.replace_with != NULL)
     e->replace_with = copy_value(proto.replace_with);
 
@@ -896,24 +1261,35 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
 
   e->path = sym.path;
 
-  add_symbol(state, sym);
+  err = add_symbol(state, sym);
+  if (err != sl_LogicError_None)
+  {
+    free_expression(e);
+    SL_FREE(e);
+    sl_free_symbol_path(sym.path);
+    return err;
+  }
 
   char *expr_str = sl_string_from_symbol_path(state, proto.expression_path);
   LOG_NORMAL(state->log_out,
     "Successfully added expression '%s'.\n", expr_str);
-  free(expr_str);
+  SL_FREE(expr_str);
   if (verbose)
   {
-    expr_str = string_from_expression(state, e);
-    LOG_VERBOSE(state->log_out, "Signature: '%s'.\n", expr_str);
-    free(expr_str);
-
-    for (size_t i = 0; i < ARR_LENGTH(e->bindings); ++i)
+    sl_StringBuilder out;
+    sl_string_builder_init_file(&out, state->log_out);
+    if (state->log_out != NULL)
     {
-      Value *binding = *ARR_GET(e->bindings, i);
-      char *binding_str = string_from_value(state, binding);
-      LOG_VERBOSE(state->log_out, "Binds: '%s'.\n", binding_str);
-      free(binding_str);
+      sl_string_builder_append(&out, "Signature: '");
+      write_expression(state, e, &out);
+      sl_string_builder_append(&out, "'.\n");
+
+      for (size_t i = 0; i < ARR_LENGTH(e->bindings); ++i)
+      {
+        sl_string_builder_append(&out, "Binds: '");
+        write_value(state, *ARR_GET(e->bindings, i), &out);
+        sl_string_builder_append(&out, "'.\n");
+      }
     }
   }
 
@@ -921,6 +1297,8 @@ add_expression(sl_LogicState *state, struct PrototypeExpression proto)
 }
 
 /* Values */
+#undef SL_MEMORY_TAG
+#define SL_MEMORY_TAG sl_MemoryTag_Values
 Value * sl_logic_make_dummy_value(sl_LogicState *state,
     uint32_t id, const sl_SymbolPath *type_path)
 {
@@ -938,8 +1316,8 @@ Value * sl_logic_make_dummy_value(sl_LogicState *state,
     LOG_NORMAL(state->log_out,
         "Cannot create dummy value because there is no such type '%s'.\n",
         type_str);
-    free(type_str);
-    free(value);
+    SL_FREE(type_str);
+    SL_FREE(value);
     return NULL;
   }
   type_sym = sl_logic_get_symbol_by_id(state, type_id);
@@ -948,8 +1326,8 @@ Value * sl_logic_make_dummy_value(sl_LogicState *state,
     LOG_NORMAL(state->log_out,
         "Cannot create dummy value because '%s' is not a type.\n",
         type_str);
-    free(type_str);
-    free(value);
+    SL_FREE(type_str);
+    SL_FREE(value);
     return NULL;
   }
   type = (struct Type *)type_sym->object;
@@ -958,8 +1336,8 @@ Value * sl_logic_make_dummy_value(sl_LogicState *state,
     LOG_NORMAL(state->log_out,
         "Cannot create dummy value because type '%s' does not support dummies.\n",
         type_str);
-    free(type_str);
-    free(value);
+    SL_FREE(type_str);
+    SL_FREE(value);
     return NULL;
   }
   value->type_id = type_id;
@@ -971,7 +1349,7 @@ Value *
 new_variable_value(sl_LogicState *state, const char *name,
     const sl_SymbolPath *type)
 {
-  Value *value = malloc(sizeof(Value));
+  Value *value = SL_MALLOC(sizeof(Value));
   uint32_t type_id;
   sl_LogicError err;
   value->content.variable_name_id = logic_state_add_string(state, name);
@@ -983,8 +1361,8 @@ new_variable_value(sl_LogicState *state, const char *name,
     char *type_str = sl_string_from_symbol_path(state, type);
     LOG_NORMAL(state->log_out,
       "Cannot create value because there is no such type '%s'.\n", type_str);
-    free(type_str);
-    free(value);
+    SL_FREE(type_str);
+    SL_FREE(value);
     return NULL;
   }
   value->type_id = type_id;
@@ -1027,8 +1405,8 @@ new_constant_value(sl_LogicState *state, const sl_SymbolPath *constant)
     char *const_str = sl_string_from_symbol_path(state, constant);
     LOG_NORMAL(state->log_out,
       "Cannot create value because there is no such constant '%s'.\n", const_str);
-    free(const_str);
-    free(value);
+    SL_FREE(const_str);
+    SL_FREE(value);
     return NULL;
   }
   const struct Constant *constant_obj =
@@ -1036,16 +1414,54 @@ new_constant_value(sl_LogicState *state, const sl_SymbolPath *constant)
   value->content.constant.constant_path =
       sl_copy_symbol_path(constant_obj->path);
   value->type_id = constant_obj->type_id;
-  value->content.constant.constant_latex = strdup(constant_obj->latex_format);
+  if (constant_obj->latex_format != NULL)
+    value->content.constant.constant_latex =
+        SL_STRDUP(constant_obj->latex_format);
+  else
+    value->content.constant.constant_latex = NULL;
 
   return value;
 }
 
 Value *
-new_composition_value(sl_LogicState *state, const sl_SymbolPath *expr_path,
-  Value * const *args)
+sl_logic_make_numeral_value(sl_LogicState *state, const sl_Natural *numeral)
 {
-  Value *value = malloc(sizeof(Value));
+  sl_Natural copy;
+  Value *value;
+  sl_natural_copy(*numeral, &copy);
+  value = sl_logic_make_numeral_value_take(state, &copy);
+  sl_natural_free(&copy);
+  return value;
+}
+
+Value *
+sl_logic_make_numeral_value_take(sl_LogicState *state, sl_Natural *numeral)
+{
+  Value *value;
+  if (state->numeral_type_id == 0) {
+    char *numeral_str = sl_natural_to_string(*numeral);
+    LOG_NORMAL(state->log_out,
+        "Cannot create numeral '%s' because no type holds numerals.\n",
+        numeral_str);
+    SL_FREE(numeral_str);
+    return NULL;
+  }
+  value = SL_NEW(Value);
+  value->value_type = ValueTypeNumeral;
+  value->type_id = state->numeral_type_id;
+  value->parent = NULL;
+  value->content.numeral = *numeral;
+  sl_natural_from_uint64_t(0, numeral);
+  return value;
+}
+
+/* When `take` is set, the arguments become those of the value, and are freed
+   if it cannot be created; otherwise they are copied. */
+static Value *
+new_composition_value_impl(sl_LogicState *state,
+  const sl_SymbolPath *expr_path, Value * const *args, bool take)
+{
+  Value *value = SL_MALLOC(sizeof(Value));
   uint32_t expr_id;
   sl_LogicError err;
   value->value_type = ValueTypeComposition;
@@ -1057,8 +1473,13 @@ new_composition_value(sl_LogicState *state, const sl_SymbolPath *expr_path,
     LOG_NORMAL(state->log_out,
       "Cannot create value because there is no such expression '%s'.\n",
       expr_str);
-    free(expr_str);
-    free(value);
+    SL_FREE(expr_str);
+    SL_FREE(value);
+    if (take)
+    {
+      for (Value * const *arg = args; *arg != NULL; ++arg)
+        free_value(*arg);
+    }
     return NULL;
   }
   value->content.composition.expression_id = expr_id;
@@ -1073,9 +1494,9 @@ new_composition_value(sl_LogicState *state, const sl_SymbolPath *expr_path,
   for (Value * const *arg = args;
     *arg != NULL; ++arg)
   {
-    Value *arg_copy = copy_value(*arg);
-    arg_copy->parent = value;
-    ARR_APPEND(value->content.composition.arguments, arg_copy);
+    Value *arg_value = take ? *arg : copy_value(*arg);
+    arg_value->parent = value;
+    ARR_APPEND(value->content.composition.arguments, arg_value);
   }
 
   /* Make sure that the arguments match the types of the parameters of
@@ -1090,60 +1511,151 @@ new_composition_value(sl_LogicState *state, const sl_SymbolPath *expr_path,
       LOG_NORMAL(state->log_out,
         "Cannot create value because the wrong number of arguments are supplied to the expression '%s'\n",
         expr_str);
-      free(expr_str);
+      SL_FREE(expr_str);
       free_value(value);
       return NULL;
     }
-    ArgumentArray args_array;
-    ARR_INIT(args_array);
     for (size_t i = 0; i < ARR_LENGTH(value->content.composition.arguments);
         ++i) {
-      Value *arg = *ARR_GET(value->content.composition.arguments, i);
+      const Value *arg = *ARR_GET(value->content.composition.arguments, i);
       const struct Parameter *param = ARR_GET(expr->parameters, i);
-      struct Argument argument;
-      argument.name_id = param->name_id;
-      argument.value = copy_value(arg);
-      ARR_APPEND(args_array, argument);
       if (arg->type_id != param->type_id)
       {
         char *expr_str = sl_string_from_symbol_path(state, expr_path);
         LOG_NORMAL(state->log_out,
           "Cannot create value because the type of an argument does not match the required value of the corresponding parameter of expression '%s'\n",
           expr_str);
-        free(expr_str);
+        SL_FREE(expr_str);
         free_value(value);
         return NULL;
       }
     }
-    for (size_t i = 0; i < ARR_LENGTH(args_array); ++i) {
-      struct Argument *arg = ARR_GET(args_array, i);
-      free_value(arg->value);
-    }
-    ARR_FREE(args_array);
   }
 
   return value;
 }
 
+Value *
+new_composition_value(sl_LogicState *state, const sl_SymbolPath *expr_path,
+  Value * const *args)
+{
+  return new_composition_value_impl(state, expr_path, args, FALSE);
+}
+
+Value *
+new_composition_value_take(sl_LogicState *state,
+  const sl_SymbolPath *expr_path, Value * const *args)
+{
+  return new_composition_value_impl(state, expr_path, args, TRUE);
+}
+
 sl_LogicError
-add_axiom(sl_LogicState *state, struct PrototypeTheorem proto)
+add_expression(sl_LogicState *state, struct PrototypeExpression proto)
+{
+  return release_unused_id(state, add_expression_impl(state, proto));
+}
+
+/* Theorems */
+#undef SL_MEMORY_TAG
+#define SL_MEMORY_TAG sl_MemoryTag_Symbols
+/* Frees the values that a prototype handed over, when the theorem is turned
+   down before any of them were moved into it. */
+static void
+free_prototype_statements(const struct PrototypeTheorem *proto)
+{
+  for (struct PrototypeRequirement **req = proto->requirements;
+    *req != NULL; ++req)
+  {
+    for (Value **arg = (*req)->arguments; *arg != NULL; ++arg)
+      free_value(*arg);
+  }
+  for (Value **assume = proto->assumptions; *assume != NULL; ++assume)
+    free_value(*assume);
+  for (Value **infer = proto->inferences; *infer != NULL; ++infer)
+    free_value(*infer);
+}
+
+/* Frees the arguments of the steps of a prototype that were handed over but
+   not used, which are those that are not NULL. */
+static void
+free_prototype_step_arguments(const struct PrototypeTheorem *proto)
+{
+  for (struct PrototypeProofStep **step = proto->steps;
+    *step != NULL; ++step)
+  {
+    for (size_t i = 0; i < (*step)->arguments_n; ++i)
+    {
+      if ((*step)->arguments[i] != NULL)
+      {
+        free_value((*step)->arguments[i]);
+        (*step)->arguments[i] = NULL;
+      }
+    }
+  }
+}
+
+/* Fills in the requirements, assumptions and inferences of `thm`, copying
+   them from `proto`, or moving them if `take` is set. A requirement that
+   cannot be made is left out. */
+static void
+add_theorem_statements(sl_LogicState *state, struct Theorem *thm,
+  const struct PrototypeTheorem *proto, bool take)
+{
+  for (struct PrototypeRequirement **req = proto->requirements;
+    *req != NULL; ++req)
+  {
+    struct Requirement requirement;
+    int err = take ? make_requirement_take(state, &requirement, *req)
+      : make_requirement(state, &requirement, *req);
+
+    if (err == 0)
+      ARR_APPEND(thm->requirements, requirement);
+  }
+
+  for (Value **assume = proto->assumptions;
+    *assume != NULL; ++assume)
+  {
+    ARR_APPEND(thm->assumptions, take ? *assume : copy_value(*assume));
+    ARR_APPEND(thm->flat_assumptions, new_flat_value(*assume));
+  }
+  for (Value **infer = proto->inferences;
+    *infer != NULL; ++infer)
+  {
+    ARR_APPEND(thm->inferences, take ? *infer : copy_value(*infer));
+    ARR_APPEND(thm->flat_inferences, new_flat_value(*infer));
+  }
+}
+
+static sl_LogicError
+add_axiom_impl(sl_LogicState *state, struct PrototypeTheorem proto, bool take)
 {
   if (locate_symbol(state, proto.theorem_path) != NULL)
   {
     char *axiom_str = sl_string_from_symbol_path(state, proto.theorem_path);
     LOG_NORMAL(state->log_out,
       "Cannot add axiom '%s' because the path is in use.\n", axiom_str);
-    free(axiom_str);
+    SL_FREE(axiom_str);
+    if (take)
+      free_prototype_statements(&proto);
     return sl_LogicError_SymbolAlreadyExists;
   }
 
-  struct Theorem *a = malloc(sizeof(struct Theorem));
+  struct Theorem *a = SL_MALLOC(sizeof(struct Theorem));
   a->is_axiom = TRUE;
   a->id = state->next_id;
   ++state->next_id;
+  ARR_INIT(a->parameters);
+  ARR_INIT(a->requirements);
+  ARR_INIT(a->assumptions);
+  ARR_INIT(a->inferences);
+  ARR_INIT(a->flat_assumptions);
+  ARR_INIT(a->flat_inferences);
+
+  /* Requirements, assumptions & inferences. These go first, so that from
+     here on the theorem owns any values that were handed over. */
+  add_theorem_statements(state, a, &proto, take);
 
   /* Parameters. */
-  ARR_INIT(a->parameters);
   for (struct PrototypeParameter **param = proto.parameters;
     *param != NULL; ++param)
   {
@@ -1158,10 +1670,10 @@ add_axiom(sl_LogicState *state, struct PrototypeTheorem proto)
       LOG_NORMAL(state->log_out,
         "Cannot add axiom '%s' because there is no such type '%s'.\n",
         axiom_str, type_str);
-      free(axiom_str);
-      free(type_str);
-      //free_expression(e);
-      free(a);
+      SL_FREE(axiom_str);
+      SL_FREE(type_str);
+      free_theorem(a);
+      SL_FREE(a);
       return sl_LogicError_SymbolAlreadyExists;
     }
     p.name_id = logic_state_add_string(state, (*param)->name);
@@ -1169,32 +1681,6 @@ add_axiom(sl_LogicState *state, struct PrototypeTheorem proto)
     ARR_APPEND(a->parameters, p);
   }
 
-  /* Requirements. */
-  ARR_INIT(a->requirements);
-  for (struct PrototypeRequirement **req = proto.requirements;
-    *req != NULL; ++req)
-  {
-    struct Requirement requirement;
-    int err = make_requirement(state, &requirement, *req);
-
-    if (err == 0)
-      ARR_APPEND(a->requirements, requirement);
-  }
-
-  /* Assumptions & inferences. */
-  ARR_INIT(a->assumptions);
-  ARR_INIT(a->inferences);
-  for (Value **assume = proto.assumptions;
-    *assume != NULL; ++assume)
-  {
-    ARR_APPEND(a->assumptions, copy_value(*assume));
-  }
-  for (Value **infer = proto.inferences;
-    *infer != NULL; ++infer)
-  {
-    ARR_APPEND(a->inferences, copy_value(*infer));
-  }
-
   sl_LogicSymbol sym;
   sym.path = sl_copy_symbol_path(proto.theorem_path);
   sym.type = sl_LogicSymbolType_Theorem;
@@ -1202,35 +1688,56 @@ add_axiom(sl_LogicState *state, struct PrototypeTheorem proto)
 
   a->path = sym.path;
 
-  add_symbol(state, sym);
+  sl_LogicError err = add_symbol(state, sym);
+  if (err != sl_LogicError_None)
+  {
+    free_theorem(a);
+    SL_FREE(a);
+    sl_free_symbol_path(sym.path);
+    return err;
+  }
 
   char *axiom_str = sl_string_from_symbol_path(state, proto.theorem_path);
   LOG_NORMAL(state->log_out,
     "Successfully added axiom '%s'.\n", axiom_str);
-  free(axiom_str);
+  SL_FREE(axiom_str);
 
   if (verbose)
   {
+    sl_StringBuilder out;
+    sl_string_builder_init_file(&out, stdout);
     for (size_t i = 0; i < ARR_LENGTH(a->assumptions); ++i)
     {
-      char *str = string_from_value(state, *ARR_GET(a->assumptions, i));
-      printf("Assumption %zu: %s\n", i, str);
-      free(str);
+      sl_string_builder_printf(&out, "Assumption %zu: ", i);
+      write_value(state, *ARR_GET(a->assumptions, i), &out);
+      sl_string_builder_append_char(&out, '\n');
     }
     for (size_t i = 0; i < ARR_LENGTH(a->inferences); ++i)
     {
-      char *str = string_from_value(state, *ARR_GET(a->inferences, i));
-      printf("Inference %zu: %s\n", i, str);
-      free(str);
+      sl_string_builder_printf(&out, "Inference %zu: ", i);
+      write_value(state, *ARR_GET(a->inferences, i), &out);
+      sl_string_builder_append_char(&out, '\n');
     }
     /*expr_str = string_from_expression(e);
     LOG_VERBOSE(state->log_out, "Signature: '%s'.\n", expr_str);
-    free(expr_str);*/
+    SL_FREE(expr_str);*/
   }
 
   return sl_LogicError_None;
 }
 
+sl_LogicError
+add_axiom(sl_LogicState *state, struct PrototypeTheorem proto)
+{
+  return release_unused_id(state, add_axiom_impl(state, proto, FALSE));
+}
+
+sl_LogicError
+add_axiom_take(sl_LogicState *state, struct PrototypeTheorem proto)
+{
+  return release_unused_id(state, add_axiom_impl(state, proto, TRUE));
+}
+
 struct ProofEnvironment *
 new_proof_environment()
 {
@@ -1240,6 +1747,7 @@ new_proof_environment()
   ARR_INIT(env->parameters); /* TODO: check these. */
   ARR_INIT(env->requirements);
   ARR_INIT(env->proven);
+  env->proven_scanned = 0;
   return env;
 }
 
@@ -1254,12 +1762,45 @@ free_proof_environment(struct ProofEnvironment *env)
   SL_FREE(env);
 }
 
+static void
+clear_theorem_failure(sl_LogicState *state)
+{
+  if (state->failure.message != NULL)
+    SL_FREE(state->failure.message);
+  state->failure.message = NULL;
+  state->failure.step = SIZE_MAX;
+  state->failure.inference = SIZE_MAX;
+}
+
+/* Records why the theorem being added cannot be, replacing any reason
+   recorded before. */
+static void
+set_theorem_failure(sl_LogicState *state, const char *fmt, ...)
+{
+  va_list args;
+  if (state->failure.message != NULL)
+    SL_FREE(state->failure.message);
+  va_start(args, fmt);
+  vasprintf(&state->failure.message, fmt, args);
+  va_end(args);
+}
+
+const char *
+sl_logic_get_theorem_failure(const sl_LogicState *state, size_t *step,
+  size_t *inference)
+{
+  *step = state->failure.step;
+  *inference = state->failure.inference;
+  return state->failure.message;
+}
+
 static bool
-statement_proven(const Value *statement, const struct ProofEnvironment *env)
+statement_proven(const Value *statement, struct ProofEnvironment *env)
 {
   for (size_t i = 0; i < ARR_LENGTH(env->proven); ++i)
   {
     const Value *s = *ARR_GET(env->proven, i);
+    env->proven_scanned += 1;
     if (values_equal(statement, s))
       return TRUE;
   }
@@ -1267,8 +1808,9 @@ statement_proven(const Value *statement, const struct ProofEnvironment *env)
 }
 
 static int
-instantiate_theorem_in_env(struct sl_LogicState *state, const struct Theorem *src,
-  ArgumentArray args, struct ProofEnvironment *env, bool force)
+instantiate_theorem_in_env_impl(struct sl_LogicState *state,
+  const struct Theorem *src, ArgumentArray args, struct ProofEnvironment *env,
+  bool force)
 {
   /* Check the requirements. */
   if (!force)
@@ -1278,7 +1820,14 @@ instantiate_theorem_in_env(struct sl_LogicState *state, const struct Theorem *sr
       const struct Requirement *req = ARR_GET(src->requirements, i);
       bool satisfied = evaluate_requirement(state, req, args, env);
       if (!satisfied)
+      {
+        char *theorem_str = sl_string_from_symbol_path(state, src->path);
+        set_theorem_failure(state,
+          "the requirement '%s' of '%s' is not met.",
+          requirement_type_name(req->type), theorem_str);
+        SL_FREE(theorem_str);
         return 1;
+      }
     }
 
     /* First, instantiate the assumptions. */
@@ -1291,28 +1840,35 @@ instantiate_theorem_in_env(struct sl_LogicState *state, const struct Theorem *sr
       Value *instantiated = reduce_expressions(state, instantiated_0);
       free_value(instantiated_0);
       if (instantiated == NULL)
-        return 1;
+        break;
       ARR_APPEND(instantiated_assumptions, instantiated);
     }
 
     /* Verify that each assumption has been proven. */
+    bool satisfied =
+      ARR_LENGTH(instantiated_assumptions) == ARR_LENGTH(src->assumptions);
     for (size_t i = 0; i < ARR_LENGTH(instantiated_assumptions); ++i)
     {
       Value *assumption = *ARR_GET(instantiated_assumptions, i);
-      if (!statement_proven(assumption, env))
+      if (satisfied && !statement_proven(assumption, env))
       {
         char *theorem_str = sl_string_from_symbol_path(state, src->path);
         char *assumption_str = string_from_value(state, assumption);
         LOG_NORMAL(state->log_out,
           "Cannot instantiate theorem '%s' because the assumption '%s' is not satisfied.\n",
           theorem_str, assumption_str);
-        free(theorem_str);
-        free(assumption_str);
-        return 1;
+        set_theorem_failure(state,
+          "the assumption '%s' of '%s' is not satisfied.",
+          assumption_str, theorem_str);
+        SL_FREE(theorem_str);
+        SL_FREE(assumption_str);
+        satisfied = FALSE;
       }
       free_value(assumption);
     }
     ARR_FREE(instantiated_assumptions);
+    if (!satisfied)
+      return 1;
   }
 
   /* Add all the inferences to the environment as proven statements. */
@@ -1330,43 +1886,532 @@ instantiate_theorem_in_env(struct sl_LogicState *state, const struct Theorem *sr
   return 0;
 }
 
+static int
+instantiate_theorem_in_env(struct sl_LogicState *state, const struct Theorem *src,
+  ArgumentArray args, struct ProofEnvironment *env, bool force)
+{
+  int err;
+  if (sl_tracing())
+  {
+    char *path_str = sl_string_from_symbol_path(state, src->path);
+    sl_trace_begin("step", path_str);
+    SL_FREE(path_str);
+  }
+  sl_profile_begin(sl_ProfilePhase_Instantiate);
+  err = instantiate_theorem_in_env_impl(state, src, args, env, force);
+  sl_profile_end();
+  sl_trace_end();
+  return err;
+}
+
 static void
 list_proven(sl_LogicState *state, const struct ProofEnvironment *env)
 {
-  LOG_NORMAL(state->log_out, "Statements proven:\n");
+  sl_StringBuilder out;
+  if (state->log_out == NULL)
+    return;
+  sl_string_builder_init_file(&out, state->log_out);
+  sl_string_builder_append(&out, "Statements proven:\n");
   for (size_t i = 0; i < ARR_LENGTH(env->proven); ++i)
   {
-    Value *stmt = *ARR_GET(env->proven, i);
-    char *str = string_from_value(state, stmt);
-    LOG_NORMAL(state->log_out, "> '%s'\n", str);
-    free(str);
+    sl_string_builder_append(&out, "> '");
+    write_value(state, *ARR_GET(env->proven, i), &out);
+    sl_string_builder_append(&out, "'\n");
   }
 }
 
-/* TODO: The return value should be a struct, or modify the PrototypeTheorem,
-   in order to propagate errors with full detail. */
-sl_LogicError
-add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
+/* Frees a theorem that failed to check, along with the step in progress
+   (`ref` and `args`) when it failed. */
+static void
+discard_theorem(struct Theorem *thm, struct TheoremReference *ref,
+  ArgumentArray *args)
 {
+  if (ref != NULL)
+  {
+    for (size_t i = 0; i < ARR_LENGTH(ref->arguments); ++i)
+      free_flat_value(*ARR_GET(ref->arguments, i));
+    ARR_FREE(ref->arguments);
+  }
+  if (args != NULL)
+  {
+    for (size_t i = 0; i < ARR_LENGTH(*args); ++i)
+      free_value(ARR_GET(*args, i)->value);
+    ARR_FREE(*args);
+  }
+  free_theorem(thm);
+  SL_FREE(thm);
+}
+
+/* Fingerprints, for the proof cache. These hash the contents of symbols
+   rather than their ids, and a symbol's fingerprint includes those of the
+   symbols it refers to, so that it changes whenever anything the symbol
+   depends on does. */
+static uint64_t
+symbol_fingerprint(sl_LogicState *state, uint32_t id);
+
+static uint64_t
+hash_path(const sl_LogicState *state, uint64_t hash, const sl_SymbolPath *path)
+{
+  hash = sl_hash_uint64(hash, ARR_LENGTH(path->segments));
+  for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
+    hash = sl_hash_string(hash,
+      logic_state_get_string(state, *ARR_GET(path->segments, i)));
+  return hash;
+}
+
+/* Hashes the node alone, and how many arguments it has. */
+static uint64_t
+hash_value_node(sl_LogicState *state, uint64_t hash, const Value *v)
+{
+  hash = sl_hash_uint64(hash, v->value_type);
+  hash = sl_hash_uint64(hash, symbol_fingerprint(state, v->type_id));
+  switch (v->value_type)
+  {
+    case ValueTypeDummy:
+      hash = sl_hash_uint64(hash, v->content.dummy_id);
+      break;
+    case ValueTypeConstant:
+      hash = hash_path(state, hash, v->content.constant.constant_path);
+      break;
+    case ValueTypeVariable:
+      hash = sl_hash_string(hash,
+        logic_state_get_string(state, v->content.variable_name_id));
+      break;
+    case ValueTypeComposition:
+      hash = sl_hash_uint64(hash,
+        symbol_fingerprint(state, v->content.composition.expression_id));
+      hash = sl_hash_uint64(hash,
+        ARR_LENGTH(v->content.composition.arguments));
+      break;
+    case ValueTypeNumeral:
+      hash = sl_natural_hash(hash, v->content.numeral);
+      break;
+  }
+  return hash;
+}
+
+/* The nodes are hashed in prefix order. */
+static uint64_t
+hash_value(sl_LogicState *state, uint64_t hash, const Value *v)
+{
+  struct ValueWalk walk;
+  hash = hash_value_node(state, hash, v);
+  init_value_walk(&walk);
+  push_value_frame(&walk, v);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next++);
+      hash = hash_value_node(state, hash, arg);
+      if (VALUE_ARITY(arg) > 0)
+        push_value_frame(&walk, arg);
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+  return hash;
+}
+
+static uint64_t
+hash_values(sl_LogicState *state, uint64_t hash, Value * const *values,
+  size_t n)
+{
+  hash = sl_hash_uint64(hash, n);
+  for (size_t i = 0; i < n; ++i)
+    hash = hash_value(state, hash, values[i]);
+  return hash;
+}
+
+static uint64_t
+hash_parameters(sl_LogicState *state, uint64_t hash,
+  const struct Parameter *parameters, size_t n)
+{
+  hash = sl_hash_uint64(hash, n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    hash = sl_hash_string(hash,
+      logic_state_get_string(state, parameters[i].name_id));
+    hash = sl_hash_uint64(hash,
+      symbol_fingerprint(state, parameters[i].type_id));
+  }
+  return hash;
+}
+
+/* For theorems, this only covers the statement: a proof can change without
+   affecting the theorems that use it. */
+static uint64_t
+symbol_fingerprint(sl_LogicState *state, uint32_t id)
+{
+  if (id >= ARR_LENGTH(state->symbol_table))
+    return 0;
+  sl_LogicSymbol *sym = ARR_GET(state->symbol_table, id);
+  if (sym->fingerprint != 0)
+    return sym->fingerprint;
+
+  uint64_t hash = sl_hash_uint64(SL_HASH_INIT, sym->type);
+  hash = hash_path(state, hash, sym->path);
+  switch (sym->type)
+  {
+    case sl_LogicSymbolType_Namespace:
+      break;
+    case sl_LogicSymbolType_Type:
+      {
+        const struct Type *type = (struct Type *)sym->object;
+        hash = sl_hash_uint64(hash, (type->atomic ? 1 : 0)
+          | (type->binds ? 2 : 0) | (type->dummies ? 4 : 0)
+          | (type->numerals ? 8 : 0));
+      }
+      break;
+    case sl_LogicSymbolType_Constant:
+      hash = sl_hash_uint64(hash, symbol_fingerprint(state,
+        ((struct Constant *)sym->object)->type_id));
+      break;
+    case sl_LogicSymbolType_Constspace:
+      hash = sl_hash_uint64(hash, symbol_fingerprint(state,
+        ((struct Constspace *)sym->object)->type_id));
+      break;
+    case sl_LogicSymbolType_Expression:
+      {
+        const struct Expression *expr = (struct Expression *)sym->object;
+        hash = sl_hash_uint64(hash, symbol_fingerprint(state, expr->type_id));
+        hash = hash_parameters(state, hash, expr->parameters.data,
+          ARR_LENGTH(expr->parameters));
+        hash = hash_values(state, hash, expr->bindings.data,
+          ARR_LENGTH(expr->bindings));
+        if (expr->replace_with != NULL)
+          hash = hash_value(state, hash, expr->replace_with);
+      }
+      break;
+    case sl_LogicSymbolType_Theorem:
+      {
+        const struct Theorem *thm = (struct Theorem *)sym->object;
+        hash = hash_parameters(state, hash, thm->parameters.data,
+          ARR_LENGTH(thm->parameters));
+        hash = sl_hash_uint64(hash, ARR_LENGTH(thm->requirements));
+        for (size_t i = 0; i < ARR_LENGTH(thm->requirements); ++i)
+        {
+          const struct Requirement *req = ARR_GET(thm->requirements, i);
+          hash = sl_hash_uint64(hash, req->type);
+          hash = hash_values(state, hash, req->arguments.data,
+            ARR_LENGTH(req->arguments));
+        }
+        hash = hash_values(state, hash, thm->assumptions.data,
+          ARR_LENGTH(thm->assumptions));
+        hash = hash_values(state, hash, thm->inferences.data,
+          ARR_LENGTH(thm->inferences));
+      }
+      break;
+  }
+  if (hash == 0)
+    hash = 1;
+  sym->fingerprint = hash;
+  return hash;
+}
+
+uint64_t
+sl_logic_symbol_fingerprint(sl_LogicState *state, uint32_t id)
+{
+  return symbol_fingerprint(state, id);
+}
+
+static size_t
+count_values(Value * const *values)
+{
+  size_t n = 0;
+  while (values[n] != NULL)
+    ++n;
+  return n;
+}
+
+/* Covers the statement and the proof of a theorem that is about to be
+   checked. Returns 0 if the theorem refers to something that does not
+   exist, or leaves out arguments of a step (which are only inferred while
+   its proof is checked), in which case it cannot be cached. */
+static uint64_t
+theorem_prototype_fingerprint(sl_LogicState *state,
+  const struct PrototypeTheorem *proto)
+{
+  uint64_t hash = hash_path(state, SL_HASH_INIT, proto->theorem_path);
+  for (struct PrototypeParameter **param = proto->parameters;
+    *param != NULL; ++param)
+  {
+    uint32_t type_id;
+    if (sl_logic_get_symbol_id(state, (*param)->type, &type_id)
+        != sl_LogicError_None)
+      return 0;
+    hash = sl_hash_string(hash, (*param)->name);
+    hash = sl_hash_uint64(hash, symbol_fingerprint(state, type_id));
+  }
+  for (struct PrototypeRequirement **req = proto->requirements;
+    *req != NULL; ++req)
+  {
+    hash = sl_hash_string(hash, (*req)->require);
+    hash = hash_values(state, hash, (*req)->arguments,
+      count_values((*req)->arguments));
+  }
+  hash = hash_values(state, hash, proto->assumptions,
+    count_values(proto->assumptions));
+  hash = hash_values(state, hash, proto->inferences,
+    count_values(proto->inferences));
+  for (struct PrototypeProofStep **step = proto->steps;
+    *step != NULL; ++step)
+  {
+    uint32_t theorem_id;
+    const sl_LogicSymbol *theorem;
+    if ((*step)->theorem_path == NULL
+        || sl_logic_get_symbol_id(state, (*step)->theorem_path, &theorem_id)
+        != sl_LogicError_None)
+      return 0;
+    theorem = sl_logic_get_symbol_by_id(state, theorem_id);
+    if (count_values((*step)->arguments) != (*step)->arguments_n
+        || (theorem->type == sl_LogicSymbolType_Theorem
+          && (*step)->arguments_n < ARR_LENGTH(
+            ((const struct Theorem *)theorem->object)->parameters)))
+      return 0;
+    hash = sl_hash_uint64(hash, symbol_fingerprint(state, theorem_id));
+    hash = hash_values(state, hash, (*step)->arguments,
+      (*step)->arguments_n);
+  }
+  return hash;
+}
+
+/* Inferring the arguments that a step leaves out. The theorem's assumptions
+   are matched against the statements proven so far, trying each in turn
+   until they all match, and if that leaves any parameter unbound, its
+   inferences are matched against the inferences of the theorem being
+   proven. The first assignment found that satisfies the requirements, and
+   proves something that was not proven already, is used (failing that, the
+   first that satisfies the requirements); the step is then checked as
+   though it had been written out. */
+struct ArgumentSearch
+{
+  sl_LogicState *state;
+  const struct Theorem *theorem;
+  struct ProofEnvironment *env;
+  ValueArray assumptions; /* The theorem's, reduced. */
+  ValueArray inferences; /* The theorem's, reduced. */
+  ValueArray goals; /* The inferences of the theorem being proven, reduced. */
+  ArgumentArray bindings; /* The values are not owned. */
+  bool novel; /* Only accept steps that prove something new. */
+};
+
+static bool
+proves_novel_statement(struct ArgumentSearch *search)
+{
+  bool novel = ARR_LENGTH(search->inferences) == 0;
+  for (size_t i = 0; !novel && i < ARR_LENGTH(search->inferences); ++i)
+  {
+    Value *instantiated_0 = instantiate_value(
+      *ARR_GET(search->inferences, i), search->bindings);
+    if (instantiated_0 == NULL)
+      continue;
+    Value *instantiated = reduce_expressions(search->state, instantiated_0);
+    free_value(instantiated_0);
+    novel = !statement_proven(instantiated, search->env);
+    free_value(instantiated);
+  }
+  return novel;
+}
+
+static bool
+search_complete(struct ArgumentSearch *search)
+{
+  if (ARR_LENGTH(search->bindings) < ARR_LENGTH(search->theorem->parameters))
+    return FALSE;
+  for (size_t i = 0; i < ARR_LENGTH(search->theorem->requirements); ++i)
+  {
+    if (!evaluate_requirement(search->state,
+        ARR_GET(search->theorem->requirements, i), search->bindings,
+        search->env))
+      return FALSE;
+  }
+  return !search->novel || proves_novel_statement(search);
+}
+
+static bool
+search_inferences(struct ArgumentSearch *search)
+{
+  if (search_complete(search))
+    return TRUE;
+  for (size_t i = 0; i < ARR_LENGTH(search->inferences); ++i)
+  {
+    const Value *inference = *ARR_GET(search->inferences, i);
+    for (size_t j = 0; j < ARR_LENGTH(search->goals); ++j)
+    {
+      /* Only matches that bind something make progress. */
+      size_t bound = ARR_LENGTH(search->bindings);
+      if (match_value(inference, *ARR_GET(search->goals, j),
+          &search->bindings) && ARR_LENGTH(search->bindings) > bound
+          && search_inferences(search))
+        return TRUE;
+      search->bindings.length = bound;
+    }
+  }
+  return FALSE;
+}
+
+static bool
+search_assumptions(struct ArgumentSearch *search, size_t index)
+{
+  if (index == ARR_LENGTH(search->assumptions))
+    return search_inferences(search);
+  const Value *assumption = *ARR_GET(search->assumptions, index);
+
+  /* The most recent statements are the likeliest to be used. */
+  for (size_t i = ARR_LENGTH(search->env->proven); i > 0; --i)
+  {
+    size_t bound = ARR_LENGTH(search->bindings);
+    search->env->proven_scanned += 1;
+    if (match_value(assumption, *ARR_GET(search->env->proven, i - 1),
+        &search->bindings) && search_assumptions(search, index + 1))
+      return TRUE;
+    search->bindings.length = bound;
+  }
+  return FALSE;
+}
+
+static void
+reduce_all(const sl_LogicState *state, ValueArray *dst, const ValueArray *src)
+{
+  ARR_INIT_RESERVE(*dst, ARR_LENGTH(*src) + 1);
+  for (size_t i = 0; i < ARR_LENGTH(*src); ++i)
+    ARR_APPEND(*dst, reduce_expressions(state, *ARR_GET(*src, i)));
+}
+
+/* A bare variable matches any statement of its type, so the assumptions
+   with more structure are matched first, to bind as much as possible before
+   trying every statement. */
+static void
+order_assumptions(ValueArray *assumptions)
+{
+  size_t next = 0;
+  for (size_t i = 0; i < ARR_LENGTH(*assumptions); ++i)
+  {
+    Value **assumption = ARR_GET(*assumptions, i);
+    if ((*assumption)->value_type != ValueTypeVariable)
+    {
+      Value *tmp = *ARR_GET(*assumptions, next);
+      *ARR_GET(*assumptions, next) = *assumption;
+      *assumption = tmp;
+      ++next;
+    }
+  }
+}
+
+static void
+free_all(ValueArray *values)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*values); ++i)
+    free_value(*ARR_GET(*values, i));
+  ARR_FREE(*values);
+}
+
+/* Adds the arguments of `theorem` that are missing from `args`. Returns 0 if
+   they could all be inferred. */
+static int
+infer_arguments(sl_LogicState *state, const struct Theorem *theorem,
+  ArgumentArray *args, struct ProofEnvironment *env,
+  const ValueArray *goals)
+{
+  struct ArgumentSearch search;
+  int err = 1;
+  sl_profile_begin(sl_ProfilePhase_Instantiate);
+  search.state = state;
+  search.theorem = theorem;
+  search.env = env;
+  reduce_all(state, &search.assumptions, &theorem->assumptions);
+  order_assumptions(&search.assumptions);
+  reduce_all(state, &search.inferences, &theorem->inferences);
+  reduce_all(state, &search.goals, goals);
+  ARR_INIT_RESERVE(search.bindings, ARR_LENGTH(theorem->parameters) + 1);
+  for (size_t i = 0; i < ARR_LENGTH(*args); ++i)
+    ARR_APPEND(search.bindings, *ARR_GET(*args, i));
+
+  search.novel = TRUE;
+  bool found = search_assumptions(&search, 0);
+  if (!found)
+  {
+    search.novel = FALSE;
+    found = search_assumptions(&search, 0);
+  }
+  if (found)
+  {
+    for (size_t i = ARR_LENGTH(*args); i < ARR_LENGTH(search.bindings); ++i)
+    {
+      struct Argument arg = *ARR_GET(search.bindings, i);
+      arg.value = copy_value(arg.value);
+      ARR_APPEND(*args, arg);
+    }
+    err = 0;
+  }
+
+  ARR_FREE(search.bindings);
+  free_all(&search.assumptions);
+  free_all(&search.inferences);
+  free_all(&search.goals);
+  sl_profile_end();
+  return err;
+}
+
+static sl_LogicError
+check_and_add_theorem(sl_LogicState *state, struct PrototypeTheorem proto,
+  struct ProofEnvironment *env, size_t *steps_checked, bool take,
+  bool proven)
+{
+  clear_theorem_failure(state);
   if (locate_symbol(state, proto.theorem_path) != NULL)
   {
     char *axiom_str = sl_string_from_symbol_path(state, proto.theorem_path);
     LOG_NORMAL(state->log_out,
       "Cannot add theorem '%s' because the path is in use.\n", axiom_str);
-    free(axiom_str);
+    set_theorem_failure(state, "the path '%s' is in use.", axiom_str);
+    SL_FREE(axiom_str);
+    if (take)
+      free_prototype_statements(&proto);
     return sl_LogicError_SymbolAlreadyExists;
   }
 
-  struct Theorem *a = malloc(sizeof(struct Theorem));
+  /* A theorem that has been proven before, from the same definitions, is
+     added without checking its proof again. */
+  sl_ProofCache *proof_cache = proven ? NULL : sl_get_active_proof_cache();
+  uint64_t fingerprint = 0;
+  bool proven_before = proven;
+  if (proof_cache != NULL)
+  {
+    fingerprint = theorem_prototype_fingerprint(state, &proto);
+    proven_before = fingerprint != 0
+      && sl_proof_cache_contains(proof_cache, fingerprint);
+  }
+
+  struct Theorem *a = SL_MALLOC(sizeof(struct Theorem));
   a->is_axiom = FALSE;
   a->id = state->next_id;
   ++state->next_id;
+  ARR_INIT(a->parameters);
+  ARR_INIT(a->requirements);
+  ARR_INIT(a->assumptions);
+  ARR_INIT(a->inferences);
+  ARR_INIT(a->flat_assumptions);
+  ARR_INIT(a->flat_inferences);
+  ARR_INIT(a->steps);
 
-  /* Environment setup. */
-  struct ProofEnvironment *env = new_proof_environment();
+  /* Requirements, assumptions & inferences. These go first, so that from
+     here on the theorem owns any values that were handed over. */
+  add_theorem_statements(state, a, &proto, take);
+  for (size_t i = 0; i < ARR_LENGTH(a->requirements); ++i)
+    ARR_APPEND(env->requirements, *ARR_GET(a->requirements, i));
+  for (size_t i = 0; !proven_before && i < ARR_LENGTH(a->assumptions); ++i)
+  {
+    ARR_APPEND(env->proven,
+      reduce_expressions(state, *ARR_GET(a->assumptions, i)));
+  }
 
   /* Parameters. */
-  ARR_INIT(a->parameters);
   for (struct PrototypeParameter **param = proto.parameters;
     *param != NULL; ++param)
   {
@@ -1381,10 +2426,10 @@ add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
       LOG_NORMAL(state->log_out,
         "Cannot add theorem '%s' because there is no such type '%s'.\n",
         axiom_str, type_str);
-      free(axiom_str);
-      free(type_str);
-      //free_expression(e);
-      free(a);
+      set_theorem_failure(state, "there is no such type '%s'.", type_str);
+      SL_FREE(axiom_str);
+      SL_FREE(type_str);
+      discard_theorem(a, NULL, NULL);
       return sl_LogicError_SymbolAlreadyExists;
     }
     p.name_id = logic_state_add_string(state, (*param)->name);
@@ -1393,62 +2438,41 @@ add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
     ARR_APPEND(env->parameters, p);
   }
 
-  /* Requirements. */
-  ARR_INIT(a->requirements);
-  for (struct PrototypeRequirement **req = proto.requirements;
-    *req != NULL; ++req)
-  {
-    struct Requirement requirement;
-    int err = make_requirement(state, &requirement, *req);
-
-    if (err == 0)
-    {
-      ARR_APPEND(a->requirements, requirement);
-      ARR_APPEND(env->requirements, requirement);
-    }
-  }
-
-  /* Assumptions & inferences. */
-  ARR_INIT(a->assumptions);
-  ARR_INIT(a->inferences);
-  for (Value **assume = proto.assumptions;
-    *assume != NULL; ++assume)
-  {
-    ARR_APPEND(a->assumptions, copy_value(*assume));
-    Value *reduced = reduce_expressions(state, *assume);
-    ARR_APPEND(env->proven, reduced);
-  }
-  for (Value **infer = proto.inferences;
-    *infer != NULL; ++infer)
-  {
-    ARR_APPEND(a->inferences, copy_value(*infer));
-  }
-
   /* Finally, check the proof. */
-  ARR_INIT(a->steps);
   for (struct PrototypeProofStep **step = proto.steps;
     *step != NULL; ++step)
   {
     struct TheoremReference ref;
     ARR_INIT(ref.arguments);
-    const sl_LogicSymbol *thm_symbol = locate_symbol_with_type(state,
-      (*step)->theorem_path, sl_LogicSymbolType_Theorem);
+    state->failure.step = step - proto.steps;
+    if (!proven_before)
+      *steps_checked += 1;
+    const sl_LogicSymbol *thm_symbol = NULL;
+    if ((*step)->theorem_path != NULL)
+      thm_symbol = locate_symbol_with_type(state, (*step)->theorem_path,
+        sl_LogicSymbolType_Theorem);
     if (thm_symbol == NULL)
     {
       LOG_NORMAL(state->log_out,
         "Cannot add theorem because an axiom/theorem referenced in proof does not exist.\n");
+      set_theorem_failure(state,
+        "the theorem used by this step does not exist.");
+      discard_theorem(a, &ref, NULL);
       return sl_LogicError_SymbolAlreadyExists;
     }
     ref.theorem = (struct Theorem *)thm_symbol->object;
 
     /* Build a list of arguments. */
-    size_t args_n = 0;
-    for (Value **arg = (*step)->arguments; *arg != NULL; ++arg)
-      ++args_n;
-    if (args_n != ARR_LENGTH(ref.theorem->parameters))
+    size_t args_n = ARR_LENGTH(ref.theorem->parameters);
+    bool omit_all = (*step)->arguments_n == 0;
+    bool omitted = FALSE;
+    if ((*step)->arguments_n != args_n && !omit_all)
     {
       LOG_NORMAL(state->log_out,
         "Cannot add theorem because an axiom/theorem referenced received the wrong number of arguments.\n");
+      set_theorem_failure(state,
+        "this step gives the wrong number of arguments.");
+      discard_theorem(a, &ref, NULL);
       return sl_LogicError_SymbolAlreadyExists;
     }
 
@@ -1459,30 +2483,83 @@ add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
       struct Parameter *param = ARR_GET(ref.theorem->parameters, i);
 
       struct Argument arg;
+      if (omit_all || (*step)->arguments[i] == NULL)
+      {
+        omitted = TRUE;
+        continue;
+      }
       arg.name_id = param->name_id;
-      arg.value = copy_value((*step)->arguments[i]);
-
-      ARR_APPEND(ref.arguments, copy_value(arg.value));
+      if (take)
+      {
+        arg.value = (*step)->arguments[i];
+        (*step)->arguments[i] = NULL;
+      }
+      else
+      {
+        arg.value = copy_value((*step)->arguments[i]);
+      }
 
       if (arg.value->type_id != param->type_id)
       {
         LOG_NORMAL(state->log_out,
           "Cannot add theorem because an axiom/theorem referenced received an argument with the wrong type.\n");
+        set_theorem_failure(state,
+          "this step gives an argument with the wrong type.");
+        free_value(arg.value);
+        discard_theorem(a, &ref, &args);
         return sl_LogicError_SymbolAlreadyExists;
       }
 
       ARR_APPEND(args, arg);
     }
 
-    if (instantiate_theorem_in_env(state, ref.theorem, args, env, FALSE) != 0)
+    if (omitted
+        && infer_arguments(state, ref.theorem, &args, env, &a->inferences) != 0)
     {
+      char *theorem_str = sl_string_from_symbol_path(state,
+        ref.theorem->path);
       LOG_NORMAL(state->log_out,
-        "Cannot add theorem because an axiom/theorem referenced could not be instantiated.\n");
+        "Cannot add theorem because the arguments left out of a step using '%s' could not be inferred.\n",
+        theorem_str);
+      set_theorem_failure(state,
+        "the arguments left out of this step using '%s' could not be inferred.",
+        theorem_str);
+      SL_FREE(theorem_str);
       list_proven(state, env);
+      discard_theorem(a, &ref, &args);
       return sl_LogicError_SymbolAlreadyExists;
     }
 
+    /* The step is kept with all of its arguments, in order. They are only
+       kept as a record of the proof, so they are stored flat. */
     for (size_t i = 0; i < args_n; ++i)
+    {
+      const struct Parameter *param = ARR_GET(ref.theorem->parameters, i);
+      for (size_t j = 0; j < ARR_LENGTH(args); ++j)
+      {
+        const struct Argument *arg = ARR_GET(args, j);
+        if (arg->name_id == param->name_id)
+        {
+          ARR_APPEND(ref.arguments, new_flat_value(arg->value));
+          break;
+        }
+      }
+    }
+
+    if (!proven_before
+        && instantiate_theorem_in_env(state, ref.theorem, args, env, FALSE) != 0)
+    {
+      LOG_NORMAL(state->log_out,
+        "Cannot add theorem because an axiom/theorem referenced could not be instantiated.\n");
+      /* Keep the reason given while instantiating, if there is one. */
+      if (state->failure.message == NULL)
+        set_theorem_failure(state, "this step could not be instantiated.");
+      list_proven(state, env);
+      discard_theorem(a, &ref, &args);
+      return sl_LogicError_SymbolAlreadyExists;
+    }
+
+    for (size_t i = 0; i < ARR_LENGTH(args); ++i)
     {
       struct Argument *arg = ARR_GET(args, i);
       free_value(arg->value);
@@ -1490,9 +2567,10 @@ add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
     ARR_FREE(args);
     ARR_APPEND(a->steps, ref);
   }
+  state->failure.step = SIZE_MAX;
 
   /* Check that all the inferences have been proven. */
-  for (size_t i = 0; i < ARR_LENGTH(a->inferences); ++i)
+  for (size_t i = 0; !proven_before && i < ARR_LENGTH(a->inferences); ++i)
   {
     Value *infer = *ARR_GET(a->inferences, i);
     Value *reduced = reduce_expressions(state, infer);
@@ -1500,7 +2578,10 @@ add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
     {
       LOG_NORMAL(state->log_out,
         "Cannot add theorem because an inference was not proven.\n");
+      state->failure.inference = i;
+      set_theorem_failure(state, "this inference was not proven.");
       free_value(reduced);
+      discard_theorem(a, NULL, NULL);
       return sl_LogicError_SymbolAlreadyExists;
     }
     free_value(reduced);
@@ -1514,32 +2595,94 @@ add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
 
   a->path = sym.path;
 
-  add_symbol(state, sym);
+  sl_LogicError err = add_symbol(state, sym);
+  if (err != sl_LogicError_None)
+  {
+    discard_theorem(a, NULL, NULL);
+    sl_free_symbol_path(sym.path);
+    return err;
+  }
+  if (proof_cache != NULL && fingerprint != 0 && !proven_before)
+    sl_proof_cache_add(proof_cache, fingerprint);
 
   char *axiom_str = sl_string_from_symbol_path(state, proto.theorem_path);
   LOG_NORMAL(state->log_out,
     "Successfully added theorem '%s'.\n", axiom_str);
-  free(axiom_str);
+  SL_FREE(axiom_str);
 
   if (verbose)
   {
+    sl_StringBuilder out;
+    sl_string_builder_init_file(&out, stdout);
     for (size_t i = 0; i < ARR_LENGTH(a->assumptions); ++i)
     {
-      char *str = string_from_value(state, *ARR_GET(a->assumptions, i));
-      printf("Assumption %zu: %s\n", i, str);
-      free(str);
+      sl_string_builder_printf(&out, "Assumption %zu: ", i);
+      write_value(state, *ARR_GET(a->assumptions, i), &out);
+      sl_string_builder_append_char(&out, '\n');
     }
     for (size_t i = 0; i < ARR_LENGTH(a->inferences); ++i)
     {
-      char *str = string_from_value(state, *ARR_GET(a->inferences, i));
-      printf("Inference %zu: %s\n", i, str);
-      free(str);
+      sl_string_builder_printf(&out, "Inference %zu: ", i);
+      write_value(state, *ARR_GET(a->inferences, i), &out);
+      sl_string_builder_append_char(&out, '\n');
     }
     /*expr_str = string_from_expression(e);
     LOG_VERBOSE(state->log_out, "Signature: '%s'.\n", expr_str);
-    free(expr_str);*/
+    SL_FREE(expr_str);*/
   }
 
-  free_proof_environment(env);
   return sl_LogicError_None;
 }
+
+static sl_LogicError
+add_theorem_impl(sl_LogicState *state, struct PrototypeTheorem proto,
+  bool take, bool proven)
+{
+  struct sl_ProfileTimer timer;
+  struct ProofEnvironment *env;
+  size_t steps_checked = 0;
+  sl_LogicError err;
+  char *path_str = NULL;
+
+  if (sl_profiling() || sl_tracing())
+    path_str = sl_string_from_symbol_path(state, proto.theorem_path);
+  sl_trace_begin("theorem", path_str);
+  sl_profile_timer_start(&timer);
+  env = new_proof_environment();
+  err = release_unused_id(state,
+    check_and_add_theorem(state, proto, env, &steps_checked, take,
+      proven));
+  if (path_str != NULL)
+  {
+    sl_profile_add_theorem(path_str, err == sl_LogicError_None, &timer,
+      steps_checked, env->proven_scanned);
+    SL_FREE(path_str);
+  }
+  free_proof_environment(env);
+  sl_trace_end();
+  return err;
+}
+
+/* TODO: The return value should be a struct, or modify the PrototypeTheorem,
+   in order to propagate errors with full detail. */
+sl_LogicError
+add_theorem(sl_LogicState *state, struct PrototypeTheorem proto)
+{
+  return add_theorem_impl(state, proto, FALSE, FALSE);
+}
+
+sl_LogicError
+add_theorem_take(sl_LogicState *state, struct PrototypeTheorem proto)
+{
+  sl_LogicError err = add_theorem_impl(state, proto, TRUE, FALSE);
+  free_prototype_step_arguments(&proto);
+  return err;
+}
+
+sl_LogicError
+add_proven_theorem_take(sl_LogicState *state, struct PrototypeTheorem proto)
+{
+  sl_LogicError err = add_theorem_impl(state, proto, TRUE, TRUE);
+  free_prototype_step_arguments(&proto);
+  return err;
+}
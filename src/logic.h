@@ -17,6 +17,54 @@ sl_free_logic_state(sl_LogicState *state);
 int sl_logic_state_write_to_interchange_file(const sl_LogicState *state,
     const char *file_path);
 
+/* Sets where the state logs to (NULL for nowhere), returning the previous
+   destination. */
+FILE *
+sl_logic_set_log_out(sl_LogicState *state, FILE *log_out);
+
+/* The files that have been verified into the state, by absolute path. A file
+   is only verified once, however many times it is imported. */
+bool
+sl_logic_file_loaded(const sl_LogicState *state, const char *path);
+
+void
+sl_logic_add_loaded_file(sl_LogicState *state, const char *path);
+
+/* The extent of a state at some point. Rolling back to a checkpoint removes
+   everything added since, which lets a warm state verify a file without
+   keeping anything from it. */
+struct sl_LogicCheckpoint
+{
+  size_t strings;
+  size_t symbols;
+  size_t loaded_files;
+  uint32_t next_id;
+  uint32_t numeral_type_id;
+};
+typedef struct sl_LogicCheckpoint sl_LogicCheckpoint;
+
+void
+sl_logic_checkpoint(const sl_LogicState *state,
+  sl_LogicCheckpoint *checkpoint);
+
+/* A fork cannot be rolled back past the point at which it was forked. */
+void
+sl_logic_rollback(sl_LogicState *state, const sl_LogicCheckpoint *checkpoint);
+
+/* A new state that starts out with everything in `base`, without copying
+   its symbols or strings: the fork only owns what is added to it afterwards,
+   so freeing the fork discards that and leaves the base as it was. The base
+   must not change, or be freed, while it has forks; as long as it does not,
+   any number of forks of it can be used at once, including on different
+   threads.
+
+   The fork does copy the base's tables, which hold a pointer or a word for
+   each symbol and string, and its hash indexes, so forking takes time and
+   memory linear in the size of the base (about 2 us for the 250 symbols of
+   math/). */
+sl_LogicState *
+sl_logic_state_fork(const sl_LogicState *base, FILE *log_out);
+
 /* Methods to manipulate paths. */
 typedef struct sl_SymbolPath sl_SymbolPath;
 
@@ -44,6 +92,10 @@ char *
 sl_string_from_symbol_path(const sl_LogicState *state,
   const sl_SymbolPath *path);
 
+void
+sl_write_symbol_path(const sl_LogicState *state, const sl_SymbolPath *path,
+  sl_StringBuilder *out);
+
 void
 sl_push_symbol_path(sl_LogicState *state, sl_SymbolPath *path,
   const char *segment);
@@ -63,6 +115,12 @@ logic_state_path_occupied(const sl_LogicState *state, const sl_SymbolPath *path)
 sl_SymbolPath *
 find_first_occupied_path(const sl_LogicState *state, sl_SymbolPath **paths); /* NULL-terminated list. */
 
+/* A copy of `scope` followed by `path` if a symbol is there, found without
+   joining the two, or NULL. */
+sl_SymbolPath *
+find_occupied_path_in(const sl_LogicState *state, const sl_SymbolPath *scope,
+  const sl_SymbolPath *path);
+
 enum sl_LogicError
 {
   sl_LogicError_None = 0,
@@ -73,7 +131,8 @@ enum sl_LogicError
   sl_LogicError_NoType,
   sl_LogicError_RepeatedParameter,
   sl_LogicError_Memory,
-  sl_LogicError_NoSymbol
+  sl_LogicError_NoSymbol,
+  sl_LogicError_NumeralTypeExists
 };
 typedef enum sl_LogicError sl_LogicError;
 
@@ -106,9 +165,11 @@ sl_LogicError
 sl_logic_make_namespace(sl_LogicState *state,
   const sl_SymbolPath *namespace_path);
 
-/* Types. */
+/* Types. Numeral literals are values of the one type declared with
+   `numerals`. */
 sl_LogicError sl_logic_make_type(sl_LogicState *state,
-    const sl_SymbolPath *type_path, bool atomic, bool binds, bool dummies);
+    const sl_SymbolPath *type_path, bool atomic, bool binds, bool dummies,
+    bool numerals);
 
 /* Constants. */
 sl_LogicError
@@ -184,6 +245,10 @@ bool value_terminal(const sl_LogicState *state, const Value *v);
 char *
 string_from_value(const sl_LogicState *state, const Value *value);
 
+void
+write_value(const sl_LogicState *state, const Value *value,
+  sl_StringBuilder *out);
+
 Value * sl_logic_make_dummy_value(sl_LogicState *state,
     uint32_t id, const sl_SymbolPath *type_path);
 
@@ -193,14 +258,35 @@ new_variable_value(sl_LogicState *state, const char *name, const sl_SymbolPath *
 Value *
 new_constant_value(sl_LogicState *state, const sl_SymbolPath *constant);
 
+/* Returns NULL if no type holds numerals. */
+Value *
+sl_logic_make_numeral_value(sl_LogicState *state, const sl_Natural *numeral);
+
+/* Like `sl_logic_make_numeral_value`, but the limbs of `numeral` become
+   those of the value instead of being copied, and `numeral` is left as
+   zero. It is left as it was if the value cannot be created. */
+Value *
+sl_logic_make_numeral_value_take(sl_LogicState *state, sl_Natural *numeral);
+
 Value *
 new_composition_value(sl_LogicState *state, const sl_SymbolPath *expr_path,
   Value * const *args); /* `args` is a NULL-terminated list. */
 
+/* Like `new_composition_value`, but the arguments become part of the value
+   instead of being copied. They are freed if the value cannot be created. */
+Value *
+new_composition_value_take(sl_LogicState *state,
+  const sl_SymbolPath *expr_path, Value * const *args);
+
 struct PrototypeProofStep
 {
   sl_SymbolPath *theorem_path;
-  Value **arguments; /* NULL-terminated list. */
+
+  /* An argument is NULL if it is left out (written `_`), to be inferred from
+     the statements proven so far. A step with no arguments at all leaves out
+     every argument of the theorem it refers to. */
+  Value **arguments;
+  size_t arguments_n;
 };
 
 struct PrototypeRequirement
@@ -229,4 +315,31 @@ add_axiom(sl_LogicState *state, struct PrototypeTheorem axiom);
 sl_LogicError
 add_theorem(sl_LogicState *state, struct PrototypeTheorem theorem);
 
+/* Like `add_axiom` and `add_theorem`, but the values in the prototype (the
+   arguments of its requirements and steps, its assumptions and its
+   inferences) are handed over rather than copied, whether or not the axiom
+   or theorem is added. The caller still owns the lists themselves. The
+   steps of an axiom are disregarded, as ever, and those of a theorem are
+   left with all of their arguments set to NULL. */
+sl_LogicError
+add_axiom_take(sl_LogicState *state, struct PrototypeTheorem axiom);
+
+sl_LogicError
+add_theorem_take(sl_LogicState *state, struct PrototypeTheorem theorem);
+
+/* Why the last theorem could not be added, or NULL if it was. `step` is set
+   to the index of the step of its proof that failed, and `inference` to the
+   index of the inference that was not proven; each is SIZE_MAX if the
+   failure is not there. */
+const char *
+sl_logic_get_theorem_failure(const sl_LogicState *state, size_t *step,
+  size_t *inference);
+
+/* Like `add_theorem_take`, for a theorem whose proof is known to hold, such
+   as one read back from a module artifact. Every step must have all of its
+   arguments; the steps are kept, but not checked again. */
+sl_LogicError
+add_proven_theorem_take(sl_LogicState *state,
+  struct PrototypeTheorem theorem);
+
 #endif
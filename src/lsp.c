@@ -0,0 +1,469 @@
+#include "lsp.h"
+#include "json.h"
+#include "parse.h"
+#include <libgen.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* JSON-RPC error codes. */
+#define LSP_PARSE_ERROR -32700
+#define LSP_INVALID_REQUEST -32600
+#define LSP_METHOD_NOT_FOUND -32601
+
+/* Diagnostic severities. */
+#define LSP_SEVERITY_ERROR 1
+#define LSP_SEVERITY_WARNING 2
+#define LSP_SEVERITY_INFORMATION 3
+
+/* Documents are always sent in full. */
+#define LSP_TEXT_DOCUMENT_SYNC_FULL 1
+
+struct Diagnostic
+{
+  char *file; /* NULL if the message is not about a named input. */
+  size_t line;
+  size_t column;
+  sl_MessageType type;
+  char *message;
+};
+
+typedef ARR(struct Diagnostic) DiagnosticArray;
+
+struct sl_LanguageServer
+{
+  sl_LogicState *state;
+  sl_ProofCache *proof_cache;
+
+  bool shutdown;
+};
+
+/* A message being written, which is only sent once its length is known. */
+struct Message
+{
+  char *data;
+  size_t size;
+  FILE *out;
+};
+
+sl_LanguageServer *
+sl_new_language_server(sl_LogicState *state)
+{
+  sl_LanguageServer *server = SL_NEW(sl_LanguageServer);
+  if (server == NULL)
+    return NULL;
+  server->state = state;
+  server->proof_cache = sl_new_proof_cache();
+  server->shutdown = FALSE;
+  return server;
+}
+
+void
+sl_free_language_server(sl_LanguageServer *server)
+{
+  if (server == NULL)
+    return;
+  sl_free_proof_cache(server->proof_cache);
+  SL_FREE(server);
+}
+
+static void
+collect_message(const char *source, size_t line, size_t column,
+  const char *message, sl_MessageType type, void *user_data)
+{
+  DiagnosticArray *diagnostics = (DiagnosticArray *)user_data;
+  struct Diagnostic diagnostic;
+  diagnostic.file = (source != NULL) ? SL_STRDUP(source) : NULL;
+  diagnostic.line = line;
+  diagnostic.column = column;
+  diagnostic.type = type;
+  diagnostic.message = SL_STRDUP(message);
+  ARR_APPEND(*diagnostics, diagnostic);
+}
+
+static void
+free_diagnostics(DiagnosticArray *diagnostics)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*diagnostics); ++i)
+  {
+    struct Diagnostic *diagnostic = ARR_GET(*diagnostics, i);
+    if (diagnostic->file != NULL)
+      SL_FREE(diagnostic->file);
+    SL_FREE(diagnostic->message);
+  }
+  ARR_FREE(*diagnostics);
+}
+
+int
+sl_language_server_load_base(sl_LanguageServer *server, const char *path)
+{
+  return sl_verify_and_add_file(path, server->state);
+}
+
+const sl_ProofCache *
+sl_language_server_get_proof_cache(const sl_LanguageServer *server)
+{
+  return server->proof_cache;
+}
+
+static int
+hex_digit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/* Returns the path of a `file://` URI, or NULL for any other URI. */
+static char *
+path_from_uri(const char *uri)
+{
+  const char *scheme = "file://";
+  if (strncmp(uri, scheme, strlen(scheme)) != 0)
+    return NULL;
+  uri += strlen(scheme);
+
+  char *path = SL_MALLOC(strlen(uri) + 1);
+  char *c = path;
+  while (*uri != '\0')
+  {
+    if (uri[0] == '%' && hex_digit(uri[1]) >= 0 && hex_digit(uri[2]) >= 0)
+    {
+      *c++ = (char)(hex_digit(uri[1]) * 16 + hex_digit(uri[2]));
+      uri += 3;
+    }
+    else
+    {
+      *c++ = *uri++;
+    }
+  }
+  *c = '\0';
+  return path;
+}
+
+/* The name that the verifier gives to the document at `path`, so that its
+   diagnostics can be told apart from those of the files it imports. */
+static char *
+document_name(const char *path)
+{
+  char *path_copy = SL_STRDUP(path);
+  char *base_copy = SL_STRDUP(path);
+  char directory[PATH_MAX];
+  char *name;
+  if (realpath(dirname(path_copy), directory) != NULL)
+    asprintf(&name, "%s/%s", directory, basename(base_copy));
+  else
+    name = SL_STRDUP(path);
+  SL_FREE(path_copy);
+  SL_FREE(base_copy);
+  return name;
+}
+
+static void
+begin_message(struct Message *message)
+{
+  message->data = NULL;
+  message->size = 0;
+  message->out = open_memstream(&message->data, &message->size);
+  fputs("{\"jsonrpc\":\"2.0\",", message->out);
+}
+
+static void
+send_message(struct Message *message, FILE *out)
+{
+  fputc('}', message->out);
+  fclose(message->out);
+  fprintf(out, "Content-Length: %zu\r\n\r\n", message->size);
+  fwrite(message->data, 1, message->size, out);
+  fflush(out);
+  free(message->data); /* Allocated by the C library. */
+}
+
+static void
+write_id(FILE *out, const sl_JsonValue *id)
+{
+  fputs("\"id\":", out);
+  if (id != NULL)
+    sl_json_write(out, id);
+  else
+    fputs("null", out);
+}
+
+/* Replies to a request with `result`, which is already JSON. */
+static void
+reply_result(const sl_JsonValue *id, const char *result, FILE *out)
+{
+  struct Message message;
+  begin_message(&message);
+  write_id(message.out, id);
+  fprintf(message.out, ",\"result\":%s", result);
+  send_message(&message, out);
+}
+
+static void
+reply_error(const sl_JsonValue *id, int code, const char *text, FILE *out)
+{
+  struct Message message;
+  begin_message(&message);
+  write_id(message.out, id);
+  fprintf(message.out, ",\"error\":{\"code\":%d,\"message\":", code);
+  sl_write_json_string(message.out, text);
+  fputc('}', message.out);
+  send_message(&message, out);
+}
+
+static int
+severity_code(sl_MessageType type)
+{
+  switch (type)
+  {
+    case sl_MessageType_Error:
+      return LSP_SEVERITY_ERROR;
+    case sl_MessageType_Warning:
+      return LSP_SEVERITY_WARNING;
+    case sl_MessageType_Note:
+      return LSP_SEVERITY_INFORMATION;
+  }
+  return LSP_SEVERITY_ERROR;
+}
+
+/* Diagnostics about other files, such as the ones the document imports, are
+   shown at the start of the document. */
+static void
+write_diagnostic(FILE *out, const struct Diagnostic *diagnostic,
+  const char *name)
+{
+  bool in_document = diagnostic->file != NULL
+    && strcmp(diagnostic->file, name) == 0;
+  size_t line = in_document ? diagnostic->line : 0;
+  size_t column = in_document ? diagnostic->column : 0;
+  fprintf(out, "{\"range\":{\"start\":{\"line\":%zu,\"character\":%zu},"
+    "\"end\":{\"line\":%zu,\"character\":%zu}},\"severity\":%d,"
+    "\"source\":\"sl\",\"message\":", line, column, line, column,
+    severity_code(diagnostic->type));
+  if (in_document || diagnostic->file == NULL)
+  {
+    sl_write_json_string(out, diagnostic->message);
+  }
+  else
+  {
+    char *text;
+    asprintf(&text, "In '%s': %s", diagnostic->file, diagnostic->message);
+    sl_write_json_string(out, text);
+    SL_FREE(text);
+  }
+  fputc('}', out);
+}
+
+static void
+publish_diagnostics(const char *uri, const DiagnosticArray *diagnostics,
+  const char *name, FILE *out)
+{
+  struct Message message;
+  begin_message(&message);
+  fputs("\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":",
+    message.out);
+  sl_write_json_string(message.out, uri);
+  fputs(",\"diagnostics\":[", message.out);
+  for (size_t i = 0; i < ARR_LENGTH(*diagnostics); ++i)
+  {
+    if (i > 0)
+      fputc(',', message.out);
+    write_diagnostic(message.out, ARR_GET(*diagnostics, i), name);
+  }
+  fputs("]}", message.out);
+  send_message(&message, out);
+}
+
+/* Verifies the text of a document against the warm state, publishes its
+   diagnostics, and rolls the state back. */
+static void
+verify_document(sl_LanguageServer *server, const char *uri, const char *text,
+  FILE *out)
+{
+  DiagnosticArray diagnostics;
+  ARR_INIT(diagnostics);
+  char *path = path_from_uri(uri);
+  char *name = (path != NULL) ? document_name(path) : SL_STRDUP(uri);
+
+  if (path == NULL)
+  {
+    collect_message(NULL, 0, 0, "only files can be verified.",
+      sl_MessageType_Error, &diagnostics);
+  }
+  else if (sl_logic_file_loaded(server->state, name))
+  {
+    collect_message(name, 0, 0,
+      "this file is part of the base, and is not verified again.",
+      sl_MessageType_Note, &diagnostics);
+  }
+  else
+  {
+    sl_LogicCheckpoint checkpoint;
+    sl_logic_checkpoint(server->state, &checkpoint);
+    sl_set_message_handler(&collect_message, &diagnostics);
+    sl_set_active_proof_cache(server->proof_cache);
+    sl_verify_and_add_string(path, text, server->state);
+    sl_set_active_proof_cache(NULL);
+    sl_set_message_handler(NULL, NULL);
+    sl_logic_rollback(server->state, &checkpoint);
+  }
+
+  publish_diagnostics(uri, &diagnostics, name, out);
+  free_diagnostics(&diagnostics);
+  if (path != NULL)
+    SL_FREE(path);
+  SL_FREE(name);
+}
+
+static const char *
+document_uri(const sl_JsonValue *params)
+{
+  return sl_json_get_member_string(
+    sl_json_get_member(params, "textDocument"), "uri");
+}
+
+/* Handles a single message. Returns 1 once the client asks the server to
+   exit. */
+static int
+handle_message(sl_LanguageServer *server, const sl_JsonValue *json,
+  FILE *out)
+{
+  const char *method = sl_json_get_member_string(json, "method");
+  const sl_JsonValue *id = sl_json_get_member(json, "id");
+  const sl_JsonValue *params = sl_json_get_member(json, "params");
+  if (method == NULL)
+  {
+    /* A response to a request we never make. */
+    return 0;
+  }
+
+  if (strcmp(method, "exit") == 0)
+    return 1;
+  if (server->shutdown && id != NULL)
+  {
+    reply_error(id, LSP_INVALID_REQUEST, "the server is shutting down.", out);
+    return 0;
+  }
+
+  if (strcmp(method, "initialize") == 0)
+  {
+    char *result;
+    asprintf(&result, "{\"capabilities\":{\"textDocumentSync\":%d},"
+      "\"serverInfo\":{\"name\":\"sl\"}}", LSP_TEXT_DOCUMENT_SYNC_FULL);
+    reply_result(id, result, out);
+    SL_FREE(result);
+  }
+  else if (strcmp(method, "shutdown") == 0)
+  {
+    server->shutdown = TRUE;
+    reply_result(id, "null", out);
+  }
+  else if (strcmp(method, "textDocument/didOpen") == 0)
+  {
+    const char *uri = document_uri(params);
+    const char *text = sl_json_get_member_string(
+      sl_json_get_member(params, "textDocument"), "text");
+    if (uri != NULL && text != NULL)
+      verify_document(server, uri, text, out);
+  }
+  else if (strcmp(method, "textDocument/didChange") == 0)
+  {
+    const char *uri = document_uri(params);
+    const sl_JsonValue *changes = sl_json_get_member(params, "contentChanges");
+    size_t n = (changes != NULL) ? sl_json_get_length(changes) : 0;
+    if (uri != NULL && n > 0)
+    {
+      const char *text = sl_json_get_member_string(
+        sl_json_get_element(changes, n - 1), "text");
+      if (text != NULL)
+        verify_document(server, uri, text, out);
+    }
+  }
+  else if (strcmp(method, "textDocument/didClose") == 0)
+  {
+    const char *uri = document_uri(params);
+    if (uri != NULL)
+    {
+      DiagnosticArray none;
+      ARR_INIT(none);
+      publish_diagnostics(uri, &none, uri, out);
+      ARR_FREE(none);
+    }
+  }
+  else if (id != NULL)
+  {
+    reply_error(id, LSP_METHOD_NOT_FOUND, "unknown method.", out);
+  }
+  /* Other notifications, such as `initialized`, need no answer. */
+  return 0;
+}
+
+/* Reads the content of the next message, which is NULL-terminated, or returns
+   NULL at the end of the input. */
+static char *
+read_message(FILE *in, size_t *length)
+{
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t line_length;
+  bool has_length = FALSE;
+  const char *header = "Content-Length:";
+
+  while ((line_length = getline(&line, &capacity, in)) >= 0)
+  {
+    while (line_length > 0
+        && (line[line_length - 1] == '\n' || line[line_length - 1] == '\r'))
+      line[--line_length] = '\0';
+    if (line_length == 0)
+    {
+      if (has_length)
+        break;
+      continue;
+    }
+    if (strncasecmp(line, header, strlen(header)) == 0)
+    {
+      *length = strtoul(line + strlen(header), NULL, 10);
+      has_length = TRUE;
+    }
+  }
+  free(line); /* Allocated by the C library. */
+  if (line_length < 0)
+    return NULL;
+
+  char *content = SL_MALLOC(*length + 1);
+  if (fread(content, 1, *length, in) != *length)
+  {
+    SL_FREE(content);
+    return NULL;
+  }
+  content[*length] = '\0';
+  return content;
+}
+
+int
+sl_language_server_serve_stream(sl_LanguageServer *server, FILE *in,
+  FILE *out)
+{
+  char *content;
+  size_t length;
+  int exit = 0;
+
+  while (!exit && (content = read_message(in, &length)) != NULL)
+  {
+    sl_JsonValue *json = sl_json_parse(content, length);
+    if (json == NULL || sl_json_get_type(json) != sl_JsonType_Object)
+      reply_error(NULL, LSP_PARSE_ERROR, "the message is not a JSON object.",
+        out);
+    else
+      exit = handle_message(server, json, out);
+    sl_json_free(json);
+    SL_FREE(content);
+  }
+  return (exit && server->shutdown) ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include "logic.h"
+#include "proof_cache.h"
+#include <stdio.h>
+
+/* A language server, speaking the Language Server Protocol (JSON-RPC messages
+   framed by a `Content-Length` header) over a pair of streams.
+
+   The base files are verified once, into a logic state that is kept warm.
+   Whenever a document is opened or changed, its text is verified against the
+   state, the diagnostics are published for it, and the state is rolled back.
+   Only the document itself is parsed again: the base is reused as it is, and
+   a theorem whose statement, proof and dependencies are unchanged since it
+   was last proven is not checked again (see proof_cache.h).
+
+   Documents are synchronized in full, and positions are counted in bytes
+   rather than UTF-16 code units. */
+typedef struct sl_LanguageServer sl_LanguageServer;
+
+/* The server does not own the state. */
+sl_LanguageServer *
+sl_new_language_server(sl_LogicState *state);
+
+void
+sl_free_language_server(sl_LanguageServer *server);
+
+/* Verifies a file into the warm state. Returns 0 if the file is valid. */
+int
+sl_language_server_load_base(sl_LanguageServer *server, const char *path);
+
+const sl_ProofCache *
+sl_language_server_get_proof_cache(const sl_LanguageServer *server);
+
+/* Answers the messages read from `in` until the end of the input or an exit
+   notification. Returns 0 if the client shut the server down before asking
+   it to exit, as the protocol expects, and 1 otherwise. */
+int
+sl_language_server_serve_stream(sl_LanguageServer *server, FILE *in,
+  FILE *out);
+
+#endif
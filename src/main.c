@@ -1,7 +1,16 @@
 #include "parse.h"
 #include "render.h"
 #include "arg.h"
+#include "batch.h"
+#include "lsp.h"
+#include "profile.h"
+#include "serve.h"
+#include "term_index.h"
+#include "trace.h"
+#include "watch.h"
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 struct CommandLineOption version_opt = {
   .short_name = 'v',
@@ -31,6 +40,54 @@ struct CommandLineOption html_opt = {
   .long_name = "html",
   .takes_argument = TRUE
 };
+struct CommandLineOption jobs_opt = {
+  .short_name = 'j',
+  .long_name = "jobs",
+  .takes_argument = TRUE
+};
+struct CommandLineOption trace_opt = {
+  .long_name = "trace",
+  .takes_argument = TRUE
+};
+struct CommandLineOption mem_stats_opt = {
+  .long_name = "mem-stats",
+  .takes_argument = FALSE
+};
+struct CommandLineOption profile_opt = {
+  .long_name = "profile",
+  .takes_argument = FALSE
+};
+struct CommandLineOption profile_out_opt = {
+  .long_name = "profile-out",
+  .takes_argument = TRUE
+};
+struct CommandLineOption socket_opt = {
+  .long_name = "socket",
+  .takes_argument = TRUE
+};
+struct CommandLineOption watch_opt = {
+  .long_name = "watch",
+  .takes_argument = FALSE
+};
+struct CommandLineOption batch_opt = {
+  .long_name = "batch",
+  .takes_argument = FALSE
+};
+struct CommandLineOption base_opt = {
+  .long_name = "base",
+  .takes_argument = TRUE
+};
+struct CommandLineOption mode_opt = {
+  .long_name = "mode",
+  .takes_argument = TRUE
+};
+struct CommandLineOption artifacts_opt = {
+  .long_name = "artifacts",
+  .takes_argument = FALSE
+};
+
+/* Number of theorems listed in the profiling report. */
+#define PROFILE_TOP_THEOREMS 10
 
 static void
 print_version()
@@ -44,6 +101,215 @@ print_help()
   printf("help\n");
 }
 
+/* `sl serve [--socket=PATH] FILE...`: verifies the files once, then answers
+   verification requests against them (see serve.h) on stdin, or on a Unix
+   socket, until told to shut down. */
+static int
+serve(struct CommandLine *cl)
+{
+  sl_LogicState *state = sl_new_logic_state(NULL);
+  sl_Server *server = sl_new_server(state);
+  int err = 0;
+  for (size_t i = 1; i < ARRAY_LENGTH(cl->arguments); ++i)
+  {
+    const char *path = *ARRAY_GET(cl->arguments, char *, i);
+    if (sl_server_load_base(server, path) != 0)
+      fprintf(stderr, "File '%s' invalid.\n", path);
+  }
+
+  if (socket_opt.argument != NULL)
+  {
+    if (sl_server_serve_socket(server, socket_opt.argument) != 0)
+    {
+      fprintf(stderr, "Cannot listen on '%s'.\n", socket_opt.argument);
+      err = 1;
+    }
+  }
+  else
+  {
+    /* Replies go to the original stdout, and anything else that would be
+       printed goes to stderr instead, so that it cannot garble a reply. */
+    FILE *replies = fdopen(dup(STDOUT_FILENO), "w");
+    fflush(stdout);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    sl_server_serve_stream(server, stdin, replies);
+    fclose(replies);
+  }
+
+  sl_free_server(server);
+  sl_free_logic_state(state);
+  return err;
+}
+
+/* `sl lsp FILE...`: verifies the files once, then acts as a language server
+   (see lsp.h) on stdin and stdout, verifying the documents that are opened
+   against them. */
+static int
+lsp(struct CommandLine *cl)
+{
+  sl_LogicState *state = sl_new_logic_state(NULL);
+  sl_LanguageServer *server = sl_new_language_server(state);
+  for (size_t i = 1; i < ARRAY_LENGTH(cl->arguments); ++i)
+  {
+    const char *path = *ARRAY_GET(cl->arguments, char *, i);
+    if (sl_language_server_load_base(server, path) != 0)
+      fprintf(stderr, "File '%s' invalid.\n", path);
+  }
+
+  /* As with `serve`, nothing but the protocol may be written to stdout. */
+  FILE *messages = fdopen(dup(STDOUT_FILENO), "w");
+  fflush(stdout);
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+  int err = sl_language_server_serve_stream(server, stdin, messages);
+  fclose(messages);
+
+  sl_free_language_server(server);
+  sl_free_logic_state(state);
+  return err;
+}
+
+/* `sl query [--mode=MODE] PATTERN FILE...`: verifies the files, then lists
+   the axioms and theorems whose inferences fit the pattern (see
+   term_index.h). MODE is one of `instances`, `generalizations` or
+   `unifiable`, the default. */
+static int
+query(struct CommandLine *cl)
+{
+  sl_TermQueryMode mode = sl_TermQueryMode_Unifiable;
+  if (mode_opt.argument != NULL)
+  {
+    if (strcmp(mode_opt.argument, "instances") == 0)
+      mode = sl_TermQueryMode_Instances;
+    else if (strcmp(mode_opt.argument, "generalizations") == 0)
+      mode = sl_TermQueryMode_Generalizations;
+    else if (strcmp(mode_opt.argument, "unifiable") != 0)
+    {
+      fprintf(stderr, "Unknown query mode '%s'.\n", mode_opt.argument);
+      return 1;
+    }
+  }
+  if (ARRAY_LENGTH(cl->arguments) < 2)
+  {
+    fprintf(stderr, "Usage: sl query [--mode=MODE] PATTERN FILE...\n");
+    return 1;
+  }
+
+  sl_LogicState *state = sl_new_logic_state(NULL);
+  sl_TermIndex *index = sl_new_term_index();
+  for (size_t i = 2; i < ARRAY_LENGTH(cl->arguments); ++i)
+  {
+    const char *path = *ARRAY_GET(cl->arguments, char *, i);
+    if (sl_verify_and_add_file(path, state) != 0)
+      fprintf(stderr, "File '%s' invalid.\n", path);
+    sl_term_index_update(index, state);
+  }
+
+  int err = 1;
+  Value *pattern =
+    sl_parse_term_pattern(state, *ARRAY_GET(cl->arguments, char *, 1));
+  if (pattern != NULL)
+  {
+    sl_TermQueryResults results;
+    ARR_INIT(results);
+    uint64_t start = sl_wall_clock_ns();
+    size_t matched = sl_term_index_query(index, state, pattern, mode,
+      &results);
+    uint64_t query_ns = sl_wall_clock_ns() - start;
+    sl_term_index_print_results(state, &results, stdout);
+    printf("Found %zu statement(s) in %.3f ms, matching %zu of %zu.\n",
+      ARR_LENGTH(results), (double)query_ns / 1e6, matched,
+      sl_term_index_count_statements(index));
+    ARR_FREE(results);
+    free_value(pattern);
+    err = 0;
+  }
+
+  sl_free_term_index(index);
+  sl_free_logic_state(state);
+  return err;
+}
+
+static int
+render(const sl_LogicState *state)
+{
+  int err = 0;
+  if (latex_opt.argument != NULL
+    && render_latex(state, latex_opt.argument) != 0)
+  {
+    fprintf(stderr, "Cannot render LaTeX to '%s'.\n", latex_opt.argument);
+    err = 1;
+  }
+  if (html_opt.argument != NULL)
+  {
+    unsigned int jobs = 0;
+    if (jobs_opt.argument != NULL)
+      jobs = (unsigned int)strtoul(jobs_opt.argument, NULL, 10);
+    if (render_html(state, html_opt.argument, jobs) != 0)
+    {
+      fprintf(stderr, "Cannot render HTML to '%s'.\n", html_opt.argument);
+      err = 1;
+    }
+  }
+  return err;
+}
+
+static void
+report_watch_round(sl_Watcher *watcher, int err, void *user_data)
+{
+  /* HTML output is incremental, so only the pages of the theorems that
+     changed are rendered again. */
+  render((const sl_LogicState *)user_data);
+  printf("Verified %zu file(s) in %.1f ms: %s.\n",
+    sl_watcher_count_verified(watcher),
+    (double)sl_watcher_get_round_ns(watcher) / 1e6,
+    err == 0 ? "valid" : "invalid");
+  fflush(stdout);
+}
+
+/* `sl --watch FILE...`: verifies the files, then verifies them again
+   whenever they, or anything they import, change. */
+static int
+watch(struct CommandLine *cl, FILE *output)
+{
+  sl_LogicState *state = sl_new_logic_state(output);
+  sl_Watcher *watcher = sl_new_watcher(state);
+  for (size_t i = 0; i < ARRAY_LENGTH(cl->arguments); ++i)
+    sl_watcher_add_root(watcher, *ARRAY_GET(cl->arguments, char *, i));
+  int err = sl_watcher_run(watcher, &report_watch_round, state);
+  if (err != 0)
+    fprintf(stderr, "Cannot watch the files.\n");
+  sl_free_watcher(watcher);
+  sl_free_logic_state(state);
+  return err;
+}
+
+/* `sl --batch [--base=FILE] FILE...`: verifies the base once, then verifies
+   each of the files on its own against it, in parallel (see batch.h). */
+static int
+batch(struct CommandLine *cl, FILE *output)
+{
+  sl_LogicState *base = sl_new_logic_state(output);
+  if (base_opt.argument != NULL
+    && sl_verify_and_add_file(base_opt.argument, base) != 0)
+  {
+    printf("File '%s' invalid.\n", base_opt.argument);
+    sl_free_logic_state(base);
+    return 1;
+  }
+
+  unsigned int jobs = 0;
+  if (jobs_opt.argument != NULL)
+    jobs = (unsigned int)strtoul(jobs_opt.argument, NULL, 10);
+  sl_Batch *files = sl_new_batch(base);
+  for (size_t i = 0; i < ARRAY_LENGTH(cl->arguments); ++i)
+    sl_batch_add_file(files, *ARRAY_GET(cl->arguments, char *, i));
+  int err = sl_batch_verify(files, jobs);
+  sl_batch_print_report(files, output);
+  sl_free_batch(files);
+  sl_free_logic_state(base);
+  return err;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -56,6 +322,17 @@ main(int argc, char **argv)
   add_command_line_option(&cl, &out_opt);
   add_command_line_option(&cl, &latex_opt);
   add_command_line_option(&cl, &html_opt);
+  add_command_line_option(&cl, &jobs_opt);
+  add_command_line_option(&cl, &trace_opt);
+  add_command_line_option(&cl, &mem_stats_opt);
+  add_command_line_option(&cl, &profile_opt);
+  add_command_line_option(&cl, &profile_out_opt);
+  add_command_line_option(&cl, &socket_opt);
+  add_command_line_option(&cl, &watch_opt);
+  add_command_line_option(&cl, &batch_opt);
+  add_command_line_option(&cl, &base_opt);
+  add_command_line_option(&cl, &mode_opt);
+  add_command_line_option(&cl, &artifacts_opt);
 
   parse_command_line(&cl);
 
@@ -78,6 +355,9 @@ main(int argc, char **argv)
   else
     verbose = 0;
 
+  if (artifacts_opt.present)
+    sl_set_use_module_artifacts(TRUE);
+
   FILE *output = stdout;
   if (out_opt.argument != NULL)
   {
@@ -90,6 +370,60 @@ main(int argc, char **argv)
     }
   }
 
+  sl_Profiler *profiler = NULL;
+  if (profile_opt.present || profile_out_opt.argument != NULL)
+  {
+    profiler = sl_new_profiler();
+    sl_set_active_profiler(profiler);
+  }
+
+  if (trace_opt.argument != NULL && sl_trace_open(trace_opt.argument) != 0)
+  {
+    fprintf(stderr, "Cannot write trace to '%s'.\n", trace_opt.argument);
+  }
+
+  if (mem_stats_opt.present && !sl_memory_stats_enabled())
+  {
+    fprintf(stderr,
+      "--mem-stats requires a build configured with -DSL_MEMORY_STATS=ON.\n");
+  }
+
+  if (ARRAY_LENGTH(cl.arguments) > 0
+    && (strcmp(*ARRAY_GET(cl.arguments, char *, 0), "serve") == 0
+      || strcmp(*ARRAY_GET(cl.arguments, char *, 0), "lsp") == 0
+      || strcmp(*ARRAY_GET(cl.arguments, char *, 0), "query") == 0))
+  {
+    const char *command = *ARRAY_GET(cl.arguments, char *, 0);
+    int err;
+    if (strcmp(command, "serve") == 0)
+      err = serve(&cl);
+    else if (strcmp(command, "lsp") == 0)
+      err = lsp(&cl);
+    else
+      err = query(&cl);
+    sl_trace_close();
+    if (profiler != NULL)
+    {
+      sl_set_active_profiler(NULL);
+      sl_free_profiler(profiler);
+    }
+    free_command_line(&cl);
+    return err;
+  }
+
+  if (watch_opt.present || batch_opt.present)
+  {
+    int err = watch_opt.present ? watch(&cl, output) : batch(&cl, output);
+    sl_trace_close();
+    if (profiler != NULL)
+    {
+      sl_set_active_profiler(NULL);
+      sl_free_profiler(profiler);
+    }
+    free_command_line(&cl);
+    return err;
+  }
+
   sl_LogicState *state = sl_new_logic_state(output);
   for (size_t i = 0; i < ARRAY_LENGTH(cl.arguments); ++i)
   {
@@ -101,18 +435,31 @@ main(int argc, char **argv)
       printf("File '%s' invalid.\n", path);
   }
 
-  if (latex_opt.argument != NULL)
-  {
-    render_latex(state, latex_opt.argument);
-  }
-  if (html_opt.argument != NULL)
-  {
-    render_html(state, html_opt.argument);
-  }
+  int err = render(state);
   { /* TODO: add a command line option for this. */
     sl_logic_state_write_to_interchange_file(state, "math.sli");
   }
+  if (mem_stats_opt.present && sl_memory_stats_enabled())
+  {
+    /* Report before freeing the state, while everything is still live. */
+    sl_memory_print_report(stdout);
+  }
   sl_free_logic_state(state);
+  sl_trace_close();
+
+  if (profiler != NULL)
+  {
+    sl_set_active_profiler(NULL);
+    if (profile_opt.present)
+      sl_profiler_print_report(profiler, stdout, PROFILE_TOP_THEOREMS);
+    if (profile_out_opt.argument != NULL
+      && sl_profiler_write_json(profiler, profile_out_opt.argument) != 0)
+    {
+      fprintf(stderr, "Cannot write profile to '%s'.\n",
+        profile_out_opt.argument);
+    }
+    sl_free_profiler(profiler);
+  }
 
   if (out_opt.argument != NULL)
   {
@@ -121,5 +468,5 @@ main(int argc, char **argv)
 
   free_command_line(&cl);
 
-  return 0;
+  return err;
 }
@@ -1,3 +1,4 @@
+#define SL_MEMORY_TAG sl_MemoryTag_AST
 #include "parse.h"
 #include "common.h"
 #include <string.h>
@@ -13,6 +14,7 @@ struct sl_ASTNode {
   size_t line;
   size_t column;
   char *name;
+  sl_Natural *numeral; /* Only for a numeral, read from its token. */
 };
 
 struct sl_ASTContainer {
@@ -130,22 +132,40 @@ sl_node_get_name(const sl_ASTNode *node)
   return node->name;
 }
 
-static void free_children(sl_ASTContainer *container, sl_ASTNode *root)
+const sl_Natural *
+sl_node_get_numeral(const sl_ASTNode *node)
 {
-  for (size_t i = 0; i < sl_node_get_child_count(container, root); ++i)
-  {
-    sl_ASTNode *child = sl_node_get_child_mutable(container, root, i);
-    free_children(container, child);
-  }
-  if (root->name != NULL)
-    free(root->name);
+  if (node == NULL)
+    return NULL;
+  return node->numeral;
+}
+
+int
+sl_node_take_numeral(sl_ASTNode *node, sl_Natural *numeral)
+{
+  if (node == NULL || node->numeral == NULL)
+    return 1;
+  *numeral = *node->numeral;
+  sl_natural_from_uint64_t(0, node->numeral);
+  return 0;
 }
 
 void sl_ast_container_free(sl_ASTContainer *container)
 {
-  free_children(container, sl_ast_container_get_root_mutable(container));
+  /* Every node is in the array, so there is no need to walk the tree. */
+  for (size_t i = 0; i < ARR_LENGTH(container->nodes); ++i)
+  {
+    sl_ASTNode *node = ARR_GET(container->nodes, i);
+    if (node->name != NULL)
+      SL_FREE(node->name);
+    if (node->numeral != NULL)
+    {
+      sl_natural_free(node->numeral);
+      SL_FREE(node->numeral);
+    }
+  }
   ARR_FREE(container->nodes);
-  free(container);
+  SL_FREE(container);
 }
 
 static void
@@ -176,6 +196,9 @@ print_node(char *buf, size_t len, const sl_ASTNode *node)
     case sl_ASTNodeType_DummyFlag:
       snprintf(buf, len, "Dummy<>");
       break;
+    case sl_ASTNodeType_NumeralsFlag:
+      snprintf(buf, len, "Numerals<>");
+      break;
     case sl_ASTNodeType_Expression:
       snprintf(buf, len, "Expression<\"%s\">", node->name);
       break;
@@ -236,6 +259,14 @@ print_node(char *buf, size_t len, const sl_ASTNode *node)
     case sl_ASTNodeType_Placeholder:
       snprintf(buf, len, "Placeholder<\"%s\">", node->name);
       break;
+    case sl_ASTNodeType_Numeral:
+      {
+        char *digits = (node->numeral != NULL)
+          ? sl_natural_to_string(*node->numeral) : NULL;
+        snprintf(buf, len, "Numeral<%s>", digits != NULL ? digits : "");
+        SL_FREE(digits);
+      }
+      break;
     case sl_ASTNodeType_ArgumentList:
       snprintf(buf, len, "Argument List<>");
       break;
@@ -254,23 +285,39 @@ print_node(char *buf, size_t len, const sl_ASTNode *node)
   }
 }
 
-static void print_children(const sl_ASTContainer *container,
-    const sl_ASTNode *root, unsigned int depth)
+/* Prints the tree in preorder by following the links between the nodes,
+   so that it takes no stack however deep the tree is. */
+void sl_ast_print(const sl_ASTContainer *container)
 {
-  for (size_t i = 0; i < depth; ++i)
-    printf(" ");
+  const sl_ASTNode *node = sl_ast_container_get_root(container);
+  unsigned int depth = 0;
   char buf[1024];
-  print_node(buf, 1024, root);
-  printf("%s\n", buf);
-  for (size_t i = 0; i < sl_node_get_child_count(container, root); ++i) {
-    print_children(container, sl_node_get_child(container, root, i),
-        depth + 1);
-  }
-}
+  while (node != NULL)
+  {
+    for (size_t i = 0; i < depth; ++i)
+      printf(" ");
+    print_node(buf, 1024, node);
+    printf("%s\n", buf);
 
-void sl_ast_print(const sl_ASTContainer *container)
-{
-  print_children(container, sl_ast_container_get_root(container), 0);
+    if (node->first_child_index != SIZE_MAX)
+    {
+      node = sl_ast_container_get_node(container, node->first_child_index);
+      ++depth;
+      continue;
+    }
+    while (node != NULL && node->right_sibling_index == SIZE_MAX)
+    {
+      if (depth == 0)
+        node = NULL;
+      else
+      {
+        node = sl_ast_container_get_node(container, node->parent_index);
+        --depth;
+      }
+    }
+    if (node != NULL)
+      node = sl_ast_container_get_node(container, node->right_sibling_index);
+  }
 }
 
 void
@@ -289,6 +336,7 @@ static sl_ASTNode * sl_node_new(sl_ASTContainer *container)
   node.left_sibling_index = SIZE_MAX;
   node.right_sibling_index = SIZE_MAX;
   node.name = NULL;
+  node.numeral = NULL;
   ARR_APPEND(container->nodes, node);
   return ARR_GET(container->nodes, node.index);
 }
@@ -511,6 +559,33 @@ consume_name(struct ParserState *state, union ParserStepUserData user_data)
   return advance(state);
 }
 
+static int
+consume_digits(struct ParserState *state, union ParserStepUserData user_data)
+{
+  if (sl_lexer_get_current_token_type(state->input)
+    == sl_LexerTokenType_Number)
+  {
+    /* The digits are read once, straight from the token. */
+    sl_Natural *numeral = SL_NEW(sl_Natural);
+    if (sl_lexer_get_current_token_numerical_value(state->input, numeral)
+      != 0)
+    {
+      SL_FREE(numeral);
+      sl_lexer_show_message_at_current_token(state->input,
+        "A numeral must consist of decimal digits.", sl_MessageType_Error);
+      return 1;
+    }
+    current(state)->numeral = numeral;
+  }
+  else
+  {
+    sl_lexer_show_message_at_current_token(state->input,
+      "Expected a number.", sl_MessageType_Error);
+    return 1;
+  }
+  return advance(state);
+}
+
 static int
 consume_symbol(struct ParserState *state, union ParserStepUserData user_data)
 {
@@ -590,6 +665,20 @@ static int parse_binds_flag(struct ParserState *state,
   return 0;
 }
 
+static int parse_numerals_flag(struct ParserState *state,
+    union ParserStepUserData user_data)
+{
+  if (next_is_keyword(state, "numerals")) {
+    add_step_to_stack(state, &parse_type_flag, user_data_none());
+    add_step_to_stack(state, &ascend, user_data_none());
+    add_step_to_stack(state, &consume_keyword, user_data_str("numerals"));
+    add_step_to_stack(state, &set_node_location, user_data_none());
+    add_step_to_stack(state, &descend,
+        user_data_node_type(sl_ASTNodeType_NumeralsFlag));
+  }
+  return 0;
+}
+
 static int parse_atomic(struct ParserState *state,
     union ParserStepUserData user_data)
 {
@@ -613,6 +702,8 @@ static int parse_type_flag(struct ParserState *state,
     add_step_to_stack(state, &parse_binds_flag, user_data_none());
   else if (next_is_keyword(state, "atomic"))
     add_step_to_stack(state, &parse_atomic, user_data_none());
+  else if (next_is_keyword(state, "numerals"))
+    add_step_to_stack(state, &parse_numerals_flag, user_data_none());
   return 0;
 }
 
@@ -1037,6 +1128,18 @@ parse_placeholder(struct ParserState *state,
   return 0;
 }
 
+static int
+parse_numeral(struct ParserState *state,
+  union ParserStepUserData user_data)
+{
+  add_step_to_stack(state, &ascend, user_data_none());
+  add_step_to_stack(state, &consume_digits, user_data_none());
+  add_step_to_stack(state, &set_node_location, user_data_none());
+  add_step_to_stack(state, &descend,
+    user_data_node_type(sl_ASTNodeType_Numeral));
+  return 0;
+}
+
 static int
 parse_argument(struct ParserState *state,
   union ParserStepUserData user_data);
@@ -1060,7 +1163,8 @@ parse_argument(struct ParserState *state,
 {
   if (next_is_identifier(state)
     || next_is_type(state, sl_LexerTokenType_DollarSign)
-    || next_is_type(state, sl_LexerTokenType_Percent))
+    || next_is_type(state, sl_LexerTokenType_Percent)
+    || next_is_type(state, sl_LexerTokenType_Number))
   {
     add_step_to_stack(state, &parse_argument_separator, user_data_none());
     add_step_to_stack(state, &parse_value, user_data_none());
@@ -1182,6 +1286,8 @@ parse_value(struct ParserState *state,
     add_step_to_stack(state, &parse_placeholder, user_data_none());
   } else if (next_is_type(state, sl_LexerTokenType_At)) {
     add_step_to_stack(state, &parse_builtin, user_data_none());
+  } else if (next_is_type(state, sl_LexerTokenType_Number)) {
+    add_step_to_stack(state, &parse_numeral, user_data_none());
   } else {
     /* TODO: implement lookahead. */
     add_step_to_stack(state, &parse_composition, user_data_none());
@@ -1449,6 +1555,7 @@ parse_namespace_item(struct ParserState *state,
   {
     sl_lexer_show_message_at_current_token(state->input,
       "Unknown expression in namespace body.", sl_MessageType_Error);
+    return 1;
   }
   if (exec != NULL)
   {
@@ -1514,6 +1621,6 @@ sl_ASTContainer * sl_parse_input(sl_LexerState *input, int *error)
 
   ARR_FREE(state.stack);
   if (error != NULL)
-    *error = 0;
+    *error = state.panic ? 1 : 0;
   return state.container;
 }
@@ -46,10 +46,33 @@ sl_input_from_string(const char *string);
 void
 sl_input_free(sl_TextInput *input);
 
+/* The name messages refer to the input by. Inputs from files are named by
+   their path, inputs from strings have no name until one is given. */
+void
+sl_input_set_name(sl_TextInput *input, const char *name);
+
+const char *
+sl_input_get_name(const sl_TextInput *input);
+
 void
 sl_input_show_message(sl_TextInput *input, size_t line, size_t column,
   const char *message, sl_MessageType type);
 
+/* Reports a message about a whole file, such as one that cannot be read. */
+void
+sl_show_file_message(const char *source, const char *message,
+  sl_MessageType type);
+
+/* Messages are printed to stdout unless a handler is set, in which case
+   they go to the handler instead. `source` is the name of the input, or
+   NULL, and `line` and `column` count from zero. Pass NULL to restore
+   printing. The handler only applies to the thread that sets it. */
+typedef void (* sl_MessageHandler)(const char *source, size_t line,
+  size_t column, const char *message, sl_MessageType type, void *user_data);
+
+void
+sl_set_message_handler(sl_MessageHandler handler, void *user_data);
+
 /* --- Lexer --- */
 typedef struct sl_LexerState sl_LexerState;
 
@@ -88,12 +111,6 @@ enum sl_LexerTokenType
 };
 typedef enum sl_LexerTokenType sl_LexerTokenType;
 
-struct sl_LexerNumber
-{
-  bool is_number;
-  uint32_t value;
-};
-
 sl_LexerState *
 sl_lexer_new_state_with_input(sl_TextInput *input);
 
@@ -109,11 +126,17 @@ sl_lexer_done(sl_LexerState *state);
 sl_LexerTokenType
 sl_lexer_get_current_token_type(const sl_LexerState *state);
 
+/* Identifiers and numbers are returned as written, strings without their
+   quotes. */
 struct sl_StringSlice
 sl_lexer_get_current_token_string_value(const sl_LexerState *state);
 
-struct sl_LexerNumber
-sl_lexer_get_current_token_numerical_value(const sl_LexerState *state);
+/* Converts the digits of a number token straight from the input, so numbers
+   of any size are read exactly. Returns nonzero if the current token is not
+   a number. */
+int
+sl_lexer_get_current_token_numerical_value(const sl_LexerState *state,
+  sl_Natural *value);
 
 uint32_t
 sl_lexer_get_current_token_line(const sl_LexerState *state);
@@ -142,6 +165,7 @@ enum sl_ASTNodeType
   sl_ASTNodeType_AtomicFlag,
   sl_ASTNodeType_BindsFlag,
   sl_ASTNodeType_DummyFlag,
+  sl_ASTNodeType_NumeralsFlag,
   sl_ASTNodeType_ConstantDeclaration,
   sl_ASTNodeType_Constspace,
   sl_ASTNodeType_Expression,
@@ -164,6 +188,7 @@ enum sl_ASTNodeType
   sl_ASTNodeType_Constant,
   sl_ASTNodeType_Variable,
   sl_ASTNodeType_Placeholder,
+  sl_ASTNodeType_Numeral,
   sl_ASTNodeType_TheoremReference,
   sl_ASTNodeType_ArgumentList,
   sl_ASTNodeType_Path,
@@ -192,6 +217,15 @@ sl_node_get_type(const sl_ASTNode *node);
 const char *
 sl_node_get_name(const sl_ASTNode *node);
 
+/* The value of a numeral node, or NULL for any other node. */
+const sl_Natural *
+sl_node_get_numeral(const sl_ASTNode *node);
+
+/* Moves the value of a numeral node into `numeral` rather than copying it,
+   leaving zero in the node. Returns nonzero if the node is not a numeral. */
+int
+sl_node_take_numeral(sl_ASTNode *node, sl_Natural *numeral);
+
 void sl_ast_container_free(sl_ASTContainer *container);
 
 const sl_ASTNode * sl_ast_container_get_root(const sl_ASTContainer *container);
@@ -212,4 +246,42 @@ extern int verbose;
 int
 sl_verify_and_add_file(const char *path, sl_LogicState *logic);
 
+/* Verifies `text` as though it were the contents of the file at `path`,
+   which need not exist. */
+int
+sl_verify_and_add_string(const char *path, const char *text,
+  sl_LogicState *logic);
+
+/* Follows the files loaded by the verifier, for tools that need to know how
+   the files depend on each other. Paths are absolute. `import` is called for
+   every import statement, even if the imported file is already loaded.
+   `begin` and `end` are called around the verification of each file that is
+   loaded; `top_level` is FALSE for a file that is imported inside a
+   namespace, and `valid` is FALSE if the file, or anything it imports, is
+   invalid. Any of the callbacks may be NULL. */
+typedef struct sl_LoadObserver sl_LoadObserver;
+
+struct sl_LoadObserver
+{
+  void (* import)(const char *importer, const char *imported, void *user_data);
+  void (* begin)(const char *path, bool top_level, void *user_data);
+  void (* end)(const char *path, bool valid, void *user_data);
+  void *user_data;
+};
+
+/* Pass NULL to stop observing. The observer is not copied, and only
+   observes the loads made by the thread that sets it. */
+void
+sl_set_load_observer(const sl_LoadObserver *observer);
+
+/* Whether files that are imported outside of any namespace are loaded from
+   their module artifacts when they can be, with artifacts written for those
+   that are verified from source (see artifact.h). Off by default. Like the
+   load observer, this only applies to the thread that sets it. */
+void
+sl_set_use_module_artifacts(bool use);
+
+bool
+sl_get_use_module_artifacts();
+
 #endif
@@ -0,0 +1,471 @@
+#include "profile.h"
+#include <pthread.h>
+#include <string.h>
+
+#define SL_PROFILE_MAX_DEPTH 128
+
+struct PhaseStats
+{
+  const char *name;
+  uint64_t calls;
+  uint64_t wall; /* Inclusive of nested phases. */
+  uint64_t cpu;
+  uint64_t self_wall; /* Exclusive of nested phases. */
+  uint64_t self_cpu;
+};
+
+struct TheoremStats
+{
+  char *path;
+  bool valid;
+  uint64_t wall;
+  uint64_t cpu;
+  size_t steps;
+  size_t proven_scanned;
+};
+
+struct CacheStats
+{
+  char *name;
+  uint64_t hits;
+  uint64_t misses;
+};
+
+struct ProfileFrame
+{
+  sl_ProfilePhase phase;
+  int detail;
+  const char *detail_name;
+  uint64_t wall_start;
+  uint64_t cpu_start;
+  uint64_t child_wall;
+  uint64_t child_cpu;
+};
+
+/* The phases currently running on a thread. */
+struct ProfileStack
+{
+  struct ProfileFrame frames[SL_PROFILE_MAX_DEPTH];
+  size_t depth;
+  size_t overflow; /* Frames that did not fit on the stack. */
+  unsigned int open[sl_ProfilePhase_Count];
+};
+
+struct sl_Profiler
+{
+  pthread_mutex_t lock; /* Protects everything below. */
+  struct PhaseStats phases[sl_ProfilePhase_Count];
+  struct PhaseStats details[sl_ProfilePhase_Count][SL_PROFILE_MAX_DETAILS];
+  ARR(struct TheoremStats) theorems;
+  ARR(struct CacheStats) caches;
+  struct sl_ProfileTimer total;
+};
+
+static const char *phase_names[] = {
+  "lex",
+  "parse",
+  "validate",
+  "reduce",
+  "requirement",
+  "instantiate",
+  "render"
+};
+
+static sl_Profiler *active_profiler = NULL;
+static _Thread_local struct ProfileStack profile_stack;
+
+sl_Profiler *
+sl_new_profiler()
+{
+  sl_Profiler *profiler = SL_NEW(sl_Profiler);
+  if (profiler == NULL)
+    return NULL;
+  memset(profiler, 0, sizeof(sl_Profiler));
+  pthread_mutex_init(&profiler->lock, NULL);
+  for (size_t i = 0; i < sl_ProfilePhase_Count; ++i)
+    profiler->phases[i].name = phase_names[i];
+  ARR_INIT(profiler->theorems);
+  ARR_INIT(profiler->caches);
+  sl_profile_timer_start(&profiler->total);
+  return profiler;
+}
+
+void
+sl_free_profiler(sl_Profiler *profiler)
+{
+  if (profiler == NULL)
+    return;
+  if (active_profiler == profiler)
+    active_profiler = NULL;
+  for (size_t i = 0; i < ARR_LENGTH(profiler->theorems); ++i)
+    SL_FREE(ARR_GET(profiler->theorems, i)->path);
+  ARR_FREE(profiler->theorems);
+  for (size_t i = 0; i < ARR_LENGTH(profiler->caches); ++i)
+    SL_FREE(ARR_GET(profiler->caches, i)->name);
+  ARR_FREE(profiler->caches);
+  pthread_mutex_destroy(&profiler->lock);
+  SL_FREE(profiler);
+}
+
+void
+sl_set_active_profiler(sl_Profiler *profiler)
+{
+  active_profiler = profiler;
+}
+
+bool
+sl_profiling()
+{
+  return active_profiler != NULL;
+}
+
+static void
+add_to_stats(struct PhaseStats *stats, uint64_t wall, uint64_t cpu,
+  uint64_t self_wall, uint64_t self_cpu, bool outermost)
+{
+  stats->calls += 1;
+  if (outermost)
+  {
+    stats->wall += wall;
+    stats->cpu += cpu;
+  }
+  stats->self_wall += self_wall;
+  stats->self_cpu += self_cpu;
+}
+
+void
+sl_profile_begin_detail(sl_ProfilePhase phase, unsigned int detail,
+  const char *detail_name)
+{
+  struct ProfileStack *stack = &profile_stack;
+  struct ProfileFrame *frame;
+  if (active_profiler == NULL)
+    return;
+  if (stack->depth >= SL_PROFILE_MAX_DEPTH)
+  {
+    stack->overflow += 1;
+    return;
+  }
+  frame = &stack->frames[stack->depth++];
+  frame->phase = phase;
+  frame->detail = -1;
+  if (detail < SL_PROFILE_MAX_DETAILS)
+  {
+    frame->detail = detail;
+    frame->detail_name = detail_name;
+  }
+  frame->child_wall = 0;
+  frame->child_cpu = 0;
+  stack->open[phase] += 1;
+  frame->cpu_start = sl_cpu_clock_ns();
+  frame->wall_start = sl_wall_clock_ns();
+}
+
+void
+sl_profile_begin(sl_ProfilePhase phase)
+{
+  sl_profile_begin_detail(phase, SL_PROFILE_MAX_DETAILS, NULL);
+}
+
+void
+sl_profile_end()
+{
+  sl_Profiler *p = active_profiler;
+  struct ProfileStack *stack = &profile_stack;
+  struct ProfileFrame *frame;
+  uint64_t wall, cpu, self_wall, self_cpu;
+  if (p == NULL)
+    return;
+  if (stack->overflow > 0)
+  {
+    stack->overflow -= 1;
+    return;
+  }
+  if (stack->depth == 0)
+    return;
+  wall = sl_wall_clock_ns();
+  cpu = sl_cpu_clock_ns();
+  frame = &stack->frames[--stack->depth];
+  wall -= frame->wall_start;
+  cpu -= frame->cpu_start;
+  self_wall = (wall > frame->child_wall) ? wall - frame->child_wall : 0;
+  self_cpu = (cpu > frame->child_cpu) ? cpu - frame->child_cpu : 0;
+  stack->open[frame->phase] -= 1;
+
+  /* A phase can contain itself (e.g. validating an import happens while
+     validating the importing file), so only count the outermost instance
+     towards the inclusive time. */
+  pthread_mutex_lock(&p->lock);
+  add_to_stats(&p->phases[frame->phase], wall, cpu, self_wall, self_cpu,
+    stack->open[frame->phase] == 0);
+  if (frame->detail >= 0)
+  {
+    struct PhaseStats *detail = &p->details[frame->phase][frame->detail];
+    detail->name = frame->detail_name;
+    add_to_stats(detail, wall, cpu, self_wall, self_cpu, TRUE);
+  }
+  pthread_mutex_unlock(&p->lock);
+  if (stack->depth > 0)
+  {
+    struct ProfileFrame *parent = &stack->frames[stack->depth - 1];
+    parent->child_wall += wall;
+    parent->child_cpu += cpu;
+  }
+}
+
+void
+sl_profile_timer_start(struct sl_ProfileTimer *timer)
+{
+  timer->cpu_start = sl_cpu_clock_ns();
+  timer->wall_start = sl_wall_clock_ns();
+}
+
+void
+sl_profile_add_theorem(const char *path, bool valid,
+  const struct sl_ProfileTimer *timer, size_t steps, size_t proven_scanned)
+{
+  sl_Profiler *p = active_profiler;
+  struct TheoremStats stats;
+  if (p == NULL)
+    return;
+  stats.wall = sl_wall_clock_ns() - timer->wall_start;
+  stats.cpu = sl_cpu_clock_ns() - timer->cpu_start;
+  stats.path = SL_STRDUP(path);
+  stats.valid = valid;
+  stats.steps = steps;
+  stats.proven_scanned = proven_scanned;
+  pthread_mutex_lock(&p->lock);
+  ARR_APPEND(p->theorems, stats);
+  pthread_mutex_unlock(&p->lock);
+}
+
+void
+sl_profile_add_cache_lookups(const char *name, uint64_t hits,
+  uint64_t misses)
+{
+  sl_Profiler *p = active_profiler;
+  struct CacheStats *stats = NULL;
+  if (p == NULL)
+    return;
+  pthread_mutex_lock(&p->lock);
+  for (size_t i = 0; i < ARR_LENGTH(p->caches); ++i)
+  {
+    if (strcmp(ARR_GET(p->caches, i)->name, name) == 0)
+    {
+      stats = ARR_GET(p->caches, i);
+      break;
+    }
+  }
+  if (stats == NULL)
+  {
+    struct CacheStats new_stats;
+    new_stats.name = SL_STRDUP(name);
+    new_stats.hits = 0;
+    new_stats.misses = 0;
+    ARR_APPEND(p->caches, new_stats);
+    stats = ARR_GET(p->caches, ARR_LENGTH(p->caches) - 1);
+  }
+  stats->hits += hits;
+  stats->misses += misses;
+  pthread_mutex_unlock(&p->lock);
+}
+
+/* Sorting. */
+static int
+compare_stats_by_wall(const void *a, const void *b)
+{
+  const struct PhaseStats *x = *(const struct PhaseStats * const *)a;
+  const struct PhaseStats *y = *(const struct PhaseStats * const *)b;
+  if (x->wall != y->wall)
+    return (x->wall < y->wall) ? 1 : -1;
+  return 0;
+}
+
+static int
+compare_theorems_by_wall(const void *a, const void *b)
+{
+  const struct TheoremStats *x = *(const struct TheoremStats * const *)a;
+  const struct TheoremStats *y = *(const struct TheoremStats * const *)b;
+  if (x->wall != y->wall)
+    return (x->wall < y->wall) ? 1 : -1;
+  return strcmp(x->path, y->path);
+}
+
+static const struct TheoremStats **
+sorted_theorems(const sl_Profiler *profiler)
+{
+  size_t n = ARR_LENGTH(profiler->theorems);
+  const struct TheoremStats **sorted =
+    SL_MALLOC(sizeof(struct TheoremStats *) * (n + 1));
+  for (size_t i = 0; i < n; ++i)
+    sorted[i] = ARR_GET(profiler->theorems, i);
+  qsort(sorted, n, sizeof(struct TheoremStats *), &compare_theorems_by_wall);
+  return sorted;
+}
+
+static size_t
+sorted_details(const sl_Profiler *profiler, sl_ProfilePhase phase,
+  const struct PhaseStats **sorted)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < SL_PROFILE_MAX_DETAILS; ++i)
+  {
+    const struct PhaseStats *stats = &profiler->details[phase][i];
+    if (stats->calls > 0)
+      sorted[n++] = stats;
+  }
+  qsort(sorted, n, sizeof(struct PhaseStats *), &compare_stats_by_wall);
+  return n;
+}
+
+#define NS_TO_MS(ns) ((double)(ns) * 1e-6)
+
+static void
+print_stats_row(FILE *out, const struct PhaseStats *stats)
+{
+  fprintf(out, "  %-20s %10llu %12.3f %12.3f %12.3f %12.3f\n",
+    stats->name != NULL ? stats->name : "?",
+    (unsigned long long)stats->calls,
+    NS_TO_MS(stats->wall), NS_TO_MS(stats->cpu),
+    NS_TO_MS(stats->self_wall), NS_TO_MS(stats->self_cpu));
+}
+
+void
+sl_profiler_print_report(const sl_Profiler *profiler, FILE *out,
+  size_t top_n)
+{
+  const struct PhaseStats *details[SL_PROFILE_MAX_DETAILS];
+  const struct TheoremStats **theorems;
+  size_t n_details, n_theorems;
+  if (profiler == NULL || out == NULL)
+    return;
+
+  fprintf(out, "Profile (times in ms, total wall %.3f, total CPU %.3f):\n",
+    NS_TO_MS(sl_wall_clock_ns() - profiler->total.wall_start),
+    NS_TO_MS(sl_cpu_clock_ns() - profiler->total.cpu_start));
+  fprintf(out, "  %-20s %10s %12s %12s %12s %12s\n", "phase", "calls",
+    "wall", "cpu", "self wall", "self cpu");
+  for (size_t i = 0; i < sl_ProfilePhase_Count; ++i)
+    print_stats_row(out, &profiler->phases[i]);
+
+  n_details = sorted_details(profiler, sl_ProfilePhase_Requirement, details);
+  if (n_details > 0)
+  {
+    fprintf(out, "Requirement kinds by wall time:\n");
+    fprintf(out, "  %-20s %10s %12s %12s %12s %12s\n", "requirement",
+      "calls", "wall", "cpu", "self wall", "self cpu");
+    for (size_t i = 0; i < n_details; ++i)
+      print_stats_row(out, details[i]);
+  }
+
+  if (ARR_LENGTH(profiler->caches) > 0)
+  {
+    fprintf(out, "Caches:\n");
+    fprintf(out, "  %-20s %10s %10s %10s %9s\n", "cache", "lookups", "hits",
+      "misses", "hit rate");
+    for (size_t i = 0; i < ARR_LENGTH(profiler->caches); ++i)
+    {
+      const struct CacheStats *cache = ARR_GET(profiler->caches, i);
+      uint64_t lookups = cache->hits + cache->misses;
+      fprintf(out, "  %-20s %10llu %10llu %10llu %8.1f%%\n", cache->name,
+        (unsigned long long)lookups, (unsigned long long)cache->hits,
+        (unsigned long long)cache->misses,
+        lookups > 0 ? 100.0 * (double)cache->hits / (double)lookups : 0.0);
+    }
+  }
+
+  n_theorems = ARR_LENGTH(profiler->theorems);
+  if (n_theorems > 0)
+  {
+    theorems = sorted_theorems(profiler);
+    if (top_n > n_theorems)
+      top_n = n_theorems;
+    fprintf(out, "Top %zu of %zu theorems by wall time:\n", top_n,
+      n_theorems);
+    fprintf(out, "  %12s %12s %8s %12s  %s\n", "wall", "cpu", "steps",
+      "scanned", "theorem");
+    for (size_t i = 0; i < top_n; ++i)
+    {
+      const struct TheoremStats *thm = theorems[i];
+      fprintf(out, "  %12.3f %12.3f %8zu %12zu  %s%s\n", NS_TO_MS(thm->wall),
+        NS_TO_MS(thm->cpu), thm->steps, thm->proven_scanned, thm->path,
+        thm->valid ? "" : " (invalid)");
+    }
+    SL_FREE(theorems);
+  }
+}
+
+static void
+write_json_stats(FILE *out, const struct PhaseStats *stats)
+{
+  fprintf(out, "{\"name\": ");
+  sl_write_json_string(out, stats->name != NULL ? stats->name : "?");
+  fprintf(out, ", \"calls\": %llu, \"wall_ns\": %llu, \"cpu_ns\": %llu, "
+    "\"self_wall_ns\": %llu, \"self_cpu_ns\": %llu}",
+    (unsigned long long)stats->calls, (unsigned long long)stats->wall,
+    (unsigned long long)stats->cpu, (unsigned long long)stats->self_wall,
+    (unsigned long long)stats->self_cpu);
+}
+
+int
+sl_profiler_write_json(const sl_Profiler *profiler, const char *file_path)
+{
+  const struct PhaseStats *details[SL_PROFILE_MAX_DETAILS];
+  const struct TheoremStats **theorems;
+  size_t n_details;
+  FILE *out = fopen(file_path, "w");
+  if (out == NULL)
+    return 1;
+
+  fprintf(out, "{\n  \"wall_ns\": %llu,\n  \"cpu_ns\": %llu,\n",
+    (unsigned long long)(sl_wall_clock_ns() - profiler->total.wall_start),
+    (unsigned long long)(sl_cpu_clock_ns() - profiler->total.cpu_start));
+
+  fprintf(out, "  \"phases\": [");
+  for (size_t i = 0; i < sl_ProfilePhase_Count; ++i)
+  {
+    fprintf(out, i == 0 ? "\n    " : ",\n    ");
+    write_json_stats(out, &profiler->phases[i]);
+  }
+  fprintf(out, "\n  ],\n");
+
+  fprintf(out, "  \"requirements\": [");
+  n_details = sorted_details(profiler, sl_ProfilePhase_Requirement, details);
+  for (size_t i = 0; i < n_details; ++i)
+  {
+    fprintf(out, i == 0 ? "\n    " : ",\n    ");
+    write_json_stats(out, details[i]);
+  }
+  fprintf(out, "\n  ],\n");
+
+  fprintf(out, "  \"caches\": [");
+  for (size_t i = 0; i < ARR_LENGTH(profiler->caches); ++i)
+  {
+    const struct CacheStats *cache = ARR_GET(profiler->caches, i);
+    fprintf(out, i == 0 ? "\n    " : ",\n    ");
+    fprintf(out, "{\"name\": ");
+    sl_write_json_string(out, cache->name);
+    fprintf(out, ", \"hits\": %llu, \"misses\": %llu}",
+      (unsigned long long)cache->hits, (unsigned long long)cache->misses);
+  }
+  fprintf(out, "\n  ],\n");
+
+  fprintf(out, "  \"theorems\": [");
+  theorems = sorted_theorems(profiler);
+  for (size_t i = 0; i < ARR_LENGTH(profiler->theorems); ++i)
+  {
+    const struct TheoremStats *thm = theorems[i];
+    fprintf(out, i == 0 ? "\n    " : ",\n    ");
+    fprintf(out, "{\"path\": ");
+    sl_write_json_string(out, thm->path);
+    fprintf(out, ", \"valid\": %s, \"wall_ns\": %llu, \"cpu_ns\": %llu, "
+      "\"steps\": %zu, \"proven_scanned\": %zu}",
+      thm->valid ? "true" : "false", (unsigned long long)thm->wall,
+      (unsigned long long)thm->cpu, thm->steps, thm->proven_scanned);
+  }
+  SL_FREE(theorems);
+  fprintf(out, "\n  ]\n}\n");
+
+  fclose(out);
+  return 0;
+}
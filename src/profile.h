@@ -0,0 +1,87 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "common.h"
+#include <stdio.h>
+
+/* Profiling of verification and rendering. When a profiler is active
+   (see `sl_set_active_profiler`), the library records the wall and CPU time
+   spent in each phase and for each theorem. All the recording functions do
+   nothing when no profiler is active, and may be called from any thread;
+   phases nest per thread. Reports should only be made once the threads
+   being profiled are done. */
+typedef struct sl_Profiler sl_Profiler;
+
+enum sl_ProfilePhase
+{
+  sl_ProfilePhase_Lex = 0,
+  sl_ProfilePhase_Parse,
+  sl_ProfilePhase_Validate,
+  sl_ProfilePhase_Reduce,
+  sl_ProfilePhase_Requirement,
+  sl_ProfilePhase_Instantiate,
+  sl_ProfilePhase_Render,
+  sl_ProfilePhase_Count
+};
+typedef enum sl_ProfilePhase sl_ProfilePhase;
+
+/* The maximum number of subdivisions (e.g. requirement kinds) of a phase. */
+#define SL_PROFILE_MAX_DETAILS 8
+
+struct sl_ProfileTimer
+{
+  uint64_t wall_start;
+  uint64_t cpu_start;
+};
+
+sl_Profiler *
+sl_new_profiler();
+
+void
+sl_free_profiler(sl_Profiler *profiler);
+
+void
+sl_set_active_profiler(sl_Profiler *profiler);
+
+bool
+sl_profiling();
+
+/* Phases nest: time spent in a phase started while another is running is
+   subtracted from the "self" time of the outer phase. */
+void
+sl_profile_begin(sl_ProfilePhase phase);
+
+/* Like `sl_profile_begin`, but also attributes the time to the subdivision
+   `detail` (< SL_PROFILE_MAX_DETAILS) of the phase, named `detail_name`. */
+void
+sl_profile_begin_detail(sl_ProfilePhase phase, unsigned int detail,
+  const char *detail_name);
+
+void
+sl_profile_end();
+
+void
+sl_profile_timer_start(struct sl_ProfileTimer *timer);
+
+/* Records the cost of checking a single theorem. `proven_scanned` is the
+   number of proven statements compared against while checking the proof. */
+void
+sl_profile_add_theorem(const char *path, bool valid,
+  const struct sl_ProfileTimer *timer, size_t steps, size_t proven_scanned);
+
+/* Records `hits` and `misses` for lookups in the cache named `name`. Counts
+   for the same name are added up. */
+void
+sl_profile_add_cache_lookups(const char *name, uint64_t hits,
+  uint64_t misses);
+
+/* Human-readable report, with the `top_n` most expensive theorems. */
+void
+sl_profiler_print_report(const sl_Profiler *profiler, FILE *out,
+  size_t top_n);
+
+/* Machine-readable (JSON) dump of everything that was recorded. */
+int
+sl_profiler_write_json(const sl_Profiler *profiler, const char *file_path);
+
+#endif
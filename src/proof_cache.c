@@ -0,0 +1,217 @@
+#include "proof_cache.h"
+#include "profile.h"
+#include <pthread.h>
+#include <string.h>
+
+/* An open addressing set with linear probing and a power of two capacity.
+   Zero marks an empty slot, so it is never stored as a fingerprint. */
+struct FingerprintSet
+{
+  uint64_t *slots;
+  size_t capacity;
+  size_t count;
+};
+
+/* The cache keeps two generations of fingerprints, so that it does not grow
+   for as long as a session runs. New fingerprints go into `recent`; once it
+   holds `limit` of them it becomes `older`, and the previous older
+   generation is dropped. A fingerprint found in `older` is moved back into
+   `recent`, so the theorems still in use are kept. */
+struct sl_ProofCache
+{
+  struct FingerprintSet recent;
+  struct FingerprintSet older;
+  size_t limit;
+  pthread_mutex_t lock;
+
+  uint64_t hits;
+  uint64_t misses;
+};
+
+static _Thread_local sl_ProofCache *active_proof_cache = NULL;
+
+#define PROOF_CACHE_INITIAL_CAPACITY 1024
+#define PROOF_CACHE_DEFAULT_LIMIT (1 << 16)
+
+static void
+init_fingerprint_set(struct FingerprintSet *set)
+{
+  set->capacity = PROOF_CACHE_INITIAL_CAPACITY;
+  set->count = 0;
+  set->slots = SL_MALLOC(sizeof(uint64_t) * set->capacity);
+  memset(set->slots, 0, sizeof(uint64_t) * set->capacity);
+}
+
+static void
+free_fingerprint_set(struct FingerprintSet *set)
+{
+  SL_FREE(set->slots);
+}
+
+sl_ProofCache *
+sl_new_proof_cache()
+{
+  sl_ProofCache *cache = SL_NEW(sl_ProofCache);
+  if (cache == NULL)
+    return NULL;
+  memset(cache, 0, sizeof(sl_ProofCache));
+  init_fingerprint_set(&cache->recent);
+  init_fingerprint_set(&cache->older);
+  cache->limit = PROOF_CACHE_DEFAULT_LIMIT;
+  pthread_mutex_init(&cache->lock, NULL);
+  return cache;
+}
+
+void
+sl_free_proof_cache(sl_ProofCache *cache)
+{
+  if (cache == NULL)
+    return;
+  if (active_proof_cache == cache)
+    active_proof_cache = NULL;
+  if (cache->hits + cache->misses > 0)
+    sl_profile_add_cache_lookups("proofs", cache->hits, cache->misses);
+  free_fingerprint_set(&cache->recent);
+  free_fingerprint_set(&cache->older);
+  pthread_mutex_destroy(&cache->lock);
+  SL_FREE(cache);
+}
+
+void
+sl_proof_cache_set_limit(sl_ProofCache *cache, size_t limit)
+{
+  pthread_mutex_lock(&cache->lock);
+  cache->limit = (limit == 0) ? 1 : limit;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+size_t
+sl_proof_cache_count(sl_ProofCache *cache)
+{
+  pthread_mutex_lock(&cache->lock);
+  size_t count = cache->recent.count + cache->older.count;
+  pthread_mutex_unlock(&cache->lock);
+  return count;
+}
+
+void
+sl_set_active_proof_cache(sl_ProofCache *cache)
+{
+  active_proof_cache = cache;
+}
+
+sl_ProofCache *
+sl_get_active_proof_cache()
+{
+  return active_proof_cache;
+}
+
+static uint64_t
+stored_fingerprint(uint64_t fingerprint)
+{
+  return (fingerprint == 0) ? 1 : fingerprint;
+}
+
+static void
+insert_slot(uint64_t *slots, size_t capacity, uint64_t fingerprint)
+{
+  size_t i = (size_t)fingerprint & (capacity - 1);
+  while (slots[i] != 0)
+  {
+    if (slots[i] == fingerprint)
+      return;
+    i = (i + 1) & (capacity - 1);
+  }
+  slots[i] = fingerprint;
+}
+
+static bool
+set_contains(const struct FingerprintSet *set, uint64_t fingerprint)
+{
+  size_t i = (size_t)fingerprint & (set->capacity - 1);
+  while (set->slots[i] != 0)
+  {
+    if (set->slots[i] == fingerprint)
+      return TRUE;
+    i = (i + 1) & (set->capacity - 1);
+  }
+  return FALSE;
+}
+
+static void
+set_add(struct FingerprintSet *set, uint64_t fingerprint)
+{
+  if (2 * (set->count + 1) > set->capacity)
+  {
+    size_t capacity = 2 * set->capacity;
+    uint64_t *slots = SL_MALLOC(sizeof(uint64_t) * capacity);
+    memset(slots, 0, sizeof(uint64_t) * capacity);
+    for (size_t i = 0; i < set->capacity; ++i)
+    {
+      if (set->slots[i] != 0)
+        insert_slot(slots, capacity, set->slots[i]);
+    }
+    SL_FREE(set->slots);
+    set->slots = slots;
+    set->capacity = capacity;
+  }
+  size_t i = (size_t)fingerprint & (set->capacity - 1);
+  while (set->slots[i] != 0)
+  {
+    if (set->slots[i] == fingerprint)
+      return;
+    i = (i + 1) & (set->capacity - 1);
+  }
+  set->slots[i] = fingerprint;
+  set->count += 1;
+}
+
+/* Adds to the recent generation, starting a new one first if it is full. */
+static void
+add_recent(sl_ProofCache *cache, uint64_t fingerprint)
+{
+  if (cache->recent.count >= cache->limit)
+  {
+    free_fingerprint_set(&cache->older);
+    cache->older = cache->recent;
+    init_fingerprint_set(&cache->recent);
+  }
+  set_add(&cache->recent, fingerprint);
+}
+
+bool
+sl_proof_cache_contains(sl_ProofCache *cache, uint64_t fingerprint)
+{
+  fingerprint = stored_fingerprint(fingerprint);
+  pthread_mutex_lock(&cache->lock);
+  bool found = set_contains(&cache->recent, fingerprint);
+  if (!found && set_contains(&cache->older, fingerprint))
+  {
+    add_recent(cache, fingerprint);
+    found = TRUE;
+  }
+  if (found)
+    cache->hits += 1;
+  else
+    cache->misses += 1;
+  pthread_mutex_unlock(&cache->lock);
+  return found;
+}
+
+void
+sl_proof_cache_add(sl_ProofCache *cache, uint64_t fingerprint)
+{
+  fingerprint = stored_fingerprint(fingerprint);
+  pthread_mutex_lock(&cache->lock);
+  if (!set_contains(&cache->recent, fingerprint))
+    add_recent(cache, fingerprint);
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void
+sl_proof_cache_get_stats(const sl_ProofCache *cache, uint64_t *hits,
+  uint64_t *misses)
+{
+  *hits = cache->hits;
+  *misses = cache->misses;
+}
@@ -0,0 +1,50 @@
+#ifndef PROOF_CACHE_H
+#define PROOF_CACHE_H
+
+#include "common.h"
+
+/* The fingerprints of the theorems whose proofs have been checked. A
+   theorem's fingerprint covers its statement and proof, and the fingerprints
+   of everything these refer to, so a theorem whose fingerprint is in the
+   cache has already been proven from exactly the same definitions, and its
+   proof need not be checked again.
+
+   The cache is only consulted while it is active (see
+   `sl_set_active_proof_cache`), which only makes it active for the calling
+   thread. It may be active on several threads at once. */
+typedef struct sl_ProofCache sl_ProofCache;
+
+sl_ProofCache *
+sl_new_proof_cache();
+
+/* Also records the hits and misses of the cache with the active profiler. */
+void
+sl_free_proof_cache(sl_ProofCache *cache);
+
+/* Bounds the cache to about twice `limit` fingerprints; the ones that have
+   not been looked up for the longest are dropped first. */
+void
+sl_proof_cache_set_limit(sl_ProofCache *cache, size_t limit);
+
+/* The number of fingerprints held. */
+size_t
+sl_proof_cache_count(sl_ProofCache *cache);
+
+void
+sl_set_active_proof_cache(sl_ProofCache *cache);
+
+sl_ProofCache *
+sl_get_active_proof_cache();
+
+/* Counts as a hit or a miss. */
+bool
+sl_proof_cache_contains(sl_ProofCache *cache, uint64_t fingerprint);
+
+void
+sl_proof_cache_add(sl_ProofCache *cache, uint64_t fingerprint);
+
+void
+sl_proof_cache_get_stats(const sl_ProofCache *cache, uint64_t *hits,
+  uint64_t *misses);
+
+#endif
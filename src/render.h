@@ -5,8 +5,15 @@
 #include "core.h"
 
 /* HTML */
+
+/* Writes the site to `output_dir`, rendering theorem pages on `jobs`
+   threads (0 for one per CPU). */
 int
-render_html(const sl_LogicState *state, const char *output_dir);
+render_html(const sl_LogicState *state, const char *output_dir,
+  unsigned int jobs);
+
+char *
+html_render_value(const sl_LogicState *state, const Value *v);
 
 /* LaTeX */
 char *
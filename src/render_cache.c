@@ -0,0 +1,324 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Renderer
+#include "render_cache.h"
+#include "core.h"
+#include "profile.h"
+#include <pthread.h>
+#include <string.h>
+
+/* One entry per class of structurally equal values that were rendered. */
+struct RenderCacheNode
+{
+  uint64_t hash;
+  const Value *representative;
+  char *rendered[sl_RenderFormat_Count];
+};
+
+struct IdentitySlot
+{
+  const Value *value;
+  struct RenderCacheNode *node;
+};
+
+/* Both tables use open addressing with linear probing, and have a power of
+   two capacity. */
+struct sl_RenderCache
+{
+  pthread_mutex_t lock; /* Protects everything below. */
+
+  struct IdentitySlot *identity;
+  size_t identity_capacity;
+  size_t identity_count;
+
+  struct RenderCacheNode **nodes;
+  size_t nodes_capacity;
+  size_t nodes_count;
+
+  uint64_t hits[sl_RenderFormat_Count];
+  uint64_t misses[sl_RenderFormat_Count];
+};
+
+static const char *format_cache_names[] = {
+  "render text",
+  "render html",
+  "render latex"
+};
+
+static sl_RenderCache *active_render_cache = NULL;
+
+#define RENDER_CACHE_INITIAL_CAPACITY 1024
+
+/* Longer strings are not kept, so that the text a cache holds stays small
+   next to the values it has seen. */
+#define RENDER_CACHE_MAX_LENGTH 4096
+
+sl_RenderCache *
+sl_new_render_cache()
+{
+  sl_RenderCache *cache = SL_NEW(sl_RenderCache);
+  if (cache == NULL)
+    return NULL;
+  memset(cache, 0, sizeof(sl_RenderCache));
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->identity_capacity = RENDER_CACHE_INITIAL_CAPACITY;
+  cache->identity = SL_MALLOC(sizeof(struct IdentitySlot)
+    * cache->identity_capacity);
+  memset(cache->identity, 0, sizeof(struct IdentitySlot)
+    * cache->identity_capacity);
+  cache->nodes_capacity = RENDER_CACHE_INITIAL_CAPACITY;
+  cache->nodes = SL_MALLOC(sizeof(struct RenderCacheNode *)
+    * cache->nodes_capacity);
+  memset(cache->nodes, 0, sizeof(struct RenderCacheNode *)
+    * cache->nodes_capacity);
+  return cache;
+}
+
+void
+sl_free_render_cache(sl_RenderCache *cache)
+{
+  if (cache == NULL)
+    return;
+  if (active_render_cache == cache)
+    active_render_cache = NULL;
+  for (size_t i = 0; i < sl_RenderFormat_Count; ++i)
+  {
+    if (cache->hits[i] + cache->misses[i] > 0)
+      sl_profile_add_cache_lookups(format_cache_names[i], cache->hits[i],
+        cache->misses[i]);
+  }
+  for (size_t i = 0; i < cache->nodes_capacity; ++i)
+  {
+    struct RenderCacheNode *node = cache->nodes[i];
+    if (node == NULL)
+      continue;
+    for (size_t j = 0; j < sl_RenderFormat_Count; ++j)
+      SL_FREE(node->rendered[j]);
+    SL_FREE(node);
+  }
+  SL_FREE(cache->nodes);
+  SL_FREE(cache->identity);
+  pthread_mutex_destroy(&cache->lock);
+  SL_FREE(cache);
+}
+
+void
+sl_set_active_render_cache(sl_RenderCache *cache)
+{
+  active_render_cache = cache;
+}
+
+static size_t
+pointer_slot(const void *ptr, size_t capacity)
+{
+  uint64_t h = (uint64_t)(uintptr_t)ptr;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return (size_t)h & (capacity - 1);
+}
+
+static struct RenderCacheNode *
+find_by_identity(const sl_RenderCache *cache, const Value *v)
+{
+  size_t i = pointer_slot(v, cache->identity_capacity);
+  while (cache->identity[i].value != NULL)
+  {
+    if (cache->identity[i].value == v)
+      return cache->identity[i].node;
+    i = (i + 1) & (cache->identity_capacity - 1);
+  }
+  return NULL;
+}
+
+static void
+insert_identity_slot(struct IdentitySlot *table, size_t capacity,
+  struct IdentitySlot slot)
+{
+  size_t i = pointer_slot(slot.value, capacity);
+  while (table[i].value != NULL)
+    i = (i + 1) & (capacity - 1);
+  table[i] = slot;
+}
+
+static void
+add_identity(sl_RenderCache *cache, const Value *v,
+  struct RenderCacheNode *node)
+{
+  struct IdentitySlot slot;
+  if (2 * (cache->identity_count + 1) > cache->identity_capacity)
+  {
+    size_t capacity = 2 * cache->identity_capacity;
+    struct IdentitySlot *table =
+      SL_MALLOC(sizeof(struct IdentitySlot) * capacity);
+    memset(table, 0, sizeof(struct IdentitySlot) * capacity);
+    for (size_t i = 0; i < cache->identity_capacity; ++i)
+    {
+      if (cache->identity[i].value != NULL)
+        insert_identity_slot(table, capacity, cache->identity[i]);
+    }
+    SL_FREE(cache->identity);
+    cache->identity = table;
+    cache->identity_capacity = capacity;
+  }
+  slot.value = v;
+  slot.node = node;
+  insert_identity_slot(cache->identity, cache->identity_capacity, slot);
+  cache->identity_count += 1;
+}
+
+static void
+insert_node(struct RenderCacheNode **table, size_t capacity,
+  struct RenderCacheNode *node)
+{
+  size_t i = (size_t)node->hash & (capacity - 1);
+  while (table[i] != NULL)
+    i = (i + 1) & (capacity - 1);
+  table[i] = node;
+}
+
+static void
+add_node(sl_RenderCache *cache, struct RenderCacheNode *node)
+{
+  if (2 * (cache->nodes_count + 1) > cache->nodes_capacity)
+  {
+    size_t capacity = 2 * cache->nodes_capacity;
+    struct RenderCacheNode **table =
+      SL_MALLOC(sizeof(struct RenderCacheNode *) * capacity);
+    memset(table, 0, sizeof(struct RenderCacheNode *) * capacity);
+    for (size_t i = 0; i < cache->nodes_capacity; ++i)
+    {
+      if (cache->nodes[i] != NULL)
+        insert_node(table, capacity, cache->nodes[i]);
+    }
+    SL_FREE(cache->nodes);
+    cache->nodes = table;
+    cache->nodes_capacity = capacity;
+  }
+  insert_node(cache->nodes, cache->nodes_capacity, node);
+  cache->nodes_count += 1;
+}
+
+/* Hashes the node alone, with the same fields that `values_equal`
+   compares, and how many arguments it has. */
+static uint64_t
+hash_value_node(uint64_t hash, const Value *v)
+{
+  hash = sl_hash_uint64(hash, v->value_type);
+  switch (v->value_type)
+  {
+    case ValueTypeDummy:
+      hash = sl_hash_uint64(hash, v->content.dummy_id);
+      break;
+    case ValueTypeConstant:
+      {
+        const sl_SymbolPath *path = v->content.constant.constant_path;
+        for (size_t i = 0; i < ARR_LENGTH(path->segments); ++i)
+          hash = sl_hash_uint64(hash, *ARR_GET(path->segments, i));
+      }
+      break;
+    case ValueTypeVariable:
+      hash = sl_hash_uint64(hash, v->type_id);
+      hash = sl_hash_uint64(hash, v->content.variable_name_id);
+      break;
+    case ValueTypeComposition:
+      hash = sl_hash_uint64(hash, v->type_id);
+      hash = sl_hash_uint64(hash, v->content.composition.expression_id);
+      hash = sl_hash_uint64(hash,
+        ARR_LENGTH(v->content.composition.arguments));
+      break;
+    case ValueTypeNumeral:
+      hash = sl_hash_uint64(hash, v->type_id);
+      hash = sl_natural_hash(hash, v->content.numeral);
+      break;
+  }
+  return hash;
+}
+
+/* The nodes are hashed in prefix order, walking with an explicit stack. */
+static uint64_t
+hash_value_structure(const Value *v)
+{
+  struct ValueWalk walk;
+  uint64_t hash = SL_HASH_INIT;
+  init_value_walk(&walk);
+  push_value_frame(&walk, v);
+  while (walk.length > 0)
+  {
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    hash = hash_value_node(hash, node);
+    for (size_t i = VALUE_ARITY(node); i > 0; --i)
+      push_value_frame(&walk, VALUE_ARGUMENT(node, i - 1));
+  }
+  free_value_walk(&walk);
+  return hash;
+}
+
+/* Finds the node of `v`, creating it if this is the first value of its
+   structure. Only whole values are interned, not their arguments. */
+static struct RenderCacheNode *
+intern_value(sl_RenderCache *cache, const Value *v)
+{
+  struct RenderCacheNode *node = find_by_identity(cache, v);
+  if (node != NULL)
+    return node;
+
+  uint64_t hash = hash_value_structure(v);
+  size_t i = (size_t)hash & (cache->nodes_capacity - 1);
+  while (cache->nodes[i] != NULL)
+  {
+    struct RenderCacheNode *candidate = cache->nodes[i];
+    if (candidate->hash == hash
+        && values_equal(candidate->representative, v))
+    {
+      node = candidate;
+      break;
+    }
+    i = (i + 1) & (cache->nodes_capacity - 1);
+  }
+
+  if (node == NULL)
+  {
+    node = SL_NEW(struct RenderCacheNode);
+    memset(node, 0, sizeof(struct RenderCacheNode));
+    node->hash = hash;
+    node->representative = v;
+    add_node(cache, node);
+  }
+  add_identity(cache, v, node);
+  return node;
+}
+
+char *
+sl_render_value_cached(const sl_LogicState *state, const Value *v,
+  sl_RenderFormat format, sl_RenderValueFunction render)
+{
+  sl_RenderCache *cache = active_render_cache;
+  struct RenderCacheNode *node;
+  char *result;
+  if (cache == NULL)
+    return render(state, v);
+
+  pthread_mutex_lock(&cache->lock);
+  node = intern_value(cache, v);
+  if (node->rendered[format] != NULL)
+  {
+    cache->hits[format] += 1;
+    result = SL_STRDUP(node->rendered[format]);
+    pthread_mutex_unlock(&cache->lock);
+    return result;
+  }
+  cache->misses[format] += 1;
+  pthread_mutex_unlock(&cache->lock);
+
+  /* Render without holding the lock, so that other threads can use the
+     cache meanwhile. Another thread may render the same node in the
+     meantime, in which case the first result is kept. */
+  result = render(state, v);
+  if (strlen(result) > RENDER_CACHE_MAX_LENGTH)
+    return result;
+  pthread_mutex_lock(&cache->lock);
+  if (node->rendered[format] == NULL)
+    node->rendered[format] = SL_STRDUP(result);
+  pthread_mutex_unlock(&cache->lock);
+  return result;
+}
@@ -0,0 +1,48 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include "logic.h"
+
+/* Memoization of the strings rendered for whole values, such as the
+   statements of theorems. Values are looked up by identity first, and values
+   that are structurally equal share a single entry, so a statement that
+   appears many times is rendered once per format. The renderers write a
+   value in a single pass, so the arguments of a value are neither looked up
+   nor kept on their own.
+
+   Caching only happens while a cache is active (see
+   `sl_set_active_render_cache`), and the values rendered during that time
+   must be neither modified nor freed. Any thread may render through the
+   active cache. */
+typedef struct sl_RenderCache sl_RenderCache;
+
+enum sl_RenderFormat
+{
+  sl_RenderFormat_Text = 0,
+  sl_RenderFormat_HTML,
+  sl_RenderFormat_Latex,
+  sl_RenderFormat_Count
+};
+typedef enum sl_RenderFormat sl_RenderFormat;
+
+typedef char *(* sl_RenderValueFunction)(const sl_LogicState *,
+  const Value *);
+
+sl_RenderCache *
+sl_new_render_cache();
+
+/* Also records the hits and misses of the cache with the active profiler. */
+void
+sl_free_render_cache(sl_RenderCache *cache);
+
+void
+sl_set_active_render_cache(sl_RenderCache *cache);
+
+/* Returns a copy of the string `render` produces for `v` in `format`, calling
+   it only if the value has not been rendered in that format yet. Long
+   strings are not kept, and are rendered again each time. */
+char *
+sl_render_value_cached(const sl_LogicState *state, const Value *v,
+  sl_RenderFormat format, sl_RenderValueFunction render);
+
+#endif
@@ -1,111 +1,178 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Renderer
 #include "render.h"
 #include "common.h"
 #include "core.h"
 #include "parse.h"
+#include "profile.h"
+#include "render_cache.h"
+#include "trace.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/stat.h>
 
-#define LINE_BUFFER_SIZE 4096
+/* The build points this at the res/ directory of the source tree, so that
+   pages can be rendered from any working directory. */
+#ifndef SL_RESOURCE_DIR
+#define SL_RESOURCE_DIR "res"
+#endif
+
+#define HTML_PAGE_TEMPLATE SL_RESOURCE_DIR "/page.html"
+#define HTML_STYLESHEET SL_RESOURCE_DIR "/style.css"
 
 typedef int (* sl_html_generator_t)(FILE *, void *);
 
 struct sl_HTMLTemplateSubstituion {
   const char *target;
   sl_html_generator_t generate;
-  void *userdata;
 };
 
-static int sl_load_html_template(const char *template_path, FILE *out,
-    struct sl_HTMLTemplateSubstituion *substitutions, size_t substitutions_n)
-{
-  sl_TextInput *input;
-  sl_TextInputLineBuffer *buf;
-  const char *line;
-  /* Load the file, and read through until we find special tags. Then
-     replace the content of each special tag using the provided callback. If
-     there is no such tag, just leave it in place. */
-  input = sl_input_from_file(template_path);
-  if (input == NULL)
-    return 1;
-  buf = sl_input_make_line_buffer(LINE_BUFFER_SIZE);
-  if (buf == NULL) {
-    sl_input_free(input);
-    return 1;
+/* A template is compiled once into a list of literal spans and slots
+   (`<@ name @>`), each slot resolved to the generator that fills it in. */
+struct HTMLTemplateSegment {
+  const char *literal; /* NULL for a slot. */
+  size_t length;
+  sl_html_generator_t generate;
+};
+
+struct sl_HTMLTemplate {
+  char *text;
+  uint64_t hash; /* Of the template text. */
+  ARR(struct HTMLTemplateSegment) segments;
+};
+typedef struct sl_HTMLTemplate sl_HTMLTemplate;
+
+static void sl_free_html_template(sl_HTMLTemplate *template)
+{
+  if (template == NULL)
+    return;
+  SL_FREE(template->text);
+  ARR_FREE(template->segments);
+  SL_FREE(template);
+}
+
+static char *read_file(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  char *text;
+  long size;
+  if (f == NULL)
+    return NULL;
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0
+      || fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  text = SL_MALLOC(size + 1);
+  if (fread(text, 1, size, f) != (size_t)size) {
+    SL_FREE(text);
+    fclose(f);
+    return NULL;
   }
+  text[size] = '\0';
+  fclose(f);
+  return text;
+}
 
-  while (sl_input_get_line(input, buf) == 0) {
-    /* Look through the line for special tags. If we find any, find the
-       corresponding substitution and insert it. If no such substitution
-       exists or another error occurs, just emit a warning and write the
-       name of the substitution. */
-    bool in_tag;
-    char output_buf[LINE_BUFFER_SIZE];
-    char *output_cursor;
-    line = sl_input_get_line_buffer_contents(buf);
-    output_cursor = output_buf;
-    for (const char *c = line; *c != '\0'; ++c) {
-      if (!in_tag) {
-        if (strlen(c) >= 2 && strncmp(c, "<@", 2) == 0) {
-          in_tag = TRUE;
-          ++c;
-          /* TODO: handle errors. */
-          fwrite(output_buf, 1, output_cursor - output_buf, out);
-          output_cursor = output_buf;
-        } else {
-          *output_cursor = *c;
-          ++output_cursor;
-        }
-      } else {
-        if (strlen(c) >= 2 && strncmp(c, "@>", 2) == 0) {
-          bool found_sub = FALSE;
-          in_tag = FALSE;
-          ++c;
-          /* TODO: handle errors. */
-          *output_cursor = '\0';
-          ++output_cursor;
-          for (size_t i = 0; i < substitutions_n; ++i) {
-            struct sl_HTMLTemplateSubstituion sub = substitutions[i];
-            if (strcmp(sub.target, output_buf) == 0) {
-              sub.generate(out, sub.userdata);
-              found_sub = TRUE;
-            }
-          }
-          if (!found_sub) {
-            printf("found tag \"%s\" without a corresponding generator\n",
-                output_buf);
-            fwrite(output_buf, 1, output_cursor - output_buf, out);
-          }
-          output_cursor = output_buf;
-        } else if (!isspace(*c)) {
-          *output_cursor = *c;
-          ++output_cursor;
-        }
+static void add_literal_segment(sl_HTMLTemplate *template,
+    const char *begin, const char *end)
+{
+  struct HTMLTemplateSegment seg;
+  if (end == begin)
+    return;
+  seg.literal = begin;
+  seg.length = end - begin;
+  seg.generate = NULL;
+  ARR_APPEND(template->segments, seg);
+}
+
+static sl_HTMLTemplate *sl_compile_html_template(const char *template_path,
+    const struct sl_HTMLTemplateSubstituion *substitutions,
+    size_t substitutions_n)
+{
+  sl_HTMLTemplate *template;
+  const char *c, *literal_begin;
+  char *text = read_file(template_path);
+  if (text == NULL)
+    return NULL;
+  template = SL_NEW(sl_HTMLTemplate);
+  template->text = text;
+  template->hash = sl_hash_string(SL_HASH_INIT, text);
+  ARR_INIT(template->segments);
+
+  /* Split the text at each tag. Tags whose name has no corresponding
+     substitution are left in place (without the delimiters), with a
+     warning. */
+  literal_begin = text;
+  c = text;
+  while ((c = strstr(c, "<@")) != NULL) {
+    const char *name_begin = c + 2, *name_end;
+    const char *tag_end = strstr(name_begin, "@>");
+    bool found_sub = FALSE;
+    if (tag_end == NULL)
+      break; /* TODO: warning, unterminated tag. */
+    while (name_begin < tag_end && isspace(*name_begin))
+      ++name_begin;
+    name_end = tag_end;
+    while (name_end > name_begin && isspace(name_end[-1]))
+      --name_end;
+
+    add_literal_segment(template, literal_begin, c);
+    for (size_t i = 0; i < substitutions_n; ++i) {
+      const char *target = substitutions[i].target;
+      if (strlen(target) == (size_t)(name_end - name_begin)
+          && strncmp(target, name_begin, name_end - name_begin) == 0) {
+        struct HTMLTemplateSegment seg;
+        seg.literal = NULL;
+        seg.length = 0;
+        seg.generate = substitutions[i].generate;
+        ARR_APPEND(template->segments, seg);
+        found_sub = TRUE;
+        break;
       }
     }
-    /* If we have an unterminated tag, just fill it in and emit a warning. */
-    if (in_tag) {
-      /* TODO: warning. */
-    } else {
-      fwrite(output_buf, 1, output_cursor - output_buf, out);
-      output_cursor = output_buf;
+    if (!found_sub) {
+      printf("found tag \"%.*s\" without a corresponding generator\n",
+          (int)(name_end - name_begin), name_begin);
+      add_literal_segment(template, name_begin, name_end);
     }
+    c = tag_end + 2;
+    literal_begin = c;
   }
+  add_literal_segment(template, literal_begin,
+      literal_begin + strlen(literal_begin));
+  return template;
+}
 
-  sl_input_free(input);
-  sl_input_free_line_buffer(buf);
+static int sl_render_html_template(const sl_HTMLTemplate *template,
+    FILE *out, void *userdata)
+{
+  for (size_t i = 0; i < ARR_LENGTH(template->segments); ++i) {
+    const struct HTMLTemplateSegment *seg =
+        ARR_GET(template->segments, i);
+    if (seg->literal != NULL) {
+      if (fwrite(seg->literal, 1, seg->length, out) != seg->length)
+        return 1;
+    } else {
+      int err = seg->generate(out, userdata);
+      PROPAGATE_ERROR(err);
+    }
+  }
   return 0;
 }
 
 struct sl_HTMLFileInfo;
 
-typedef int (* sl_html_write_content_t)(struct sl_HTMLFileInfo *);
+typedef int (* sl_html_write_content_t)(FILE *, struct sl_HTMLFileInfo *);
 
 struct sl_HTMLFileInfo {
   const char *output_path;
   const char *page_name;
   sl_html_write_content_t content;
-  void *userdata;
+  const sl_LogicState *state;
+  const void *userdata;
 };
 
 static int substitute_title(FILE *out, void *userdata)
@@ -115,23 +182,53 @@ static int substitute_title(FILE *out, void *userdata)
   return 0;
 }
 
-int sl_generate_full_html_file(struct sl_HTMLFileInfo *info)
+static const struct sl_HTMLTemplateSubstituion page_substitutions[] = {
+  { "page_title", &substitute_title }
+};
+
+static sl_HTMLTemplate *sl_load_page_template()
 {
-  struct sl_HTMLTemplateSubstituion substitutions[1];
-  if (info == NULL)
-    return 0;
-  {
-    /* Title */
-    substitutions[0].target = "page_title";
-    substitutions[0].generate = &substitute_title;
-    substitutions[0].userdata = info;
-  }
-  {
-    FILE *f = fopen(info->output_path, "w");
-    sl_load_html_template("res/page.html", f, substitutions, 1);
+  sl_HTMLTemplate *template = sl_compile_html_template(HTML_PAGE_TEMPLATE,
+      page_substitutions,
+      sizeof(page_substitutions) / sizeof(page_substitutions[0]));
+  if (template == NULL)
+    fprintf(stderr, "Cannot read the page template '%s'.\n",
+        HTML_PAGE_TEMPLATE);
+  return template;
+}
+
+/* Pages are generated into a growable in-memory buffer, and then written
+   to their file in one go. The buffer is reused from page to page. */
+struct HTMLPageBuffer {
+  FILE *out;
+  char *data;
+  size_t size;
+};
+
+static int init_page_buffer(struct HTMLPageBuffer *buffer)
+{
+  buffer->data = NULL;
+  buffer->size = 0;
+  buffer->out = open_memstream(&buffer->data, &buffer->size);
+  return buffer->out == NULL;
+}
+
+static void free_page_buffer(struct HTMLPageBuffer *buffer)
+{
+  fclose(buffer->out);
+  free(buffer->data); /* Allocated by the C library, not SL_MALLOC. */
+}
+
+static int write_page_file(const char *path, const char *data, size_t size)
+{
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return 1;
+  if (fwrite(data, 1, size, f) != size) {
     fclose(f);
+    return 1;
   }
-  return 0;
+  return fclose(f) != 0;
 }
 
 #define HTML_HEAD_FORMAT \
@@ -153,76 +250,302 @@ html_head(const char *title)
   return dst;
 }
 
-char *
-html_render_value(const sl_LogicState *state, const Value *v)
+/* A page with content of its own, under a plain head. */
+static int sl_render_plain_html_page(struct sl_HTMLFileInfo *info,
+    FILE *out)
+{
+  int err;
+  char *head = html_head(info->page_name);
+  fputs(head, out);
+  SL_FREE(head);
+  err = info->content(out, info);
+  PROPAGATE_ERROR(err);
+  fputs(HTML_END, out);
+  return 0;
+}
+
+/* Generates the page into `buffer` without writing it. Pages without a
+   template are plain pages. */
+static int sl_render_html_page(const sl_HTMLTemplate *template,
+    struct sl_HTMLFileInfo *info, struct HTMLPageBuffer *buffer)
+{
+  int err;
+  rewind(buffer->out);
+  if (template != NULL)
+    err = sl_render_html_template(template, buffer->out, info);
+  else
+    err = sl_render_plain_html_page(info, buffer->out);
+  if (err == 0 && fflush(buffer->out) != 0)
+    err = 1;
+  return err;
+}
+
+static int sl_generate_full_html_file(const sl_HTMLTemplate *template,
+    struct sl_HTMLFileInfo *info, struct HTMLPageBuffer *buffer)
+{
+  int err;
+  if (info == NULL)
+    return 0;
+  err = sl_render_html_page(template, info, buffer);
+  PROPAGATE_ERROR(err);
+  return write_page_file(info->output_path, buffer->data, buffer->size);
+}
+
+/* Incremental output. The output directory keeps a manifest of the pages
+   that were generated, each with a hash of what its content depends on.
+   Pages whose hash is unchanged are not generated or written again, and
+   pages that are no longer generated are removed. */
+#define HTML_MANIFEST_NAME ".sl-manifest"
+
+/* Bump this whenever the rendering of theorem pages changes, so that the
+   hashes in existing manifests no longer match. */
+#define HTML_RENDER_VERSION 2
+
+struct HTMLManifestEntry {
+  char *page; /* Relative to the output directory. */
+  uint64_t hash;
+};
+
+typedef ARR(struct HTMLManifestEntry) HTMLManifest;
+
+static int compare_manifest_entries(const void *a, const void *b)
+{
+  return strcmp(((const struct HTMLManifestEntry *)a)->page,
+      ((const struct HTMLManifestEntry *)b)->page);
+}
+
+static void add_manifest_entry(HTMLManifest *manifest, const char *page,
+    uint64_t hash)
+{
+  struct HTMLManifestEntry entry;
+  entry.page = SL_STRDUP(page);
+  entry.hash = hash;
+  ARR_APPEND(*manifest, entry);
+}
+
+static void free_manifest(HTMLManifest *manifest)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*manifest); ++i)
+    SL_FREE(ARR_GET(*manifest, i)->page);
+  ARR_FREE(*manifest);
+}
+
+/* Entries are sorted by page after loading, for lookups. A missing or
+   unreadable manifest is treated as empty. */
+static void load_manifest(HTMLManifest *manifest, const char *output_dir)
+{
+  char path[1024], line[1024], page[1024];
+  FILE *f;
+  ARR_INIT(*manifest);
+  snprintf(path, 1024, "%s/%s", output_dir, HTML_MANIFEST_NAME);
+  f = fopen(path, "r");
+  if (f == NULL)
+    return;
+  while (fgets(line, 1024, f) != NULL) {
+    unsigned long long hash;
+    if (sscanf(line, "%llx %1023s", &hash, page) == 2)
+      add_manifest_entry(manifest, page, hash);
+  }
+  fclose(f);
+  qsort(manifest->data, ARR_LENGTH(*manifest),
+      sizeof(struct HTMLManifestEntry), &compare_manifest_entries);
+}
+
+static const struct HTMLManifestEntry *find_manifest_entry(
+    const HTMLManifest *manifest, const char *page)
+{
+  struct HTMLManifestEntry key;
+  key.page = (char *)page;
+  return bsearch(&key, manifest->data, ARR_LENGTH(*manifest),
+      sizeof(struct HTMLManifestEntry), &compare_manifest_entries);
+}
+
+/* Whether the page was generated from inputs with this hash last time, and
+   is still there. */
+static bool page_up_to_date(const HTMLManifest *manifest,
+    const char *output_dir, const char *page, uint64_t hash)
+{
+  char path[1024];
+  const struct HTMLManifestEntry *entry = find_manifest_entry(manifest, page);
+  if (entry == NULL || entry->hash != hash)
+    return FALSE;
+  snprintf(path, 1024, "%s/%s", output_dir, page);
+  return access(path, F_OK) == 0;
+}
+
+/* Sorts `manifest`, writes it, and removes the pages of `old_manifest`
+   that are no longer part of the site. */
+static int update_manifest(HTMLManifest *manifest,
+    const HTMLManifest *old_manifest, const char *output_dir)
+{
+  char path[1024], tmp_path[1024];
+  FILE *f;
+  qsort(manifest->data, ARR_LENGTH(*manifest),
+      sizeof(struct HTMLManifestEntry), &compare_manifest_entries);
+  for (size_t i = 0; i < ARR_LENGTH(*old_manifest); ++i) {
+    const struct HTMLManifestEntry *entry = ARR_GET(*old_manifest, i);
+    if (find_manifest_entry(manifest, entry->page) == NULL) {
+      char page_path[1024];
+      snprintf(page_path, 1024, "%s/%s", output_dir, entry->page);
+      unlink(page_path);
+    }
+  }
+
+  if (ARR_LENGTH(*manifest) == ARR_LENGTH(*old_manifest)) {
+    bool same = TRUE;
+    for (size_t i = 0; i < ARR_LENGTH(*manifest) && same; ++i) {
+      const struct HTMLManifestEntry *a = ARR_GET(*manifest, i);
+      const struct HTMLManifestEntry *b = ARR_GET(*old_manifest, i);
+      same = a->hash == b->hash && strcmp(a->page, b->page) == 0;
+    }
+    if (same)
+      return 0;
+  }
+
+  /* Write to a temporary file first so that an interrupted run cannot
+     leave a truncated manifest behind. */
+  snprintf(path, 1024, "%s/%s", output_dir, HTML_MANIFEST_NAME);
+  snprintf(tmp_path, 1024, "%s/%s.tmp", output_dir, HTML_MANIFEST_NAME);
+  f = fopen(tmp_path, "w");
+  if (f == NULL)
+    return 1;
+  for (size_t i = 0; i < ARR_LENGTH(*manifest); ++i) {
+    const struct HTMLManifestEntry *entry = ARR_GET(*manifest, i);
+    fprintf(f, "%016llx %s\n", (unsigned long long)entry->hash,
+        entry->page);
+  }
+  if (fclose(f) != 0)
+    return 1;
+  return rename(tmp_path, path) != 0;
+}
+
+/* For pages that are cheap to generate: generate the page, and only write
+   it if its content changed. */
+static int sl_update_html_file(const sl_HTMLTemplate *template,
+    struct sl_HTMLFileInfo *info, struct HTMLPageBuffer *buffer,
+    const char *output_dir, const char *page,
+    const HTMLManifest *old_manifest, HTMLManifest *manifest)
+{
+  uint64_t hash;
+  int err = sl_render_html_page(template, info, buffer);
+  PROPAGATE_ERROR(err);
+  hash = sl_hash_bytes(SL_HASH_INIT, buffer->data, buffer->size);
+  add_manifest_entry(manifest, page, hash);
+  if (page_up_to_date(old_manifest, output_dir, page, hash))
+    return 0;
+  return write_page_file(info->output_path, buffer->data, buffer->size);
+}
+
+/* Everything needed while generating the site. */
+struct HTMLSite {
+  const sl_LogicState *state;
+  const char *output_dir;
+  const sl_HTMLTemplate *template;
+  HTMLManifest old_manifest; /* From the previous run. */
+  HTMLManifest manifest; /* Pages generated by this run. */
+};
+
+static void
+html_write_value_leaf(const sl_LogicState *state, const Value *v,
+  sl_StringBuilder *out)
 {
-  char *str;
   switch (v->value_type)
   {
     case ValueTypeDummy:
-      asprintf(&str, "Dummy %u", v->content.dummy_id);
+      sl_string_builder_printf(out, "Dummy %u", v->content.dummy_id);
       break;
     case ValueTypeConstant:
-      asprintf(&str, "<a href=\"#sym-%u\">%s</a>",
+      sl_string_builder_printf(out, "<a href=\"#sym-%u\">%s</a>",
         /*v->constant->id*/ 0,
         sl_get_symbol_path_last_segment(state,
             v->content.constant.constant_path));
       break;
     case ValueTypeVariable:
-      asprintf(&str, "$%s",
+      sl_string_builder_printf(out, "$%s",
           logic_state_get_string(state, v->content.variable_name_id));
       break;
+    case ValueTypeNumeral:
+      {
+        char *digits = sl_natural_to_string(v->content.numeral);
+        sl_string_builder_append(out, digits);
+        SL_FREE(digits);
+      }
+      break;
     case ValueTypeComposition:
-      if (ARR_LENGTH(v->content.composition.arguments) == 0)
+      break;
+  }
+}
+
+/* Writes the link to the expression and the opening parenthesis of a
+   composition. */
+static void
+html_write_composition_open(const sl_LogicState *state, const Value *v,
+  sl_StringBuilder *out)
+{
+  const sl_SymbolPath *expr_path = sl_logic_get_symbol_path_by_id(state,
+      v->content.composition.expression_id);
+  sl_string_builder_printf(out, "<a href=\"#sym-%u\">%s</a>(",
+    v->content.composition.expression_id,
+    sl_get_symbol_path_last_segment(state, expr_path));
+}
+
+/* The value is written in one pass, walking it with an explicit stack, so
+   that neither the time nor the stack it takes grows faster than its size. */
+static void
+html_write_value(const sl_LogicState *state, const Value *v,
+  sl_StringBuilder *out)
+{
+  struct ValueWalk walk;
+  if (v->value_type != ValueTypeComposition)
+  {
+    html_write_value_leaf(state, v, out);
+    return;
+  }
+  init_value_walk(&walk);
+  html_write_composition_open(state, v, out);
+  push_value_frame(&walk, v);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next);
+      if (top->next > 0)
+        sl_string_builder_append(out, ", ");
+      top->next += 1;
+      if (arg->value_type == ValueTypeComposition)
       {
-        const sl_SymbolPath *expr_path = sl_logic_get_symbol_path_by_id(state,
-            v->content.composition.expression_id);
-        asprintf(&str, "<a href=\"#sym-%u\">%s</a>()",
-          v->content.composition.expression_id,
-          sl_get_symbol_path_last_segment(state, expr_path));
+        html_write_composition_open(state, arg, out);
+        push_value_frame(&walk, arg);
       }
       else
       {
-        size_t args_str_len = 1;
-        char **args = malloc(sizeof(char *)
-            * ARR_LENGTH(v->content.composition.arguments));
-        for (size_t i = 0; i < ARR_LENGTH(v->content.composition.arguments);
-            ++i) {
-          const Value *arg = *ARR_GET(v->content.composition.arguments, i);
-          args[i] = html_render_value(state, arg);
-          args_str_len += strlen(args[i]);
-        }
-        args_str_len += (ARR_LENGTH(v->content.composition.arguments) - 1) * 2;
-
-        char *args_str = malloc(args_str_len);
-        char *c = args_str;
-        bool first_arg = TRUE;
-        for (size_t i = 0; i < ARR_LENGTH(v->content.composition.arguments);
-            ++i) {
-          if (!first_arg)
-          {
-            strcpy(c, ", ");
-            c += 2;
-          }
-          if (first_arg)
-            first_arg = FALSE;
-          strcpy(c, args[i]);
-          c += strlen(args[i]);
-          free(args[i]);
-        }
-        free(args);
-        *c = '\0';
-
-        const sl_SymbolPath *expr_path = sl_logic_get_symbol_path_by_id(state,
-            v->content.composition.expression_id);
-        asprintf(&str, "<a href=\"#sym-%u\">%s</a>(%s)",
-            v->content.composition.expression_id,
-            sl_get_symbol_path_last_segment(state, expr_path), args_str);
-        free(args_str);
+        html_write_value_leaf(state, arg, out);
       }
-      break;
+    }
+    else
+    {
+      sl_string_builder_append_char(out, ')');
+      VALUE_WALK_POP(&walk);
+    }
   }
-  return str;
+  free_value_walk(&walk);
+}
+
+static char *
+html_render_value_uncached(const sl_LogicState *state, const Value *v)
+{
+  sl_StringBuilder builder;
+  sl_string_builder_init(&builder);
+  html_write_value(state, v, &builder);
+  return sl_string_builder_finish(&builder);
+}
+
+char *
+html_render_value(const sl_LogicState *state, const Value *v)
+{
+  return sl_render_value_cached(state, v, sl_RenderFormat_HTML,
+    &html_render_value_uncached);
 }
 
 int
@@ -233,7 +556,7 @@ html_render_type(const sl_LogicState *state, const struct Type *type, FILE *f)
     char *div_begin;
     asprintf(&div_begin, "<div class=\"symbol\" id=\"sym-%u\">\n", type->id);
     fputs(div_begin, f);
-    free(div_begin);
+    SL_FREE(div_begin);
   }
   {
     char *id_label;
@@ -242,15 +565,15 @@ html_render_type(const sl_LogicState *state, const struct Type *type, FILE *f)
     else
       asprintf(&id_label, "<h3><code>%u:</code> Type</h3>\n", type->id);
     fputs(id_label, f);
-    free(id_label);
+    SL_FREE(id_label);
   }
   {
     char *path = sl_string_from_symbol_path(state, type->path);
     char *type_label;
     asprintf(&type_label, "<h4>Path: <code>%s</code></h4>\n", path);
     fputs(type_label, f);
-    free(path);
-    free(type_label);
+    SL_FREE(path);
+    SL_FREE(type_label);
   }
   fputs("</div>\n", f);
   return 0;
@@ -265,21 +588,21 @@ html_render_constant(const sl_LogicState *state,
     char *div_begin;
     asprintf(&div_begin, "<div class=\"symbol\" id=\"sym-%u\">\n", constant->id);
     fputs(div_begin, f);
-    free(div_begin);
+    SL_FREE(div_begin);
   }
   {
     char *id_label;
     asprintf(&id_label, "<h3><code>%u:</code> Constant</h3>\n", constant->id);
     fputs(id_label, f);
-    free(id_label);
+    SL_FREE(id_label);
   }
   {
     char *path = sl_string_from_symbol_path(state, constant->path);
     char *type_label;
     asprintf(&type_label, "<h4>Path: <code>%s</code></h4>\n", path);
     fputs(type_label, f);
-    free(path);
-    free(type_label);
+    SL_FREE(path);
+    SL_FREE(type_label);
   }
   {
     const sl_SymbolPath *const_path;
@@ -290,8 +613,8 @@ html_render_constant(const sl_LogicState *state,
       "<h4>Type: <code><a href=\"#sym-%u\">%s</a></code></h4>\n",
       constant->type_id, const_type);
     fputs(type_label, f);
-    free(const_type);
-    free(type_label);
+    SL_FREE(const_type);
+    SL_FREE(type_label);
   }
   if (constant->latex_format != NULL)
   {
@@ -299,8 +622,8 @@ html_render_constant(const sl_LogicState *state,
     char *latex_label;
     asprintf(&latex_label, "<h4>LaTeX: \\(%s\\)</h4>\n", latex);
     fputs(latex_label, f);
-    free(latex);
-    free(latex_label);
+    SL_FREE(latex);
+    SL_FREE(latex_label);
   }
   fputs("</div>\n", f);
   return 0;
@@ -315,22 +638,22 @@ html_render_expression(const sl_LogicState *state,
     asprintf(&div_begin, "<div class=\"symbol\" id=\"sym-%u\">\n",
       expression->id);
     fputs(div_begin, f);
-    free(div_begin);
+    SL_FREE(div_begin);
   }
   {
     char *id_label;
     asprintf(&id_label, "<h3><code>%u:</code> Expression</h3>\n",
       expression->id);
     fputs(id_label, f);
-    free(id_label);
+    SL_FREE(id_label);
   }
   {
     char *path = sl_string_from_symbol_path(state, expression->path);
     char *path_label;
     asprintf(&path_label, "<h4>Path: <code>%s</code></h4>\n", path);
     fputs(path_label, f);
-    free(path);
-    free(path_label);
+    SL_FREE(path);
+    SL_FREE(path_label);
   }
   {
     const sl_SymbolPath *type_path
@@ -341,8 +664,8 @@ html_render_expression(const sl_LogicState *state,
       "<h4>Type: <code><a href=\"#sym-%u\">%s</a></code></h4>\n",
       expression->type_id, expr_type);
     fputs(type_label, f);
-    free(expr_type);
-    free(type_label);
+    SL_FREE(expr_type);
+    SL_FREE(type_label);
   }
   if (ARR_LENGTH(expression->parameters) > 0)
   {
@@ -362,9 +685,9 @@ html_render_expression(const sl_LogicState *state,
         logic_state_get_string(state, param->name_id),
         param->type_id, param_type, param_str);
       fputs(param_label, f);
-      free(param_type);
-      free(param_str);
-      free(param_label);
+      SL_FREE(param_type);
+      SL_FREE(param_str);
+      SL_FREE(param_label);
     }
     fputs("</ol>\n", f);
   }
@@ -376,9 +699,9 @@ html_render_expression(const sl_LogicState *state,
         abbreviates_str, abbreviates_latex);
     fputs("<h4>Abbreviates:</h4>\n", f);
     fputs(abbreviates_label, f);
-    free(abbreviates_label);
-    free(abbreviates_str);
-    free(abbreviates_latex);
+    SL_FREE(abbreviates_label);
+    SL_FREE(abbreviates_str);
+    SL_FREE(abbreviates_latex);
   }
   if (expression->has_latex)
   {
@@ -386,8 +709,8 @@ html_render_expression(const sl_LogicState *state,
     char *latex_label;
     asprintf(&latex_label, "<h4>LaTeX: \\(%s\\)</h4>\n", latex);
     fputs(latex_label, f);
-    free(latex);
-    free(latex_label);
+    SL_FREE(latex);
+    SL_FREE(latex_label);
   }
   fputs("</div>\n", f);
   return 0;
@@ -401,7 +724,7 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
     char *div_begin;
     asprintf(&div_begin, "<div class=\"symbol\" id=\"sym-%u\">\n", theorem->id);
     fputs(div_begin, f);
-    free(div_begin);
+    SL_FREE(div_begin);
   }
   {
     char *id_label;
@@ -410,7 +733,7 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
     else
       asprintf(&id_label, "<h3><code>%u:</code> Theorem</h3>\n", theorem->id);
     fputs(id_label, f);
-    free(id_label);
+    SL_FREE(id_label);
   }
   {
     char *path = sl_string_from_symbol_path(state, theorem->path);
@@ -418,8 +741,8 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
     asprintf(&path_label, "<h4>Path: <code><a href=\"./symbols/theorem-%u.html\">%s</a></code></h4>\n",
       theorem->id, path);
     fputs(path_label, f);
-    free(path);
-    free(path_label);
+    SL_FREE(path);
+    SL_FREE(path_label);
   }
   if (ARR_LENGTH(theorem->requirements) > 0) {
     fputs("<h4>Requirements:</h4>\n", f);
@@ -437,9 +760,9 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
             asprintf(&arg_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
               arg_str, arg_latex);
             fputs(arg_label, f);
-            free(arg_str);
-            free(arg_latex);
-            free(arg_label);
+            SL_FREE(arg_str);
+            SL_FREE(arg_latex);
+            SL_FREE(arg_label);
           }
           fputs("</ul></li>\n", f);
           break;
@@ -455,6 +778,8 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
           break;
         case RequirementTypeUnused:
           break;
+        case RequirementTypeSuccessor:
+          break;
       }
     }
     fputs("</ul>\n", f);
@@ -477,9 +802,9 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
           logic_state_get_string(state, param->name_id),
           param->type_id, param_type, param_str);
       fputs(param_label, f);
-      free(param_type);
-      free(param_str);
-      free(param_label);
+      SL_FREE(param_type);
+      SL_FREE(param_str);
+      SL_FREE(param_label);
     }
     fputs("</ol>\n", f);
   }
@@ -496,9 +821,9 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
       asprintf(&assume_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
         assume_str, assume_latex);
       fputs(assume_label, f);
-      free(assume_str);
-      free(assume_latex);
-      free(assume_label);
+      SL_FREE(assume_str);
+      SL_FREE(assume_latex);
+      SL_FREE(assume_label);
 
     }
     fputs("</ul>\n", f);
@@ -516,9 +841,9 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
       asprintf(&infer_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
         infer_str, infer_latex);
       fputs(infer_label, f);
-      free(infer_str);
-      free(infer_latex);
-      free(infer_label);
+      SL_FREE(infer_str);
+      SL_FREE(infer_latex);
+      SL_FREE(infer_label);
     }
     fputs("</ul>\n", f);
   }
@@ -526,17 +851,10 @@ html_render_theorem(const sl_LogicState *state, const struct Theorem *theorem,
   return 0;
 }
 
-int
-html_render_all_page(const sl_LogicState *state, const char *filepath)
+static int
+html_write_all_content(FILE *f, struct sl_HTMLFileInfo *info)
 {
-  FILE *f = fopen(filepath, "w");
-  if (f == NULL)
-    return 1;
-  {
-    char *head = html_head("All Symbols");
-    fputs(head, f);
-    free(head);
-  }
+  const sl_LogicState *state = info->state;
   fputs("<h1>All Symbols</h1>\n", f);
 
   /* Print out all the symbols. */
@@ -552,12 +870,24 @@ html_render_all_page(const sl_LogicState *state, const char *filepath)
     else if (sym->type == sl_LogicSymbolType_Theorem)
       html_render_theorem(state, (struct Theorem *)sym->object, f);
   }
-
-  fputs(HTML_END, f);
-  fclose(f);
   return 0;
 }
 
+int
+html_render_all_page(struct HTMLSite *site, struct HTMLPageBuffer *buffer)
+{
+  char filepath[1024];
+  struct sl_HTMLFileInfo file_info;
+  snprintf(filepath, 1024, "%s/all.html", site->output_dir);
+  file_info.output_path = filepath;
+  file_info.page_name = "All Symbols";
+  file_info.content = &html_write_all_content;
+  file_info.state = site->state;
+  file_info.userdata = NULL;
+  return sl_update_html_file(NULL, &file_info, buffer,
+    site->output_dir, "all.html", &site->old_manifest, &site->manifest);
+}
+
 static void render_symbol_count(const sl_LogicState *state,
   sl_LogicSymbolType type, const char *type_name_plural, FILE *out)
 {
@@ -566,18 +896,23 @@ static void render_symbol_count(const sl_LogicState *state,
   asprintf(&symbols_string, "<li><p>%zu %s.</p></li>\n", symbols_n,
     type_name_plural);
   fputs(symbols_string, out);
-  free(symbols_string);
+  SL_FREE(symbols_string);
 }
 
-static int html_render_index_page(const sl_LogicState *state,
-  const char *filepath)
+static int html_render_index_page(struct HTMLSite *site,
+  struct HTMLPageBuffer *buffer)
 {
+  char filepath[1024];
   struct sl_HTMLFileInfo file_info;
+  snprintf(filepath, 1024, "%s/index.html", site->output_dir);
   file_info.output_path = filepath;
   file_info.page_name = "Index";
   file_info.content = NULL;
+  file_info.state = site->state;
   file_info.userdata = NULL;
-  sl_generate_full_html_file(&file_info);
+  int err = sl_update_html_file(site->template, &file_info, buffer,
+    site->output_dir, "index.html", &site->old_manifest, &site->manifest);
+  PROPAGATE_ERROR(err);
 #if 0
   FILE *f = fopen(filepath, "w");
   if (f == NULL)
@@ -585,7 +920,7 @@ static int html_render_index_page(const sl_LogicState *state,
   {
     char *head = html_head("Index");
     fputs(head, f);
-    free(head);
+    SL_FREE(head);
   }
   fputs("<h1>Index of Logic Database</h1>\n", f);
 
@@ -597,7 +932,7 @@ static int html_render_index_page(const sl_LogicState *state,
       size_t symbols_n = sl_logic_count_symbols(state);
       asprintf(&symbols_string, "<li><p>%zu symbol(s).</p></li>\n", symbols_n);
       fputs(symbols_string, f);
-      free(symbols_string);
+      SL_FREE(symbols_string);
     }
     render_symbol_count(state, sl_LogicSymbolType_Namespace,
         "namespace(s)", f);
@@ -620,18 +955,8 @@ static int html_render_index_page(const sl_LogicState *state,
 
 int
 html_render_theorem_page(const sl_LogicState *state,
-  const struct Theorem *theorem, const char *filepath)
+  const struct Theorem *theorem, FILE *f)
 {
-  FILE *f = fopen(filepath, "w");
-  if (f == NULL)
-    return 1;
-  {
-    char *head = html_head(sl_get_symbol_path_last_segment(state,
-      theorem->path));
-    fputs(head, f);
-    free(head);
-  }
-
   {
     char *id_label;
     if (theorem->is_axiom)
@@ -639,15 +964,15 @@ html_render_theorem_page(const sl_LogicState *state,
     else
       asprintf(&id_label, "<h1><code>%u:</code> Theorem</h1>\n", theorem->id);
     fputs(id_label, f);
-    free(id_label);
+    SL_FREE(id_label);
   }
   {
     char *path = sl_string_from_symbol_path(state, theorem->path);
     char *path_label;
     asprintf(&path_label, "<h2>Path: <code>%s</code></h2>\n", path);
     fputs(path_label, f);
-    free(path);
-    free(path_label);
+    SL_FREE(path);
+    SL_FREE(path_label);
   }
   if (ARR_LENGTH(theorem->parameters))
   {
@@ -667,9 +992,9 @@ html_render_theorem_page(const sl_LogicState *state,
           logic_state_get_string(state, param->name_id),
           param->type_id, param_type, param_str);
       fputs(param_label, f);
-      free(param_type);
-      free(param_str);
-      free(param_label);
+      SL_FREE(param_type);
+      SL_FREE(param_str);
+      SL_FREE(param_label);
     }
     fputs("</ol>\n", f);
   }
@@ -686,9 +1011,9 @@ html_render_theorem_page(const sl_LogicState *state,
       asprintf(&assume_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
         assume_str, assume_latex);
       fputs(assume_label, f);
-      free(assume_str);
-      free(assume_latex);
-      free(assume_label);
+      SL_FREE(assume_str);
+      SL_FREE(assume_latex);
+      SL_FREE(assume_label);
 
     }
     fputs("</ul>\n", f);
@@ -706,9 +1031,9 @@ html_render_theorem_page(const sl_LogicState *state,
       asprintf(&infer_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
         infer_str, infer_latex);
       fputs(infer_label, f);
-      free(infer_str);
-      free(infer_latex);
-      free(infer_label);
+      SL_FREE(infer_str);
+      SL_FREE(infer_latex);
+      SL_FREE(infer_label);
     }
     fputs("</ul>\n", f);
   }
@@ -727,8 +1052,8 @@ html_render_theorem_page(const sl_LogicState *state,
         asprintf(&path_label, "<h4>Path: <code><a href=\"../symbols/theorem-%u.html\">%s</a></code></h4>\n",
           ref->theorem->id, path);
         fputs(path_label, f);
-        free(path);
-        free(path_label);
+        SL_FREE(path);
+        SL_FREE(path_label);
       }
       fputs("<h4>Arguments: </h4>\n", f);
       fputs("<ol>\n", f);
@@ -741,9 +1066,9 @@ html_render_theorem_page(const sl_LogicState *state,
         asprintf(&arg_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
           arg_str, arg_latex);
         fputs(arg_label, f);
-        free(arg_str);
-        free(arg_latex);
-        free(arg_label);
+        SL_FREE(arg_str);
+        SL_FREE(arg_latex);
+        SL_FREE(arg_label);
       }
       fputs("</ol>\n", f);
       fputs("<h4>Inferred: </h4>\n", f);
@@ -758,7 +1083,7 @@ html_render_theorem_page(const sl_LogicState *state,
           struct Parameter *param = ARR_GET(ref->theorem->parameters, j);
 
           struct Argument arg;
-          arg.name = strdup(param->name);
+          arg.name = SL_STRDUP(param->name);
           arg.value = copy_value(*ARR_GET(ref->arguments, j));
 
           ARR_APPEND(args, arg);
@@ -775,9 +1100,9 @@ html_render_theorem_page(const sl_LogicState *state,
           asprintf(&proven_label, "<li><code>%s</code><br />\\(%s\\)</li>\n",
             proven_str, proven_latex);
           fputs(proven_label, f);
-          free(proven_str);
-          free(proven_latex);
-          free(proven_label);
+          SL_FREE(proven_str);
+          SL_FREE(proven_latex);
+          SL_FREE(proven_label);
         }
       }
       fputs("</ul>\n", f);
@@ -789,59 +1114,338 @@ html_render_theorem_page(const sl_LogicState *state,
   fputs("</div>\n", f);
 
   fputs("<a href=\"../index.html\">Index</a>", f);
-  fputs(HTML_END, f);
-  fclose(f);
   return 0;
 }
 
-int
-render_html(const sl_LogicState *state, const char *output_dir)
+static int
+html_write_theorem_content(FILE *f, struct sl_HTMLFileInfo *info)
 {
-  mkdir(output_dir, 0777); /* TODO: handle errors. */
+  return html_render_theorem_page(info->state,
+    (const struct Theorem *)info->userdata, f);
+}
+
+/* The inputs of a theorem page, for the manifest. This must cover
+   everything `html_render_theorem_page` reads. */
+static uint64_t
+hash_expression_rendering(const sl_LogicState *state,
+  const struct Expression *expr, uint64_t hash)
+{
+  hash = sl_hash_string(hash, sl_get_symbol_path_last_segment(state,
+    expr->path));
+  hash = sl_hash_uint64(hash, expr->has_latex);
+  if (expr->has_latex)
   {
-    char *style_dst, *style_src;
-    asprintf(&style_dst, "%s/style.css", output_dir);
-    asprintf(&style_src, "./res/style.css", style_src);
-    sl_copy_file(style_dst, style_src);
-    free(style_dst);
-    free(style_src);
+    hash = sl_hash_uint64(hash, ARR_LENGTH(expr->latex.segments));
+    for (size_t i = 0; i < ARR_LENGTH(expr->latex.segments); ++i)
+    {
+      const struct LatexFormatSegment *seg = ARR_GET(expr->latex.segments, i);
+      hash = sl_hash_uint64(hash, seg->is_variable);
+      hash = sl_hash_string(hash, seg->string);
+    }
+    hash = sl_hash_uint64(hash, ARR_LENGTH(expr->parameters));
+    for (size_t i = 0; i < ARR_LENGTH(expr->parameters); ++i)
+    {
+      const struct Parameter *param = ARR_GET(expr->parameters, i);
+      hash = sl_hash_string(hash, logic_state_get_string(state,
+        param->name_id));
+    }
   }
+  return hash;
+}
+
+/* A single node, without its arguments. */
+static uint64_t
+hash_value_node_rendering(const sl_LogicState *state, const Value *v,
+  uint64_t hash)
+{
+  hash = sl_hash_uint64(hash, v->value_type);
+  switch (v->value_type)
   {
-    char symbol_dir[1024];
-    snprintf(symbol_dir, 1024, "%s/symbols", output_dir);
-    mkdir(symbol_dir, 0777); /* TODO: handle errors. */
+    case ValueTypeDummy:
+      hash = sl_hash_uint64(hash, v->content.dummy_id);
+      break;
+    case ValueTypeConstant:
+      hash = sl_hash_string(hash, sl_get_symbol_path_last_segment(state,
+        v->content.constant.constant_path));
+      hash = sl_hash_uint64(hash, v->content.constant.constant_latex != NULL);
+      if (v->content.constant.constant_latex != NULL)
+        hash = sl_hash_string(hash, v->content.constant.constant_latex);
+      break;
+    case ValueTypeVariable:
+      hash = sl_hash_string(hash, logic_state_get_string(state,
+        v->content.variable_name_id));
+      break;
+    case ValueTypeNumeral:
+      hash = sl_natural_hash(hash, v->content.numeral);
+      break;
+    case ValueTypeComposition:
+      {
+        const sl_LogicSymbol *expr_sym = sl_logic_get_const_symbol_by_id(
+          state, v->content.composition.expression_id);
+        hash = sl_hash_uint64(hash, v->content.composition.expression_id);
+        hash = hash_expression_rendering(state,
+          (const struct Expression *)expr_sym->object, hash);
+        hash = sl_hash_uint64(hash,
+          ARR_LENGTH(v->content.composition.arguments));
+      }
+      break;
+  }
+  return hash;
+}
+
+/* The nodes in prefix order, walked with a stack since statements can be
+   nested too deeply to recurse. */
+static uint64_t
+hash_value_rendering(const sl_LogicState *state, const Value *v,
+  uint64_t hash)
+{
+  struct ValueWalk walk;
+  init_value_walk(&walk);
+  push_value_frame(&walk, v);
+  while (walk.length > 0)
+  {
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    hash = hash_value_node_rendering(state, node, hash);
+    for (size_t i = VALUE_ARITY(node); i > 0; --i)
+      push_value_frame(&walk, VALUE_ARGUMENT(node, i - 1));
   }
+  free_value_walk(&walk);
+  return hash;
+}
+
+static uint64_t
+hash_theorem_page(const sl_LogicState *state, const struct Theorem *theorem)
+{
+  uint64_t hash = sl_hash_uint64(SL_HASH_INIT, HTML_RENDER_VERSION);
+  hash = sl_hash_uint64(hash, theorem->id);
+  hash = sl_hash_uint64(hash, theorem->is_axiom);
   {
-    char index_path[1024];
-    snprintf(index_path, 1024, "%s/index.html", output_dir);
-    int err = html_render_index_page(state, index_path);
-    PROPAGATE_ERROR(err);
+    char *path = sl_string_from_symbol_path(state, theorem->path);
+    hash = sl_hash_string(hash, path);
+    SL_FREE(path);
   }
+  hash = sl_hash_uint64(hash, ARR_LENGTH(theorem->parameters));
+  for (size_t i = 0; i < ARR_LENGTH(theorem->parameters); ++i)
   {
-    char all_path[1024];
-    snprintf(all_path, 1024, "%s/all.html", output_dir);
-    int err = html_render_all_page(state, all_path);
-    PROPAGATE_ERROR(err);
+    const struct Parameter *param = ARR_GET(theorem->parameters, i);
+    char *type_path = sl_string_from_symbol_path(state,
+      sl_logic_get_symbol_path_by_id(state, param->type_id));
+    hash = sl_hash_string(hash, logic_state_get_string(state,
+      param->name_id));
+    hash = sl_hash_uint64(hash, param->type_id);
+    hash = sl_hash_string(hash, type_path);
+    SL_FREE(type_path);
+  }
+  hash = sl_hash_uint64(hash, ARR_LENGTH(theorem->assumptions));
+  for (size_t i = 0; i < ARR_LENGTH(theorem->assumptions); ++i)
+    hash = hash_value_rendering(state, *ARR_GET(theorem->assumptions, i), hash);
+  hash = sl_hash_uint64(hash, ARR_LENGTH(theorem->inferences));
+  for (size_t i = 0; i < ARR_LENGTH(theorem->inferences); ++i)
+    hash = hash_value_rendering(state, *ARR_GET(theorem->inferences, i), hash);
+  return hash;
+}
+
+/* Theorem pages are independent of each other, so they are rendered by a
+   pool of threads that share the (read-only) logic state. */
+struct HTMLPage
+{
+  const struct Theorem *theorem;
+  char *path;
+};
+
+struct HTMLPagePool
+{
+  const sl_LogicState *state;
+  ARR(struct HTMLPage) pages;
+  atomic_size_t next_page;
+  atomic_int error;
+};
+
+static void *
+html_render_pages(void *userdata)
+{
+  struct HTMLPagePool *pool = (struct HTMLPagePool *)userdata;
+  struct HTMLPageBuffer buffer;
+
+  /* Each thread has its own page buffer. */
+  if (init_page_buffer(&buffer) != 0)
+  {
+    atomic_store(&pool->error, 1);
+    return NULL;
   }
+  while (1)
+  {
+    size_t i = atomic_fetch_add(&pool->next_page, 1);
+    if (i >= ARR_LENGTH(pool->pages))
+      break;
+    const struct HTMLPage *page = ARR_GET(pool->pages, i);
+    struct sl_HTMLFileInfo file_info;
+    file_info.output_path = page->path;
+    file_info.page_name = sl_get_symbol_path_last_segment(pool->state,
+      page->theorem->path);
+    file_info.content = &html_write_theorem_content;
+    file_info.state = pool->state;
+    file_info.userdata = page->theorem;
+
+    sl_trace_begin("page", page->path);
+    if (sl_generate_full_html_file(NULL, &file_info, &buffer) != 0)
+      atomic_store(&pool->error, 1);
+    sl_trace_end();
+  }
+  free_page_buffer(&buffer);
+  return NULL;
+}
+
+static int
+html_render_theorem_pages(struct HTMLSite *site, unsigned int jobs)
+{
+  const sl_LogicState *state = site->state;
+  struct HTMLPagePool pool;
+  pool.state = state;
+  ARR_INIT(pool.pages);
+  atomic_init(&pool.next_page, 0);
+  atomic_init(&pool.error, 0);
   for (size_t i = 0; i < ARR_LENGTH(state->symbol_table); ++i)
   {
     const sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
-    char page_path[1024];
     if (sym->type == sl_LogicSymbolType_Theorem)
     {
-      const struct Theorem *thm = (struct Theorem *)sym->object;
-      snprintf(page_path, 1024, "%s/symbols/theorem-%zu.html",
-        output_dir, thm->id);
-      html_render_theorem_page(state, thm, page_path);
+      struct HTMLPage page;
+      char name[64];
+      uint64_t hash;
+      page.theorem = (struct Theorem *)sym->object;
+      snprintf(name, 64, "symbols/theorem-%u.html", page.theorem->id);
+      hash = hash_theorem_page(state, page.theorem);
+      add_manifest_entry(&site->manifest, name, hash);
+      if (page_up_to_date(&site->old_manifest, site->output_dir, name, hash))
+        continue;
+      asprintf(&page.path, "%s/%s", site->output_dir, name);
+      ARR_APPEND(pool.pages, page);
+    }
+  }
+
+  if (jobs == 0)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = (cpus > 0) ? (unsigned int)cpus : 1;
+  }
+  if (jobs > ARR_LENGTH(pool.pages))
+    jobs = ARR_LENGTH(pool.pages);
+
+  if (jobs <= 1)
+  {
+    html_render_pages(&pool);
+  }
+  else
+  {
+    pthread_t *threads = SL_MALLOC(sizeof(pthread_t) * jobs);
+    unsigned int started = 0;
+    for (; started < jobs; ++started)
+    {
+      if (pthread_create(&threads[started], NULL, &html_render_pages,
+          &pool) != 0)
+        break;
+    }
+    /* If no thread could be started, render everything here. */
+    if (started == 0)
+      html_render_pages(&pool);
+    for (unsigned int i = 0; i < started; ++i)
+      pthread_join(threads[i], NULL);
+    SL_FREE(threads);
+  }
+
+  for (size_t i = 0; i < ARR_LENGTH(pool.pages); ++i)
+    SL_FREE(ARR_GET(pool.pages, i)->path);
+  ARR_FREE(pool.pages);
+  return atomic_load(&pool.error);
+}
+
+static int
+copy_file_if_changed(const char *dst_path, const char *src_path)
+{
+  int err = 0;
+  char *src = read_file(src_path);
+  char *dst = read_file(dst_path);
+  if (src == NULL || dst == NULL || strcmp(src, dst) != 0)
+    err = sl_copy_file(dst_path, src_path);
+  SL_FREE(src);
+  SL_FREE(dst);
+  return err;
+}
+
+static int
+write_html_site(const sl_LogicState *state, const char *output_dir,
+  unsigned int jobs)
+{
+  mkdir(output_dir, 0777); /* TODO: handle errors. */
+  {
+    char *style_dst;
+    int err;
+    asprintf(&style_dst, "%s/style.css", output_dir);
+    err = copy_file_if_changed(style_dst, HTML_STYLESHEET);
+    if (err != 0)
+      fprintf(stderr, "Cannot copy the stylesheet '%s' to '%s'.\n",
+          HTML_STYLESHEET, style_dst);
+    SL_FREE(style_dst);
+    PROPAGATE_ERROR(err);
+  }
+  {
+    char symbol_dir[1024];
+    snprintf(symbol_dir, 1024, "%s/symbols", output_dir);
+    mkdir(symbol_dir, 0777); /* TODO: handle errors. */
+  }
+
+  /* The template is compiled once, and shared by the pages made from it. */
+  struct HTMLSite site;
+  site.state = state;
+  site.output_dir = output_dir;
+  site.template = sl_load_page_template();
+  if (site.template == NULL)
+    return 1;
+  load_manifest(&site.old_manifest, output_dir);
+  ARR_INIT(site.manifest);
+  {
+    struct HTMLPageBuffer buffer;
+    int err = init_page_buffer(&buffer);
+    if (err == 0)
+    {
+      err = html_render_index_page(&site, &buffer);
+      if (err == 0)
+        err = html_render_all_page(&site, &buffer);
+      free_page_buffer(&buffer);
     }
-    /*if (sym->type == SymbolTypeType)
-      html_render_type((struct Type *)sym->object, f);
-    else if (sym->type == SymbolTypeConstant)
-      html_render_constant((struct Constant *)sym->object, f);
-    else if (sym->type == SymbolTypeExpression)
-      html_render_expression((struct Expression *)sym->object, f);*/
-    /*if (sym->type == SymbolTypeTheorem)
-      html_render_theorem_page((struct Theorem *)sym->object, f);*/
+    if (err == 0)
+      err = html_render_theorem_pages(&site, jobs);
+
+    /* Only record the pages if they were all generated, so that a failed
+       run is redone in full next time. */
+    if (err == 0)
+      err = update_manifest(&site.manifest, &site.old_manifest, output_dir);
+    free_manifest(&site.old_manifest);
+    free_manifest(&site.manifest);
+    sl_free_html_template((sl_HTMLTemplate *)site.template);
+    PROPAGATE_ERROR(err);
   }
   return 0;
 }
+
+int
+render_html(const sl_LogicState *state, const char *output_dir,
+  unsigned int jobs)
+{
+  int err;
+  sl_trace_begin("render", "html");
+  sl_profile_begin(sl_ProfilePhase_Render);
+
+  /* The same statements appear on many pages, and in both HTML and LaTeX. */
+  sl_RenderCache *cache = sl_new_render_cache();
+  sl_set_active_render_cache(cache);
+  err = write_html_site(state, output_dir, jobs);
+  sl_set_active_render_cache(NULL);
+  sl_free_render_cache(cache);
+
+  sl_profile_end();
+  sl_trace_end();
+  return err;
+}
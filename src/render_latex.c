@@ -1,6 +1,11 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Renderer
 #include "render.h"
+#include "profile.h"
+#include "render_cache.h"
+#include "trace.h"
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #define LATEX_BEGIN \
   "\\documentclass[10pt,letterpaper]{article}\n" \
@@ -36,13 +41,23 @@ render_theorem(FILE *out)
 int
 render_latex(const sl_LogicState *state, const char *output_filename)
 {
+  sl_trace_begin("render", "latex");
+  sl_profile_begin(sl_ProfilePhase_Render);
   FILE *f = fopen(output_filename, "w");
+  if (f == NULL)
+  {
+    sl_profile_end();
+    sl_trace_end();
+    return 1;
+  }
   fputs(LATEX_BEGIN, f);
 
   render_theorem(f); /* TODO: tmp. */
 
   fputs(LATEX_END, f);
   fclose(f);
+  sl_profile_end();
+  sl_trace_end();
   return 0;
 }
 
@@ -105,67 +120,121 @@ struct SubstitutionMap greek_letters[] = {
   { "Omega", "\\Omega" }
 };
 
-static char *
-do_substitution(const char *src, struct SubstitutionMap map)
+/* The keys of `greek_letters`, as a trie over ASCII letters so that a word
+   can be looked up in a single scan. Built once, on first use. */
+#define LATEX_TRIE_ALPHABET 52
+
+struct LatexTrieNode
 {
-  /* First calculate the the length. */
-  size_t len = 1;
-  const char *c = src;
-  while (*c != '\0')
+  /* Node indices; 0 (the root) means there is no child. */
+  unsigned short children[LATEX_TRIE_ALPHABET];
+  /* Index into `greek_letters`, or -1. */
+  short substitution;
+};
+
+static struct LatexTrieNode *latex_trie = NULL;
+static pthread_once_t latex_trie_once = PTHREAD_ONCE_INIT;
+
+static int
+latex_trie_letter(char c)
+{
+  if (c >= 'a' && c <= 'z')
+    return c - 'a';
+  else if (c >= 'A' && c <= 'Z')
+    return 26 + (c - 'A');
+  return -1;
+}
+
+static void
+build_latex_trie()
+{
+  const size_t n_substitutions =
+    sizeof(greek_letters) / sizeof(struct SubstitutionMap);
+  size_t max_nodes = 1;
+  for (size_t i = 0; i < n_substitutions; ++i)
+    max_nodes += strlen(greek_letters[i].dst);
+
+  latex_trie = SL_MALLOC(sizeof(struct LatexTrieNode) * max_nodes);
+  memset(&latex_trie[0], 0, sizeof(struct LatexTrieNode));
+  latex_trie[0].substitution = -1;
+  size_t n_nodes = 1;
+  for (size_t i = 0; i < n_substitutions; ++i)
   {
-    if (c == src && strncmp(c, map.dst, strlen(map.dst)) == 0
-      && !isalpha(c[strlen(map.dst)]))
-    {
-      len += strlen(map.src);
-      c += strlen(map.dst);
-    }
-    else if (c != src && strncmp(c, map.dst, strlen(map.dst)) == 0
-      && !isalpha(c[-1]) && *(c - 1) != '\\' && !isalpha(c[strlen(map.dst)]))
-    {
-      len += strlen(map.src);
-      c += strlen(map.dst);
-    }
-    else
+    size_t node = 0;
+    for (const char *c = greek_letters[i].dst; *c != '\0'; ++c)
     {
-      len += 1;
-      ++c;
+      int letter = latex_trie_letter(*c);
+      if (latex_trie[node].children[letter] == 0)
+      {
+        memset(&latex_trie[n_nodes], 0, sizeof(struct LatexTrieNode));
+        latex_trie[n_nodes].substitution = -1;
+        latex_trie[node].children[letter] = n_nodes;
+        ++n_nodes;
+      }
+      node = latex_trie[node].children[letter];
     }
+    latex_trie[node].substitution = i;
+  }
+}
+
+static const struct SubstitutionMap *
+find_substitution(const char *word, size_t length)
+{
+  size_t node = 0;
+  for (size_t i = 0; i < length; ++i)
+  {
+    int letter = latex_trie_letter(word[i]);
+    if (letter < 0 || latex_trie[node].children[letter] == 0)
+      return NULL;
+    node = latex_trie[node].children[letter];
   }
+  if (latex_trie[node].substitution < 0)
+    return NULL;
+  return &greek_letters[latex_trie[node].substitution];
+}
 
-  char *dst = malloc(len);
-  c = src;
-  char *write_to = dst;
+/* Replaces every whole word of `src` that is a key of `greek_letters` and is
+   not preceded by a backslash. Writes the result to `dst` if it is not NULL,
+   and returns its length. */
+static size_t
+substitute_words(const char *src, char *dst, bool *substituted)
+{
+  size_t len = 0;
+  const char *c = src;
   while (*c != '\0')
   {
-    if (c == src && strncmp(c, map.dst, strlen(map.dst)) == 0
-      && !isalpha(c[strlen(map.dst)]))
-    {
-      strcpy(write_to, map.src);
-      c += strlen(map.dst);
-      write_to += strlen(map.src);
-    }
-    else if (c != src && strncmp(c, map.dst, strlen(map.dst)) == 0
-      && !isalpha(c[-1]) && *(c - 1) != '\\' && !isalpha(c[strlen(map.dst)]))
-    {
-      strcpy(write_to, map.src);
-      c += strlen(map.dst);
-      write_to += strlen(map.src);
-    }
-    else
+    if (!isalpha(*c))
     {
-      *write_to = *c;
+      if (dst != NULL)
+        dst[len] = *c;
+      ++len;
       ++c;
-      ++write_to;
+      continue;
     }
+
+    const char *word = c;
+    while (isalpha(*c))
+      ++c;
+    const struct SubstitutionMap *map = NULL;
+    if (word == src || word[-1] != '\\')
+      map = find_substitution(word, c - word);
+    const char *replace_with = (map != NULL) ? map->src : word;
+    size_t replace_len = (map != NULL) ? strlen(map->src) : (size_t)(c - word);
+    if (map != NULL)
+      *substituted = TRUE;
+    if (dst != NULL)
+      memcpy(dst + len, replace_with, replace_len);
+    len += replace_len;
   }
-  *write_to = '\0';
-  return dst;
+  if (dst != NULL)
+    dst[len] = '\0';
+  return len;
 }
 
 char *
 latex_render_string(const char *src)
 {
-  char *dst = malloc(strlen(src) + 1);
+  char *dst = SL_MALLOC(strlen(src) + 1);
   char *dst_ptr = dst;
   bool in_escape = FALSE;
   for (const char *c = src; *c != '\0'; ++c)
@@ -191,15 +260,16 @@ latex_render_string(const char *src)
   }
   *dst_ptr = '\0';
 
-  for (size_t i = 0; i < sizeof(greek_letters) / sizeof(struct SubstitutionMap);
-    ++i)
-  {
-    char *result = do_substitution(dst, greek_letters[i]);
-    free(dst);
-    dst = result;
-  }
-
-  return dst;
+  /* Measure first, and only allocate again if a word was replaced. */
+  pthread_once(&latex_trie_once, &build_latex_trie);
+  bool substituted = FALSE;
+  size_t len = substitute_words(dst, NULL, &substituted);
+  if (!substituted)
+    return dst;
+  char *result = SL_MALLOC(len + 1);
+  substitute_words(dst, result, &substituted);
+  SL_FREE(dst);
+  return result;
 }
 
 char *
@@ -215,121 +285,132 @@ char *
 latex_render_expression(const sl_LogicState *state, const struct Expression *e)
 {
   char *result;
-  ARR(char *) segments;
-  ARR_INIT(segments);
   size_t len = 1;
   for (size_t i = 0; i < ARR_LENGTH(e->latex.segments); ++i)
   {
     const struct LatexFormatSegment *seg = ARR_GET(e->latex.segments, i);
-    char *str = latex_render_string(seg->string);
-    ARR_APPEND(segments, str);
-    len += strlen(str);
+    len += strlen(seg->latex);
   }
-  result = malloc(len);
+  result = SL_MALLOC(len);
   char *result_ptr = result;
-  for (size_t i = 0; i < ARR_LENGTH(segments); ++i)
+  for (size_t i = 0; i < ARR_LENGTH(e->latex.segments); ++i)
   {
-    char *seg = *ARR_GET(segments, i);
-    strcpy(result_ptr, seg);
-    result_ptr += strlen(seg);
+    const struct LatexFormatSegment *seg = ARR_GET(e->latex.segments, i);
+    strcpy(result_ptr, seg->latex);
+    result_ptr += strlen(seg->latex);
   }
   *result_ptr = '\0';
-  for (size_t i = 0; i < ARR_LENGTH(segments); ++i) {
-    char *seg = *ARR_GET(segments, i);
-    free(seg);
-  }
-  ARR_FREE(segments);
   return result;
 }
 
-char *
-latex_render_value(const sl_LogicState *state, const Value *v)
+static void
+latex_write_value_leaf(const sl_LogicState *state, const Value *v,
+  sl_StringBuilder *out)
 {
+  char *str = NULL;
   switch (v->value_type)
   {
     case ValueTypeDummy:
       {
-        char *str, *result;
-        asprintf(&str, "D_{%u}", v->content.dummy_id);
-        result = latex_render_string(str);
-        free(str);
-        return result;
+        char *dummy;
+        asprintf(&dummy, "D_{%u}", v->content.dummy_id);
+        str = latex_render_string(dummy);
+        SL_FREE(dummy);
       }
       break;
     case ValueTypeConstant:
       if (v->content.constant.constant_latex != NULL)
-        return latex_render_string(v->content.constant.constant_latex);
+        str = latex_render_string(v->content.constant.constant_latex);
       else
-        return latex_render_string(sl_get_symbol_path_last_segment(state,
+        str = latex_render_string(sl_get_symbol_path_last_segment(state,
             v->content.constant.constant_path));
       break;
     case ValueTypeVariable:
-      return latex_render_string(logic_state_get_string(state,
+      str = latex_render_string(logic_state_get_string(state,
           v->content.variable_name_id));
       break;
+    case ValueTypeNumeral:
+      str = sl_natural_to_string(v->content.numeral);
+      break;
     case ValueTypeComposition:
-      const sl_LogicSymbol *expr_sym;
-      const struct Expression *expr;
-      expr_sym = sl_logic_get_symbol_by_id(state,
-          v->content.composition.expression_id);
-      expr = (struct Expression *)expr_sym->object;
-      if (expr->has_latex)
-      {
-        char *result;
-        ARR(char *) segments;
-        ARR_INIT(segments);
-        size_t len = 1;
-        for (size_t i = 0; i < ARR_LENGTH(expr->latex.segments); ++i)
-        {
-          const struct LatexFormatSegment *seg =
-            ARR_GET(expr->latex.segments, i);
-          char *str;
-          if (seg->is_variable)
-          {
-            /* Find the corresponding argument. */
-            size_t arg_index;
-            for (size_t j = 0; j < ARR_LENGTH(expr->parameters); ++j)
-            {
-              const struct Parameter *param =
-                ARR_GET(expr->parameters, j);
-              if (strcmp(logic_state_get_string(state, param->name_id),
-                  seg->string) == 0)
-              {
-                arg_index = j;
-                break;
-              }
-            }
-            Value *arg = *ARR_GET(v->content.composition.arguments, arg_index);
-            str = latex_render_value(state, arg);
-          }
-          else
-          {
-            str = latex_render_string(seg->string);
-          }
-          ARR_APPEND(segments, str);
-          len += strlen(str);
-        }
-        result = malloc(len);
-        char *result_ptr = result;
-        for (size_t i = 0; i < ARR_LENGTH(segments); ++i)
-        {
-          char *seg = *ARR_GET(segments, i);
-          strcpy(result_ptr, seg);
-          result_ptr += strlen(seg);
-        }
-        *result_ptr = '\0';
-        for (size_t i = 0; i < ARR_LENGTH(segments); ++i)
-        {
-          char *seg = *ARR_GET(segments, i);
-          free(seg);
-        }
-        ARR_FREE(segments);
-        return result;
-      }
-      else
-      {
-        return strdup("");
-      }
       break;
   }
+  if (str != NULL)
+  {
+    sl_string_builder_append(out, str);
+    SL_FREE(str);
+  }
+}
+
+/* The compiled LaTeX format of the expression of a composition, or NULL if
+   it has none, in which case the composition renders as nothing. */
+static const struct Expression *
+latex_format_expression(const sl_LogicState *state, const Value *v)
+{
+  if (!(SYMBOL_FLAGS(state, v->content.composition.expression_id)
+      & SYMBOL_LATEX))
+    return NULL;
+  return (struct Expression *)sl_logic_get_const_symbol_by_id(state,
+      v->content.composition.expression_id)->object;
+}
+
+/* Walks the value with an explicit stack, in which each frame is a
+   composition and `next` is the next segment of its format. The segments
+   are written as they are reached, so the value is written in one pass
+   however deep it is. */
+static void
+latex_write_value(const sl_LogicState *state, const Value *v,
+  sl_StringBuilder *out)
+{
+  struct ValueWalk walk;
+  if (v->value_type != ValueTypeComposition)
+  {
+    latex_write_value_leaf(state, v, out);
+    return;
+  }
+  if (latex_format_expression(state, v) == NULL)
+    return;
+  init_value_walk(&walk);
+  push_value_frame(&walk, v);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    const struct Expression *expr = latex_format_expression(state,
+      top->value);
+    if (top->next >= ARR_LENGTH(expr->latex.segments))
+    {
+      VALUE_WALK_POP(&walk);
+      continue;
+    }
+    const struct LatexFormatSegment *seg =
+      ARR_GET(expr->latex.segments, top->next);
+    top->next += 1;
+    if (seg->argument_index < 0)
+    {
+      sl_string_builder_append(out, seg->latex);
+      continue;
+    }
+    const Value *arg = VALUE_ARGUMENT(top->value, seg->argument_index);
+    if (arg->value_type != ValueTypeComposition)
+      latex_write_value_leaf(state, arg, out);
+    else if (latex_format_expression(state, arg) != NULL)
+      push_value_frame(&walk, arg);
+  }
+  free_value_walk(&walk);
+}
+
+static char *
+latex_render_value_uncached(const sl_LogicState *state, const Value *v)
+{
+  sl_StringBuilder builder;
+  sl_string_builder_init(&builder);
+  latex_write_value(state, v, &builder);
+  return sl_string_builder_finish(&builder);
+}
+
+char *
+latex_render_value(const sl_LogicState *state, const Value *v)
+{
+  return sl_render_value_cached(state, v, sl_RenderFormat_Latex,
+    &latex_render_value_uncached);
 }
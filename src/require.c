@@ -1,100 +1,127 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Values
 #include "core.h"
+#include "profile.h"
+#include "trace.h"
 #include <string.h>
 
 /* --- Requirement Creation --- */
-int
-make_requirement(sl_LogicState *state,
-  struct Requirement *dst, const struct PrototypeRequirement *src)
+static void
+free_requirement_arguments(struct Requirement *req)
 {
-  ARR_INIT(dst->arguments);
-  for (Value **arg = src->arguments; *arg != NULL; ++arg)
-    ARR_APPEND(dst->arguments, copy_value(*arg));
+  for (size_t i = 0; i < ARR_LENGTH(req->arguments); ++i)
+    free_value(*ARR_GET(req->arguments, i));
+  ARR_FREE(req->arguments);
+}
 
-  /* Make sure that the number of arguments is correct. */
-  if (strcmp(src->require, "distinct") == 0)
+/* Sets the type of `dst`, whose arguments are already in place, making sure
+   that the number of arguments is correct. On failure, the arguments are
+   freed. */
+static int
+set_requirement_type(struct Requirement *dst, const char *require)
+{
+  if (strcmp(require, "distinct") == 0)
   {
     dst->type = RequirementTypeDistinct;
     if (ARR_LENGTH(dst->arguments) < 2)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
       return 1;
     }
   }
-  else if (strcmp(src->require, "free_for") == 0)
+  else if (strcmp(require, "free_for") == 0)
   {
     dst->type = RequirementTypeFreeFor;
     if (ARR_LENGTH(dst->arguments) != 3)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
       return 1;
     }
   }
-  else if (strcmp(src->require, "not_free") == 0)
+  else if (strcmp(require, "not_free") == 0)
   {
     dst->type = RequirementTypeNotFree;
     if (ARR_LENGTH(dst->arguments) != 2)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
       return 1;
     }
   }
-  else if (strcmp(src->require, "cover_free") == 0)
+  else if (strcmp(require, "cover_free") == 0)
   {
     dst->type = RequirementTypeCoverFree;
     if (ARR_LENGTH(dst->arguments) < 1)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
       return 1;
     }
   }
-  else if (strcmp(src->require, "substitution") == 0)
+  else if (strcmp(require, "substitution") == 0)
   {
     dst->type = RequirementTypeSubstitution;
     if (ARR_LENGTH(dst->arguments) != 4)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
       return 1;
     }
   }
-  else if (strcmp(src->require, "full_substitution") == 0)
+  else if (strcmp(require, "full_substitution") == 0)
   {
     dst->type = RequirementTypeFullSubstitution;
     if (ARR_LENGTH(dst->arguments) != 4)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
       return 1;
     }
   }
-  else if (strcmp(src->require, "unused") == 0)
+  else if (strcmp(require, "unused") == 0)
   {
     dst->type = RequirementTypeUnused;
     if (ARR_LENGTH(dst->arguments) != 1)
     {
-      for (size_t i = 0; i < ARR_LENGTH(dst->arguments); ++i)
-        free_value(*ARR_GET(dst->arguments, i));
-      ARR_FREE(dst->arguments);
+      free_requirement_arguments(dst);
+      return 1;
+    }
+  }
+  else if (strcmp(require, "successor") == 0)
+  {
+    dst->type = RequirementTypeSuccessor;
+    if (ARR_LENGTH(dst->arguments) != 2)
+    {
+      free_requirement_arguments(dst);
       return 1;
     }
   }
   else
   {
+    free_requirement_arguments(dst);
     return 1;
   }
   return 0;
 }
 
+int
+make_requirement(sl_LogicState *state,
+  struct Requirement *dst, const struct PrototypeRequirement *src)
+{
+  ARR_INIT(dst->arguments);
+  for (Value **arg = src->arguments; *arg != NULL; ++arg)
+    ARR_APPEND(dst->arguments, copy_value(*arg));
+  return set_requirement_type(dst, src->require);
+}
+
+int
+make_requirement_take(sl_LogicState *state,
+  struct Requirement *dst, struct PrototypeRequirement *src)
+{
+  ARR_INIT(dst->arguments);
+  for (Value **arg = src->arguments; *arg != NULL; ++arg)
+  {
+    ARR_APPEND(dst->arguments, *arg);
+    *arg = NULL;
+  }
+  return set_requirement_type(dst, src->require);
+}
+
 /* Note that not all cases are treated by this code, as many of them are
    nontrivial. However, each evaluation function only returns true when
    the corresponding statement is true. There are cases where a requirement
@@ -102,12 +129,120 @@ make_requirement(sl_LogicState *state,
    not impede the development of our logic. Since there are only false
    negatives, this only limits the scope of theorems that can be proved. */
 
+/* Most requirements hold of a value when they hold of each of its
+   arguments, so they are checked one node at a time by a step that decides
+   the node on its own, or leaves it to the node's arguments. Values are
+   walked with a stack rather than by recursion, as they can be very deep. */
+enum CheckStep
+{
+  CheckFails,
+  CheckHolds,
+  CheckDescend
+};
+
+typedef enum CheckStep (* CheckStepFunction)(const void *data,
+  const Value *value, const Value *other);
+
+/* The compositions enclosing the node being checked whose expressions bind
+   something, innermost last, for checks that look at what a node is bound
+   by without going up through every one of its parents. */
+struct BindingScopes
+{
+  const sl_LogicState *state;
+  ARR(const Value *) scopes;
+};
+
+static bool
+binds_anything(const sl_LogicState *state, const Value *value)
+{
+  return value->value_type == ValueTypeComposition
+    && SYMBOL_BINDER_COUNT(state, value->content.composition.expression_id)
+      > 0;
+}
+
+/* Starts with the scopes that enclose `value` itself. */
+static void
+init_binding_scopes(struct BindingScopes *scopes, const sl_LogicState *state,
+  const Value *value)
+{
+  scopes->state = state;
+  ARR_INIT(scopes->scopes);
+  for (const Value *scope = value->parent; scope != NULL;
+      scope = scope->parent) {
+    if (binds_anything(state, scope))
+      ARR_APPEND(scopes->scopes, scope);
+  }
+  for (size_t i = 0; i < ARR_LENGTH(scopes->scopes) / 2; ++i)
+  {
+    const Value **inner = ARR_GET(scopes->scopes, i);
+    const Value **outer = ARR_GET(scopes->scopes,
+      ARR_LENGTH(scopes->scopes) - 1 - i);
+    const Value *tmp = *inner;
+    *inner = *outer;
+    *outer = tmp;
+  }
+}
+
+static void
+free_binding_scopes(struct BindingScopes *scopes)
+{
+  ARR_FREE(scopes->scopes);
+}
+
+/* Runs `step` on each node of `value` it reaches, and on the node of
+   `other`, if not NULL, at the same place. The step only descends into a
+   node of `other` that has as many arguments. If `scopes` is not NULL, it is
+   kept up to date with the scopes enclosing each node as it is checked. */
+static bool
+check_throughout(const Value *value, const Value *other,
+  CheckStepFunction step, const void *data, struct BindingScopes *scopes)
+{
+  struct ValueWalk walk;
+  enum CheckStep result = step(data, value, other);
+  if (result != CheckDescend)
+    return result == CheckHolds;
+
+  init_value_walk(&walk);
+  push_value_frame(&walk, value)->other = other;
+  if (scopes != NULL && binds_anything(scopes->state, value))
+    ARR_APPEND(scopes->scopes, value);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next);
+      const Value *other_arg = (top->other != NULL)
+        ? VALUE_ARGUMENT(top->other, top->next) : NULL;
+      top->next += 1;
+      result = step(data, arg, other_arg);
+      if (result == CheckFails)
+        break;
+      else if (result == CheckDescend)
+      {
+        push_value_frame(&walk, arg)->other = other_arg;
+        if (scopes != NULL && binds_anything(scopes->state, arg))
+          ARR_APPEND(scopes->scopes, arg);
+      }
+    }
+    else
+    {
+      if (scopes != NULL && binds_anything(scopes->state, top->value))
+        scopes->scopes.length -= 1;
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+  return result != CheckFails;
+}
+
 /* --- Distinctness --- */
-static bool pair_distinct_in_env(const struct ProofEnvironment *env,
-    const Value *a, const Value *b)
+static enum CheckStep
+pair_distinct_step(const void *data, const Value *a, const Value *b)
 {
+  const struct ProofEnvironment *env = data;
   if (values_equal(a, b))
-    return FALSE;
+    return CheckFails;
   for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
   {
     const struct Requirement *req = ARR_GET(env->requirements, i);
@@ -127,42 +262,40 @@ static bool pair_distinct_in_env(const struct ProofEnvironment *env,
           break;
       }
       if (found_a && found_b)
-        return TRUE;
+        return CheckHolds;
     }
   }
   if (a->value_type != b->value_type)
-    return TRUE;
+    return CheckHolds;
   switch (a->value_type)
   {
     case ValueTypeDummy:
-      return !values_equal(a, b);
-      break;
     case ValueTypeConstant:
-      return !values_equal(a, b);
+    case ValueTypeNumeral:
+      return values_equal(a, b) ? CheckFails : CheckHolds;
       break;
     case ValueTypeVariable:
       /* If we did not establish the distinctness of these variables through
          another requirhements, then it is possible that they are the same. */
-      return FALSE;
+      return CheckFails;
       break;
     case ValueTypeComposition:
       if (ARR_LENGTH(a->content.composition.arguments)
           != ARR_LENGTH(b->content.composition.arguments))
-        return TRUE;
+        return CheckHolds;
       if (a->content.composition.expression_id
           != b->content.composition.expression_id)
-        return TRUE;
-      for (size_t i = 0; i < ARR_LENGTH(a->content.composition.arguments);
-          ++i) {
-        Value *arg_a, *arg_b;
-        arg_a = *ARR_GET(a->content.composition.arguments, i);
-        arg_b = *ARR_GET(b->content.composition.arguments, i);
-        if (!pair_distinct_in_env(env, arg_a, arg_b))
-          return FALSE;
-      }
+        return CheckHolds;
+      return CheckDescend;
       break;
   }
-  return TRUE;
+  return CheckHolds;
+}
+
+static bool pair_distinct_in_env(const struct ProofEnvironment *env,
+    const Value *a, const Value *b)
+{
+  return check_throughout(a, b, pair_distinct_step, env, NULL);
 }
 
 static bool evaluate_distinct(sl_LogicState *state,
@@ -184,163 +317,166 @@ static bool evaluate_distinct(sl_LogicState *state,
 }
 
 /* --- Free For --- */
-static bool value_gets_bound(const sl_LogicState *state,
-    const struct ProofEnvironment *env, const Value *source,
-    const Value *context)
+/* The value bound by the `index`th binding of the expression of `scope`.
+   When the binding is one of the expression's parameters, this is just the
+   argument for it; otherwise the binding is instantiated, and `*owned` is
+   set to tell the caller to free it. */
+static Value *
+scope_binding(const sl_LogicState *state, const Value *scope, size_t index,
+    bool *owned)
 {
+  uint32_t expr_id = scope->content.composition.expression_id;
+  int32_t binder = SYMBOL_BINDERS(state, expr_id)[index];
+  if (binder >= 0) {
+    *owned = FALSE;
+    return *ARR_GET(scope->content.composition.arguments, binder);
+  }
+
+  const struct Parameter *params = SYMBOL_PARAMETERS(state, expr_id);
+  const struct Expression *expr = (struct Expression *)
+      sl_logic_get_const_symbol_by_id(state, expr_id)->object;
+  ArgumentArray args_array;
+  Value *binding;
+  ARR_INIT(args_array);
+  for (size_t i = 0;
+      i < ARR_LENGTH(scope->content.composition.arguments); ++i) {
+    struct Argument argument;
+    argument.name_id = params[i].name_id;
+    argument.value = *ARR_GET(scope->content.composition.arguments, i);
+    ARR_APPEND(args_array, argument);
+  }
+  binding = instantiate_value(*ARR_GET(expr->bindings, index), args_array);
+  ARR_FREE(args_array);
+  *owned = TRUE;
+  return binding;
+}
+
+struct BoundCheck
+{
+  const sl_LogicState *state;
+  const struct ProofEnvironment *env;
+  const struct BindingScopes *scopes; /* Those enclosing the context. */
+};
+
+/* Fails at a term of the source that can be bound where the context is. */
+static enum CheckStep
+not_bound_step(const void *data, const Value *source, const Value *unused)
+{
+  const struct BoundCheck *check = data;
+  const sl_LogicState *state = check->state;
+  const struct ProofEnvironment *env = check->env;
+  const struct BindingScopes *scopes = check->scopes;
   switch (source->value_type)
   {
     case ValueTypeDummy:
-      /* For a constant, look up through the parents of context. If there is
+      /* For a constant, look up through the scopes of context. If there is
          a binding equal to source, or if there is a variable that gets
-         bound, return true. */
-      {
-        const sl_LogicSymbol *type_sym;
-        const struct Type *type;
-        type_sym = sl_logic_get_symbol_by_id(state, source->type_id);
-        type = (struct Type *)type_sym->object;
-        if (!type->binds)
-          return FALSE;
-        for (const Value *scope = context->parent; scope != NULL;
-            scope = scope->parent) {
-          ArgumentArray args_array;
-          const sl_LogicSymbol *expr_sym;
-          const struct Expression *expr;
-          ARR_INIT(args_array);
-          expr_sym = sl_logic_get_symbol_by_id(state,
-              scope->content.composition.expression_id);
-          expr = (struct Expression *)expr_sym->object;
-          for (size_t i = 0;
-              i < ARR_LENGTH(scope->content.composition.arguments); ++i) {
-            Value *arg = *ARR_GET(scope->content.composition.arguments, i);
-            const struct Parameter *param = ARR_GET(expr->parameters, i);
-            struct Argument argument;
-            argument.name_id = param->name_id;
-            argument.value = arg;
-            ARR_APPEND(args_array, argument);
-          }
-
-          for (size_t i = 0; i < ARR_LENGTH(expr->bindings); ++i) {
-            const Value *binding = *ARR_GET(expr->bindings, i);
-            Value *instantiated_binding =
-                instantiate_value(binding, args_array);
-            if (values_equal(instantiated_binding, source)) {
-              free_value(instantiated_binding);
-              ARR_FREE(args_array);
-              return TRUE;
-              /* TODO: free. */
-            }
-            free_value(instantiated_binding);
-          }
-          ARR_FREE(args_array);
+         bound, the source gets bound. */
+      if (!(SYMBOL_FLAGS(state, source->type_id) & SYMBOL_BINDS))
+        return CheckHolds;
+      for (size_t j = ARR_LENGTH(scopes->scopes); j > 0; --j) {
+        const Value *scope = *ARR_GET(scopes->scopes, j - 1);
+        uint32_t binder_count = SYMBOL_BINDER_COUNT(state,
+            scope->content.composition.expression_id);
+        for (size_t i = 0; i < binder_count; ++i) {
+          bool owned, bound;
+          Value *binding = scope_binding(state, scope, i, &owned);
+          bound = values_equal(binding, source);
+          if (owned)
+            free_value(binding);
+          if (bound)
+            return CheckFails;
         }
       }
-      return FALSE;
+      return CheckHolds;
       break;
     case ValueTypeConstant:
-      /* For a constant, look up through the parents of context. If there is
+      /* For a constant, look up through the scopes of context. If there is
          a binding equal to source, or if there is a variable that gets
-         bound, return true. */
-      {
-        const sl_LogicSymbol *type_sym;
-        const struct Type *type;
-        type_sym = sl_logic_get_symbol_by_id(state, source->type_id);
-        type = (struct Type *)type_sym->object;
-        if (!type->binds)
-          return FALSE;
-        for (const Value *scope = context->parent; scope != NULL;
-            scope = scope->parent) {
-          ArgumentArray args_array;
-          const sl_LogicSymbol *expr_sym;
-          const struct Expression *expr;
-          ARR_INIT(args_array);
-          expr_sym = sl_logic_get_symbol_by_id(state,
-              scope->content.composition.expression_id);
-          expr = (struct Expression *)expr_sym->object;
-          for (size_t i = 0;
-              i < ARR_LENGTH(scope->content.composition.arguments); ++i) {
-            Value *arg = *ARR_GET(scope->content.composition.arguments, i);
-            const struct Parameter *param = ARR_GET(expr->parameters, i);
-            struct Argument argument;
-            argument.name_id = param->name_id;
-            argument.value = arg;
-            ARR_APPEND(args_array, argument);
-          }
-
-          for (size_t i = 0; i < ARR_LENGTH(expr->bindings); ++i) {
-            const Value *binding = *ARR_GET(expr->bindings, i);
-            Value *instantiated_binding =
-                instantiate_value(binding, args_array);
-            if (instantiated_binding->value_type == ValueTypeVariable
-              || values_equal(instantiated_binding, source))
-            {
-              free_value(instantiated_binding);
-              ARR_FREE(args_array);
-              return TRUE;
-              /* TODO: free. */
-            }
-            free_value(instantiated_binding);
-          }
-          ARR_FREE(args_array);
+         bound, the source gets bound. */
+      if (!(SYMBOL_FLAGS(state, source->type_id) & SYMBOL_BINDS))
+        return CheckHolds;
+      for (size_t j = ARR_LENGTH(scopes->scopes); j > 0; --j) {
+        const Value *scope = *ARR_GET(scopes->scopes, j - 1);
+        uint32_t binder_count = SYMBOL_BINDER_COUNT(state,
+            scope->content.composition.expression_id);
+        for (size_t i = 0; i < binder_count; ++i) {
+          bool owned, bound;
+          Value *binding = scope_binding(state, scope, i, &owned);
+          bound = binding->value_type == ValueTypeVariable
+            || values_equal(binding, source);
+          if (owned)
+            free_value(binding);
+          if (bound)
+            return CheckFails;
         }
       }
-      return FALSE;
+      return CheckHolds;
       break;
     case ValueTypeVariable:
       /* Look for distinctness requirements that prevent source from being
          bound in context. */
-      for (const Value *scope = context->parent; scope != NULL;
-          scope = scope->parent) {
-        const sl_LogicSymbol *expr_sym = sl_logic_get_symbol_by_id(state,
+      for (size_t j = ARR_LENGTH(scopes->scopes); j > 0; --j) {
+        const Value *scope = *ARR_GET(scopes->scopes, j - 1);
+        uint32_t binder_count = SYMBOL_BINDER_COUNT(state,
             scope->content.composition.expression_id);
-        const struct Expression *expr = (struct Expression *)expr_sym->object;
-        ArgumentArray args_array;
-        ARR_INIT(args_array);
-        for (size_t i = 0;
-            i < ARR_LENGTH(scope->content.composition.arguments); ++i) {
-          Value *arg = *ARR_GET(scope->content.composition.arguments, i);
-          const struct Parameter *param = ARR_GET(expr->parameters, i);
-          struct Argument argument;
-          argument.name_id = param->name_id;
-          argument.value = arg;
-          ARR_APPEND(args_array, argument);
-        }
-
-        for (size_t i = 0; i < ARR_LENGTH(expr->bindings); ++i) {
-          const Value *binding = *ARR_GET(expr->bindings, i);
-          Value *instantiated_binding = instantiate_value(binding, args_array);
+        for (size_t i = 0; i < binder_count; ++i) {
+          bool owned, bound;
+          Value *binding = scope_binding(state, scope, i, &owned);
           /* Is there a distinctness requirement that prevents source from
              being bound? */
-          if (!pair_distinct_in_env(env, instantiated_binding, source)) {
-            free_value(instantiated_binding);
-            ARR_FREE(args_array);
-            return TRUE;
-          }
-          free_value(instantiated_binding);
+          bound = !pair_distinct_in_env(env, binding, source);
+          if (owned)
+            free_value(binding);
+          if (bound)
+            return CheckFails;
         }
-        ARR_FREE(args_array);
       }
-      return FALSE;
+      return CheckHolds;
       break;
     case ValueTypeComposition:
-      for (size_t i = 0; i < ARR_LENGTH(source->content.composition.arguments);
-          ++i) {
-        const Value *arg = *ARR_GET(source->content.composition.arguments, i);
-        if (value_gets_bound(state, env, arg, context))
-          return TRUE;
-      }
-      return FALSE;
+      return CheckDescend;
+      break;
+    case ValueTypeNumeral:
+      /* Numerals are closed, so nothing in them can be bound. */
+      return CheckHolds;
       break;
   }
+  return CheckHolds;
 }
 
-static bool
-free_for_in_env(const sl_LogicState *state, const struct ProofEnvironment *env,
-  const Value *source, const Value *target, const Value *context)
+static bool value_gets_bound(const sl_LogicState *state,
+    const struct ProofEnvironment *env, const Value *source,
+    const struct BindingScopes *scopes)
+{
+  struct BoundCheck check;
+  check.state = state;
+  check.env = env;
+  check.scopes = scopes;
+  return !check_throughout(source, NULL, not_bound_step, &check, NULL);
+}
+
+struct FreeForCheck
 {
+  const sl_LogicState *state;
+  const struct ProofEnvironment *env;
+  const Value *source;
+  const Value *target;
+  struct BindingScopes scopes;
+};
+
+static enum CheckStep
+free_for_step(const void *data, const Value *context, const Value *unused)
+{
+  const struct FreeForCheck *check = data;
+  const sl_LogicState *state = check->state;
+  const struct ProofEnvironment *env = check->env;
+  const Value *source = check->source;
+  const Value *target = check->target;
+
   /* Special case: anything is always free for itself. */
   if (values_equal(source, target))
-    return TRUE;
+    return CheckHolds;
 
   /* Check if there is a corresponding requirement in the environment. */
   for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
@@ -354,7 +490,7 @@ free_for_in_env(const sl_LogicState *state, const struct ProofEnvironment *env,
       r_context = *ARR_GET(req->arguments, 2);
       if (values_equal(source, r_source) && values_equal(target, r_target)
         && values_equal(context, r_context))
-        return TRUE;
+        return CheckHolds;
     }
   }
 
@@ -369,24 +505,37 @@ free_for_in_env(const sl_LogicState *state, const struct ProofEnvironment *env,
   {
     /* Then, iterate through the source and look for terms that can
        be bound. */
-    return !value_gets_bound(state, env, source, context);
+    return value_gets_bound(state, env, source, &check->scopes)
+      ? CheckFails : CheckHolds;
   } else if (context->value_type == ValueTypeConstant
-      || context->value_type == ValueTypeDummy) {
+      || context->value_type == ValueTypeDummy
+      || context->value_type == ValueTypeNumeral) {
     /* Since we didn't match above, we're all good. */
-    return TRUE;
+    return CheckHolds;
   }
   else if (context->value_type == ValueTypeComposition)
   {
     /* Check all the children. */
-    for (size_t i = 0; i < ARR_LENGTH(context->content.composition.arguments);
-        ++i) {
-      const Value *arg = *ARR_GET(context->content.composition.arguments, i);
-      if (!free_for_in_env(state, env, source, target, arg))
-        return FALSE;
-    }
-    return TRUE;
+    return CheckDescend;
   }
-  return TRUE;
+  return CheckHolds;
+}
+
+static bool
+free_for_in_env(const sl_LogicState *state, const struct ProofEnvironment *env,
+  const Value *source, const Value *target, const Value *context)
+{
+  struct FreeForCheck check;
+  bool free_for;
+  check.state = state;
+  check.env = env;
+  check.source = source;
+  check.target = target;
+  init_binding_scopes(&check.scopes, state, context);
+  free_for = check_throughout(context, NULL, free_for_step, &check,
+    &check.scopes);
+  free_binding_scopes(&check.scopes);
+  return free_for;
 }
 
 static bool
@@ -408,10 +557,21 @@ evaluate_free_for(struct sl_LogicState *state,
 }
 
 /* --- Not Free --- */
-static bool not_free_in_env(const sl_LogicState *state,
-    const struct ProofEnvironment *env, const Value *target,
-    const Value *context)
+struct NotFreeCheck
 {
+  const sl_LogicState *state;
+  const struct ProofEnvironment *env;
+  const Value *target;
+};
+
+static enum CheckStep
+not_free_step(const void *data, const Value *context, const Value *unused)
+{
+  const struct NotFreeCheck *check = data;
+  const sl_LogicState *state = check->state;
+  const struct ProofEnvironment *env = check->env;
+  const Value *target = check->target;
+
   /* Check if there is a corresponding requirement in the environment. */
   for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
   {
@@ -422,14 +582,14 @@ static bool not_free_in_env(const sl_LogicState *state,
       r_target = *ARR_GET(req->arguments, 0);
       r_context = *ARR_GET(req->arguments, 1);
       if (values_equal(target, r_target) && values_equal(context, r_context))
-        return TRUE;
+        return CheckHolds;
     }
   }
 
   if (values_equal(target, context))
   {
     /* The value occurs free as itself. */
-    return FALSE;
+    return CheckFails;
   }
   else if (context->value_type == ValueTypeComposition)
   {
@@ -437,41 +597,48 @@ static bool not_free_in_env(const sl_LogicState *state,
        context binds the target, then the target cannot be free. If the
        expression does not bind the target, we can only conclude that target
        is not free if it is not free in all the composition's arguments. */
-    const sl_LogicSymbol *expr_sym = sl_logic_get_symbol_by_id(state,
-        context->content.composition.expression_id);
-    const struct Expression *expr = (struct Expression *)expr_sym->object;
-    for (size_t i = 0; i < ARR_LENGTH(expr->bindings); ++i)
+    uint32_t expr_id = context->content.composition.expression_id;
+    if (SYMBOL_BINDER_COUNT(state, expr_id) > 0)
     {
-      const Value *binding = *ARR_GET(expr->bindings, i);
-      if (values_equal(target, binding))
-        return TRUE;
-    }
-
-    for (size_t i = 0; i < ARR_LENGTH(context->content.composition.arguments);
-        ++i) {
-      const Value *arg = *ARR_GET(context->content.composition.arguments, i);
-      if (!not_free_in_env(state, env, target, arg))
-        return FALSE;
+      const struct Expression *expr = (struct Expression *)
+          sl_logic_get_const_symbol_by_id(state, expr_id)->object;
+      for (size_t i = 0; i < ARR_LENGTH(expr->bindings); ++i)
+      {
+        const Value *binding = *ARR_GET(expr->bindings, i);
+        if (values_equal(target, binding))
+          return CheckHolds;
+      }
     }
-    return TRUE;
+    return CheckDescend;
   }
   else if (context->value_type == ValueTypeVariable)
   {
     if (pair_distinct_in_env(env, target, context))
-      return TRUE;
+      return CheckHolds;
     /* Unless they are guaranteed distinct, it is possible these variables
        have the same value. */
-    return FALSE;
+    return CheckFails;
   }
   else
   {
     /* If we made it this far, we have a constant distinct from the target.
        The target does not occur in the context, so it does not occur free
        in the context. */
-    return TRUE;
+    return CheckHolds;
   }
 }
 
+static bool not_free_in_env(const sl_LogicState *state,
+    const struct ProofEnvironment *env, const Value *target,
+    const Value *context)
+{
+  struct NotFreeCheck check;
+  check.state = state;
+  check.env = env;
+  check.target = target;
+  return check_throughout(context, NULL, not_free_step, &check, NULL);
+}
+
 static bool
 evaluate_not_free(sl_LogicState *state, const struct ProofEnvironment *env,
   ValueArray args)
@@ -490,10 +657,22 @@ evaluate_not_free(sl_LogicState *state, const struct ProofEnvironment *env,
 }
 
 /* --- Cover Free --- */
-static bool cover_free_in_env(const sl_LogicState *state,
-    const struct ProofEnvironment *env, ValueArray covering,
-    const Value *context)
+struct CoverFreeCheck
 {
+  const sl_LogicState *state;
+  const struct ProofEnvironment *env;
+  ValueArray covering;
+  struct BindingScopes scopes;
+};
+
+static enum CheckStep
+cover_free_step(const void *data, const Value *context, const Value *unused)
+{
+  const struct CoverFreeCheck *check = data;
+  const sl_LogicState *state = check->state;
+  const struct ProofEnvironment *env = check->env;
+  ValueArray covering = check->covering;
+
   /* Check if there is a corresponding requirement in the environment. */
   for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
   {
@@ -521,7 +700,7 @@ static bool cover_free_in_env(const sl_LogicState *state,
         continue;
       r_context = *ARR_GET(req->arguments, ARR_LENGTH(covering));
       if (values_equal(context, r_context))
-        return TRUE;
+        return CheckHolds;
     }
   }
 
@@ -529,36 +708,44 @@ static bool cover_free_in_env(const sl_LogicState *state,
   {
     const Value *cover = *ARR_GET(covering, i);
     if (values_equal(cover, context))
-      return TRUE;
+      return CheckHolds;
   }
 
   if (context->value_type == ValueTypeConstant
       || context->value_type == ValueTypeDummy
       || context->value_type == ValueTypeVariable) {
-    if (value_gets_bound(state, env, context, context))
-      return TRUE;
+    if (value_gets_bound(state, env, context, &check->scopes))
+      return CheckHolds;
   }
 
   if (context->value_type == ValueTypeComposition)
   {
-    for (size_t i = 0; i < ARR_LENGTH(context->content.composition.arguments);
-        ++i) {
-      const Value *arg = *ARR_GET(context->content.composition.arguments, i);
-      if (!cover_free_in_env(state, env, covering, arg))
-        return FALSE;
-    }
-    return TRUE;
+    return CheckDescend;
   }
   else if (context->value_type == ValueTypeConstant
-      || context->value_type == ValueTypeDummy)
+      || context->value_type == ValueTypeDummy
+      || context->value_type == ValueTypeNumeral)
   {
-    const sl_LogicSymbol *type_sym = sl_logic_get_symbol_by_id(state,
-        context->type_id);
-    const struct Type *type = (struct Type *)type_sym->object;
-    if (!type->binds)
-      return TRUE;
+    if (!(SYMBOL_FLAGS(state, context->type_id) & SYMBOL_BINDS))
+      return CheckHolds;
   }
-  return FALSE;
+  return CheckFails;
+}
+
+static bool cover_free_in_env(const sl_LogicState *state,
+    const struct ProofEnvironment *env, ValueArray covering,
+    const Value *context)
+{
+  struct CoverFreeCheck check;
+  bool covers;
+  check.state = state;
+  check.env = env;
+  check.covering = covering;
+  init_binding_scopes(&check.scopes, state, context);
+  covers = check_throughout(context, NULL, cover_free_step, &check,
+    &check.scopes);
+  free_binding_scopes(&check.scopes);
+  return covers;
 }
 
 static bool
@@ -587,16 +774,28 @@ evaluate_cover_free(sl_LogicState *state,
 }
 
 /* --- Substitution --- */
-static bool
-is_substitution(const struct ProofEnvironment *env, const Value *target,
-  const Value *context, const Value *source, const Value *new_context)
+struct SubstitutionCheck
+{
+  const struct ProofEnvironment *env;
+  const Value *target;
+  const Value *source;
+};
+
+static enum CheckStep
+substitution_step(const void *data, const Value *context,
+  const Value *new_context)
 {
+  const struct SubstitutionCheck *check = data;
+  const struct ProofEnvironment *env = check->env;
+  const Value *target = check->target;
+  const Value *source = check->source;
+
   /* Doing nothing is always a substitution (but not a full substitution,
      unless there are no occurences of target in context). */
   if (values_equal(context, new_context))
-    return TRUE;
+    return CheckHolds;
   if (values_equal(target, source) && values_equal(context, new_context))
-    return TRUE;
+    return CheckHolds;
 
   /* Check if there is a corresponding requirement in the environment. */
   for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
@@ -612,48 +811,51 @@ is_substitution(const struct ProofEnvironment *env, const Value *target,
       if (values_equal(target, r_target) && values_equal(context, r_context)
         && values_equal(source, r_source)
         && values_equal(new_context, r_new_context))
-        return TRUE;
+        return CheckHolds;
     }
   }
 
   if (values_equal(target, context))
   {
     if (values_equal(source, new_context))
-      return TRUE;
+      return CheckHolds;
     else if (values_equal(target, new_context))
-      return TRUE;
+      return CheckHolds;
     else
-      return FALSE;
+      return CheckFails;
   }
   else if (context->value_type == ValueTypeComposition)
   {
     if (new_context->value_type != ValueTypeComposition)
-      return FALSE;
+      return CheckFails;
     if (ARR_LENGTH(context->content.composition.arguments) !=
         ARR_LENGTH(new_context->content.composition.arguments))
-      return FALSE;
-    for (size_t i = 0; i < ARR_LENGTH(context->content.composition.arguments);
-        ++i) {
-      const Value *ctx_arg =
-          *ARR_GET(context->content.composition.arguments, i);
-      const Value *new_ctx_arg =
-          *ARR_GET(new_context->content.composition.arguments, i);
-      if (!is_substitution(env, target, ctx_arg, source, new_ctx_arg))
-        return FALSE;
-    }
-    return TRUE;
+      return CheckFails;
+    return CheckDescend;
   }
   else
   {
     /* If there is nothing that can be substituted in the tree, they must
        be equal. */
     if (values_equal(context, new_context))
-      return TRUE;
+      return CheckHolds;
     else
-      return FALSE;
+      return CheckFails;
   }
 }
 
+static bool
+is_substitution(const struct ProofEnvironment *env, const Value *target,
+  const Value *context, const Value *source, const Value *new_context)
+{
+  struct SubstitutionCheck check;
+  check.env = env;
+  check.target = target;
+  check.source = source;
+  return check_throughout(context, new_context, substitution_step, &check,
+    NULL);
+}
+
 static bool
 evaluate_substitution(sl_LogicState *state,
   const struct ProofEnvironment *env, ValueArray args)
@@ -674,14 +876,19 @@ evaluate_substitution(sl_LogicState *state,
 }
 
 /* --- Full Substitution --- */
-static bool
-is_full_substitution(const struct ProofEnvironment *env, const Value *target,
-  const Value *context, const Value *source, const Value *new_context)
+static enum CheckStep
+full_substitution_step(const void *data, const Value *context,
+  const Value *new_context)
 {
+  const struct SubstitutionCheck *check = data;
+  const struct ProofEnvironment *env = check->env;
+  const Value *target = check->target;
+  const Value *source = check->source;
+
   /* As a special case that doesn't (and cannot) require evaluation,
      always return true when performing the identity substitution. */
   if (values_equal(target, source) && values_equal(context, new_context))
-    return TRUE;
+    return CheckHolds;
 
   /* Check if there is a corresponding requirement in the environment. */
   for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
@@ -697,44 +904,47 @@ is_full_substitution(const struct ProofEnvironment *env, const Value *target,
       if (values_equal(target, r_target) && values_equal(context, r_context)
         && values_equal(source, r_source)
         && values_equal(new_context, r_new_context))
-        return TRUE;
+        return CheckHolds;
     }
   }
 
   if (values_equal(target, context))
   {
     if (values_equal(source, new_context))
-      return TRUE;
+      return CheckHolds;
     else
-      return FALSE;
+      return CheckFails;
   }
   else if (context->value_type == ValueTypeComposition)
   {
     if (new_context->value_type != ValueTypeComposition)
-      return FALSE;
+      return CheckFails;
     if (ARR_LENGTH(context->content.composition.arguments)
         != ARR_LENGTH(new_context->content.composition.arguments))
-      return FALSE;
-    for (size_t i = 0; i < ARR_LENGTH(context->content.composition.arguments);
-        ++i) {
-      const Value *ctx_arg =
-          *ARR_GET(context->content.composition.arguments, i);
-      const Value *new_ctx_arg =
-          *ARR_GET(new_context->content.composition.arguments, i);
-      if (!is_full_substitution(env, target, ctx_arg, source, new_ctx_arg))
-        return FALSE;
-    }
-    return TRUE;
+      return CheckFails;
+    return CheckDescend;
   }
   else
   {
     if (values_equal(context, new_context))
-      return TRUE;
+      return CheckHolds;
     else
-      return FALSE;
+      return CheckFails;
   }
 }
 
+static bool
+is_full_substitution(const struct ProofEnvironment *env, const Value *target,
+  const Value *context, const Value *source, const Value *new_context)
+{
+  struct SubstitutionCheck check;
+  check.env = env;
+  check.target = target;
+  check.source = source;
+  return check_throughout(context, new_context, full_substitution_step,
+    &check, NULL);
+}
+
 static bool
 evaluate_full_substitution(struct sl_LogicState *state,
   const struct ProofEnvironment *env, ValueArray args)
@@ -785,13 +995,79 @@ evaluate_unused(sl_LogicState *state, const struct ProofEnvironment *env,
   return TRUE;
 }
 
+/* --- Successor --- */
+static bool
+evaluate_successor(sl_LogicState *state, const struct ProofEnvironment *env,
+  ValueArray args)
+{
+  /* Holds when the second argument is the numeral following the first, so
+     a single step relates any numeral to its predecessor, however large. */
+  const Value *n, *m;
+  sl_Natural one, next;
+  bool is_successor;
+  if (ARR_LENGTH(args) != 2) {
+    LOG_NORMAL(state->log_out,
+        "Requirement 'successor' given wrong number of arguments.");
+    return FALSE;
+  }
+  n = *ARR_GET(args, 0);
+  m = *ARR_GET(args, 1);
+
+  /* Check if there is a corresponding requirement in the environment. */
+  for (size_t i = 0; i < ARR_LENGTH(env->requirements); ++i)
+  {
+    const struct Requirement *req = ARR_GET(env->requirements, i);
+    if (req->type == RequirementTypeSuccessor
+        && values_equal(n, *ARR_GET(req->arguments, 0))
+        && values_equal(m, *ARR_GET(req->arguments, 1)))
+      return TRUE;
+  }
+
+  if (n->value_type != ValueTypeNumeral || m->value_type != ValueTypeNumeral)
+    return FALSE;
+  sl_natural_from_uint64_t(1, &one);
+  sl_natural_add(n->content.numeral, one, &next);
+  is_successor = sl_natural_equal(next, m->content.numeral);
+  sl_natural_free(&one);
+  sl_natural_free(&next);
+  return is_successor;
+}
+
 /* --- Evaluation --- */
+const char *
+requirement_type_name(enum RequirementType type)
+{
+  switch (type)
+  {
+    case RequirementTypeDistinct:
+      return "distinct";
+    case RequirementTypeFreeFor:
+      return "free_for";
+    case RequirementTypeNotFree:
+      return "not_free";
+    case RequirementTypeCoverFree:
+      return "cover_free";
+    case RequirementTypeSubstitution:
+      return "substitution";
+    case RequirementTypeFullSubstitution:
+      return "full_substitution";
+    case RequirementTypeUnused:
+      return "unused";
+    case RequirementTypeSuccessor:
+      return "successor";
+  }
+  return "unknown";
+}
+
 bool evaluate_requirement(sl_LogicState *state, const struct Requirement *req,
     ArgumentArray environment_args, const struct ProofEnvironment *env)
 {
   bool satisfied = FALSE;
   ValueArray instantiated_args;
 
+  sl_trace_begin("requirement", requirement_type_name(req->type));
+  sl_profile_begin_detail(sl_ProfilePhase_Requirement, req->type,
+    requirement_type_name(req->type));
   ARR_INIT(instantiated_args);
   for (size_t j = 0; j < ARR_LENGTH(req->arguments); ++j)
   {
@@ -825,6 +1101,9 @@ bool evaluate_requirement(sl_LogicState *state, const struct Requirement *req,
     case RequirementTypeUnused:
       satisfied = evaluate_unused(state, env, instantiated_args);
       break;
+    case RequirementTypeSuccessor:
+      satisfied = evaluate_successor(state, env, instantiated_args);
+      break;
   }
   for (size_t i = 0; i < ARR_LENGTH(instantiated_args); ++i) {
     Value *arg;
@@ -832,5 +1111,7 @@ bool evaluate_requirement(sl_LogicState *state, const struct Requirement *req,
     free_value(arg);
   }
   ARR_FREE(instantiated_args);
+  sl_profile_end();
+  sl_trace_end();
   return satisfied;
 }
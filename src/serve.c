@@ -0,0 +1,356 @@
+#include "serve.h"
+#include "json.h"
+#include "parse.h"
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct Diagnostic
+{
+  char *file; /* NULL if the message is not about a named input. */
+  size_t line;
+  size_t column;
+  sl_MessageType type;
+  char *message;
+};
+
+typedef ARR(struct Diagnostic) DiagnosticArray;
+
+struct sl_Server
+{
+  sl_LogicState *state;
+
+  ARR(char *) base_files;
+  bool base_valid;
+  uint64_t base_load_ns;
+  DiagnosticArray base_diagnostics;
+
+  size_t requests;
+};
+
+sl_Server *
+sl_new_server(sl_LogicState *state)
+{
+  sl_Server *server = SL_NEW(sl_Server);
+  if (server == NULL)
+    return NULL;
+  server->state = state;
+  ARR_INIT(server->base_files);
+  server->base_valid = TRUE;
+  server->base_load_ns = 0;
+  ARR_INIT(server->base_diagnostics);
+  server->requests = 0;
+  return server;
+}
+
+static void
+free_diagnostics(DiagnosticArray *diagnostics)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*diagnostics); ++i)
+  {
+    struct Diagnostic *diagnostic = ARR_GET(*diagnostics, i);
+    if (diagnostic->file != NULL)
+      SL_FREE(diagnostic->file);
+    SL_FREE(diagnostic->message);
+  }
+  ARR_FREE(*diagnostics);
+}
+
+void
+sl_free_server(sl_Server *server)
+{
+  if (server == NULL)
+    return;
+  for (size_t i = 0; i < ARR_LENGTH(server->base_files); ++i)
+    SL_FREE(*ARR_GET(server->base_files, i));
+  ARR_FREE(server->base_files);
+  free_diagnostics(&server->base_diagnostics);
+  SL_FREE(server);
+}
+
+static void
+collect_message(const char *source, size_t line, size_t column,
+  const char *message, sl_MessageType type, void *user_data)
+{
+  DiagnosticArray *diagnostics = (DiagnosticArray *)user_data;
+  struct Diagnostic diagnostic;
+  diagnostic.file = (source != NULL) ? SL_STRDUP(source) : NULL;
+  diagnostic.line = line;
+  diagnostic.column = column;
+  diagnostic.type = type;
+  diagnostic.message = SL_STRDUP(message);
+  ARR_APPEND(*diagnostics, diagnostic);
+}
+
+static const char *
+severity_name(sl_MessageType type)
+{
+  switch (type)
+  {
+    case sl_MessageType_Error:
+      return "error";
+    case sl_MessageType_Warning:
+      return "warning";
+    case sl_MessageType_Note:
+      return "note";
+  }
+  return "error";
+}
+
+static void
+write_diagnostics(FILE *out, const DiagnosticArray *diagnostics)
+{
+  fputc('[', out);
+  for (size_t i = 0; i < ARR_LENGTH(*diagnostics); ++i)
+  {
+    const struct Diagnostic *diagnostic = ARR_GET(*diagnostics, i);
+    if (i > 0)
+      fputc(',', out);
+    fputs("{\"file\":", out);
+    if (diagnostic->file != NULL)
+      sl_write_json_string(out, diagnostic->file);
+    else
+      fputs("null", out);
+    fprintf(out, ",\"line\":%zu,\"column\":%zu,\"severity\":\"%s\",",
+      diagnostic->line + 1, diagnostic->column + 1,
+      severity_name(diagnostic->type));
+    fputs("\"message\":", out);
+    sl_write_json_string(out, diagnostic->message);
+    fputc('}', out);
+  }
+  fputc(']', out);
+}
+
+static void
+write_id(FILE *out, const sl_JsonValue *id)
+{
+  fputs("{\"id\":", out);
+  if (id != NULL)
+    sl_json_write(out, id);
+  else
+    fputs("null", out);
+}
+
+static void
+write_status(const sl_Server *server, FILE *out)
+{
+  fputs("\"base\":{\"files\":[", out);
+  for (size_t i = 0; i < ARR_LENGTH(server->base_files); ++i)
+  {
+    if (i > 0)
+      fputc(',', out);
+    sl_write_json_string(out, *ARR_GET(server->base_files, i));
+  }
+  fprintf(out, "],\"valid\":%s,\"load_ms\":%.3f,\"symbols\":%zu,",
+    server->base_valid ? "true" : "false",
+    (double)server->base_load_ns / 1e6,
+    sl_logic_count_symbols(server->state));
+  fputs("\"diagnostics\":", out);
+  write_diagnostics(out, &server->base_diagnostics);
+  fprintf(out, "},\"requests\":%zu", server->requests);
+}
+
+int
+sl_server_load_base(sl_Server *server, const char *path)
+{
+  uint64_t start = sl_wall_clock_ns();
+  sl_set_message_handler(&collect_message, &server->base_diagnostics);
+  int err = sl_verify_and_add_file(path, server->state);
+  sl_set_message_handler(NULL, NULL);
+  server->base_load_ns += sl_wall_clock_ns() - start;
+  ARR_APPEND(server->base_files, SL_STRDUP(path));
+  if (err != 0)
+    server->base_valid = FALSE;
+  return err;
+}
+
+/* Verifies a file against the warm state and rolls the state back. */
+static void
+answer_verify(sl_Server *server, const sl_JsonValue *id, const char *path,
+  const char *text, FILE *out)
+{
+  DiagnosticArray diagnostics;
+  sl_LogicCheckpoint checkpoint;
+  char *log_data = NULL;
+  size_t log_size = 0;
+  FILE *log_out = open_memstream(&log_data, &log_size);
+  FILE *old_log_out = sl_logic_set_log_out(server->state, log_out);
+  uint64_t verify_start, rollback_start, rollback_end;
+  int err;
+
+  ARR_INIT(diagnostics);
+  sl_logic_checkpoint(server->state, &checkpoint);
+  sl_set_message_handler(&collect_message, &diagnostics);
+  verify_start = sl_wall_clock_ns();
+  if (text != NULL)
+    err = sl_verify_and_add_string(path, text, server->state);
+  else
+    err = sl_verify_and_add_file(path, server->state);
+  rollback_start = sl_wall_clock_ns();
+  sl_logic_rollback(server->state, &checkpoint);
+  rollback_end = sl_wall_clock_ns();
+  sl_set_message_handler(NULL, NULL);
+  sl_logic_set_log_out(server->state, old_log_out);
+  if (log_out != NULL)
+    fclose(log_out);
+
+  write_id(out, id);
+  fputs(",\"path\":", out);
+  sl_write_json_string(out, path);
+  fprintf(out, ",\"valid\":%s,\"diagnostics\":", err == 0 ? "true" : "false");
+  write_diagnostics(out, &diagnostics);
+  fputs(",\"log\":", out);
+  sl_write_json_string(out, log_data != NULL ? log_data : "");
+  fprintf(out, ",\"timings\":{\"verify_ms\":%.3f,\"rollback_ms\":%.3f}}\n",
+    (double)(rollback_start - verify_start) / 1e6,
+    (double)(rollback_end - rollback_start) / 1e6);
+
+  free(log_data); /* Allocated by the C library. */
+  free_diagnostics(&diagnostics);
+}
+
+static void
+answer_error(const sl_JsonValue *id, const char *message, FILE *out)
+{
+  write_id(out, id);
+  fputs(",\"error\":", out);
+  sl_write_json_string(out, message);
+  fputs("}\n", out);
+}
+
+int
+sl_server_handle_request(sl_Server *server, const char *request,
+  size_t length, FILE *out)
+{
+  sl_JsonValue *json = sl_json_parse(request, length);
+  int result = 0;
+  server->requests += 1;
+  if (json == NULL || sl_json_get_type(json) != sl_JsonType_Object)
+  {
+    answer_error(NULL, "the request is not a JSON object.", out);
+    fflush(out);
+    sl_json_free(json);
+    return 0;
+  }
+
+  const sl_JsonValue *id = sl_json_get_member(json, "id");
+  const char *command = sl_json_get_member_string(json, "command");
+  const char *path = sl_json_get_member_string(json, "path");
+  if (command == NULL || strcmp(command, "verify") == 0)
+  {
+    if (path == NULL)
+      answer_error(id, "a verify request needs a path.", out);
+    else
+      answer_verify(server, id, path,
+        sl_json_get_member_string(json, "text"), out);
+  }
+  else if (strcmp(command, "status") == 0)
+  {
+    write_id(out, id);
+    fputc(',', out);
+    write_status(server, out);
+    fputs("}\n", out);
+  }
+  else if (strcmp(command, "shutdown") == 0)
+  {
+    write_id(out, id);
+    fputs(",\"shutdown\":true}\n", out);
+    result = 1;
+  }
+  else
+  {
+    answer_error(id, "unknown command.", out);
+  }
+  fflush(out);
+  sl_json_free(json);
+  return result;
+}
+
+int
+sl_server_serve_stream(sl_Server *server, FILE *in, FILE *out)
+{
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  int stop = 0;
+
+  fputs("{\"ready\":true,", out);
+  write_status(server, out);
+  fputs("}\n", out);
+  fflush(out);
+
+  while (!stop && (length = getline(&line, &capacity, in)) >= 0)
+  {
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+      --length;
+    if (length == 0)
+      continue;
+    stop = sl_server_handle_request(server, line, (size_t)length, out);
+  }
+  free(line); /* Allocated by the C library. */
+  return stop;
+}
+
+int
+sl_server_serve_socket(sl_Server *server, const char *socket_path)
+{
+  struct sockaddr_un address;
+  int listener;
+  int stop = 0;
+
+  if (strlen(socket_path) >= sizeof(address.sun_path))
+    return 1;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    return 1;
+  unlink(socket_path);
+  if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0
+      || listen(listener, 8) != 0)
+  {
+    close(listener);
+    return 1;
+  }
+
+  /* A client that goes away mid-reply must not take the server with it. */
+  signal(SIGPIPE, SIG_IGN);
+
+  while (!stop)
+  {
+    int connection = accept(listener, NULL, NULL);
+    if (connection < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    int write_fd = dup(connection);
+    FILE *in = fdopen(connection, "r");
+    FILE *out = (write_fd >= 0) ? fdopen(write_fd, "w") : NULL;
+    if (in == NULL || out == NULL)
+    {
+      if (in != NULL)
+        fclose(in);
+      else
+        close(connection);
+      if (out != NULL)
+        fclose(out);
+      else if (write_fd >= 0)
+        close(write_fd);
+      continue;
+    }
+    stop = sl_server_serve_stream(server, in, out);
+    fclose(in);
+    fclose(out);
+  }
+
+  close(listener);
+  unlink(socket_path);
+  return 0;
+}
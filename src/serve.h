@@ -0,0 +1,55 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "logic.h"
+#include <stdio.h>
+
+/* A verification server. The base files are verified once, into a logic
+   state that is then kept warm, and each request is verified against it.
+   Whatever a request adds to the state is rolled back once it has been
+   answered, so that requests are independent of each other.
+
+   Requests and replies are JSON objects, one per line:
+
+     {"id": 1, "path": "file.sl"}
+     {"id": 2, "path": "file.sl", "text": "..."}
+     {"id": 3, "command": "status"}
+     {"id": 4, "command": "shutdown"}
+
+   The second form verifies `text` as though it were the contents of the file
+   at `path`, which need not exist. A reply has the id of its request,
+   whether the file is valid, the diagnostics (with lines and columns counted
+   from one), the verifier's log and the time taken. */
+typedef struct sl_Server sl_Server;
+
+/* The server does not own the state. */
+sl_Server *
+sl_new_server(sl_LogicState *state);
+
+void
+sl_free_server(sl_Server *server);
+
+/* Verifies a file into the warm state, keeping it for all the requests.
+   Returns 0 if the file is valid. */
+int
+sl_server_load_base(sl_Server *server, const char *path);
+
+/* Answers the request in `request` (of `length` bytes) with a line written to
+   `out`. Returns 1 once a shutdown has been requested, 0 otherwise. */
+int
+sl_server_handle_request(sl_Server *server, const char *request,
+  size_t length, FILE *out);
+
+/* Writes a line describing the base files, then answers the requests read
+   from `in` until the end of the input or a shutdown. Returns 1 on a
+   shutdown. */
+int
+sl_server_serve_stream(sl_Server *server, FILE *in, FILE *out);
+
+/* Listens on a Unix domain socket at `socket_path`, serving one connection
+   at a time as a stream, until a shutdown is requested. Returns nonzero if
+   the socket cannot be set up. */
+int
+sl_server_serve_socket(sl_Server *server, const char *socket_path);
+
+#endif
@@ -0,0 +1,823 @@
+#include "term_index.h"
+#include "core.h"
+#include "parse.h"
+#include <ctype.h>
+#include <string.h>
+
+/* The symbols that statements are filed under. Constants are told apart by
+   a hash of their path, and numerals are all filed together; either way,
+   the candidates are matched exactly afterwards. */
+enum IndexKeyKind
+{
+  IndexKeyKind_Wildcard = 0,
+  IndexKeyKind_Composition,
+  IndexKeyKind_Constant,
+  IndexKeyKind_Dummy,
+  IndexKeyKind_Numeral
+};
+
+struct IndexKey
+{
+  enum IndexKeyKind kind;
+  uint32_t arity;
+  uint64_t symbol;
+};
+typedef ARR(struct IndexKey) IndexKeyArray;
+
+struct IndexEdge
+{
+  struct IndexKey key;
+  uint32_t child;
+};
+
+struct IndexNode
+{
+  ARR(struct IndexEdge) edges;
+  sl_TermQueryResults statements; /* Those whose walk ends here. */
+};
+
+struct sl_TermIndex
+{
+  ARR(struct IndexNode) nodes; /* The root is the first. */
+  size_t indexed_symbols;
+  size_t statements;
+};
+
+static uint32_t
+add_node(sl_TermIndex *index)
+{
+  struct IndexNode node;
+  ARR_INIT(node.edges);
+  ARR_INIT(node.statements);
+  ARR_APPEND(index->nodes, node);
+  return (uint32_t)(ARR_LENGTH(index->nodes) - 1);
+}
+
+sl_TermIndex *
+sl_new_term_index()
+{
+  sl_TermIndex *index = SL_NEW(sl_TermIndex);
+  if (index == NULL)
+    return NULL;
+  ARR_INIT(index->nodes);
+  add_node(index);
+  index->indexed_symbols = 0;
+  index->statements = 0;
+  return index;
+}
+
+void
+sl_term_index_clear(sl_TermIndex *index)
+{
+  for (size_t i = 0; i < ARR_LENGTH(index->nodes); ++i)
+  {
+    struct IndexNode *node = ARR_GET(index->nodes, i);
+    ARR_FREE(node->edges);
+    ARR_FREE(node->statements);
+  }
+  index->nodes.length = 0;
+  add_node(index);
+  index->indexed_symbols = 0;
+  index->statements = 0;
+}
+
+void
+sl_free_term_index(sl_TermIndex *index)
+{
+  if (index == NULL)
+    return;
+  sl_term_index_clear(index);
+  ARR_FREE(ARR_GET(index->nodes, 0)->edges);
+  ARR_FREE(ARR_GET(index->nodes, 0)->statements);
+  ARR_FREE(index->nodes);
+  SL_FREE(index);
+}
+
+size_t
+sl_term_index_count_statements(const sl_TermIndex *index)
+{
+  return index->statements;
+}
+
+static struct IndexKey
+key_of(const Value *value)
+{
+  struct IndexKey key;
+  key.arity = 0;
+  key.symbol = 0;
+  switch (value->value_type)
+  {
+    case ValueTypeComposition:
+      key.kind = IndexKeyKind_Composition;
+      key.arity = (uint32_t)ARR_LENGTH(value->content.composition.arguments);
+      key.symbol = value->content.composition.expression_id;
+      break;
+    case ValueTypeConstant:
+      key.kind = IndexKeyKind_Constant;
+      key.symbol = SL_HASH_INIT;
+      for (size_t i = 0;
+          i < ARR_LENGTH(value->content.constant.constant_path->segments);
+          ++i)
+        key.symbol = sl_hash_uint64(key.symbol,
+          *ARR_GET(value->content.constant.constant_path->segments, i));
+      break;
+    case ValueTypeDummy:
+      key.kind = IndexKeyKind_Dummy;
+      key.symbol = value->content.dummy_id;
+      break;
+    case ValueTypeNumeral:
+      key.kind = IndexKeyKind_Numeral;
+      break;
+    default:
+      key.kind = IndexKeyKind_Wildcard;
+      break;
+  }
+  return key;
+}
+
+static bool
+keys_equal(struct IndexKey a, struct IndexKey b)
+{
+  return a.kind == b.kind && a.arity == b.arity && a.symbol == b.symbol;
+}
+
+/* The keys of a preorder walk of a value. */
+static void
+flatten_value(const Value *value, IndexKeyArray *keys)
+{
+  struct ValueWalk walk;
+  init_value_walk(&walk);
+  push_value_frame(&walk, value);
+  while (walk.length > 0)
+  {
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    ARR_APPEND(*keys, key_of(node));
+    for (size_t i = VALUE_ARITY(node); i > 0; --i)
+      push_value_frame(&walk, VALUE_ARGUMENT(node, i - 1));
+  }
+  free_value_walk(&walk);
+}
+
+static void
+insert_statement(sl_TermIndex *index, const Value *statement,
+  struct sl_TermQueryResult entry)
+{
+  IndexKeyArray keys;
+  uint32_t node = 0;
+  ARR_INIT(keys);
+  flatten_value(statement, &keys);
+  for (size_t i = 0; i < ARR_LENGTH(keys); ++i)
+  {
+    struct IndexKey key = *ARR_GET(keys, i);
+    struct IndexNode *current = ARR_GET(index->nodes, node);
+    uint32_t next = 0;
+    for (size_t j = 0; j < ARR_LENGTH(current->edges); ++j)
+    {
+      const struct IndexEdge *edge = ARR_GET(current->edges, j);
+      if (keys_equal(edge->key, key))
+      {
+        next = edge->child;
+        break;
+      }
+    }
+    if (next == 0)
+    {
+      struct IndexEdge edge;
+      /* Adding a node may move the array, so look the parent up again. */
+      next = add_node(index);
+      edge.key = key;
+      edge.child = next;
+      ARR_APPEND(ARR_GET(index->nodes, node)->edges, edge);
+    }
+    node = next;
+  }
+  ARR_APPEND(ARR_GET(index->nodes, node)->statements, entry);
+  index->statements += 1;
+  ARR_FREE(keys);
+}
+
+void
+sl_term_index_update(sl_TermIndex *index, sl_LogicState *state)
+{
+  for (size_t i = index->indexed_symbols;
+      i < ARR_LENGTH(state->symbol_table); ++i)
+  {
+    const sl_LogicSymbol *sym = ARR_GET(state->symbol_table, i);
+    if (sym->type != sl_LogicSymbolType_Theorem)
+      continue;
+    const struct Theorem *theorem = (const struct Theorem *)sym->object;
+    for (size_t j = 0; j < ARR_LENGTH(theorem->inferences); ++j)
+    {
+      struct sl_TermQueryResult entry;
+      entry.theorem_id = (uint32_t)i;
+      entry.inference = (uint32_t)j;
+      insert_statement(index, *ARR_GET(theorem->inferences, j), entry);
+    }
+  }
+  index->indexed_symbols = ARR_LENGTH(state->symbol_table);
+}
+
+/* Walking the tree. A variable of the pattern may stand for a whole
+   subterm of a statement, and a wildcard in the tree for a whole subterm of
+   the pattern, depending on the mode. */
+struct IndexWalk
+{
+  const sl_TermIndex *index;
+  IndexKeyArray keys; /* The pattern's. */
+  ARR(size_t) ends; /* Where the subterm starting at each key ends. */
+  bool pattern_variables; /* Whether the pattern's variables are bound. */
+  bool statement_variables; /* Whether the statements' are. */
+  ARR(struct sl_TermQueryResult) candidates;
+};
+
+static size_t
+compute_ends(struct IndexWalk *walk, size_t start)
+{
+  size_t end = start + 1;
+  for (uint32_t i = 0; i < ARR_GET(walk->keys, start)->arity; ++i)
+    end = compute_ends(walk, end);
+  *ARR_GET(walk->ends, start) = end;
+  return end;
+}
+
+/* The walk is kept on a stack of tasks rather than by recursion, since a
+   subterm skipped in the tree can be as deep as any statement. Each task
+   skips `remaining` whole subterms in the tree from `node`, then carries on
+   walking the pattern from `position`. */
+struct IndexTask
+{
+  uint32_t node;
+  size_t remaining;
+  size_t position;
+};
+typedef ARR(struct IndexTask) IndexTaskArray;
+
+static void
+push_index_task(IndexTaskArray *tasks, uint32_t node, size_t remaining,
+  size_t position)
+{
+  struct IndexTask task;
+  task.node = node;
+  task.remaining = remaining;
+  task.position = position;
+  ARR_APPEND(*tasks, task);
+}
+
+/* Tasks are pushed last to first, so that candidates are found in the same
+   order as a depth-first walk would. */
+static void
+skip_subterm(const struct IndexWalk *walk, IndexTaskArray *tasks,
+  struct IndexTask task)
+{
+  const struct IndexNode *current = ARR_GET(walk->index->nodes, task.node);
+  for (size_t i = ARR_LENGTH(current->edges); i > 0; --i)
+  {
+    const struct IndexEdge *edge = ARR_GET(current->edges, i - 1);
+    push_index_task(tasks, edge->child,
+      task.remaining - 1 + edge->key.arity, task.position);
+  }
+}
+
+static void
+walk_node(struct IndexWalk *walk, IndexTaskArray *tasks, uint32_t node,
+  size_t position)
+{
+  const struct IndexNode *current = ARR_GET(walk->index->nodes, node);
+  if (position == ARR_LENGTH(walk->keys))
+  {
+    for (size_t i = 0; i < ARR_LENGTH(current->statements); ++i)
+      ARR_APPEND(walk->candidates, *ARR_GET(current->statements, i));
+    return;
+  }
+
+  struct IndexKey key = *ARR_GET(walk->keys, position);
+  if (key.kind == IndexKeyKind_Wildcard && walk->pattern_variables)
+  {
+    push_index_task(tasks, node, 1, position + 1);
+    return;
+  }
+  for (size_t i = ARR_LENGTH(current->edges); i > 0; --i)
+  {
+    const struct IndexEdge *edge = ARR_GET(current->edges, i - 1);
+    if (edge->key.kind == IndexKeyKind_Wildcard)
+    {
+      /* A variable of the statement, which only fits a variable of the
+         pattern unless it can be bound. */
+      if (walk->statement_variables)
+        push_index_task(tasks, edge->child, 0,
+          *ARR_GET(walk->ends, position));
+      else if (key.kind == IndexKeyKind_Wildcard)
+        push_index_task(tasks, edge->child, 0, position + 1);
+    }
+    else if (keys_equal(edge->key, key))
+    {
+      push_index_task(tasks, edge->child, 0, position + 1);
+    }
+  }
+}
+
+static void
+walk_tree(struct IndexWalk *walk)
+{
+  IndexTaskArray tasks;
+  ARR_INIT(tasks);
+  push_index_task(&tasks, 0, 0, 0);
+  while (ARR_LENGTH(tasks) > 0)
+  {
+    struct IndexTask task = *ARR_GET(tasks, ARR_LENGTH(tasks) - 1);
+    tasks.length -= 1;
+    if (task.remaining == 0)
+      walk_node(walk, &tasks, task.node, task.position);
+    else
+      skip_subterm(walk, &tasks, task);
+  }
+  ARR_FREE(tasks);
+}
+
+/* Exact matching, by unification. Each variable belongs to one side, the
+   pattern (0) or the statement (1), and only the variables of the sides
+   that may be bound are. */
+struct Binding
+{
+  unsigned int side;
+  uint32_t name_id;
+  const Value *value;
+  unsigned int value_side;
+};
+
+struct Unifier
+{
+  bool bindable[2];
+  ARR(struct Binding) bindings;
+};
+
+static const struct Binding *
+find_binding(const struct Unifier *unifier, unsigned int side,
+  uint32_t name_id)
+{
+  for (size_t i = 0; i < ARR_LENGTH(unifier->bindings); ++i)
+  {
+    const struct Binding *binding = ARR_GET(unifier->bindings, i);
+    if (binding->side == side && binding->name_id == name_id)
+      return binding;
+  }
+  return NULL;
+}
+
+static void
+resolve(const struct Unifier *unifier, const Value **value,
+  unsigned int *side)
+{
+  while ((*value)->value_type == ValueTypeVariable)
+  {
+    const struct Binding *binding = find_binding(unifier, *side,
+      (*value)->content.variable_name_id);
+    if (binding == NULL)
+      return;
+    *value = binding->value;
+    *side = binding->value_side;
+  }
+}
+
+/* Values are compared on a stack of their own, as statements can be too
+   deep to recurse into. The side is that of the value, or of the first
+   value of a pair. */
+struct UnifyTask
+{
+  const Value *a;
+  unsigned int side_a;
+  const Value *b;
+  unsigned int side_b;
+};
+typedef ARR(struct UnifyTask) UnifyTaskArray;
+
+static void
+push_unify_task(UnifyTaskArray *tasks, const Value *a, unsigned int side_a,
+  const Value *b, unsigned int side_b)
+{
+  struct UnifyTask task;
+  task.a = a;
+  task.side_a = side_a;
+  task.b = b;
+  task.side_b = side_b;
+  ARR_APPEND(*tasks, task);
+}
+
+static bool
+occurs_in(const struct Unifier *unifier, unsigned int side, uint32_t name_id,
+  const Value *value, unsigned int value_side)
+{
+  UnifyTaskArray tasks;
+  bool occurs = FALSE;
+  ARR_INIT(tasks);
+  push_unify_task(&tasks, value, value_side, NULL, 0);
+  while (ARR_LENGTH(tasks) > 0 && !occurs)
+  {
+    struct UnifyTask task = *ARR_GET(tasks, ARR_LENGTH(tasks) - 1);
+    tasks.length -= 1;
+    resolve(unifier, &task.a, &task.side_a);
+    if (task.a->value_type == ValueTypeVariable)
+    {
+      occurs = task.side_a == side
+        && task.a->content.variable_name_id == name_id;
+      continue;
+    }
+    for (size_t i = VALUE_ARITY(task.a); i > 0; --i)
+      push_unify_task(&tasks, VALUE_ARGUMENT(task.a, i - 1), task.side_a,
+        NULL, 0);
+  }
+  ARR_FREE(tasks);
+  return occurs;
+}
+
+static bool
+bind_variable(struct Unifier *unifier, const Value *variable,
+  unsigned int side, const Value *value, unsigned int value_side)
+{
+  if (variable->type_id != 0 && value->type_id != 0
+      && variable->type_id != value->type_id)
+    return FALSE;
+  if (occurs_in(unifier, side, variable->content.variable_name_id, value,
+      value_side))
+    return FALSE;
+  struct Binding binding;
+  binding.side = side;
+  binding.name_id = variable->content.variable_name_id;
+  binding.value = value;
+  binding.value_side = value_side;
+  ARR_APPEND(unifier->bindings, binding);
+  return TRUE;
+}
+
+/* Unifies a single pair of nodes, pushing the pairs of their arguments
+   last to first so that variables are bound in the order they are met. */
+static bool
+unify_node(struct Unifier *unifier, UnifyTaskArray *tasks,
+  struct UnifyTask task)
+{
+  const Value *a = task.a, *b = task.b;
+  unsigned int side_a = task.side_a, side_b = task.side_b;
+  resolve(unifier, &a, &side_a);
+  resolve(unifier, &b, &side_b);
+  if (a->value_type == ValueTypeVariable && b->value_type == ValueTypeVariable
+      && side_a == side_b
+      && a->content.variable_name_id == b->content.variable_name_id)
+    return TRUE;
+  if (a->value_type == ValueTypeVariable && unifier->bindable[side_a])
+    return bind_variable(unifier, a, side_a, b, side_b);
+  if (b->value_type == ValueTypeVariable && unifier->bindable[side_b])
+    return bind_variable(unifier, b, side_b, a, side_a);
+  if (a->value_type == ValueTypeVariable || b->value_type == ValueTypeVariable)
+    return FALSE;
+  if (a->value_type == ValueTypeComposition
+      && b->value_type == ValueTypeComposition)
+  {
+    if (a->content.composition.expression_id
+        != b->content.composition.expression_id
+        || ARR_LENGTH(a->content.composition.arguments)
+          != ARR_LENGTH(b->content.composition.arguments))
+      return FALSE;
+    for (size_t i = VALUE_ARITY(a); i > 0; --i)
+      push_unify_task(tasks, VALUE_ARGUMENT(a, i - 1), side_a,
+        VALUE_ARGUMENT(b, i - 1), side_b);
+    return TRUE;
+  }
+  return values_equal(a, b);
+}
+
+static bool
+unify(struct Unifier *unifier, const Value *a, unsigned int side_a,
+  const Value *b, unsigned int side_b)
+{
+  UnifyTaskArray tasks;
+  bool unified = TRUE;
+  ARR_INIT(tasks);
+  push_unify_task(&tasks, a, side_a, b, side_b);
+  while (ARR_LENGTH(tasks) > 0 && unified)
+  {
+    struct UnifyTask task = *ARR_GET(tasks, ARR_LENGTH(tasks) - 1);
+    tasks.length -= 1;
+    unified = unify_node(unifier, &tasks, task);
+  }
+  ARR_FREE(tasks);
+  return unified;
+}
+
+size_t
+sl_term_index_query(const sl_TermIndex *index, sl_LogicState *state,
+  const Value *pattern, sl_TermQueryMode mode, sl_TermQueryResults *results)
+{
+  struct IndexWalk walk;
+  struct Unifier unifier;
+  size_t matched;
+
+  walk.index = index;
+  ARR_INIT(walk.keys);
+  flatten_value(pattern, &walk.keys);
+  ARR_INIT_RESERVE(walk.ends, ARR_LENGTH(walk.keys) + 1);
+  walk.ends.length = ARR_LENGTH(walk.keys);
+  compute_ends(&walk, 0);
+  walk.pattern_variables = mode != sl_TermQueryMode_Generalizations;
+  walk.statement_variables = mode != sl_TermQueryMode_Instances;
+  ARR_INIT(walk.candidates);
+  walk_tree(&walk);
+
+  unifier.bindable[0] = walk.pattern_variables;
+  unifier.bindable[1] = walk.statement_variables;
+  ARR_INIT(unifier.bindings);
+  matched = ARR_LENGTH(walk.candidates);
+
+  /* Report statements in the order they were indexed. */
+  for (size_t i = 1; i < ARR_LENGTH(walk.candidates); ++i)
+  {
+    struct sl_TermQueryResult candidate = *ARR_GET(walk.candidates, i);
+    size_t j = i;
+    for (; j > 0; --j)
+    {
+      const struct sl_TermQueryResult *prev = ARR_GET(walk.candidates, j - 1);
+      if (prev->theorem_id < candidate.theorem_id
+          || (prev->theorem_id == candidate.theorem_id
+            && prev->inference < candidate.inference))
+        break;
+      *ARR_GET(walk.candidates, j) = *prev;
+    }
+    *ARR_GET(walk.candidates, j) = candidate;
+  }
+
+  for (size_t i = 0; i < ARR_LENGTH(walk.candidates); ++i)
+  {
+    const struct sl_TermQueryResult *candidate =
+      ARR_GET(walk.candidates, i);
+    const struct Theorem *theorem = (const struct Theorem *)
+      sl_logic_get_symbol_by_id(state, candidate->theorem_id)->object;
+    const Value *statement =
+      *ARR_GET(theorem->inferences, candidate->inference);
+    unifier.bindings.length = 0;
+    if (unify(&unifier, pattern, 0, statement, 1))
+      ARR_APPEND(*results, *candidate);
+  }
+
+  ARR_FREE(unifier.bindings);
+  ARR_FREE(walk.candidates);
+  ARR_FREE(walk.ends);
+  ARR_FREE(walk.keys);
+  return matched;
+}
+
+void
+sl_term_index_print_results(sl_LogicState *state,
+  const sl_TermQueryResults *results, FILE *out)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*results); ++i)
+  {
+    const struct sl_TermQueryResult *result = ARR_GET(*results, i);
+    const sl_LogicSymbol *sym =
+      sl_logic_get_symbol_by_id(state, result->theorem_id);
+    const struct Theorem *theorem = (const struct Theorem *)sym->object;
+    char *path = sl_string_from_symbol_path(state, sym->path);
+    char *statement = string_from_value(state,
+      *ARR_GET(theorem->inferences, result->inference));
+    fprintf(out, "%s: %s\n", path, statement);
+    SL_FREE(statement);
+    SL_FREE(path);
+  }
+}
+
+/* Reading patterns. */
+struct PatternParser
+{
+  sl_LogicState *state;
+  const char *at;
+  bool error;
+};
+
+static void
+pattern_error(struct PatternParser *parser, const char *format,
+  const char *name)
+{
+  char *message;
+  if (parser->error)
+    return;
+  asprintf(&message, format, name);
+  sl_show_file_message("(pattern)", message, sl_MessageType_Error);
+  SL_FREE(message);
+  parser->error = TRUE;
+}
+
+static void
+skip_spaces(struct PatternParser *parser)
+{
+  while (isspace((unsigned char)*parser->at))
+    ++parser->at;
+}
+
+static char *
+read_name(struct PatternParser *parser)
+{
+  const char *begin = parser->at;
+  while (isalnum((unsigned char)*parser->at) || *parser->at == '_')
+    ++parser->at;
+  if (parser->at == begin)
+    return NULL;
+  char *name = SL_MALLOC(parser->at - begin + 1);
+  memcpy(name, begin, parser->at - begin);
+  name[parser->at - begin] = '\0';
+  return name;
+}
+
+static bool
+path_ends_with(const sl_SymbolPath *path, const sl_SymbolPath *suffix)
+{
+  size_t n = ARR_LENGTH(path->segments);
+  size_t m = ARR_LENGTH(suffix->segments);
+  if (m > n)
+    return FALSE;
+  for (size_t i = 0; i < m; ++i)
+  {
+    if (*ARR_GET(path->segments, n - m + i)
+        != *ARR_GET(suffix->segments, i))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* The expression or constant at `path`, or with a path ending in it. */
+static sl_LogicSymbol *
+resolve_pattern_symbol(struct PatternParser *parser,
+  const sl_SymbolPath *path, const char *path_str, uint32_t *id)
+{
+  sl_LogicSymbol *found = NULL;
+  if (sl_logic_get_symbol_id(parser->state, path, id) == sl_LogicError_None)
+    return sl_logic_get_symbol_by_id(parser->state, *id);
+  for (size_t i = 0; i < ARR_LENGTH(parser->state->symbol_table); ++i)
+  {
+    sl_LogicSymbol *sym = ARR_GET(parser->state->symbol_table, i);
+    if ((sym->type != sl_LogicSymbolType_Expression
+        && sym->type != sl_LogicSymbolType_Constant)
+        || !path_ends_with(sym->path, path))
+      continue;
+    if (found != NULL)
+    {
+      pattern_error(parser, "'%s' is ambiguous.", path_str);
+      return NULL;
+    }
+    found = sym;
+    *id = (uint32_t)i;
+  }
+  if (found == NULL)
+    pattern_error(parser, "there is no expression or constant '%s'.",
+      path_str);
+  return found;
+}
+
+static Value *
+parse_pattern_value(struct PatternParser *parser, uint32_t type_id);
+
+static Value *
+parse_pattern_composition(struct PatternParser *parser,
+  uint32_t expression_id, const struct Expression *expression,
+  const char *path_str)
+{
+  Value *value = SL_NEW(Value);
+  value->value_type = ValueTypeComposition;
+  value->type_id = expression->type_id;
+  value->parent = NULL;
+  value->content.composition.expression_id = expression_id;
+  ARR_INIT(value->content.composition.arguments);
+
+  skip_spaces(parser);
+  if (*parser->at == '(')
+  {
+    ++parser->at;
+    skip_spaces(parser);
+    while (!parser->error && *parser->at != ')')
+    {
+      size_t i = ARR_LENGTH(value->content.composition.arguments);
+      if (i > 0)
+      {
+        if (*parser->at != ',')
+        {
+          pattern_error(parser, "expected ',' or ')' in the arguments of '%s'.",
+            path_str);
+          break;
+        }
+        ++parser->at;
+      }
+      if (i >= ARR_LENGTH(expression->parameters))
+      {
+        pattern_error(parser, "too many arguments for '%s'.", path_str);
+        break;
+      }
+      Value *arg = parse_pattern_value(parser,
+        ARR_GET(expression->parameters, i)->type_id);
+      if (arg == NULL)
+        break;
+      arg->parent = value;
+      ARR_APPEND(value->content.composition.arguments, arg);
+      skip_spaces(parser);
+    }
+    if (!parser->error)
+      ++parser->at;
+  }
+  if (!parser->error && ARR_LENGTH(value->content.composition.arguments)
+      != ARR_LENGTH(expression->parameters))
+    pattern_error(parser, "the wrong number of arguments for '%s'.",
+      path_str);
+  if (parser->error)
+  {
+    free_value(value);
+    return NULL;
+  }
+  return value;
+}
+
+static Value *
+parse_pattern_value(struct PatternParser *parser, uint32_t type_id)
+{
+  skip_spaces(parser);
+  if (*parser->at == '$')
+  {
+    ++parser->at;
+    char *name = read_name(parser);
+    if (name == NULL)
+    {
+      pattern_error(parser, "expected a variable name after '%s'.", "$");
+      return NULL;
+    }
+    Value *value = SL_NEW(Value);
+    value->value_type = ValueTypeVariable;
+    value->type_id = type_id;
+    value->parent = NULL;
+    value->content.variable_name_id =
+      logic_state_add_string(parser->state, name);
+    SL_FREE(name);
+    return value;
+  }
+  if (isdigit((unsigned char)*parser->at))
+  {
+    char *digits = read_name(parser);
+    sl_Natural numeral;
+    Value *value = NULL;
+    if (sl_natural_from_string(digits, &numeral) == 0)
+    {
+      value = sl_logic_make_numeral_value_take(parser->state, &numeral);
+      sl_natural_free(&numeral);
+    }
+    if (value == NULL)
+      pattern_error(parser, "cannot read the numeral '%s'.", digits);
+    SL_FREE(digits);
+    return value;
+  }
+
+  sl_SymbolPath *path = sl_new_symbol_path();
+  while (TRUE)
+  {
+    char *segment = read_name(parser);
+    if (segment == NULL)
+    {
+      pattern_error(parser, "expected a value at '%s'.", parser->at);
+      sl_free_symbol_path(path);
+      return NULL;
+    }
+    sl_push_symbol_path(parser->state, path, segment);
+    SL_FREE(segment);
+    if (*parser->at != '.')
+      break;
+    ++parser->at;
+  }
+
+  char *path_str = sl_string_from_symbol_path(parser->state, path);
+  uint32_t id;
+  sl_LogicSymbol *sym = resolve_pattern_symbol(parser, path, path_str, &id);
+  Value *value = NULL;
+  if (sym != NULL && sym->type == sl_LogicSymbolType_Expression)
+    value = parse_pattern_composition(parser, id,
+      (const struct Expression *)sym->object, path_str);
+  else if (sym != NULL && sym->type == sl_LogicSymbolType_Constant)
+    value = new_constant_value(parser->state, sym->path);
+  else if (sym != NULL)
+    pattern_error(parser, "'%s' is not an expression or a constant.",
+      path_str);
+  SL_FREE(path_str);
+  sl_free_symbol_path(path);
+  return value;
+}
+
+Value *
+sl_parse_term_pattern(sl_LogicState *state, const char *text)
+{
+  struct PatternParser parser;
+  parser.state = state;
+  parser.at = text;
+  parser.error = FALSE;
+  Value *value = parse_pattern_value(&parser, 0);
+  skip_spaces(&parser);
+  if (value != NULL && *parser.at != '\0')
+  {
+    pattern_error(&parser, "unexpected '%s' after the pattern.", parser.at);
+    free_value(value);
+    return NULL;
+  }
+  return value;
+}
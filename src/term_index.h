@@ -0,0 +1,80 @@
+#ifndef TERM_INDEX_H
+#define TERM_INDEX_H
+
+#include "logic.h"
+#include <stdio.h>
+
+/* An index of the inferences of the axioms and theorems in a logic state,
+   for finding the ones that fit a pattern without comparing it against every
+   statement in the library.
+
+   The index is a discrimination tree: each statement is filed under the
+   sequence of symbols met in a preorder walk of it, with every variable
+   written as the same wildcard, so that statements sharing a prefix share a
+   path through the tree. A lookup walks the tree along the pattern, only
+   branching where the pattern or a statement has a variable, and the few
+   candidates it reaches are then matched exactly. */
+typedef struct sl_TermIndex sl_TermIndex;
+
+enum sl_TermQueryMode
+{
+  /* Statements that are instances of the pattern. */
+  sl_TermQueryMode_Instances,
+
+  /* Statements of which the pattern is an instance. */
+  sl_TermQueryMode_Generalizations,
+
+  /* Statements that have an instance in common with the pattern. */
+  sl_TermQueryMode_Unifiable
+};
+typedef enum sl_TermQueryMode sl_TermQueryMode;
+
+struct sl_TermQueryResult
+{
+  uint32_t theorem_id; /* The symbol id of the axiom or theorem. */
+  uint32_t inference; /* The index of the inference that fits. */
+};
+typedef ARR(struct sl_TermQueryResult) sl_TermQueryResults;
+
+sl_TermIndex *
+sl_new_term_index();
+
+void
+sl_free_term_index(sl_TermIndex *index);
+
+/* Indexes the axioms and theorems added to `state` since the last update, so
+   the index can be kept up to date as a library loads. After a rollback,
+   `sl_term_index_clear` the index before updating it again. */
+void
+sl_term_index_update(sl_TermIndex *index, sl_LogicState *state);
+
+void
+sl_term_index_clear(sl_TermIndex *index);
+
+size_t
+sl_term_index_count_statements(const sl_TermIndex *index);
+
+/* Appends the statements fitting `pattern` to `results`, in the order in
+   which they were indexed. The variables of the pattern and those of the
+   statements are distinct, even if they have the same names. A variable of
+   the pattern whose type is 0 fits a value of any type. Returns the number
+   of statements that were matched exactly, out of those in the index. */
+size_t
+sl_term_index_query(const sl_TermIndex *index, sl_LogicState *state,
+  const Value *pattern, sl_TermQueryMode mode, sl_TermQueryResults *results);
+
+/* Writes each result as the path of its theorem followed by the statement,
+   one per line. */
+void
+sl_term_index_print_results(sl_LogicState *state,
+  const sl_TermQueryResults *results, FILE *out);
+
+/* Reads a pattern, such as `implies($a, implies($b, $a))`. Paths are looked
+   up in the root namespace, or else by their last segments, if that makes
+   them unique. The type of a variable is that of the parameter it is passed
+   for, or 0 if the whole pattern is a variable. Returns NULL, after showing
+   a message, if the pattern cannot be read. */
+Value *
+sl_parse_term_pattern(sl_LogicState *state, const char *text);
+
+#endif
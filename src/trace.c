@@ -0,0 +1,96 @@
+#include "trace.h"
+#include <stdatomic.h>
+#include <unistd.h>
+
+static FILE *trace_out = NULL;
+static uint64_t trace_start;
+static long trace_pid;
+
+/* Small sequential thread ids, which display better than `pthread_self`. */
+static atomic_uint next_thread_id = 1;
+static _Thread_local unsigned int thread_id = 0;
+
+static unsigned int
+current_thread_id()
+{
+  if (thread_id == 0)
+    thread_id = atomic_fetch_add(&next_thread_id, 1);
+  return thread_id;
+}
+
+int
+sl_trace_open(const char *file_path)
+{
+  if (trace_out != NULL)
+    return 1;
+  trace_out = fopen(file_path, "w");
+  if (trace_out == NULL)
+    return 1;
+  trace_start = sl_wall_clock_ns();
+  trace_pid = (long)getpid();
+
+  /* Every later event is written with a leading comma, so start with the
+     process name. */
+  fprintf(trace_out, "{\"traceEvents\": [\n"
+    "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %ld, \"tid\": %u, "
+    "\"args\": {\"name\": \"sl\"}}", trace_pid, current_thread_id());
+  return 0;
+}
+
+void
+sl_trace_close()
+{
+  if (trace_out == NULL)
+    return;
+  fprintf(trace_out, "\n], \"displayTimeUnit\": \"ms\"}\n");
+  fclose(trace_out);
+  trace_out = NULL;
+}
+
+bool
+sl_tracing()
+{
+  return trace_out != NULL;
+}
+
+static void
+write_event(char phase, const char *category, const char *name)
+{
+  /* Timestamps are in microseconds. */
+  uint64_t now = sl_wall_clock_ns() - trace_start;
+  unsigned int tid = current_thread_id();
+
+  /* Keep each event in one piece when several threads are tracing. */
+  flockfile(trace_out);
+  fprintf(trace_out, ",\n{\"ph\": \"%c\", \"ts\": %llu.%03u, \"pid\": %ld, "
+    "\"tid\": %u", phase, (unsigned long long)(now / 1000),
+    (unsigned int)(now % 1000), trace_pid, tid);
+  if (category != NULL)
+  {
+    fprintf(trace_out, ", \"cat\": ");
+    sl_write_json_string(trace_out, category);
+  }
+  if (name != NULL)
+  {
+    fprintf(trace_out, ", \"name\": ");
+    sl_write_json_string(trace_out, name);
+  }
+  fputc('}', trace_out);
+  funlockfile(trace_out);
+}
+
+void
+sl_trace_begin(const char *category, const char *name)
+{
+  if (trace_out == NULL)
+    return;
+  write_event('B', category, name);
+}
+
+void
+sl_trace_end()
+{
+  if (trace_out == NULL)
+    return;
+  write_event('E', NULL, NULL);
+}
@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+
+/* Timeline tracing in the Chrome trace event format, which can be loaded
+   into chrome://tracing or https://ui.perfetto.dev. Spans are written to the
+   trace file as they begin and end, tagged with the calling thread. All the
+   functions do nothing unless a trace is open. */
+int
+sl_trace_open(const char *file_path);
+
+void
+sl_trace_close();
+
+bool
+sl_tracing();
+
+/* Spans must be properly nested within each thread. */
+void
+sl_trace_begin(const char *category, const char *name);
+
+void
+sl_trace_end();
+
+#endif
@@ -1,5 +1,8 @@
+#include "artifact.h"
 #include "logic.h"
 #include "parse.h"
+#include "profile.h"
+#include "trace.h"
 #include <string.h>
 
 #if defined(__APPLE__) || defined(__linux__)
@@ -13,23 +16,55 @@ struct ValidationState
   bool valid;
 
   char *prefix;
-  ARR(char *) files_opened;
   sl_TextInput *text;
   sl_LogicState *logic;
   sl_SymbolPath *prefix_path;
   ARR(sl_SymbolPath *) search_paths;
   uint32_t next_dummy_id;
+
+  /* The files being loaded, innermost last. */
+  ARR(const char *) loading;
+
+  /* What is noted for the artifact of the file being verified, or NULL if
+     none is to be written for it. */
+  sl_ModuleRecord *record;
 };
 
+static _Thread_local const sl_LoadObserver *load_observer = NULL;
+static _Thread_local bool use_module_artifacts = FALSE;
+
+void
+sl_set_load_observer(const sl_LoadObserver *observer)
+{
+  load_observer = observer;
+}
+
+void
+sl_set_use_module_artifacts(bool use)
+{
+  use_module_artifacts = use;
+}
+
+bool
+sl_get_use_module_artifacts()
+{
+  return use_module_artifacts;
+}
+
 static int
 validate_import(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *import);
 
+static int
+load_file_and_validate(struct ValidationState *state, const char *path);
+
+/* Builds the candidate absolute paths, for a file whose lookups are
+   recorded. */
 static sl_SymbolPath *
-lookup_symbol(struct ValidationState *state, const sl_SymbolPath *path)
+lookup_symbol_recorded(struct ValidationState *state,
+  const sl_SymbolPath *path)
 {
-  /* Build a list of candidate absolute paths. */
-  sl_SymbolPath **paths = malloc(sizeof(sl_SymbolPath *) *
+  sl_SymbolPath **paths = SL_MALLOC(sizeof(sl_SymbolPath *) *
     (ARRAY_LENGTH(state->search_paths) + 1));
   for (size_t i = 0; i < ARRAY_LENGTH(state->search_paths); ++i)
   {
@@ -41,14 +76,42 @@ lookup_symbol(struct ValidationState *state, const sl_SymbolPath *path)
   paths[ARRAY_LENGTH(state->search_paths)] = NULL;
 
   sl_SymbolPath *result = find_first_occupied_path(state->logic, paths);
+  sl_module_record_lookup(state->record, paths, result);
 
   for (size_t i = 0; i < ARRAY_LENGTH(state->search_paths); ++i)
     sl_free_symbol_path(paths[i]);
-  free(paths);
+  SL_FREE(paths);
 
   return result;
 }
 
+static sl_SymbolPath *
+lookup_symbol(struct ValidationState *state, const sl_SymbolPath *path)
+{
+  if (path == NULL)
+    return NULL;
+  if (state->record != NULL)
+    return lookup_symbol_recorded(state, path);
+
+  /* Each search path is probed in the symbol index as it is, with no
+     candidate paths built. A namespace and a `use` of the same path only
+     need to be tried once. */
+  const sl_SymbolPath *previous = NULL;
+  for (size_t i = 0; i < ARRAY_LENGTH(state->search_paths); ++i)
+  {
+    const sl_SymbolPath *search_in =
+      *ARRAY_GET(state->search_paths, sl_SymbolPath *, i);
+    if (previous != NULL && sl_symbol_paths_equal(search_in, previous))
+      continue;
+    previous = search_in;
+    sl_SymbolPath *result =
+      find_occupied_path_in(state->logic, search_in, path);
+    if (result != NULL)
+      return result;
+  }
+  return NULL;
+}
+
 static sl_SymbolPath * extract_path(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *path)
 {
@@ -116,6 +179,7 @@ static int validate_type(struct ValidationState *state,
   bool atomic;
   bool binds;
   bool dummies;
+  bool numerals;
   sl_LogicError err;
 
   if (sl_node_get_type(type) != sl_ASTNodeType_Type)
@@ -132,6 +196,7 @@ static int validate_type(struct ValidationState *state,
   atomic = FALSE;
   binds = FALSE;
   dummies = FALSE;
+  numerals = FALSE;
   for (size_t i = 0; i < sl_node_get_child_count(container, type); ++i) {
     const sl_ASTNode *child = sl_node_get_child(container, type, i);
     if (sl_node_get_type(child) == sl_ASTNodeType_AtomicFlag)
@@ -140,10 +205,20 @@ static int validate_type(struct ValidationState *state,
       binds = TRUE;
     else if (sl_node_get_type(child) == sl_ASTNodeType_DummyFlag)
       dummies = TRUE;
+    else if (sl_node_get_type(child) == sl_ASTNodeType_NumeralsFlag)
+      numerals = TRUE;
   }
 
-  err = sl_logic_make_type(state->logic, type_path, atomic, binds, dummies);
-  if (err != sl_LogicError_None)
+  err = sl_logic_make_type(state->logic, type_path, atomic, binds, dummies,
+    numerals);
+  if (err == sl_LogicError_NumeralTypeExists)
+  {
+    sl_node_show_message(state->text, type,
+      "only one type may hold numerals.",
+      sl_MessageType_Error);
+    state->valid = FALSE;
+  }
+  else if (err != sl_LogicError_None)
   {
     sl_node_show_message(state->text, type,
       "symbol already exists when declaring type.",
@@ -165,7 +240,7 @@ struct Definition
 static void
 free_definition(struct Definition *def)
 {
-  free(def->name);
+  SL_FREE(def->name);
   free_value(def->value);
 
 }
@@ -195,7 +270,8 @@ free_theorem_environment(struct TheoremEnvironment *thm)
   ARR_FREE(thm->definitions);
 }
 
-static Value * extract_value(struct ValidationState *state,
+/* Extracts a value that is not a composition. */
+static Value * extract_value_leaf(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *value,
     const struct TheoremEnvironment *env)
 {
@@ -246,62 +322,25 @@ static Value * extract_value(struct ValidationState *state,
       state->valid = FALSE;
       return NULL;
     }
-  } else if (sl_node_get_type(value) == sl_ASTNodeType_Composition) {
-    /* Locate the corresponding expression, and verify that the types of
-       the arguments match. */
-    const sl_ASTNode *expr, *args_node;
-    sl_SymbolPath *expr_path;
+  } else if (sl_node_get_type(value) == sl_ASTNodeType_Numeral) {
+    sl_Natural numeral;
     Value *v;
-    if (sl_node_get_child_count(container, value) != 2)
-    {
+    /* Numerals are moved out of the tree, which is otherwise only read. */
+    if (sl_node_take_numeral((sl_ASTNode *)value, &numeral) != 0) {
       sl_node_show_message(state->text, value,
-        "a composition node must have two children, the path to the expression and a list of arguments.",
-        sl_MessageType_Error);
+          "a numeral node must have the value of its digits.",
+          sl_MessageType_Error);
       state->valid = FALSE;
       return NULL;
     }
-
-    expr = sl_node_get_child(container, value, 0);
-    args_node = sl_node_get_child(container, value, 1);
-    {
-      sl_SymbolPath *local_path = extract_path(state, container, expr);
-      expr_path = lookup_symbol(state, local_path);
-      sl_free_symbol_path(local_path);
-    }
-
-    if (sl_node_get_type(args_node) != sl_ASTNodeType_ArgumentList)
-    {
-      sl_node_show_message(state->text, args_node,
-        "expected a composition arguments node, but found the wrong type of node.",
-        sl_MessageType_Error);
+    v = sl_logic_make_numeral_value_take(state->logic, &numeral);
+    sl_natural_free(&numeral);
+    if (v == NULL) {
+      sl_node_show_message(state->text, value,
+          "Cannot use a numeral because no type holds numerals.",
+          sl_MessageType_Error);
       state->valid = FALSE;
-      sl_free_symbol_path(expr_path);
-      return NULL;
-    }
-    Value **args =
-        malloc(sizeof(Value *) *
-        (sl_node_get_child_count(container, args_node) + 1));
-    for (size_t i = 0; i < sl_node_get_child_count(container, args_node); ++i)
-    {
-      const sl_ASTNode *child = sl_node_get_child(container, args_node, i);
-      args[i] = extract_value(state, container, child, env);
-      if (args[i] == NULL)
-      {
-        /* TODO: free. */
-        return NULL;
-      }
     }
-    args[sl_node_get_child_count(container, args_node)] = NULL;
-
-    v = new_composition_value(state->logic, expr_path, args);
-
-    for (size_t i = 0; i < sl_node_get_child_count(container, args_node); ++i)
-    {
-      free_value(args[i]);
-    }
-    sl_free_symbol_path(expr_path);
-    free(args);
-
     return v;
   }
   else if (sl_node_get_type(value) == sl_ASTNodeType_Constant)
@@ -406,6 +445,144 @@ static Value * extract_value(struct ValidationState *state,
   }
 }
 
+/* A composition whose arguments are being extracted, which are gathered on
+   a stack of results from `first_result` on. */
+struct ExtractFrame
+{
+  const sl_ASTNode *args_node;
+  size_t arg_count;
+  size_t next;
+  sl_SymbolPath *expr_path;
+  size_t first_result;
+};
+
+/* Checks the shape of a composition node and looks up its expression. */
+static int
+begin_extract_composition(struct ValidationState *state,
+    const sl_ASTContainer *container, const sl_ASTNode *value,
+    struct ExtractFrame *frame)
+{
+  const sl_ASTNode *expr;
+  if (sl_node_get_child_count(container, value) != 2)
+  {
+    sl_node_show_message(state->text, value,
+      "a composition node must have two children, the path to the expression and a list of arguments.",
+      sl_MessageType_Error);
+    state->valid = FALSE;
+    return 1;
+  }
+
+  expr = sl_node_get_child(container, value, 0);
+  frame->args_node = sl_node_get_child(container, value, 1);
+  if (sl_node_get_type(frame->args_node) != sl_ASTNodeType_ArgumentList)
+  {
+    sl_node_show_message(state->text, frame->args_node,
+      "expected a composition arguments node, but found the wrong type of node.",
+      sl_MessageType_Error);
+    state->valid = FALSE;
+    return 1;
+  }
+  {
+    sl_SymbolPath *local_path = extract_path(state, container, expr);
+    frame->expr_path = lookup_symbol(state, local_path);
+    sl_free_symbol_path(local_path);
+  }
+  if (frame->expr_path == NULL)
+  {
+    sl_node_show_message(state->text, expr,
+      "cannot find the expression referenced.", sl_MessageType_Error);
+    state->valid = FALSE;
+    return 1;
+  }
+  frame->arg_count = sl_node_get_child_count(container, frame->args_node);
+  frame->next = 0;
+  return 0;
+}
+
+/* Compositions are extracted with a stack of their own, since a formula
+   may be nested far too deeply to recurse on. The arguments of each are
+   extracted in order and then handed to it. */
+static Value * extract_value(struct ValidationState *state,
+    const sl_ASTContainer *container, const sl_ASTNode *value,
+    const struct TheoremEnvironment *env)
+{
+  ARR(struct ExtractFrame) frames;
+  ARR(Value *) results;
+  struct ExtractFrame frame;
+  Value *result = NULL;
+  bool failed = FALSE;
+
+  if (sl_node_get_type(value) != sl_ASTNodeType_Composition)
+    return extract_value_leaf(state, container, value, env);
+  if (begin_extract_composition(state, container, value, &frame) != 0)
+    return NULL;
+  ARR_INIT(frames);
+  ARR_INIT(results);
+  frame.first_result = 0;
+  ARR_APPEND(frames, frame);
+  while (ARR_LENGTH(frames) > 0)
+  {
+    struct ExtractFrame *top = ARR_GET(frames, ARR_LENGTH(frames) - 1);
+    if (top->next < top->arg_count)
+    {
+      const sl_ASTNode *child =
+        sl_node_get_child(container, top->args_node, top->next++);
+      if (sl_node_get_type(child) == sl_ASTNodeType_Composition)
+      {
+        if (begin_extract_composition(state, container, child, &frame) != 0)
+        {
+          failed = TRUE;
+          break;
+        }
+        frame.first_result = ARR_LENGTH(results);
+        ARR_APPEND(frames, frame);
+      }
+      else
+      {
+        Value *arg = extract_value_leaf(state, container, child, env);
+        if (arg == NULL)
+        {
+          failed = TRUE;
+          break;
+        }
+        ARR_APPEND(results, arg);
+      }
+    }
+    else
+    {
+      /* The arguments become part of the value. */
+      Value *v;
+      ARR_APPEND(results, NULL);
+      top = ARR_GET(frames, ARR_LENGTH(frames) - 1);
+      v = new_composition_value_take(state->logic, top->expr_path,
+        ARR_GET(results, top->first_result));
+      results.length = top->first_result;
+      sl_free_symbol_path(top->expr_path);
+      ARR_POP(frames);
+      if (v == NULL)
+      {
+        failed = TRUE;
+        break;
+      }
+      if (ARR_LENGTH(frames) == 0)
+        result = v;
+      else
+        ARR_APPEND(results, v);
+    }
+  }
+
+  if (failed)
+  {
+    for (size_t i = 0; i < ARR_LENGTH(frames); ++i)
+      sl_free_symbol_path(ARR_GET(frames, i)->expr_path);
+    for (size_t i = 0; i < ARR_LENGTH(results); ++i)
+      free_value(*ARR_GET(results, i));
+  }
+  ARR_FREE(frames);
+  ARR_FREE(results);
+  return result;
+}
+
 static int extract_latex_format(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *latex,
     struct TheoremEnvironment *env, struct PrototypeLatexFormat *dst)
@@ -418,22 +595,22 @@ static int extract_latex_format(struct ValidationState *state,
     return 0;
   }
 
-  dst->segments = malloc(sizeof(struct PrototypeLatexFormatSegment *)
+  dst->segments = SL_MALLOC(sizeof(struct PrototypeLatexFormatSegment *)
       * (sl_node_get_child_count(container, latex) + 1));
   for (size_t i = 0; i < sl_node_get_child_count(container, latex); ++i) {
     const sl_ASTNode *child = sl_node_get_child(container, latex, i);
     if (sl_node_get_type(child) == sl_ASTNodeType_LatexString) {
       struct PrototypeLatexFormatSegment *seg =
-          malloc(sizeof(struct PrototypeLatexFormatSegment));
+          SL_MALLOC(sizeof(struct PrototypeLatexFormatSegment));
       seg->is_variable = FALSE;
-      seg->string = strdup(sl_node_get_name(child));
+      seg->string = SL_STRDUP(sl_node_get_name(child));
       dst->segments[i] = seg;
     } else if (sl_node_get_type(child) == sl_ASTNodeType_LatexVariable) {
       /* Attempt to extract a value from this. */
       struct PrototypeLatexFormatSegment *seg =
-          malloc(sizeof(struct PrototypeLatexFormatSegment));
+          SL_MALLOC(sizeof(struct PrototypeLatexFormatSegment));
       seg->is_variable = TRUE;
-      seg->string = strdup(sl_node_get_name(child));
+      seg->string = SL_STRDUP(sl_node_get_name(child));
       dst->segments[i] = seg;
     }
   }
@@ -503,7 +680,7 @@ static int validate_constant(struct ValidationState *state,
         sl_free_symbol_path(type_path);
         return 0;
       }
-      latex = strdup(sl_node_get_name(latex_node));
+      latex = SL_STRDUP(sl_node_get_name(latex_node));
     }
   }
 
@@ -515,7 +692,7 @@ static int validate_constant(struct ValidationState *state,
   }
 
   if (latex != NULL)
-    free(latex);
+    SL_FREE(latex);
   sl_free_symbol_path(constant_path);
   sl_free_symbol_path(type_path);
   return 0;
@@ -578,14 +755,14 @@ static int extract_parameter(struct ValidationState *state,
     state->valid = FALSE;
     return 0;
   }
-  dst->name = strdup(sl_node_get_name(parameter));
+  dst->name = SL_STRDUP(sl_node_get_name(parameter));
 
   if (sl_node_get_child_count(container, parameter) != 1) {
     sl_node_show_message(state->text, parameter,
         "a parameter node must have a single child, containing the path to the parameter's type",
         sl_MessageType_Error);
     state->valid = FALSE;
-    free(dst->name);
+    SL_FREE(dst->name);
     return 0;
   }
   type = sl_node_get_child(container, parameter, 0);
@@ -650,10 +827,10 @@ static int validate_expression(struct ValidationState *state,
 
   args_n = sl_node_get_child_count(container, param_list);
   proto.parameters =
-      malloc(sizeof(struct PrototypeParameter *) * (args_n + 1));
+      SL_MALLOC(sizeof(struct PrototypeParameter *) * (args_n + 1));
   for (size_t i = 0; i < args_n; ++i) {
     const sl_ASTNode *param = sl_node_get_child(container, param_list, i);
-    proto.parameters[i] = malloc(sizeof(struct PrototypeParameter));
+    proto.parameters[i] = SL_MALLOC(sizeof(struct PrototypeParameter));
     int err = extract_parameter(state, container, param, proto.parameters[i]);
     ARR_APPEND(env.parameters, *proto.parameters[i]);
     PROPAGATE_ERROR(err); /* TODO: free in case of error. */
@@ -670,7 +847,7 @@ static int validate_expression(struct ValidationState *state,
   if (binds_n == 0) {
     proto.bindings = NULL;
   } else {
-    proto.bindings = malloc(sizeof(Value *) * (binds_n + 1));
+    proto.bindings = SL_MALLOC(sizeof(Value *) * (binds_n + 1));
     size_t binding_index = 0;
     for (size_t i = 0; i < sl_node_get_child_count(container, expression); ++i)
     {
@@ -725,23 +902,23 @@ static int validate_expression(struct ValidationState *state,
   sl_free_symbol_path(proto.expression_path);
   sl_free_symbol_path(proto.expression_type);
   for (size_t i = 0; i < args_n; ++i) {
-    free(proto.parameters[i]->name);
+    SL_FREE(proto.parameters[i]->name);
     sl_free_symbol_path(proto.parameters[i]->type);
-    free(proto.parameters[i]);
+    SL_FREE(proto.parameters[i]);
   }
-  free(proto.parameters);
+  SL_FREE(proto.parameters);
   if (proto.bindings != NULL) {
     for (Value **binding = proto.bindings; *binding != NULL; ++binding)
       free_value(*binding);
-    free(proto.bindings);
+    SL_FREE(proto.bindings);
   }
   if (proto.latex.segments != NULL) {
     for (struct PrototypeLatexFormatSegment **seg = proto.latex.segments;
         *seg != NULL; ++seg) {
-      free((*seg)->string);
-      free((*seg));
+      SL_FREE((*seg)->string);
+      SL_FREE((*seg));
     }
-    free(proto.latex.segments);
+    SL_FREE(proto.latex.segments);
   }
   if (proto.replace_with != NULL) {
     free_value(proto.replace_with);
@@ -755,14 +932,14 @@ static struct PrototypeRequirement * extract_require(
     const sl_ASTNode *require, struct TheoremEnvironment *env)
 {
   struct PrototypeRequirement *dst =
-      malloc(sizeof(struct PrototypeRequirement));
+      SL_MALLOC(sizeof(struct PrototypeRequirement));
   const sl_ASTNode *args;
   if (sl_node_get_type(require) != sl_ASTNodeType_Require) {
     sl_node_show_message(state->text, require,
         "expected a requirement but found the wrong type of node.",
         sl_MessageType_Error);
     state->valid = FALSE;
-    free(dst);
+    SL_FREE(dst);
     return NULL;
   }
   if (sl_node_get_child_count(container, require) != 1) {
@@ -770,14 +947,14 @@ static struct PrototypeRequirement * extract_require(
         "a requirement node should have exactly one child, its list of arguments.",
         sl_MessageType_Error);
     state->valid = FALSE;
-    free(dst);
+    SL_FREE(dst);
     return NULL;
   }
 
-  dst->require = strdup(sl_node_get_name(require));
+  dst->require = SL_STRDUP(sl_node_get_name(require));
   args = sl_node_get_child(container, require, 0);
   dst->arguments =
-      malloc(sizeof(Value *) * (sl_node_get_child_count(container, args) + 1));
+      SL_MALLOC(sizeof(Value *) * (sl_node_get_child_count(container, args) + 1));
   for (size_t i = 0; i < sl_node_get_child_count(container, args); ++i) {
     const sl_ASTNode *child = sl_node_get_child(container, args, i);
     dst->arguments[i] = extract_value(state, container, child, env);
@@ -809,10 +986,10 @@ static int extract_definition(struct ValidationState *state,
   }
 
   value_node = sl_node_get_child(container, definition, 0);
-  def.name = strdup(sl_node_get_name(definition));
+  def.name = SL_STRDUP(sl_node_get_name(definition));
   def.value = extract_value(state, container, value_node, env);
   if (def.value == NULL) {
-    free(def.name);
+    SL_FREE(def.name);
     return 1;
   }
   ARR_APPEND(env->definitions, def);
@@ -869,6 +1046,21 @@ static Value * extract_inference(struct ValidationState *state,
   return extract_value(state, container, value_node, env);
 }
 
+/* After a prototype is handed to `add_axiom_take` or `add_theorem_take`,
+   frees the values of one of its lists that come after a value that could
+   not be extracted: the NULL left in its place ends the list early, so the
+   logic state never took them. */
+static void free_values_not_taken(Value **values, size_t n)
+{
+  size_t i = 0;
+  while (i < n && values[i] != NULL)
+    ++i;
+  for (; i < n; ++i) {
+    if (values[i] != NULL)
+      free_value(values[i]);
+  }
+}
+
 static int validate_axiom(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *axiom)
 {
@@ -904,11 +1096,11 @@ static int validate_axiom(struct ValidationState *state,
       ++inferences_n;
   }
   proto.requirements =
-      malloc(sizeof(struct PrototypeRequirement *) * (requirements_n + 1));
+      SL_MALLOC(sizeof(struct PrototypeRequirement *) * (requirements_n + 1));
   proto.assumptions =
-      malloc(sizeof(Value *) * (assumptions_n + 1));
+      SL_MALLOC(sizeof(Value *) * (assumptions_n + 1));
   proto.inferences =
-      malloc(sizeof(Value *) * (inferences_n + 1));
+      SL_MALLOC(sizeof(Value *) * (inferences_n + 1));
 
   init_theorem_environment(&env);
   param_list = sl_node_get_child(container, axiom, 0);
@@ -923,10 +1115,10 @@ static int validate_axiom(struct ValidationState *state,
 
   args_n = sl_node_get_child_count(container, param_list);
   proto.parameters =
-      malloc(sizeof(struct PrototypeParameter *) * (args_n + 1));
+      SL_MALLOC(sizeof(struct PrototypeParameter *) * (args_n + 1));
   for (size_t i = 0; i < args_n; ++i) {
     const sl_ASTNode *param = sl_node_get_child(container, param_list, i);
-    proto.parameters[i] = malloc(sizeof(struct PrototypeParameter));
+    proto.parameters[i] = SL_MALLOC(sizeof(struct PrototypeParameter));
     int err = extract_parameter(state, container, param, proto.parameters[i]);
     ARR_APPEND(env.parameters, *proto.parameters[i]);
     PROPAGATE_ERROR(err);
@@ -964,7 +1156,9 @@ static int validate_axiom(struct ValidationState *state,
   proto.assumptions[assumptions_n] = NULL;
   proto.inferences[inferences_n] = NULL;
 
-  err = add_axiom(state->logic, proto);
+  /* The values in the prototype are handed over, so only the lists holding
+     them are freed here. */
+  err = add_axiom_take(state->logic, proto);
   if (err != sl_LogicError_None) {
     sl_node_show_message(state->text, axiom,
         "cannot add axiom to logic state.",
@@ -974,31 +1168,41 @@ static int validate_axiom(struct ValidationState *state,
 
   sl_free_symbol_path(proto.theorem_path);
   for (size_t i = 0; i < args_n; ++i) {
-    free(proto.parameters[i]->name);
+    SL_FREE(proto.parameters[i]->name);
     sl_free_symbol_path(proto.parameters[i]->type);
-    free(proto.parameters[i]);
+    SL_FREE(proto.parameters[i]);
   }
   for (size_t i = 0; i < requirements_n; ++i) {
-    free(proto.requirements[i]->require);
-    for (Value **arg = proto.requirements[i]->arguments; *arg != NULL; ++arg) {
-      free_value(*arg);
-    }
-    free(proto.requirements[i]->arguments);
-    free(proto.requirements[i]);
-  }
-  for (size_t i = 0; i < assumptions_n; ++i) {
-    free_value(proto.assumptions[i]);
-  }
-  for (size_t i = 0; i < inferences_n; ++i) {
-    free_value(proto.inferences[i]);
-  }
-  free(proto.parameters);
-  free(proto.requirements);
-  free(proto.assumptions);
-  free(proto.inferences);
+    SL_FREE(proto.requirements[i]->require);
+    SL_FREE(proto.requirements[i]->arguments);
+    SL_FREE(proto.requirements[i]);
+  }
+  free_values_not_taken(proto.assumptions, assumptions_n);
+  free_values_not_taken(proto.inferences, inferences_n);
+  SL_FREE(proto.parameters);
+  SL_FREE(proto.requirements);
+  SL_FREE(proto.assumptions);
+  SL_FREE(proto.inferences);
   return 0;
 }
 
+/* Whether a step's argument is `_`, which leaves it to be inferred. */
+static bool argument_omitted(const sl_ASTContainer *container,
+    const sl_ASTNode *arg)
+{
+  const sl_ASTNode *path, *segment;
+  if (sl_node_get_type(arg) != sl_ASTNodeType_Constant
+      || sl_node_get_child_count(container, arg) != 1)
+    return FALSE;
+  path = sl_node_get_child(container, arg, 0);
+  if (sl_node_get_type(path) != sl_ASTNodeType_Path
+      || sl_node_get_child_count(container, path) != 1)
+    return FALSE;
+  segment = sl_node_get_child(container, path, 0);
+  return sl_node_get_type(segment) == sl_ASTNodeType_PathSegment
+    && strcmp(sl_node_get_name(segment), "_") == 0;
+}
+
 static struct PrototypeProofStep * extract_step(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *step,
     struct TheoremEnvironment *env)
@@ -1043,11 +1247,16 @@ static struct PrototypeProofStep * extract_step(struct ValidationState *state,
     sl_SymbolPath *local_path = extract_path(state, container, thm_ref_path);
     dst->theorem_path = lookup_symbol(state, local_path);
     sl_free_symbol_path(local_path);
+    if (dst->theorem_path == NULL) {
+      sl_node_show_message(state->text, thm_ref_path,
+          "cannot find the theorem referenced.", sl_MessageType_Error);
+      state->valid = FALSE;
+    }
   }
 
   /* Next, extract all the arguments being passed to the theorem. */
   arg_list = sl_node_get_child(container, thm_ref, 1);
-  dst->arguments = malloc(sizeof(Value *) *
+  dst->arguments = SL_MALLOC(sizeof(Value *) *
       (sl_node_get_child_count(container, arg_list) + 1));
   if (sl_node_get_type(arg_list) != sl_ASTNodeType_ArgumentList) {
     sl_node_show_message(state->text, arg_list,
@@ -1057,15 +1266,42 @@ static struct PrototypeProofStep * extract_step(struct ValidationState *state,
     /* TODO: free. */
     return NULL;
   }
-  for (size_t i = 0; i < sl_node_get_child_count(container, arg_list); ++i) {
+  dst->arguments_n = sl_node_get_child_count(container, arg_list);
+  for (size_t i = 0; i < dst->arguments_n; ++i) {
     const sl_ASTNode *arg = sl_node_get_child(container, arg_list, i);
+    if (argument_omitted(container, arg)) {
+      dst->arguments[i] = NULL;
+      continue;
+    }
     dst->arguments[i] = extract_value(state, container, arg, env);
+    if (dst->arguments[i] == NULL && dst->theorem_path != NULL) {
+      /* Do not let a bad argument pass for one that was left out. */
+      sl_free_symbol_path(dst->theorem_path);
+      dst->theorem_path = NULL;
+    }
   }
-  dst->arguments[sl_node_get_child_count(container, arg_list)] = NULL;
+  dst->arguments[dst->arguments_n] = NULL;
 
   return dst;
 }
 
+/* The `index`-th child of `node` of type `type`, or `node` itself if there
+   are fewer. */
+static const sl_ASTNode *
+nth_child_of_type(const sl_ASTContainer *container, const sl_ASTNode *node,
+    sl_ASTNodeType type, size_t index)
+{
+  for (size_t i = 0; i < sl_node_get_child_count(container, node); ++i) {
+    const sl_ASTNode *child = sl_node_get_child(container, node, i);
+    if (sl_node_get_type(child) != type)
+      continue;
+    if (index == 0)
+      return child;
+    --index;
+  }
+  return node;
+}
+
 static int validate_theorem(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *theorem)
 {
@@ -1104,13 +1340,13 @@ static int validate_theorem(struct ValidationState *state,
       ++steps_n;
   }
   proto.requirements =
-      malloc(sizeof(struct PrototypeRequirement *) * (requirements_n + 1));
+      SL_MALLOC(sizeof(struct PrototypeRequirement *) * (requirements_n + 1));
   proto.assumptions =
-      malloc(sizeof(Value *) * (assumptions_n + 1));
+      SL_MALLOC(sizeof(Value *) * (assumptions_n + 1));
   proto.inferences =
-      malloc(sizeof(Value *) * (inferences_n + 1));
+      SL_MALLOC(sizeof(Value *) * (inferences_n + 1));
   proto.steps =
-      malloc(sizeof(struct PrototypeProofStep) * (steps_n + 1));
+      SL_MALLOC(sizeof(struct PrototypeProofStep) * (steps_n + 1));
 
   param_list = sl_node_get_child(container, theorem, 0);
   init_theorem_environment(&env);
@@ -1125,10 +1361,10 @@ static int validate_theorem(struct ValidationState *state,
 
   args_n = sl_node_get_child_count(container, param_list);
   proto.parameters =
-      malloc(sizeof(struct PrototypeParameter *) * (args_n + 1));
+      SL_MALLOC(sizeof(struct PrototypeParameter *) * (args_n + 1));
   for (size_t i = 0; i < args_n; ++i) {
     const sl_ASTNode *param = sl_node_get_child(container, param_list, i);
-    proto.parameters[i] = malloc(sizeof(struct PrototypeParameter));
+    proto.parameters[i] = SL_MALLOC(sizeof(struct PrototypeParameter));
     int err = extract_parameter(state, container, param, proto.parameters[i]);
     ARR_APPEND(env.parameters, *proto.parameters[i]);
     PROPAGATE_ERROR(err);
@@ -1153,9 +1389,6 @@ static int validate_theorem(struct ValidationState *state,
       } else if (sl_node_get_type(child) == sl_ASTNodeType_Assume) {
         proto.assumptions[assume_index] =
             extract_assumption(state, container, child, &env);
-        char *str = string_from_value(state->logic,
-            proto.assumptions[assume_index]);
-        free(str);
         ++assume_index;
       } else if (sl_node_get_type(child) == sl_ASTNodeType_Infer) {
         proto.inferences[infer_index] =
@@ -1174,51 +1407,61 @@ static int validate_theorem(struct ValidationState *state,
   proto.inferences[inferences_n] = NULL;
   proto.steps[steps_n] = NULL;
 
-  err = add_theorem(state->logic, proto);
+  /* The values in the prototype are handed over, so only the lists holding
+     them are freed here. */
+  err = add_theorem_take(state->logic, proto);
   if (err != sl_LogicError_None) {
-    sl_node_show_message(state->text, theorem,
-        "cannot add theorem to logic state.",
-        sl_MessageType_Error);
+    /* Point at the step or inference that failed, if there is one. */
+    size_t step, inference;
+    const char *failure = sl_logic_get_theorem_failure(state->logic,
+        &step, &inference);
+    const sl_ASTNode *at = theorem;
+    char *message;
+    if (step != SIZE_MAX)
+      at = nth_child_of_type(container, theorem, sl_ASTNodeType_Step, step);
+    else if (inference != SIZE_MAX)
+      at = nth_child_of_type(container, theorem, sl_ASTNodeType_Infer,
+          inference);
+    if (failure != NULL)
+      asprintf(&message, "cannot add theorem to logic state: %s", failure);
+    else
+      message = SL_STRDUP("cannot add theorem to logic state.");
+    sl_node_show_message(state->text, at, message, sl_MessageType_Error);
+    SL_FREE(message);
     state->valid = FALSE;
   }
 
   sl_free_symbol_path(proto.theorem_path);
   for (size_t i = 0; i < args_n; ++i) {
-    free(proto.parameters[i]->name);
+    SL_FREE(proto.parameters[i]->name);
     sl_free_symbol_path(proto.parameters[i]->type);
-    free(proto.parameters[i]);
+    SL_FREE(proto.parameters[i]);
   }
   for (size_t i = 0; i < requirements_n; ++i) {
-    free(proto.requirements[i]->require);
-    for (Value **arg = proto.requirements[i]->arguments; *arg != NULL; ++arg) {
-      free_value(*arg);
-    }
-    free(proto.requirements[i]->arguments);
-    free(proto.requirements[i]);
-  }
-  for (size_t i = 0; i < assumptions_n; ++i) {
-    free_value(proto.assumptions[i]);
-  }
-  for (size_t i = 0; i < inferences_n; ++i) {
-    free_value(proto.inferences[i]);
+    SL_FREE(proto.requirements[i]->require);
+    SL_FREE(proto.requirements[i]->arguments);
+    SL_FREE(proto.requirements[i]);
   }
+  free_values_not_taken(proto.assumptions, assumptions_n);
+  free_values_not_taken(proto.inferences, inferences_n);
   for (size_t i = 0; i < steps_n; ++i) {
     sl_free_symbol_path(proto.steps[i]->theorem_path);
-    for (Value **v = proto.steps[i]->arguments; *v != NULL; ++v)
-      free_value(*v);
-    free(proto.steps[i]->arguments);
-    free(proto.steps[i]);
+    SL_FREE(proto.steps[i]->arguments);
+    SL_FREE(proto.steps[i]);
   }
-  free(proto.requirements);
-  free(proto.parameters);
-  free(proto.assumptions);
-  free(proto.inferences);
-  free(proto.steps);
+  SL_FREE(proto.requirements);
+  SL_FREE(proto.parameters);
+  SL_FREE(proto.assumptions);
+  SL_FREE(proto.inferences);
+  SL_FREE(proto.steps);
 
   return 0;
 }
 
 static int validate_namespace(struct ValidationState *state,
+    const sl_ASTContainer *container, const sl_ASTNode *namespace);
+
+static int validate_namespace_impl(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *namespace)
 {
   sl_LogicError err;
@@ -1238,6 +1481,11 @@ static int validate_namespace(struct ValidationState *state,
          we have an issue. */
       const sl_LogicSymbol *sym = sl_logic_get_symbol(state->logic,
           state->prefix_path);
+      if (state->record != NULL) {
+        sl_SymbolPath *candidates[] = { state->prefix_path, NULL };
+        sl_module_record_lookup(state->record, candidates,
+            (sym != NULL) ? state->prefix_path : NULL);
+      }
       if (sym == NULL) {
         err = sl_logic_make_namespace(state->logic, state->prefix_path);
         if (err != sl_LogicError_None)
@@ -1321,56 +1569,83 @@ static int validate_namespace(struct ValidationState *state,
   return 0;
 }
 
-static int load_file_and_validate(struct ValidationState *state,
-    const char *path) {
-  /* TODO: check that the path is accessible and report this error. */
-  sl_TextInput *input;
-  sl_LexerState *lex;
-  sl_ASTContainer *ast;
-  char *old_prefix = state->prefix;
-  char *absolute_path;
-  int err;
-  if (path == NULL) {
-    state->valid = FALSE;
-    return 0;
-  }
+static int validate_namespace(struct ValidationState *state,
+    const sl_ASTContainer *container, const sl_ASTNode *namespace)
+{
+  const char *name = sl_node_get_name(namespace);
+  sl_trace_begin("namespace", name != NULL ? name : "(root)");
+  int err = validate_namespace_impl(state, container, namespace);
+  sl_trace_end();
+  return err;
+}
+
+/* What `begin_input` saves, to be restored by `end_input`. */
+struct InputScope
+{
+  char *old_prefix;
+  bool old_valid;
+};
+
+/* Starts loading the file at `absolute_path`: its imports are resolved
+   relative to its directory, and its validity is tracked on its own. */
+static void
+begin_input(struct ValidationState *state, const char *absolute_path,
+    struct InputScope *scope)
+{
+  scope->old_prefix = state->prefix;
+  scope->old_valid = state->valid;
 
   /* Establish the prefix path by taking the global path of the directory
      containing the target file. */
 #if defined(__APPLE__) || defined(__linux__)
-  if (state->prefix == NULL) {
-    char full_path[PATH_MAX];
-    if (realpath(path, full_path) == NULL) {
-      /* TODO: error. */
-      return 0;
-    }
-    absolute_path = strdup(full_path);
-  } else {
-    asprintf(&absolute_path, "%s/%s", state->prefix, path);
-  }
   {
-    char *absolute_path_copy = strdup(absolute_path);
-    state->prefix = strdup(dirname(absolute_path_copy));
-    free(absolute_path_copy);
+    char *absolute_path_copy = SL_STRDUP(absolute_path);
+    state->prefix = SL_STRDUP(dirname(absolute_path_copy));
+    SL_FREE(absolute_path_copy);
   }
 #endif
+  ARR_APPEND(state->loading, absolute_path);
+  state->valid = TRUE;
+  if (load_observer != NULL && load_observer->begin != NULL)
+    load_observer->begin(absolute_path,
+      sl_get_symbol_path_length(state->prefix_path) == 0,
+      load_observer->user_data);
+}
 
-  for (size_t i = 0; i < ARR_LENGTH(state->files_opened); ++i) {
-    if (strcmp(absolute_path, *ARR_GET(state->files_opened, i)) == 0) {
-      free(absolute_path);
-      free(state->prefix);
-      state->prefix = old_prefix;
-      return 0;
-    }
-  }
-  ARR_APPEND(state->files_opened, strdup(absolute_path));
+/* A file only counts as loaded once it has been validated, so that rolling
+   the logic state back to before a file was finished also forgets that the
+   file was loaded. */
+static void
+end_input(struct ValidationState *state, const char *absolute_path,
+    const struct InputScope *scope)
+{
+  if (state->prefix != scope->old_prefix)
+    SL_FREE(state->prefix);
+  state->prefix = scope->old_prefix;
+  ARR_POP(state->loading);
+  sl_logic_add_loaded_file(state->logic, absolute_path);
+  if (load_observer != NULL && load_observer->end != NULL)
+    load_observer->end(absolute_path, state->valid, load_observer->user_data);
+  state->valid = scope->old_valid && state->valid;
+}
 
-  input = sl_input_from_file(absolute_path);
-  if (input == NULL) {
-    /* TODO: report error. */
-    state->valid = FALSE;
-    return 0;
+static bool
+file_loading(const struct ValidationState *state, const char *absolute_path)
+{
+  for (size_t i = 0; i < ARR_LENGTH(state->loading); ++i)
+  {
+    if (strcmp(*ARR_GET(state->loading, i), absolute_path) == 0)
+      return TRUE;
   }
+  return FALSE;
+}
+
+/* Parses and validates `input`, the contents of the file being loaded.
+   Takes ownership of the input. */
+static int validate_text(struct ValidationState *state, sl_TextInput *input) {
+  sl_LexerState *lex;
+  sl_ASTContainer *ast;
+  int err;
 
   lex = sl_lexer_new_state_with_input(input);
   if (lex == NULL) {
@@ -1380,7 +1655,9 @@ static int load_file_and_validate(struct ValidationState *state,
     return 0;
   }
 
+  sl_profile_begin(sl_ProfilePhase_Parse);
   ast = sl_parse_input(lex, &err);
+  sl_profile_end();
   if (ast == NULL) {
     /* TODO: report error. */
     sl_input_free(input);
@@ -1391,24 +1668,183 @@ static int load_file_and_validate(struct ValidationState *state,
   if (err != 0)
     state->valid = FALSE;
 
-  {
-    sl_TextInput *old_input = state->text;
-    state->text = input;
-    state->text = old_input;
-  }
+  sl_TextInput *old_input = state->text;
+  state->text = input;
+  sl_profile_begin(sl_ProfilePhase_Validate);
   int result = validate_namespace(state, ast, sl_ast_container_get_root(ast));
+  sl_profile_end();
+  state->text = old_input;
 
   sl_input_free(input);
   sl_lexer_free_state(lex);
   sl_ast_container_free(ast);
-  free(absolute_path);
 
-  free(state->prefix);
-  state->prefix = old_prefix;
+  if (result != 0)
+    state->valid = FALSE;
+  return result;
+}
+
+/* Parses and validates `input`, the contents of the file at `absolute_path`.
+   Takes ownership of the input. */
+static int validate_input(struct ValidationState *state,
+    const char *absolute_path, sl_TextInput *input) {
+  struct InputScope scope;
+  begin_input(state, absolute_path, &scope);
+  int result = validate_text(state, input);
+  end_input(state, absolute_path, &scope);
+  return result;
+}
+
+/* True if nothing around an import affects what the imported file adds: it
+   is made outside of any namespace, and nothing is in use. Only such files
+   have artifacts, since they add the same symbols wherever they are
+   imported from. */
+static bool
+import_context_free(const struct ValidationState *state)
+{
+  if (sl_get_symbol_path_length(state->prefix_path) != 0)
+    return FALSE;
+  for (size_t i = 0; i < ARR_LENGTH(state->search_paths); ++i)
+  {
+    if (sl_get_symbol_path_length(*ARR_GET(state->search_paths, i)) != 0)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Like `validate_input`, for an imported file: it is loaded from its
+   artifact if it has one that fits, and otherwise it is validated, and if
+   it is valid, its artifact is written. Takes ownership of the input. */
+static int validate_module(struct ValidationState *state,
+    const char *absolute_path, sl_TextInput *input) {
+  sl_ModuleRecord *old_record = state->record;
+  sl_ModuleArtifact *artifact = sl_read_module_artifact(absolute_path);
+  struct InputScope scope;
+  int result = 0;
+
+  begin_input(state, absolute_path, &scope);
+  state->record = NULL;
+  if (artifact != NULL) {
+    bool loaded = FALSE;
+    sl_trace_begin("artifact", absolute_path);
+    for (size_t i = 0; i < sl_module_artifact_count_imports(artifact)
+        && result == 0; ++i) {
+      result = load_file_and_validate(state,
+          sl_module_artifact_get_import(artifact, i));
+    }
+    if (result == 0 && state->valid)
+      loaded = sl_module_artifact_add_to_state(artifact, state->logic) == 0;
+    sl_trace_end();
+    sl_free_module_artifact(artifact);
+    if (loaded || result != 0 || !state->valid) {
+      sl_input_free(input);
+      state->record = old_record;
+      end_input(state, absolute_path, &scope);
+      return result;
+    }
+  }
 
+  /* The imports that were loaded above are not loaded again, and do not
+     belong to the file. */
+  state->record = sl_new_module_record(state->logic);
+  result = validate_text(state, input);
+  if (result == 0 && state->valid)
+    sl_module_record_write(state->record, state->logic, absolute_path);
+  sl_free_module_record(state->record);
+  state->record = old_record;
+  end_input(state, absolute_path, &scope);
   return result;
 }
 
+/* Resolves `path`, relative to the directory of the file being validated if
+   there is one, to an absolute path. Returns NULL if there is no such file. */
+static char *
+resolve_path(const struct ValidationState *state, const char *path)
+{
+#if defined(__APPLE__) || defined(__linux__)
+  char full_path[PATH_MAX];
+  char *joined = NULL;
+  char *result;
+  if (state->prefix != NULL && path[0] != '/')
+  {
+    asprintf(&joined, "%s/%s", state->prefix, path);
+    path = joined;
+  }
+  result = realpath(path, full_path);
+  if (joined != NULL)
+    SL_FREE(joined);
+  if (result == NULL)
+    return NULL;
+  return SL_STRDUP(full_path);
+#else
+  return SL_STRDUP(path);
+#endif
+}
+
+static int load_file_and_validate_impl(struct ValidationState *state,
+    const char *path) {
+  sl_TextInput *input;
+  char *absolute_path;
+  int result;
+  if (path == NULL) {
+    state->valid = FALSE;
+    return 0;
+  }
+
+  absolute_path = resolve_path(state, path);
+  if (absolute_path == NULL) {
+    sl_show_file_message(path, "cannot find file.", sl_MessageType_Error);
+    state->valid = FALSE;
+    return 0;
+  }
+
+  if (ARR_LENGTH(state->loading) > 0 && load_observer != NULL
+      && load_observer->import != NULL)
+    load_observer->import(*ARR_GET(state->loading,
+      ARR_LENGTH(state->loading) - 1), absolute_path,
+      load_observer->user_data);
+
+  /* Files that are already part of the logic state, or that are being loaded
+     further up, are not validated again, so importing a file twice (or in a
+     cycle) is harmless. A file in a cycle depends on more than its artifact
+     would say, though. */
+  if (file_loading(state, absolute_path)) {
+    if (state->record != NULL)
+      sl_module_record_disable(state->record);
+    SL_FREE(absolute_path);
+    return 0;
+  }
+  if (sl_logic_file_loaded(state->logic, absolute_path)) {
+    SL_FREE(absolute_path);
+    return 0;
+  }
+
+  input = sl_input_from_file(absolute_path);
+  if (input == NULL) {
+    sl_show_file_message(absolute_path, "cannot open file.",
+      sl_MessageType_Error);
+    SL_FREE(absolute_path);
+    state->valid = FALSE;
+    return 0;
+  }
+
+  if (use_module_artifacts && ARR_LENGTH(state->loading) > 0
+      && import_context_free(state))
+    result = validate_module(state, absolute_path, input);
+  else
+    result = validate_input(state, absolute_path, input);
+  SL_FREE(absolute_path);
+  return result;
+}
+
+static int load_file_and_validate(struct ValidationState *state,
+    const char *path) {
+  sl_trace_begin("file", path != NULL ? path : "(null)");
+  int err = load_file_and_validate_impl(state, path);
+  sl_trace_end();
+  return err;
+}
+
 static int validate_import(struct ValidationState *state,
     const sl_ASTContainer *container, const sl_ASTNode *import)
 {
@@ -1421,32 +1857,102 @@ static int validate_import(struct ValidationState *state,
     return 0;
   }
 
-  return load_file_and_validate(state, sl_node_get_name(import));
+  /* The artifact of the file doing the importing replays its imports at the
+     root, before anything else. */
+  const char *name = sl_node_get_name(import);
+  sl_ModuleRecord *record = state->record;
+  if (record != NULL) {
+    if (name == NULL || !import_context_free(state)) {
+      sl_module_record_disable(record);
+    } else {
+      sl_module_record_begin_import(record, state->logic, name);
+    }
+  }
+  int err = load_file_and_validate(state, name);
+  if (record != NULL)
+    sl_module_record_end_import(record, state->logic);
+  return err;
+}
+
+static void
+init_validation_state(struct ValidationState *state, sl_LogicState *logic)
+{
+  state->valid = TRUE;
+  state->prefix_path = sl_new_symbol_path();
+  state->logic = logic;
+  state->prefix = NULL;
+  state->text = NULL;
+  state->next_dummy_id = 0;
+  state->record = NULL;
+  ARR_INIT(state->search_paths);
+  ARR_INIT(state->loading);
+}
+
+static int
+finish_validation_state(struct ValidationState *state, int err)
+{
+  sl_free_symbol_path(state->prefix_path);
+  ARR_FREE(state->search_paths);
+  ARR_FREE(state->loading);
+  if (err != 0)
+    return err;
+  return state->valid ? 0 : 1;
 }
 
 int
 sl_verify_and_add_file(const char *path, sl_LogicState *logic)
 {
   struct ValidationState state;
-  state.valid = TRUE;
-  state.prefix_path = sl_new_symbol_path();
-  state.logic = logic;
-  state.prefix = NULL;
-  state.next_dummy_id = 0;
-  ARR_INIT(state.files_opened);
-  ARR_INIT(state.search_paths);
-
+  init_validation_state(&state, logic);
   int err = load_file_and_validate(&state, path);
+  return finish_validation_state(&state, err);
+}
 
-  sl_free_symbol_path(state.prefix_path);
-  ARR_FREE(state.search_paths);
+int
+sl_verify_and_add_string(const char *path, const char *text,
+  sl_LogicState *logic)
+{
+  struct ValidationState state;
+  char *absolute_path;
+  int err = 0;
+  init_validation_state(&state, logic);
 
-  if (err != 0)
-    return err;
-  if (state.prefix != NULL)
-    free(state.prefix);
-  for (size_t i = 0; i < ARR_LENGTH(state.files_opened); ++i)
-    free(*ARR_GET(state.files_opened, i));
-  ARR_FREE(state.files_opened);
-  return state.valid ? 0 : 1;
+  /* The file need not exist, but its directory must, since imports are
+     resolved relative to it. */
+#if defined(__APPLE__) || defined(__linux__)
+  {
+    char *path_copy = SL_STRDUP(path);
+    char *base_copy = SL_STRDUP(path);
+    char *directory = resolve_path(&state, dirname(path_copy));
+    if (directory == NULL)
+      absolute_path = NULL;
+    else
+      asprintf(&absolute_path, "%s/%s", directory, basename(base_copy));
+    if (directory != NULL)
+      SL_FREE(directory);
+    SL_FREE(path_copy);
+    SL_FREE(base_copy);
+  }
+#else
+  absolute_path = SL_STRDUP(path);
+#endif
+
+  if (absolute_path == NULL) {
+    sl_show_file_message(path, "cannot find the directory of the file.",
+      sl_MessageType_Error);
+    state.valid = FALSE;
+  } else {
+    /* The lexer expects every line, including the last, to end in a
+       newline. */
+    char *terminated;
+    asprintf(&terminated, "%s\n", text);
+    sl_TextInput *input = sl_input_from_string(terminated);
+    sl_input_set_name(input, absolute_path);
+    sl_trace_begin("file", path);
+    err = validate_input(&state, absolute_path, input);
+    sl_trace_end();
+    SL_FREE(terminated);
+    SL_FREE(absolute_path);
+  }
+  return finish_validation_state(&state, err);
 }
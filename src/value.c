@@ -1,40 +1,104 @@
+#define SL_MEMORY_TAG sl_MemoryTag_Values
 #include "core.h"
+#include "profile.h"
+#include "render_cache.h"
 #include <string.h>
 
 void
-free_value(Value *value)
+init_value_walk(struct ValueWalk *walk)
 {
-  if (value->value_type == ValueTypeDummy) {
+  walk->frames = walk->inline_frames;
+  walk->length = 0;
+  walk->capacity = VALUE_WALK_INLINE_FRAMES;
+}
 
-  } if (value->value_type == ValueTypeVariable) {
+void
+free_value_walk(struct ValueWalk *walk)
+{
+  if (walk->frames != walk->inline_frames)
+    SL_FREE(walk->frames);
+}
 
+struct ValueFrame *
+push_value_frame(struct ValueWalk *walk, const Value *value)
+{
+  if (walk->length == walk->capacity)
+  {
+    walk->capacity *= 2;
+    if (walk->frames == walk->inline_frames)
+    {
+      walk->frames = SL_MALLOC(sizeof(struct ValueFrame) * walk->capacity);
+      memcpy(walk->frames, walk->inline_frames,
+        sizeof(struct ValueFrame) * walk->length);
+    }
+    else
+    {
+      walk->frames = SL_REALLOC(walk->frames,
+        sizeof(struct ValueFrame) * walk->capacity);
+    }
   }
-  else if (value->value_type == ValueTypeConstant)
+  struct ValueFrame *frame = &walk->frames[walk->length++];
+  frame->value = value;
+  frame->other = NULL;
+  frame->target = NULL;
+  frame->next = 0;
+  return frame;
+}
+
+/* Frees what the node holds other than its arguments, and the node. */
+static void
+free_value_node(Value *value)
+{
+  if (value->value_type == ValueTypeConstant)
   {
     sl_free_symbol_path(value->content.constant.constant_path);
     if (value->content.constant.constant_latex != NULL)
-      free(value->content.constant.constant_latex);
+      SL_FREE(value->content.constant.constant_latex);
   }
   else if (value->value_type == ValueTypeComposition)
   {
-    for (size_t i = 0; i < ARR_LENGTH(value->content.composition.arguments);
-        ++i) {
-      Value *arg = *ARR_GET(value->content.composition.arguments, i);
-      free_value(arg);
-    }
     ARR_FREE(value->content.composition.arguments);
   }
-  free(value);
+  else if (value->value_type == ValueTypeNumeral)
+  {
+    sl_natural_free(&value->content.numeral);
+  }
+  SL_FREE(value);
 }
 
 void
-copy_value_to(Value *dst, const Value *src)
+free_value(Value *value)
+{
+  struct ValueWalk walk;
+  init_value_walk(&walk);
+  push_value_frame(&walk, value);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    Value *node = (Value *)top->value;
+    if (top->next < VALUE_ARITY(node))
+    {
+      push_value_frame(&walk, VALUE_ARGUMENT(node, top->next++));
+    }
+    else
+    {
+      free_value_node(node);
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+}
+
+/* Copies what the node holds other than its arguments: a composition is
+   left with none, but with room for them. */
+static void
+copy_value_node(Value *dst, const Value *src)
 {
   dst->value_type = src->value_type;
   dst->type_id = src->type_id;
   if (src->value_type == ValueTypeDummy) {
     dst->content.dummy_id = src->content.dummy_id;
-  } if (src->value_type == ValueTypeVariable) {
+  } else if (src->value_type == ValueTypeVariable) {
     dst->content.variable_name_id = src->content.variable_name_id;
   }
   else if (src->value_type == ValueTypeConstant)
@@ -43,24 +107,49 @@ copy_value_to(Value *dst, const Value *src)
         sl_copy_symbol_path(src->content.constant.constant_path);
     if (src->content.constant.constant_latex != NULL)
       dst->content.constant.constant_latex =
-          strdup(src->content.constant.constant_latex);
+          SL_STRDUP(src->content.constant.constant_latex);
     else
       dst->content.constant.constant_latex = NULL;
   }
   else if (src->value_type == ValueTypeComposition)
   {
+    size_t arity = ARR_LENGTH(src->content.composition.arguments);
     dst->content.composition.expression_id =
         src->content.composition.expression_id;
-    ARR_INIT(dst->content.composition.arguments);
-    for (size_t i = 0; i < ARR_LENGTH(src->content.composition.arguments);
-        ++i) {
-      const struct Value *arg =
-          *ARR_GET(src->content.composition.arguments, i);
-      struct Value *arg_copy = copy_value(arg);
-      arg_copy->parent = dst;
-      ARR_APPEND(dst->content.composition.arguments, arg_copy);
+    ARR_INIT_RESERVE(dst->content.composition.arguments,
+      (arity > 0) ? arity : 1);
+  }
+  else if (src->value_type == ValueTypeNumeral)
+  {
+    sl_natural_copy(src->content.numeral, &dst->content.numeral);
+  }
+}
+
+void
+copy_value_to(Value *dst, const Value *src)
+{
+  struct ValueWalk walk;
+  copy_value_node(dst, src);
+  init_value_walk(&walk);
+  push_value_frame(&walk, src)->target = dst;
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next++);
+      Value *arg_copy = SL_NEW(Value);
+      arg_copy->parent = top->target;
+      copy_value_node(arg_copy, arg);
+      ARR_APPEND(top->target->content.composition.arguments, arg_copy);
+      push_value_frame(&walk, arg)->target = arg_copy;
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
     }
   }
+  free_value_walk(&walk);
 }
 
 Value *
@@ -72,8 +161,10 @@ copy_value(const Value *value)
   return v;
 }
 
-bool
-values_equal(const Value *a, const Value *b)
+/* Compares what two nodes hold other than their arguments, and how many
+   arguments they have. */
+static bool
+value_nodes_equal(const Value *a, const Value *b)
 {
   if (a->value_type != b->value_type)
     return FALSE;
@@ -103,307 +194,358 @@ values_equal(const Value *a, const Value *b)
       if (ARR_LENGTH(a->content.composition.arguments)
           != ARR_LENGTH(b->content.composition.arguments))
         return FALSE;
-      for (size_t i = 0; i < ARR_LENGTH(a->content.composition.arguments);
-        ++i) {
-        const Value *arg_a = *ARR_GET(a->content.composition.arguments, i);
-        const Value *arg_b = *ARR_GET(b->content.composition.arguments, i);
-        if (!values_equal(arg_a, arg_b))
-          return FALSE;
-      }
+      break;
+    case ValueTypeNumeral:
+      if (a->type_id != b->type_id)
+        return FALSE;
+      if (!sl_natural_equal(a->content.numeral, b->content.numeral))
+        return FALSE;
       break;
   }
   return TRUE;
 }
 
-bool value_terminal(const sl_LogicState *state, const Value *v)
+bool
+values_equal(const Value *a, const Value *b)
 {
-  switch (v->value_type)
+  struct ValueWalk walk;
+  bool equal = TRUE;
+  if (!value_nodes_equal(a, b))
+    return FALSE;
+  if (VALUE_ARITY(a) == 0)
+    return TRUE;
+  init_value_walk(&walk);
+  push_value_frame(&walk, a)->other = b;
+  while (walk.length > 0)
   {
-    case ValueTypeDummy:
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg_a = VALUE_ARGUMENT(top->value, top->next);
+      const Value *arg_b = VALUE_ARGUMENT(top->other, top->next);
+      top->next += 1;
+      if (!value_nodes_equal(arg_a, arg_b))
       {
-        const sl_LogicSymbol *type_sym = sl_logic_get_symbol_by_id(state,
-            v->type_id);
-        const struct Type *type = (struct Type *)type_sym->object;
-        return type->atomic;
+        equal = FALSE;
+        break;
       }
+      if (VALUE_ARITY(arg_a) > 0)
+        push_value_frame(&walk, arg_a)->other = arg_b;
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+  return equal;
+}
+
+bool value_terminal(const sl_LogicState *state, const Value *v)
+{
+  struct ValueWalk walk;
+  bool terminal = TRUE;
+  init_value_walk(&walk);
+  push_value_frame(&walk, v);
+  while (terminal && walk.length > 0)
+  {
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    switch (node->value_type)
+    {
+      case ValueTypeDummy:
+      case ValueTypeVariable:
+        terminal = (SYMBOL_FLAGS(state, node->type_id) & SYMBOL_ATOMIC) != 0;
+        break;
+      case ValueTypeConstant:
+      case ValueTypeNumeral:
+        break;
+      case ValueTypeComposition:
+        for (size_t i = 0; i < VALUE_ARITY(node); ++i)
+          push_value_frame(&walk, VALUE_ARGUMENT(node, i));
+        break;
+    }
+  }
+  free_value_walk(&walk);
+  return terminal;
+}
+
+/* Writes a node other than a composition. */
+static void
+write_value_leaf(const sl_LogicState *state, const Value *value,
+  sl_StringBuilder *out)
+{
+  switch (value->value_type)
+  {
+    case ValueTypeDummy:
+      sl_string_builder_printf(out, "Dummy #%u", value->content.dummy_id);
       break;
     case ValueTypeConstant:
-      return TRUE;
+      sl_write_symbol_path(state, value->content.constant.constant_path, out);
       break;
     case ValueTypeVariable:
+      sl_string_builder_append_char(out, '$');
+      sl_string_builder_append(out, logic_state_get_string(state,
+          value->content.variable_name_id));
+      break;
+    case ValueTypeNumeral:
       {
-        const sl_LogicSymbol *type_sym = sl_logic_get_symbol_by_id(state,
-            v->type_id);
-        const struct Type *type = (struct Type *)type_sym->object;
-        return type->atomic;
+        char *digits = sl_natural_to_string(value->content.numeral);
+        sl_string_builder_append(out, digits);
+        SL_FREE(digits);
       }
       break;
     case ValueTypeComposition:
-      for (size_t i = 0; i < ARR_LENGTH(v->content.composition.arguments);
-        ++i) {
-        Value *arg = *ARR_GET(v->content.composition.arguments, i);
-        if (!value_terminal(state, arg))
-          return FALSE;
-      }
-      return TRUE;
       break;
   }
 }
 
-char *
-string_from_value(const sl_LogicState *state, const Value *value)
+/* Writes the expression and opening parenthesis of a composition. */
+static void
+write_composition_open(const sl_LogicState *state, const Value *value,
+  sl_StringBuilder *out)
 {
-  switch (value->value_type)
-  {
-    case ValueTypeDummy:
-      {
-        char *dummy_str;
-        asprintf(&dummy_str, "Dummy #%u", value->content.dummy_id);
-        return dummy_str;
-      }
-      break;
-    case ValueTypeComposition:
-      {
-        const sl_LogicSymbol *expr_sym = sl_logic_get_symbol_by_id(state,
-            value->content.composition.expression_id);
-        const struct Expression *expr = (struct Expression *)expr_sym->object;
-        char *expr_str = sl_string_from_symbol_path(state, expr->path);
-        char *str;
-        if (ARR_LENGTH(value->content.composition.arguments) == 0)
-        {
-          size_t len = 3 + strlen(expr_str);
-          str = malloc(len);
-          char *c = str;
-          strcpy(c, expr_str);
-          c += strlen(expr_str);
-          strcpy(c, "()");
-          c += 2;
-          *c = '\0';
-          return str;
-        }
-        else
-        {
-          size_t len = 3 + strlen(expr_str);
-          char **args = malloc(sizeof(char *)
-              * ARR_LENGTH(value->content.composition.arguments));
-          for (size_t i = 0;
-              i < ARR_LENGTH(value->content.composition.arguments); ++i) {
-            const struct Value *arg =
-                *ARR_GET(value->content.composition.arguments, i);
-            args[i] = string_from_value(state, arg);
-            len += strlen(args[i]);
-          }
-          len += (ARR_LENGTH(value->content.composition.arguments) - 1) * 2;
+  const sl_LogicSymbol *expr_sym = sl_logic_get_const_symbol_by_id(state,
+      value->content.composition.expression_id);
+  const struct Expression *expr = (struct Expression *)expr_sym->object;
+  sl_write_symbol_path(state, expr->path, out);
+  sl_string_builder_append_char(out, '(');
+}
 
-          str = malloc(len);
-          char *c = str;
-          strcpy(c, expr_str);
-          c += strlen(expr_str);
-          *c = '(';
-          ++c;
-          bool first_arg = TRUE;
-          for (size_t i = 0;
-              i < ARR_LENGTH(value->content.composition.arguments); ++i) {
-            if (!first_arg)
-            {
-              strcpy(c, ", ");
-              c += 2;
-            }
-            if (first_arg)
-              first_arg = FALSE;
-            strcpy(c, args[i]);
-            c += strlen(args[i]);
-            free(args[i]);
-          }
-          free(args);
-          *c = ')';
-          ++c;
-          *c = '\0';
-          ++c;
-        }
-        free(expr_str);
-        return str;
-      }
-      break;
-    case ValueTypeConstant:
+void
+write_value(const sl_LogicState *state, const Value *value,
+  sl_StringBuilder *out)
+{
+  struct ValueWalk walk;
+  if (value->value_type != ValueTypeComposition)
+  {
+    write_value_leaf(state, value, out);
+    return;
+  }
+  init_value_walk(&walk);
+  write_composition_open(state, value, out);
+  push_value_frame(&walk, value);
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next);
+      if (top->next > 0)
+        sl_string_builder_append(out, ", ");
+      top->next += 1;
+      if (arg->value_type == ValueTypeComposition)
       {
-        char *const_str = sl_string_from_symbol_path(state,
-            value->content.constant.constant_path);
-        size_t len = 1 + strlen(const_str);
-        char *str = malloc(len);
-        char *c = str;
-        strcpy(c, const_str);
-        c += strlen(const_str);
-        *c = '\0';
-        free(const_str);
-        return str;
+        write_composition_open(state, arg, out);
+        push_value_frame(&walk, arg);
       }
-      break;
-    case ValueTypeVariable:
+      else
       {
-        size_t len = 2 + strlen(logic_state_get_string(state,
-            value->content.variable_name_id));
-        char *str = malloc(len);
-        char *c = str;
-        *c = '$';
-        ++c;
-        strcpy(c, logic_state_get_string(state,
-            value->content.variable_name_id));
-        c += strlen(logic_state_get_string(state,
-            value->content.variable_name_id));
-        *c = '\0';
-        return str;
+        write_value_leaf(state, arg, out);
       }
-      break;
+    }
+    else
+    {
+      sl_string_builder_append_char(out, ')');
+      VALUE_WALK_POP(&walk);
+    }
   }
+  free_value_walk(&walk);
+}
+
+static char *
+string_from_value_uncached(const sl_LogicState *state,
+  const Value *value)
+{
+  sl_StringBuilder builder;
+  sl_string_builder_init(&builder);
+  write_value(state, value, &builder);
+  return sl_string_builder_finish(&builder);
+}
+
+char *
+string_from_value(const sl_LogicState *state, const Value *value)
+{
+  return sl_render_value_cached(state, value, sl_RenderFormat_Text,
+    &string_from_value_uncached);
 }
 
 void
 enumerate_value_occurrences(const Value *target, const Value *search_in,
   ValueArray *occurrences)
 {
-  if (values_equal(target, search_in))
+  struct ValueWalk walk;
+  init_value_walk(&walk);
+  push_value_frame(&walk, search_in);
+  while (walk.length > 0)
   {
-    ARR_APPEND(*occurrences, search_in);
-  }
-  else if (search_in->value_type == ValueTypeComposition)
-  {
-    for (size_t i = 0;
-        i < ARR_LENGTH(search_in->content.composition.arguments); ++i) {
-      const Value *arg = *ARR_GET(search_in->content.composition.arguments, i);
-      enumerate_value_occurrences(target, arg, occurrences);
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next == 0 && values_equal(target, top->value))
+    {
+      ARR_APPEND(*occurrences, top->value);
+      VALUE_WALK_POP(&walk);
+    }
+    else if (top->next < VALUE_ARITY(top->value))
+    {
+      push_value_frame(&walk, VALUE_ARGUMENT(top->value, top->next++));
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
     }
   }
+  free_value_walk(&walk);
 }
 
 unsigned int
 count_value_occurrences(const Value *target, const Value *search_in)
 {
-  if (values_equal(target, search_in)) {
-    return 1;
-  } else if (search_in->value_type == ValueTypeComposition) {
-    unsigned int child_occurrences = 0;
-    for (size_t i = 0;
-        i < ARR_LENGTH(search_in->content.composition.arguments); ++i) {
-      const Value *arg = *ARR_GET(search_in->content.composition.arguments, i);
-      child_occurrences += count_value_occurrences(target, arg);
+  struct ValueWalk walk;
+  unsigned int occurrences = 0;
+  init_value_walk(&walk);
+  push_value_frame(&walk, search_in);
+  while (walk.length > 0)
+  {
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    if (values_equal(target, node))
+    {
+      occurrences += 1;
+    }
+    else
+    {
+      for (size_t i = 0; i < VALUE_ARITY(node); ++i)
+        push_value_frame(&walk, VALUE_ARGUMENT(node, i));
     }
-    return child_occurrences;
-  } else {
-    return 0;
   }
+  free_value_walk(&walk);
+  return occurrences;
 }
 
 static bool value_is_irreducible(const sl_LogicState *state,
     const Value *value)
 {
-  switch (value->value_type)
+  struct ValueWalk walk;
+  bool irreducible = TRUE;
+  init_value_walk(&walk);
+  push_value_frame(&walk, value);
+  while (irreducible && walk.length > 0)
   {
-    case ValueTypeDummy:
-      return TRUE;
-      break;
-    case ValueTypeConstant:
-      return TRUE;
-      break;
-    case ValueTypeVariable:
-      return TRUE;
-      break;
-    case ValueTypeComposition:
-      {
-        const sl_LogicSymbol *expr_sym = sl_logic_get_symbol_by_id(state,
-            value->content.composition.expression_id);
-        const struct Expression *expr = (struct Expression *)expr_sym->object;
-        if (expr->replace_with != NULL)
-          return FALSE;
-        for (size_t i = 0;
-            i < ARR_LENGTH(value->content.composition.arguments); ++i) {
-          const Value *arg = *ARR_GET(value->content.composition.arguments, i);
-          if (!value_is_irreducible(state, arg))
-            return FALSE;
-        }
-        return TRUE;
-      }
-      break;
+    const Value *node = VALUE_WALK_TOP(&walk)->value;
+    VALUE_WALK_POP(&walk);
+    if (node->value_type != ValueTypeComposition)
+      continue;
+    if (SYMBOL_DEFINITION(state,
+        node->content.composition.expression_id) != NULL)
+      irreducible = FALSE;
+    for (size_t i = 0; i < VALUE_ARITY(node); ++i)
+      push_value_frame(&walk, VALUE_ARGUMENT(node, i));
   }
+  free_value_walk(&walk);
+  return irreducible;
+}
+
+/* Whether a reduction step needs the arguments of `value` reduced: they
+   are unless it is replaced by a definition that does not use them. */
+static bool
+reduction_uses_arguments(const sl_LogicState *state, const Value *value)
+{
+  const Value *definition;
+  if (value->value_type != ValueTypeComposition)
+    return FALSE;
+  definition = SYMBOL_DEFINITION(state,
+    value->content.composition.expression_id);
+  return definition == NULL || definition->value_type == ValueTypeComposition;
 }
 
+static Value *
+instantiate_value_take(const Value *src, ArgumentArray args);
+
+/* Expands each abbreviation in `value` once. The arguments of a node are
+   reduced before it, onto a stack of results that the node then takes its
+   own arguments from. */
 static Value * do_reduction_step(const sl_LogicState *state,
     const Value *value)
 {
-  switch (value->value_type)
+  struct ValueWalk walk;
+  ValueArray results;
+  Value *result;
+  ARR_INIT(results);
+  init_value_walk(&walk);
+  push_value_frame(&walk, value);
+  while (walk.length > 0)
   {
-    case ValueTypeDummy:
-      return copy_value(value);
-      break;
-    case ValueTypeConstant:
-      return copy_value(value);
-      break;
-    case ValueTypeVariable:
-      return copy_value(value);
-      break;
-    case ValueTypeComposition:
-      /* TODO: check that types and number of arguments match. Probably best
-         to do this here as well as in the expression creation function. */
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    const Value *node = top->value;
+    if (top->next < VALUE_ARITY(node)
+        && reduction_uses_arguments(state, node))
+    {
+      push_value_frame(&walk, VALUE_ARGUMENT(node, top->next++));
+      continue;
+    }
+    VALUE_WALK_POP(&walk);
+    if (node->value_type != ValueTypeComposition)
+    {
+      ARR_APPEND(results, copy_value(node));
+      continue;
+    }
+
+    /* TODO: check that types and number of arguments match. Probably best
+       to do this here as well as in the expression creation function. */
+    uint32_t expr_id = node->content.composition.expression_id;
+    const Value *definition = SYMBOL_DEFINITION(state, expr_id);
+    size_t arity = ARR_LENGTH(node->content.composition.arguments);
+    Value **reduced_args = NULL;
+    Value *new;
+    if (reduction_uses_arguments(state, node))
+    {
+      results.length -= arity;
+      reduced_args = ARR_GET(results, ARR_LENGTH(results));
+    }
+    if (definition == NULL)
+    {
+      new = SL_NEW(Value);
+      new->value_type = ValueTypeComposition;
+      new->parent = NULL;
+      new->content.composition.expression_id = expr_id;
+      new->type_id = node->type_id;
+      ARR_INIT_RESERVE(new->content.composition.arguments,
+        (arity > 0) ? arity : 1);
+      for (size_t i = 0; i < arity; ++i)
       {
-        const sl_LogicSymbol *expr_sym = sl_logic_get_symbol_by_id(state,
-            value->content.composition.expression_id);
-        const struct Expression *expr = (struct Expression *)expr_sym->object;
-        if (expr->replace_with == NULL)
-        {
-          Value *new = SL_NEW(Value);
-          new->value_type = ValueTypeComposition;
-          new->parent = NULL;
-          new->content.composition.expression_id =
-              value->content.composition.expression_id;
-          new->type_id = value->type_id;
-          ARR_INIT(new->content.composition.arguments);
-          for (size_t i = 0;
-              i < ARR_LENGTH(value->content.composition.arguments); ++i)
-          {
-            const Value *arg =
-                *ARR_GET(value->content.composition.arguments, i);
-            Value *reduced = do_reduction_step(state, arg);
-            reduced->parent = new;
-            ARR_APPEND(new->content.composition.arguments, reduced);
-          }
-          return new;
-        }
-        else
-        {
-          Value *new;
-          if (expr->replace_with->value_type == ValueTypeComposition) {
-            ArgumentArray args;
-            ARR_INIT(args);
-            for (size_t i = 0;
-                i < ARR_LENGTH(value->content.composition.arguments); ++i) {
-              struct Argument arg;
-              const struct Parameter *param;
-              param = ARR_GET(expr->parameters, i);
-              arg.name_id = param->name_id;
-              arg.value = do_reduction_step(state,
-                  *ARR_GET(value->content.composition.arguments, i));
-              ARR_APPEND(args, arg);
-            }
-            new = instantiate_value(expr->replace_with, args);
-            for (size_t i = 0; i < ARR_LENGTH(args); ++i) {
-              struct Argument *arg = ARR_GET(args, i);
-              free_value(arg->value);
-            }
-            ARR_FREE(args);
-            return new;
-          }
-          else
-          {
-            return copy_value(expr->replace_with);
-          }
-        }
+        reduced_args[i]->parent = new;
+        ARR_APPEND(new->content.composition.arguments, reduced_args[i]);
       }
-      break;
+    }
+    else if (definition->value_type == ValueTypeComposition)
+    {
+      const struct Parameter *params = SYMBOL_PARAMETERS(state, expr_id);
+      ArgumentArray args;
+      ARR_INIT(args);
+      for (size_t i = 0; i < arity; ++i) {
+        struct Argument arg;
+        arg.name_id = params[i].name_id;
+        arg.value = reduced_args[i];
+        ARR_APPEND(args, arg);
+      }
+      new = instantiate_value_take(definition, args);
+      ARR_FREE(args);
+    }
+    else
+    {
+      new = copy_value(definition);
+    }
+    ARR_APPEND(results, new);
   }
+  free_value_walk(&walk);
+  result = *ARR_GET(results, 0);
+  ARR_FREE(results);
+  return result;
 }
 
 Value * reduce_expressions(const sl_LogicState *state, const Value *value)
 {
+  sl_profile_begin(sl_ProfilePhase_Reduce);
   Value *reduced = copy_value(value);
   while (!value_is_irreducible(state, reduced))
   {
@@ -411,60 +553,241 @@ Value * reduce_expressions(const sl_LogicState *state, const Value *value)
     free_value(reduced);
     reduced = tmp;
   }
+  sl_profile_end();
   return reduced;
 }
 
+/* Fills in `dst` from the node `src`: a variable with a copy of its
+   argument, and anything else as `copy_value_node` does. Returns FALSE if
+   there is no argument of the right type for a variable. */
+static bool
+instantiate_value_node(Value *dst, const Value *src, ArgumentArray args)
+{
+  const struct Argument *arg = NULL;
+  if (src->value_type != ValueTypeVariable)
+  {
+    copy_value_node(dst, src);
+    return TRUE;
+  }
+
+  /* Find the corresponding argument. */
+  for (size_t i = 0; i < ARR_LENGTH(args); ++i)
+  {
+    const struct Argument *a = ARR_GET(args, i);
+    if (a->name_id == src->content.variable_name_id) {
+      arg = a;
+      break;
+    }
+  }
+  if (arg == NULL)
+    return FALSE;
+  if (arg->value->type_id != src->type_id)
+    return FALSE;
+  copy_value_to(dst, arg->value);
+  return TRUE;
+}
+
 Value *
 instantiate_value(const Value *src, ArgumentArray args)
 {
-  switch (src->value_type)
+  struct ValueWalk walk;
+  bool instantiated = TRUE;
+  Value *dst = SL_NEW(Value);
+  dst->parent = NULL;
+  if (!instantiate_value_node(dst, src, args))
   {
-    case ValueTypeDummy:
-      return copy_value(src);
-      break;
-    case ValueTypeConstant:
-      return copy_value(src);
-      break;
-    case ValueTypeVariable:
-      /* Find the corresponding argument. */
+    SL_FREE(dst);
+    return NULL;
+  }
+  init_value_walk(&walk);
+  push_value_frame(&walk, src)->target = dst;
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next++);
+      Value *instantiated_arg = SL_NEW(Value);
+      instantiated_arg->parent = top->target;
+      if (!instantiate_value_node(instantiated_arg, arg, args))
+      {
+        SL_FREE(instantiated_arg);
+        instantiated = FALSE;
+        break;
+      }
+      ARR_APPEND(top->target->content.composition.arguments,
+        instantiated_arg);
+      push_value_frame(&walk, arg)->target = instantiated_arg;
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+  if (!instantiated)
+  {
+    free_value(dst);
+    return NULL;
+  }
+  return dst;
+}
+
+/* Like `instantiate_value`, but takes the values of `args`: each is moved
+   into the place of the first occurrence of its variable rather than copied,
+   so that expanding an abbreviation does not copy its arguments again at
+   every level of a formula. `src` must be a composition. */
+static Value *
+instantiate_value_take(const Value *src, ArgumentArray args)
+{
+  struct ValueWalk walk;
+  bool instantiated = TRUE;
+  bool *taken = SL_MALLOC(sizeof(bool) * (ARR_LENGTH(args) + 1));
+  Value *dst = SL_NEW(Value);
+  dst->parent = NULL;
+  for (size_t i = 0; i < ARR_LENGTH(args); ++i)
+    taken[i] = FALSE;
+  copy_value_node(dst, src);
+  init_value_walk(&walk);
+  push_value_frame(&walk, src)->target = dst;
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg = VALUE_ARGUMENT(top->value, top->next++);
+      Value *instantiated_arg = NULL;
+      if (arg->value_type == ValueTypeVariable)
       {
-        const struct Argument *arg = NULL;
         for (size_t i = 0; i < ARR_LENGTH(args); ++i)
         {
-          const struct Argument *a = ARR_GET(args, i);
-          if (a->name_id == src->content.variable_name_id) {
-            arg = a;
+          struct Argument *a = ARR_GET(args, i);
+          if (a->name_id == arg->content.variable_name_id && !taken[i]
+              && a->value->type_id == arg->type_id)
+          {
+            instantiated_arg = a->value;
+            taken[i] = TRUE;
+            break;
+          }
+          else if (a->name_id == arg->content.variable_name_id)
+          {
             break;
           }
         }
-        if (arg == NULL) {
-          return NULL;
-        }
-        if (arg->value->type_id != src->type_id) {
-          return NULL;
+      }
+      if (instantiated_arg == NULL)
+      {
+        instantiated_arg = SL_NEW(Value);
+        if (!instantiate_value_node(instantiated_arg, arg, args))
+        {
+          SL_FREE(instantiated_arg);
+          instantiated = FALSE;
+          break;
         }
-        return copy_value(arg->value);
       }
-      break;
+      instantiated_arg->parent = top->target;
+      ARR_APPEND(top->target->content.composition.arguments,
+        instantiated_arg);
+      push_value_frame(&walk, arg)->target = instantiated_arg;
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
+    }
+  }
+  free_value_walk(&walk);
+  for (size_t i = 0; i < ARR_LENGTH(args); ++i)
+  {
+    if (!taken[i])
+      free_value(ARR_GET(args, i)->value);
+  }
+  SL_FREE(taken);
+  if (!instantiated)
+  {
+    free_value(dst);
+    return NULL;
+  }
+  return dst;
+}
+
+/* Matches a single node, binding it if `pattern` is a variable. Whether the
+   arguments of compositions match is left to the caller. */
+static bool
+match_value_node(const Value *pattern, const Value *target,
+  ArgumentArray *bindings)
+{
+  switch (pattern->value_type)
+  {
+    case ValueTypeVariable:
+      if (pattern->type_id != target->type_id)
+        return FALSE;
+      for (size_t i = 0; i < ARR_LENGTH(*bindings); ++i)
+      {
+        const struct Argument *arg = ARR_GET(*bindings, i);
+        if (arg->name_id == pattern->content.variable_name_id)
+          return values_equal(arg->value, target);
+      }
+      {
+        struct Argument arg;
+        arg.name_id = pattern->content.variable_name_id;
+        arg.value = (Value *)target;
+        ARR_APPEND(*bindings, arg);
+      }
+      return TRUE;
     case ValueTypeComposition:
+      return target->value_type == ValueTypeComposition
+          && pattern->type_id == target->type_id
+          && pattern->content.composition.expression_id
+            == target->content.composition.expression_id
+          && ARR_LENGTH(pattern->content.composition.arguments)
+            == ARR_LENGTH(target->content.composition.arguments);
+    default:
+      return values_equal(pattern, target);
+  }
+}
+
+static bool
+match_value_impl(const Value *pattern, const Value *target,
+  ArgumentArray *bindings)
+{
+  struct ValueWalk walk;
+  bool matched = TRUE;
+  if (!match_value_node(pattern, target, bindings))
+    return FALSE;
+  init_value_walk(&walk);
+  push_value_frame(&walk, pattern)->other = target;
+  while (walk.length > 0)
+  {
+    struct ValueFrame *top = VALUE_WALK_TOP(&walk);
+    if (top->next < VALUE_ARITY(top->value))
+    {
+      const Value *arg_pattern = VALUE_ARGUMENT(top->value, top->next);
+      const Value *arg_target = VALUE_ARGUMENT(top->other, top->next);
+      top->next += 1;
+      if (!match_value_node(arg_pattern, arg_target, bindings))
       {
-        Value *dst = SL_NEW(Value);
-        dst->type_id = src->type_id;
-        dst->value_type = ValueTypeComposition;
-        dst->content.composition.expression_id =
-            src->content.composition.expression_id;
-        dst->parent = NULL;
-        ARR_INIT(dst->content.composition.arguments);
-        for (size_t i = 0;
-            i < ARR_LENGTH(src->content.composition.arguments); ++i) {
-          const Value *arg = *ARR_GET(src->content.composition.arguments, i);
-          Value *instantiated_arg = instantiate_value(arg, args);
-          instantiated_arg->parent = dst;
-          ARR_APPEND(dst->content.composition.arguments, instantiated_arg);
-        }
-        return dst;
+        matched = FALSE;
+        break;
       }
-      break;
+      if (VALUE_ARITY(arg_pattern) > 0)
+        push_value_frame(&walk, arg_pattern)->other = arg_target;
+    }
+    else
+    {
+      VALUE_WALK_POP(&walk);
+    }
   }
-  return 0;
+  free_value_walk(&walk);
+  return matched;
+}
+
+bool
+match_value(const Value *pattern, const Value *target,
+  ArgumentArray *bindings)
+{
+  size_t bound = ARR_LENGTH(*bindings);
+  if (match_value_impl(pattern, target, bindings))
+    return TRUE;
+  bindings->length = bound;
+  return FALSE;
 }
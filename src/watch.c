@@ -0,0 +1,565 @@
+#include "watch.h"
+#include "parse.h"
+#include "proof_cache.h"
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* How long to wait for more changes after one is seen, so that an editor
+   saving several files (or one file in several steps) causes one round. */
+#define WATCH_SETTLE_MS 50
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM \
+  | IN_MOVED_TO)
+
+/* A point in the verification, at which the logic state can be restored. */
+struct Mark
+{
+  sl_LogicCheckpoint checkpoint;
+  size_t sequence;
+};
+
+/* A file that has been verified, in the order in which they were finished.
+   Everything the file added itself (rather than through its imports) is
+   between `own_start` and `end`. */
+struct LoadedFile
+{
+  char *path;
+  bool top_level;
+  bool valid;
+  struct Mark own_start;
+  struct Mark end;
+};
+
+/* A file being verified. `mark` is where the file last resumed, after its
+   latest import. */
+struct OpenFile
+{
+  char *path;
+  bool top_level;
+  bool has_own_start;
+  struct Mark own_start;
+  struct Mark mark;
+};
+
+struct Import
+{
+  char *importer;
+  char *imported;
+};
+
+struct WatchedDirectory
+{
+  char *path;
+  int descriptor;
+};
+
+struct sl_Watcher
+{
+  sl_LogicState *state;
+  sl_ProofCache *proof_cache;
+  sl_LoadObserver observer;
+
+  ARR(char *) roots;
+  ARR(struct LoadedFile) loaded;
+  ARR(struct OpenFile) open;
+  ARR(struct Import) imports;
+  size_t sequence;
+
+  size_t verified;
+  uint64_t round_ns;
+
+  int inotify;
+  ARR(struct WatchedDirectory) directories;
+};
+
+static void
+take_mark(sl_Watcher *watcher, struct Mark *mark)
+{
+  sl_logic_checkpoint(watcher->state, &mark->checkpoint);
+  mark->sequence = watcher->sequence++;
+}
+
+static void
+observe_import(const char *importer, const char *imported, void *user_data)
+{
+  sl_Watcher *watcher = (sl_Watcher *)user_data;
+  if (importer == NULL)
+    return;
+  for (size_t i = 0; i < ARR_LENGTH(watcher->imports); ++i)
+  {
+    const struct Import *import = ARR_GET(watcher->imports, i);
+    if (strcmp(import->importer, importer) == 0
+        && strcmp(import->imported, imported) == 0)
+      return;
+  }
+  struct Import import;
+  import.importer = SL_STRDUP(importer);
+  import.imported = SL_STRDUP(imported);
+  ARR_APPEND(watcher->imports, import);
+}
+
+static void
+observe_begin(const char *path, bool top_level, void *user_data)
+{
+  sl_Watcher *watcher = (sl_Watcher *)user_data;
+  struct OpenFile file;
+  take_mark(watcher, &file.mark);
+  if (ARR_LENGTH(watcher->open) > 0)
+  {
+    /* The importing file has added something of its own since it last
+       resumed. */
+    struct OpenFile *parent = ARR_GET(watcher->open,
+      ARR_LENGTH(watcher->open) - 1);
+    if (!parent->has_own_start
+        && file.mark.checkpoint.symbols != parent->mark.checkpoint.symbols)
+    {
+      parent->own_start = parent->mark;
+      parent->has_own_start = TRUE;
+    }
+  }
+  file.path = SL_STRDUP(path);
+  file.top_level = top_level;
+  file.has_own_start = FALSE;
+  ARR_APPEND(watcher->open, file);
+}
+
+static void
+observe_end(const char *path, bool valid, void *user_data)
+{
+  sl_Watcher *watcher = (sl_Watcher *)user_data;
+  struct OpenFile file = *ARR_GET(watcher->open,
+    ARR_LENGTH(watcher->open) - 1);
+  ARR_POP(watcher->open);
+
+  struct LoadedFile loaded;
+  loaded.path = file.path;
+  loaded.top_level = file.top_level;
+  loaded.valid = valid;
+  loaded.own_start = file.has_own_start ? file.own_start : file.mark;
+  take_mark(watcher, &loaded.end);
+  ARR_APPEND(watcher->loaded, loaded);
+  watcher->verified += 1;
+
+  if (ARR_LENGTH(watcher->open) > 0)
+    ARR_GET(watcher->open, ARR_LENGTH(watcher->open) - 1)->mark = loaded.end;
+}
+
+/* The absolute path of a file, which need not exist as long as its directory
+   does. */
+static char *
+absolute_path(const char *path)
+{
+  char resolved[PATH_MAX];
+  if (realpath(path, resolved) != NULL)
+    return SL_STRDUP(resolved);
+
+  char *path_copy = SL_STRDUP(path);
+  char *base_copy = SL_STRDUP(path);
+  char *result;
+  if (realpath(dirname(path_copy), resolved) != NULL)
+    asprintf(&result, "%s/%s", resolved, basename(base_copy));
+  else
+    result = SL_STRDUP(path);
+  SL_FREE(path_copy);
+  SL_FREE(base_copy);
+  return result;
+}
+
+sl_Watcher *
+sl_new_watcher(sl_LogicState *state)
+{
+  sl_Watcher *watcher = SL_NEW(sl_Watcher);
+  if (watcher == NULL)
+    return NULL;
+  watcher->state = state;
+  watcher->proof_cache = sl_new_proof_cache();
+  watcher->observer.import = &observe_import;
+  watcher->observer.begin = &observe_begin;
+  watcher->observer.end = &observe_end;
+  watcher->observer.user_data = watcher;
+  ARR_INIT(watcher->roots);
+  ARR_INIT(watcher->loaded);
+  ARR_INIT(watcher->open);
+  ARR_INIT(watcher->imports);
+  watcher->sequence = 0;
+  watcher->verified = 0;
+  watcher->round_ns = 0;
+  watcher->inotify = -1;
+  ARR_INIT(watcher->directories);
+  return watcher;
+}
+
+static const struct LoadedFile *
+find_loaded(const sl_Watcher *watcher, const char *path)
+{
+  for (size_t i = 0; i < ARR_LENGTH(watcher->loaded); ++i)
+  {
+    const struct LoadedFile *file = ARR_GET(watcher->loaded, i);
+    if (strcmp(file->path, path) == 0)
+      return file;
+  }
+  return NULL;
+}
+
+/* Forgets the imports of the files that are no longer loaded, or all of
+   them, since they are recorded again when the files are verified. */
+static void
+forget_imports(sl_Watcher *watcher, bool all)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < ARR_LENGTH(watcher->imports); ++i)
+  {
+    struct Import *import = ARR_GET(watcher->imports, i);
+    if (all || find_loaded(watcher, import->importer) == NULL)
+    {
+      SL_FREE(import->importer);
+      SL_FREE(import->imported);
+    }
+    else
+    {
+      *ARR_GET(watcher->imports, kept++) = *import;
+    }
+  }
+  watcher->imports.length = kept;
+}
+
+void
+sl_free_watcher(sl_Watcher *watcher)
+{
+  if (watcher == NULL)
+    return;
+  sl_free_proof_cache(watcher->proof_cache);
+  for (size_t i = 0; i < ARR_LENGTH(watcher->roots); ++i)
+    SL_FREE(*ARR_GET(watcher->roots, i));
+  ARR_FREE(watcher->roots);
+  for (size_t i = 0; i < ARR_LENGTH(watcher->loaded); ++i)
+    SL_FREE(ARR_GET(watcher->loaded, i)->path);
+  ARR_FREE(watcher->loaded);
+  ARR_FREE(watcher->open);
+  forget_imports(watcher, TRUE);
+  ARR_FREE(watcher->imports);
+  for (size_t i = 0; i < ARR_LENGTH(watcher->directories); ++i)
+    SL_FREE(ARR_GET(watcher->directories, i)->path);
+  ARR_FREE(watcher->directories);
+  if (watcher->inotify >= 0)
+    close(watcher->inotify);
+  SL_FREE(watcher);
+}
+
+void
+sl_watcher_add_root(sl_Watcher *watcher, const char *path)
+{
+  ARR_APPEND(watcher->roots, absolute_path(path));
+}
+
+size_t
+sl_watcher_count_verified(const sl_Watcher *watcher)
+{
+  return watcher->verified;
+}
+
+uint64_t
+sl_watcher_get_round_ns(const sl_Watcher *watcher)
+{
+  return watcher->round_ns;
+}
+
+/* Verifies `paths` (skipping those that are already loaded), then the roots.
+   Returns 0 if the roots are all valid. A file that imports an invalid file
+   is only invalid if the two were verified together, so this looks at every
+   file that is loaded. */
+static int
+verify_files(sl_Watcher *watcher, char * const *paths, size_t paths_n)
+{
+  uint64_t start = sl_wall_clock_ns();
+  int err = 0;
+  sl_set_load_observer(&watcher->observer);
+  sl_set_active_proof_cache(watcher->proof_cache);
+  for (size_t i = 0; i < paths_n; ++i)
+    sl_verify_and_add_file(paths[i], watcher->state);
+  for (size_t i = 0; i < ARR_LENGTH(watcher->roots); ++i)
+  {
+    const char *root = *ARR_GET(watcher->roots, i);
+    sl_verify_and_add_file(root, watcher->state);
+    if (find_loaded(watcher, root) == NULL)
+      err = 1;
+  }
+  for (size_t i = 0; i < ARR_LENGTH(watcher->loaded); ++i)
+  {
+    if (!ARR_GET(watcher->loaded, i)->valid)
+      err = 1;
+  }
+  sl_set_active_proof_cache(NULL);
+  sl_set_load_observer(NULL);
+  watcher->round_ns = sl_wall_clock_ns() - start;
+  return err;
+}
+
+int
+sl_watcher_verify_all(sl_Watcher *watcher)
+{
+  watcher->verified = 0;
+  return verify_files(watcher, NULL, 0);
+}
+
+typedef ARR(char *) PathArray;
+
+static bool
+path_in(const PathArray *paths, const char *path)
+{
+  for (size_t i = 0; i < ARR_LENGTH(*paths); ++i)
+  {
+    if (strcmp(*ARR_GET(*paths, i), path) == 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static bool
+path_known(const sl_Watcher *watcher, const char *path)
+{
+  if (find_loaded(watcher, path) != NULL)
+    return TRUE;
+  for (size_t i = 0; i < ARR_LENGTH(watcher->imports); ++i)
+  {
+    if (strcmp(ARR_GET(watcher->imports, i)->imported, path) == 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static bool
+is_source_file(const char *path)
+{
+  size_t length = strlen(path);
+  return length >= 3 && strcmp(path + length - 3, ".sl") == 0;
+}
+
+/* The changed files, and the files that import them, directly or not. A
+   new source file might be an import that was missing, so it affects the
+   files that are invalid. */
+static void
+find_affected(const sl_Watcher *watcher, const char * const *changed,
+  size_t changed_n, PathArray *affected)
+{
+  for (size_t i = 0; i < changed_n; ++i)
+  {
+    char *path = absolute_path(changed[i]);
+    if (!path_known(watcher, path) && is_source_file(path))
+    {
+      for (size_t j = 0; j < ARR_LENGTH(watcher->loaded); ++j)
+      {
+        const struct LoadedFile *file = ARR_GET(watcher->loaded, j);
+        if (!file->valid && !path_in(affected, file->path))
+          ARR_APPEND(*affected, SL_STRDUP(file->path));
+      }
+    }
+    if (path_known(watcher, path) && !path_in(affected, path))
+      ARR_APPEND(*affected, path);
+    else
+      SL_FREE(path);
+  }
+
+  bool grew = TRUE;
+  while (grew)
+  {
+    grew = FALSE;
+    for (size_t i = 0; i < ARR_LENGTH(watcher->imports); ++i)
+    {
+      const struct Import *import = ARR_GET(watcher->imports, i);
+      if (path_in(affected, import->imported)
+          && !path_in(affected, import->importer))
+      {
+        ARR_APPEND(*affected, SL_STRDUP(import->importer));
+        grew = TRUE;
+      }
+    }
+  }
+}
+
+int
+sl_watcher_update(sl_Watcher *watcher, const char * const *changed,
+  size_t changed_n)
+{
+  PathArray affected, again;
+  ARR_INIT(affected);
+  ARR_INIT(again);
+  find_affected(watcher, changed, changed_n, &affected);
+
+  /* Go back to where the earliest of the affected files began adding things
+     of its own: everything finished before then is kept. */
+  const struct Mark *rollback_to = NULL;
+  for (size_t i = 0; i < ARR_LENGTH(watcher->loaded); ++i)
+  {
+    const struct LoadedFile *file = ARR_GET(watcher->loaded, i);
+    if (path_in(&affected, file->path) && (rollback_to == NULL
+        || file->own_start.sequence < rollback_to->sequence))
+      rollback_to = &file->own_start;
+  }
+
+  if (rollback_to != NULL)
+  {
+    struct Mark mark = *rollback_to;
+    size_t kept = 0;
+    for (size_t i = 0; i < ARR_LENGTH(watcher->loaded); ++i)
+    {
+      struct LoadedFile *file = ARR_GET(watcher->loaded, i);
+      if (file->end.sequence <= mark.sequence)
+      {
+        *ARR_GET(watcher->loaded, kept++) = *file;
+        continue;
+      }
+      /* Files imported inside a namespace are verified again by the files
+         that import them. */
+      if (file->top_level)
+        ARR_APPEND(again, SL_STRDUP(file->path));
+      SL_FREE(file->path);
+    }
+    watcher->loaded.length = kept;
+    forget_imports(watcher, FALSE);
+    sl_logic_rollback(watcher->state, &mark.checkpoint);
+  }
+
+  watcher->verified = 0;
+  int err = verify_files(watcher, again.data, ARR_LENGTH(again));
+
+  for (size_t i = 0; i < ARR_LENGTH(affected); ++i)
+    SL_FREE(*ARR_GET(affected, i));
+  ARR_FREE(affected);
+  for (size_t i = 0; i < ARR_LENGTH(again); ++i)
+    SL_FREE(*ARR_GET(again, i));
+  ARR_FREE(again);
+  return err;
+}
+
+static void
+watch_directory_of(sl_Watcher *watcher, const char *path)
+{
+  char *path_copy = SL_STRDUP(path);
+  const char *directory = dirname(path_copy);
+  for (size_t i = 0; i < ARR_LENGTH(watcher->directories); ++i)
+  {
+    if (strcmp(ARR_GET(watcher->directories, i)->path, directory) == 0)
+    {
+      SL_FREE(path_copy);
+      return;
+    }
+  }
+  struct WatchedDirectory watched;
+  watched.descriptor = inotify_add_watch(watcher->inotify, directory,
+    WATCH_EVENTS);
+  if (watched.descriptor >= 0)
+  {
+    watched.path = SL_STRDUP(directory);
+    ARR_APPEND(watcher->directories, watched);
+  }
+  SL_FREE(path_copy);
+}
+
+/* Files may be added to the graph by any round, so their directories are
+   watched as they appear. */
+static void
+watch_directories(sl_Watcher *watcher)
+{
+  for (size_t i = 0; i < ARR_LENGTH(watcher->roots); ++i)
+    watch_directory_of(watcher, *ARR_GET(watcher->roots, i));
+  for (size_t i = 0; i < ARR_LENGTH(watcher->loaded); ++i)
+    watch_directory_of(watcher, ARR_GET(watcher->loaded, i)->path);
+  for (size_t i = 0; i < ARR_LENGTH(watcher->imports); ++i)
+    watch_directory_of(watcher, ARR_GET(watcher->imports, i)->imported);
+}
+
+/* Reads the pending events, adding the paths they are about to `changed`.
+   Returns nonzero if the events cannot be read. */
+static int
+read_changes(sl_Watcher *watcher, PathArray *changed)
+{
+  char buffer[4096]
+    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  ssize_t length = read(watcher->inotify, buffer, sizeof(buffer));
+  if (length < 0)
+    return (errno == EINTR) ? 0 : 1;
+
+  for (char *c = buffer; c < buffer + length;
+    c += sizeof(struct inotify_event) + ((struct inotify_event *)c)->len)
+  {
+    const struct inotify_event *event = (const struct inotify_event *)c;
+    if (event->len == 0)
+      continue;
+    for (size_t i = 0; i < ARR_LENGTH(watcher->directories); ++i)
+    {
+      const struct WatchedDirectory *directory =
+        ARR_GET(watcher->directories, i);
+      if (directory->descriptor != event->wd)
+        continue;
+      char *path;
+      asprintf(&path, "%s/%s", directory->path, event->name);
+      if (path_in(changed, path))
+        SL_FREE(path);
+      else
+        ARR_APPEND(*changed, path);
+      break;
+    }
+  }
+  return 0;
+}
+
+int
+sl_watcher_run(sl_Watcher *watcher, sl_WatchCallback callback,
+  void *user_data)
+{
+  watcher->inotify = inotify_init1(IN_CLOEXEC);
+  if (watcher->inotify < 0)
+    return 1;
+  int err = sl_watcher_verify_all(watcher);
+  if (callback != NULL)
+    callback(watcher, err, user_data);
+
+  while (1)
+  {
+    PathArray changed;
+    ARR_INIT(changed);
+    watch_directories(watcher);
+    if (read_changes(watcher, &changed) != 0)
+    {
+      ARR_FREE(changed);
+      return 1;
+    }
+
+    struct pollfd pending;
+    pending.fd = watcher->inotify;
+    pending.events = POLLIN;
+    while (poll(&pending, 1, WATCH_SETTLE_MS) > 0)
+    {
+      if (read_changes(watcher, &changed) != 0)
+        break;
+    }
+
+    /* Changes to anything other than source files are only of interest
+       if the file is part of the graph. */
+    size_t relevant = 0;
+    for (size_t i = 0; i < ARR_LENGTH(changed); ++i)
+    {
+      const char *path = *ARR_GET(changed, i);
+      if (is_source_file(path) || path_known(watcher, path))
+        ++relevant;
+    }
+    if (relevant > 0)
+    {
+      err = sl_watcher_update(watcher, (const char * const *)changed.data,
+        ARR_LENGTH(changed));
+      if (callback != NULL)
+        callback(watcher, err, user_data);
+    }
+    for (size_t i = 0; i < ARR_LENGTH(changed); ++i)
+      SL_FREE(*ARR_GET(changed, i));
+    ARR_FREE(changed);
+  }
+  return 0;
+}
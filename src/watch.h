@@ -0,0 +1,53 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "logic.h"
+
+/* Keeps a set of root files verified as they change. The import graph and
+   the point at which each file was loaded are recorded as the files are
+   verified, so that when some files change, the logic state is only rolled
+   back to where the first of them (or of the files that import them) began.
+   The files loaded after that point are verified again, and the theorems in
+   them that did not change are not proven again (see proof_cache.h). */
+typedef struct sl_Watcher sl_Watcher;
+
+/* The watcher does not own the state. */
+sl_Watcher *
+sl_new_watcher(sl_LogicState *state);
+
+void
+sl_free_watcher(sl_Watcher *watcher);
+
+void
+sl_watcher_add_root(sl_Watcher *watcher, const char *path);
+
+/* Verifies the roots. Returns 0 if they are all valid. */
+int
+sl_watcher_verify_all(sl_Watcher *watcher);
+
+/* Verifies again what depends on the files at `changed`, and the roots.
+   Returns 0 if the roots are all valid. */
+int
+sl_watcher_update(sl_Watcher *watcher, const char * const *changed,
+  size_t changed_n);
+
+/* The number of files verified by the last call to `sl_watcher_verify_all`
+   or `sl_watcher_update`, and the time it took. */
+size_t
+sl_watcher_count_verified(const sl_Watcher *watcher);
+
+uint64_t
+sl_watcher_get_round_ns(const sl_Watcher *watcher);
+
+/* Called after each round of verification with its result. */
+typedef void (* sl_WatchCallback)(sl_Watcher *watcher, int err,
+  void *user_data);
+
+/* Verifies the roots, then watches the directories of all the files they
+   load with inotify, updating whenever one of them changes. Only returns
+   if the files cannot be watched, with a nonzero value. */
+int
+sl_watcher_run(sl_Watcher *watcher, sl_WatchCallback callback,
+  void *user_data);
+
+#endif
@@ -0,0 +1,126 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_MIN_TIME 0.2
+
+/* Allocation counting. The benchmark executable is linked with
+   `-Wl,--wrap=malloc` (etc.) so that every allocation made by the library
+   goes through these functions. */
+static uint64_t allocations = 0;
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *str);
+
+void *
+__wrap_malloc(size_t size)
+{
+  ++allocations;
+  return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t n, size_t size)
+{
+  ++allocations;
+  return __real_calloc(n, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+  ++allocations;
+  return __real_realloc(ptr, size);
+}
+
+char *
+__wrap_strdup(const char *str)
+{
+  ++allocations;
+  return __real_strdup(str);
+}
+#endif
+
+uint64_t
+bench_allocations()
+{
+  return allocations;
+}
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void
+init_bench_state(struct BenchState *state, int argc, char **argv)
+{
+  state->filter = NULL;
+  state->min_time = BENCH_DEFAULT_MIN_TIME;
+  state->count = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strncmp(argv[i], "--min-time=", 11) == 0)
+      state->min_time = atof(argv[i] + 11);
+    else
+      state->filter = argv[i];
+  }
+  printf("%-44s %8s %14s %14s\n", "benchmark", "param", "ns/op",
+    "allocs/op");
+}
+
+void
+run_bench(struct BenchState *state, const char *name, size_t parameter,
+  bench_op_t op, void *data)
+{
+  uint64_t iterations = 1;
+  double elapsed;
+  size_t units;
+  uint64_t allocs;
+
+  if (state->filter != NULL && strstr(name, state->filter) == NULL)
+    return;
+
+  /* Double the number of iterations until the batch takes long enough to
+     be measured reliably, then report the last batch. */
+  while (1)
+  {
+    uint64_t allocs_start = bench_allocations();
+    double start = now();
+    units = 0;
+    for (uint64_t i = 0; i < iterations; ++i)
+      units += op(data);
+    elapsed = now() - start;
+    allocs = bench_allocations() - allocs_start;
+    if (elapsed >= state->min_time || iterations >= (1ULL << 40))
+      break;
+    iterations *= 2;
+  }
+  if (units == 0)
+    units = 1;
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+  printf("%-44s %8zu %14.1f %14.2f\n", name, parameter,
+    elapsed * 1e9 / (double)units, (double)allocs / (double)units);
+#else
+  printf("%-44s %8zu %14.1f %14s\n", name, parameter,
+    elapsed * 1e9 / (double)units, "n/a");
+#endif
+  fflush(stdout);
+  state->count += 1;
+}
+
+void
+cleanup_bench_state(struct BenchState *state)
+{
+  if (state->count == 0)
+    printf("No benchmarks matched.\n");
+}
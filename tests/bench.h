@@ -0,0 +1,38 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* State for running benchmarks. */
+struct BenchState
+{
+  const char *filter; /* Only run benchmarks whose name contains this. */
+  double min_time; /* Minimum measured time per benchmark, in seconds. */
+  unsigned int count;
+};
+
+/* A benchmarked operation. Runs the operation once on `data`, and returns
+   how many units of work were done (usually 1, but e.g. the number of
+   tokens when lexing a whole buffer). Results are reported per unit. */
+typedef size_t (* bench_op_t)(void *data);
+
+void
+init_bench_state(struct BenchState *state, int argc, char **argv);
+
+/* Repeats `op` until at least `min_time` has been measured, then prints
+   the time and the number of allocations per unit of work. `parameter` is
+   the size or depth of the input, printed next to the name. */
+void
+run_bench(struct BenchState *state, const char *name, size_t parameter,
+  bench_op_t op, void *data);
+
+void
+cleanup_bench_state(struct BenchState *state);
+
+/* Number of heap allocations (malloc, calloc, realloc, strdup) made so far.
+   Only counted when built with BENCH_COUNT_ALLOCATIONS. */
+uint64_t
+bench_allocations();
+
+#endif
@@ -0,0 +1,156 @@
+#include "bench.h"
+#include <common.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Microbenchmarks for the arbitrary precision arithmetic. Sizes are in
+   64-bit limbs for the arithmetic operations, and in decimal digits for the
+   string conversions. */
+
+static const size_t add_sizes[] = { 1, 16, 256, 4096 };
+static const size_t multiply_sizes[] = { 1, 8, 32, 128, 512, 2048 };
+static const size_t divide_sizes[] = { 1, 8, 64, 512 };
+static const size_t digit_counts[] = { 19, 190, 1900, 19000 };
+
+#define N_PARAMS(params) (sizeof(params) / sizeof(params[0]))
+
+static volatile size_t sink;
+
+/* Deterministic pseudorandom numbers of a given number of digits. */
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+static char *
+random_digits(size_t n)
+{
+  char *str = malloc(n + 1);
+  for (size_t i = 0; i < n; ++i)
+  {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    str[i] = '0' + (char)(random_state % 10);
+  }
+  str[0] = '1' + (char)(random_state % 9);
+  str[n] = '\0';
+  return str;
+}
+
+/* A number with about `limbs` limbs (19.3 digits each). */
+static void
+random_natural(size_t limbs, sl_Natural *nat)
+{
+  char *str = random_digits(limbs * 19);
+  sl_natural_from_string(str, nat);
+  free(str);
+}
+
+struct BinaryData
+{
+  sl_Natural a;
+  sl_Natural b;
+};
+
+static size_t
+op_add(void *data)
+{
+  struct BinaryData *d = data;
+  sl_Natural result;
+  sl_natural_add(d->a, d->b, &result);
+  sink = result.length;
+  sl_natural_free(&result);
+  return 1;
+}
+
+static size_t
+op_multiply(void *data)
+{
+  struct BinaryData *d = data;
+  sl_Natural result;
+  sl_natural_multiply(d->a, d->b, &result);
+  sink = result.length;
+  sl_natural_free(&result);
+  return 1;
+}
+
+static size_t
+op_divide(void *data)
+{
+  struct BinaryData *d = data;
+  sl_Natural quotient, remainder;
+  sl_natural_divide_with_remainder(d->a, d->b, &quotient, &remainder);
+  sink = quotient.length + remainder.length;
+  sl_natural_free(&quotient);
+  sl_natural_free(&remainder);
+  return 1;
+}
+
+static void
+bench_binary(struct BenchState *state, const char *name, bench_op_t op,
+  const size_t *sizes, size_t n_sizes, size_t a_factor)
+{
+  for (size_t i = 0; i < n_sizes; ++i)
+  {
+    struct BinaryData d;
+    random_natural(a_factor * sizes[i], &d.a);
+    random_natural(sizes[i], &d.b);
+    run_bench(state, name, sizes[i], op, &d);
+    sl_natural_free(&d.a);
+    sl_natural_free(&d.b);
+  }
+}
+
+static size_t
+op_from_string(void *data)
+{
+  sl_Natural result;
+  sl_natural_from_string(data, &result);
+  sink = result.length;
+  sl_natural_free(&result);
+  return 1;
+}
+
+static size_t
+op_to_string(void *data)
+{
+  char *str = sl_natural_to_string(*(sl_Natural *)data);
+  sink = strlen(str);
+  SL_FREE(str);
+  return 1;
+}
+
+static void
+bench_strings(struct BenchState *state)
+{
+  for (size_t i = 0; i < N_PARAMS(digit_counts); ++i)
+  {
+    char *str = random_digits(digit_counts[i]);
+    sl_Natural nat;
+    run_bench(state, "sl_natural_from_string", digit_counts[i],
+      &op_from_string, str);
+    sl_natural_from_string(str, &nat);
+    run_bench(state, "sl_natural_to_string", digit_counts[i],
+      &op_to_string, &nat);
+    sl_natural_free(&nat);
+    free(str);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  struct BenchState state;
+  init_bench_state(&state, argc, argv);
+
+  bench_binary(&state, "sl_natural_add", &op_add, add_sizes,
+    N_PARAMS(add_sizes), 1);
+  bench_binary(&state, "sl_natural_multiply", &op_multiply, multiply_sizes,
+    N_PARAMS(multiply_sizes), 1);
+  bench_binary(&state, "sl_natural_multiply (unbalanced 8:1)", &op_multiply,
+    multiply_sizes, N_PARAMS(multiply_sizes), 8);
+  bench_binary(&state, "sl_natural_divide_with_remainder (2n / n)",
+    &op_divide, divide_sizes, N_PARAMS(divide_sizes), 2);
+  bench_strings(&state);
+
+  cleanup_bench_state(&state);
+  return 0;
+}
@@ -0,0 +1,691 @@
+#include "bench.h"
+#include <logic.h>
+#include <core.h>
+#include <parse.h>
+#include <string.h>
+
+/* Microbenchmarks for the core value and requirement machinery. Each
+   benchmark is run over a range of input sizes: "balanced" formulas are
+   complete binary trees of the given depth, "chain" formulas are nested
+   to the given depth along a single branch. "deep" formulas are chains
+   nested far deeper than recursion would allow, to check that the time per
+   node stays the same as they grow. */
+
+static const size_t balanced_depths[] = { 2, 6, 10 };
+static const size_t chain_depths[] = { 16, 128, 1024 };
+static const size_t deep_depths[] = { 10000, 100000, 1000000 };
+static const size_t table_sizes[] = { 64, 512, 4096 };
+
+#define N_PARAMS(params) (sizeof(params) / sizeof(params[0]))
+
+static volatile size_t sink;
+
+/* A small logic containing propositional and predicate connectives. */
+struct Fixture
+{
+  sl_LogicState *logic;
+  sl_SymbolPath *formula_type;
+  sl_SymbolPath *variable_type;
+  sl_SymbolPath *implies_path;
+  sl_SymbolPath *not_path;
+  sl_SymbolPath *or_path;
+  sl_SymbolPath *any_path;
+  sl_SymbolPath *eq_path;
+  sl_SymbolPath *true_path;
+  sl_SymbolPath *false_path;
+};
+
+static sl_SymbolPath *
+make_path(sl_LogicState *logic, const char *name)
+{
+  sl_SymbolPath *path = sl_new_symbol_path();
+  sl_push_symbol_path(logic, path, name);
+  return path;
+}
+
+static Value *
+make_composition(struct Fixture *fix, const sl_SymbolPath *expr, Value *a,
+  Value *b)
+{
+  Value *args[3] = { a, b, NULL };
+  return new_composition_value_take(fix->logic, expr, args);
+}
+
+static Value *
+variable(struct Fixture *fix, const char *name, const sl_SymbolPath *type)
+{
+  return new_variable_value(fix->logic, name, type);
+}
+
+static Value *
+formula_variable(struct Fixture *fix, const char *name)
+{
+  return variable(fix, name, fix->formula_type);
+}
+
+static Value *
+term_variable(struct Fixture *fix, const char *name)
+{
+  return variable(fix, name, fix->variable_type);
+}
+
+static void
+add_bench_expression(struct Fixture *fix, const sl_SymbolPath *path,
+  struct PrototypeParameter **params, Value *replace_with, Value **bindings)
+{
+  struct PrototypeExpression proto;
+  proto.expression_path = (sl_SymbolPath *)path;
+  proto.expression_type = fix->formula_type;
+  proto.parameters = params;
+  proto.replace_with = replace_with;
+  proto.bindings = bindings;
+  proto.latex.segments = NULL;
+  add_expression(fix->logic, proto);
+}
+
+static void
+init_fixture(struct Fixture *fix)
+{
+  fix->logic = sl_new_logic_state(NULL);
+  fix->formula_type = make_path(fix->logic, "Formula");
+  fix->variable_type = make_path(fix->logic, "Variable");
+  fix->implies_path = make_path(fix->logic, "implies");
+  fix->not_path = make_path(fix->logic, "not");
+  fix->or_path = make_path(fix->logic, "or");
+  fix->any_path = make_path(fix->logic, "any");
+  fix->eq_path = make_path(fix->logic, "eq");
+  fix->true_path = make_path(fix->logic, "T");
+  fix->false_path = make_path(fix->logic, "F");
+
+  sl_logic_make_type(fix->logic, fix->formula_type, FALSE, FALSE, FALSE,
+    FALSE);
+  sl_logic_make_type(fix->logic, fix->variable_type, TRUE, TRUE, TRUE,
+    FALSE);
+  sl_logic_make_constant(fix->logic, fix->true_path, fix->formula_type, "T");
+  sl_logic_make_constant(fix->logic, fix->false_path, fix->formula_type, "F");
+
+  {
+    struct PrototypeParameter phi = { "phi", fix->formula_type };
+    struct PrototypeParameter psi = { "psi", fix->formula_type };
+    struct PrototypeParameter x = { "x", fix->variable_type };
+    struct PrototypeParameter y = { "y", fix->variable_type };
+    struct PrototypeParameter *unary[] = { &phi, NULL };
+    struct PrototypeParameter *binary[] = { &phi, &psi, NULL };
+    struct PrototypeParameter *quantifier[] = { &x, &phi, NULL };
+    struct PrototypeParameter *relation[] = { &x, &y, NULL };
+    Value *no_bindings[] = { NULL };
+
+    add_bench_expression(fix, fix->implies_path, binary, NULL, no_bindings);
+    add_bench_expression(fix, fix->not_path, unary, NULL, no_bindings);
+    add_bench_expression(fix, fix->eq_path, relation, NULL, no_bindings);
+
+    /* or(phi, psi) := implies(not(phi), psi) */
+    {
+      Value *def = make_composition(fix, fix->implies_path,
+        make_composition(fix, fix->not_path, formula_variable(fix, "phi"),
+          NULL), formula_variable(fix, "psi"));
+      add_bench_expression(fix, fix->or_path, binary, def, no_bindings);
+      free_value(def);
+    }
+
+    {
+      Value *bound = term_variable(fix, "x");
+      Value *bindings[] = { bound, NULL };
+      add_bench_expression(fix, fix->any_path, quantifier, NULL, bindings);
+      free_value(bound);
+    }
+  }
+}
+
+static void
+free_fixture(struct Fixture *fix)
+{
+  sl_free_symbol_path(fix->formula_type);
+  sl_free_symbol_path(fix->variable_type);
+  sl_free_symbol_path(fix->implies_path);
+  sl_free_symbol_path(fix->not_path);
+  sl_free_symbol_path(fix->or_path);
+  sl_free_symbol_path(fix->any_path);
+  sl_free_symbol_path(fix->eq_path);
+  sl_free_symbol_path(fix->true_path);
+  sl_free_symbol_path(fix->false_path);
+  sl_free_logic_state(fix->logic);
+}
+
+/* Formula generators. `leaf` is copied into every leaf position. Internal
+   nodes use `connective`, which must be a binary expression on formulas. */
+static Value *
+balanced_formula(struct Fixture *fix, size_t depth, const Value *leaf,
+  const sl_SymbolPath *connective)
+{
+  if (depth == 0)
+    return copy_value(leaf);
+  return make_composition(fix, connective,
+    balanced_formula(fix, depth - 1, leaf, connective),
+    balanced_formula(fix, depth - 1, leaf, connective));
+}
+
+static Value *
+chain_formula(struct Fixture *fix, size_t depth, const Value *leaf,
+  const sl_SymbolPath *connective)
+{
+  Value *result = copy_value(leaf);
+  for (size_t i = 0; i < depth; ++i)
+    result = make_composition(fix, connective, copy_value(leaf), result);
+  return result;
+}
+
+typedef Value * (* formula_generator_t)(struct Fixture *, size_t,
+  const Value *, const sl_SymbolPath *);
+
+struct Shape
+{
+  const char *name;
+  const size_t *depths;
+  size_t n_depths;
+  formula_generator_t generate;
+};
+
+static const struct Shape shapes[] = {
+  { "balanced", balanced_depths, N_PARAMS(balanced_depths),
+    &balanced_formula },
+  { "chain", chain_depths, N_PARAMS(chain_depths), &chain_formula },
+  { "deep", deep_depths, N_PARAMS(deep_depths), &chain_formula }
+};
+
+/* --- Values --- */
+struct ValueData
+{
+  sl_LogicState *logic;
+  const Value *a;
+  const Value *b;
+  const sl_SymbolPath *path;
+  ArgumentArray args;
+};
+
+static size_t
+op_values_equal(void *data)
+{
+  struct ValueData *d = data;
+  sink += values_equal(d->a, d->b);
+  return 1;
+}
+
+static size_t
+op_copy_value(void *data)
+{
+  struct ValueData *d = data;
+  free_value(copy_value(d->a));
+  return 1;
+}
+
+static size_t
+op_instantiate_value(void *data)
+{
+  struct ValueData *d = data;
+  free_value(instantiate_value(d->a, d->args));
+  return 1;
+}
+
+static size_t
+op_reduce_expressions(void *data)
+{
+  struct ValueData *d = data;
+  free_value(reduce_expressions(d->logic, d->a));
+  return 1;
+}
+
+static size_t
+op_string_from_value(void *data)
+{
+  struct ValueData *d = data;
+  char *str = string_from_value(d->logic, d->a);
+  sink += strlen(str);
+  SL_FREE(str);
+  return 1;
+}
+
+static size_t
+op_flat_value(void *data)
+{
+  struct ValueData *d = data;
+  struct FlatValue *flat = new_flat_value(d->a);
+  free_value(value_from_flat(d->logic, flat));
+  free_flat_value(flat);
+  return 1;
+}
+
+static size_t
+op_new_composition_value(void *data)
+{
+  struct ValueData *d = data;
+  Value *args[] = { (Value *)d->a, (Value *)d->b, NULL };
+  free_value(new_composition_value(d->logic, d->path, args));
+  return 1;
+}
+
+static void
+bench_values(struct BenchState *state, struct Fixture *fix)
+{
+  Value *phi = formula_variable(fix, "phi");
+  Value *psi = formula_variable(fix, "psi");
+  Value *t = new_constant_value(fix->logic, fix->true_path);
+  char name[128];
+
+  for (size_t s = 0; s < N_PARAMS(shapes); ++s)
+  {
+    const struct Shape *shape = &shapes[s];
+    for (size_t i = 0; i < shape->n_depths; ++i)
+    {
+      size_t depth = shape->depths[i];
+      struct ValueData d;
+      Value *a, *b, *ors;
+      d.logic = fix->logic;
+      a = shape->generate(fix, depth, phi, fix->implies_path);
+      b = shape->generate(fix, depth, phi, fix->implies_path);
+      d.a = a;
+      d.b = b;
+
+      snprintf(name, sizeof(name), "values_equal/%s", shape->name);
+      run_bench(state, name, depth, &op_values_equal, &d);
+
+      snprintf(name, sizeof(name), "copy_value+free_value/%s", shape->name);
+      run_bench(state, name, depth, &op_copy_value, &d);
+
+      snprintf(name, sizeof(name), "string_from_value/%s", shape->name);
+      run_bench(state, name, depth, &op_string_from_value, &d);
+
+      snprintf(name, sizeof(name), "new_flat_value+value_from_flat/%s",
+        shape->name);
+      run_bench(state, name, depth, &op_flat_value, &d);
+
+      d.path = fix->implies_path;
+      snprintf(name, sizeof(name), "new_composition_value/%s", shape->name);
+      run_bench(state, name, depth, &op_new_composition_value, &d);
+
+      /* Substitute a small formula for $phi at every leaf. */
+      {
+        struct Argument arg;
+        Value *replacement = make_composition(fix, fix->implies_path,
+          copy_value(t), copy_value(psi));
+        ARR_INIT(d.args);
+        arg.name_id = phi->content.variable_name_id;
+        arg.value = replacement;
+        ARR_APPEND(d.args, arg);
+        snprintf(name, sizeof(name), "instantiate_value/%s", shape->name);
+        run_bench(state, name, depth, &op_instantiate_value, &d);
+        free_value(replacement);
+        ARR_FREE(d.args);
+      }
+
+      /* Every internal node is an abbreviation that must be expanded. */
+      ors = shape->generate(fix, depth, phi, fix->or_path);
+      d.a = ors;
+      snprintf(name, sizeof(name), "reduce_expressions/%s", shape->name);
+      run_bench(state, name, depth, &op_reduce_expressions, &d);
+
+      free_value(a);
+      free_value(b);
+      free_value(ors);
+    }
+  }
+
+  free_value(phi);
+  free_value(psi);
+  free_value(t);
+}
+
+/* --- Requirements --- */
+struct RequirementData
+{
+  sl_LogicState *logic;
+  struct Requirement req;
+  ArgumentArray args;
+  struct ProofEnvironment *env;
+};
+
+static size_t
+op_evaluate_requirement(void *data)
+{
+  struct RequirementData *d = data;
+  sink += evaluate_requirement(d->logic, &d->req, d->args, d->env);
+  return 1;
+}
+
+/* Builds the requirement `require(params...)`, where each parameter is a
+   variable that is bound to the corresponding entry of `values` when the
+   requirement is evaluated. */
+static int
+init_requirement_data(struct RequirementData *d, struct Fixture *fix,
+  const char *require, Value **params, Value **values)
+{
+  struct PrototypeRequirement proto;
+  d->logic = fix->logic;
+  proto.require = (char *)require;
+  proto.arguments = params;
+  if (make_requirement(fix->logic, &d->req, &proto) != 0)
+    return 1;
+  ARR_INIT(d->args);
+  for (size_t i = 0; params[i] != NULL; ++i)
+  {
+    struct Argument arg;
+    arg.name_id = params[i]->content.variable_name_id;
+    arg.value = values[i];
+    ARR_APPEND(d->args, arg);
+  }
+  d->env = new_proof_environment();
+  return 0;
+}
+
+static void
+free_requirement_data(struct RequirementData *d)
+{
+  for (size_t i = 0; i < ARR_LENGTH(d->req.arguments); ++i)
+    free_value(*ARR_GET(d->req.arguments, i));
+  ARR_FREE(d->req.arguments);
+  ARR_FREE(d->args);
+  free_proof_environment(d->env);
+}
+
+/* `shape` is added to the name of the benchmark unless it is NULL. */
+static void
+bench_requirement(struct BenchState *state, struct Fixture *fix,
+  const char *require, Value **params, Value **values, size_t depth,
+  const char *shape)
+{
+  struct RequirementData d;
+  char name[128];
+  if (init_requirement_data(&d, fix, require, params, values) != 0)
+  {
+    printf("Could not create requirement '%s'.\n", require);
+    return;
+  }
+  if (shape != NULL)
+    snprintf(name, sizeof(name), "evaluate_requirement/%s/%s", require,
+      shape);
+  else
+    snprintf(name, sizeof(name), "evaluate_requirement/%s", require);
+  run_bench(state, name, depth, &op_evaluate_requirement, &d);
+  free_requirement_data(&d);
+}
+
+static void
+bench_requirements(struct BenchState *state, struct Fixture *fix)
+{
+  /* Parameters of the requirements. */
+  Value *s = term_variable(fix, "s");
+  Value *t = term_variable(fix, "t");
+  Value *phi = formula_variable(fix, "phi");
+  Value *psi = formula_variable(fix, "psi");
+
+  /* Values that the parameters are instantiated with. */
+  Value *x = term_variable(fix, "x");
+  Value *y = term_variable(fix, "y");
+  Value *z = term_variable(fix, "z");
+  Value *true_value = new_constant_value(fix->logic, fix->true_path);
+  Value *false_value = new_constant_value(fix->logic, fix->false_path);
+  Value *eq_xz = make_composition(fix, fix->eq_path, copy_value(x),
+    copy_value(z));
+  Value *eq_yz = make_composition(fix, fix->eq_path, copy_value(y),
+    copy_value(z));
+  Value *bound_leaf = make_composition(fix, fix->any_path, copy_value(x),
+    copy_value(eq_xz));
+
+  for (size_t i = 0; i < N_PARAMS(balanced_depths); ++i)
+  {
+    size_t depth = balanced_depths[i];
+    Value *trues = balanced_formula(fix, depth, true_value,
+      fix->implies_path);
+    Value *falses = balanced_formula(fix, depth, false_value,
+      fix->implies_path);
+    Value *bound = balanced_formula(fix, depth, bound_leaf,
+      fix->implies_path);
+    Value *context = balanced_formula(fix, depth, eq_xz, fix->implies_path);
+    Value *new_context = balanced_formula(fix, depth, eq_yz,
+      fix->implies_path);
+
+    {
+      Value *params[] = { phi, psi, NULL };
+      Value *values[] = { trues, falses };
+      bench_requirement(state, fix, "distinct", params, values, depth, NULL);
+    }
+    {
+      Value *params[] = { s, t, phi, NULL };
+      Value *values[] = { y, x, bound };
+      bench_requirement(state, fix, "free_for", params, values, depth, NULL);
+    }
+    {
+      Value *params[] = { t, phi, NULL };
+      Value *values[] = { x, bound };
+      bench_requirement(state, fix, "not_free", params, values, depth, NULL);
+    }
+    {
+      Value *params[] = { t, phi, NULL };
+      Value *values[] = { x, bound };
+      bench_requirement(state, fix, "cover_free", params, values, depth,
+        NULL);
+    }
+    {
+      Value *params[] = { t, phi, s, psi, NULL };
+      Value *values[] = { x, context, y, new_context };
+      bench_requirement(state, fix, "substitution", params, values, depth,
+        NULL);
+      bench_requirement(state, fix, "full_substitution", params, values,
+        depth, NULL);
+    }
+
+    free_value(trues);
+    free_value(falses);
+    free_value(bound);
+    free_value(context);
+    free_value(new_context);
+  }
+
+  /* The same requirements on chains, whose binders are all at the bottom. */
+  for (size_t i = 0; i < N_PARAMS(deep_depths); ++i)
+  {
+    size_t depth = deep_depths[i];
+    Value *bound = chain_formula(fix, depth, bound_leaf, fix->implies_path);
+    Value *context = chain_formula(fix, depth, eq_xz, fix->implies_path);
+    Value *new_context = chain_formula(fix, depth, eq_yz, fix->implies_path);
+
+    {
+      Value *params[] = { s, t, phi, NULL };
+      Value *values[] = { y, x, bound };
+      bench_requirement(state, fix, "free_for", params, values, depth,
+        "deep");
+    }
+    {
+      Value *params[] = { t, phi, NULL };
+      Value *values[] = { x, bound };
+      bench_requirement(state, fix, "not_free", params, values, depth,
+        "deep");
+    }
+    {
+      Value *params[] = { t, phi, s, psi, NULL };
+      Value *values[] = { x, context, y, new_context };
+      bench_requirement(state, fix, "full_substitution", params, values,
+        depth, "deep");
+    }
+
+    free_value(bound);
+    free_value(context);
+    free_value(new_context);
+  }
+
+  /* `unused` scans the inferences of every theorem in the library, so it
+     is parameterized by the number of axioms. */
+  for (size_t i = 0; i < N_PARAMS(table_sizes); ++i)
+  {
+    struct Fixture library;
+    size_t n_axioms = table_sizes[i] / 4;
+    init_fixture(&library);
+    {
+      Value *leaf = make_composition(&library, library.eq_path,
+        term_variable(&library, "x"), term_variable(&library, "y"));
+      Value *inference = balanced_formula(&library, 4, leaf,
+        library.implies_path);
+      for (size_t j = 0; j < n_axioms; ++j)
+      {
+        char axiom_name[64];
+        struct PrototypeTheorem axiom;
+        struct PrototypeParameter *no_params[] = { NULL };
+        struct PrototypeRequirement *no_requirements[] = { NULL };
+        Value *no_assumptions[] = { NULL };
+        Value *inferences[] = { inference, NULL };
+        snprintf(axiom_name, sizeof(axiom_name), "axiom%zu", j);
+        axiom.theorem_path = make_path(library.logic, axiom_name);
+        axiom.parameters = no_params;
+        axiom.requirements = no_requirements;
+        axiom.assumptions = no_assumptions;
+        axiom.inferences = inferences;
+        axiom.steps = NULL;
+        add_axiom(library.logic, axiom);
+        sl_free_symbol_path(axiom.theorem_path);
+      }
+      free_value(leaf);
+      free_value(inference);
+    }
+    {
+      Value *param = term_variable(&library, "t");
+      Value *unused = term_variable(&library, "z");
+      Value *params[] = { param, NULL };
+      Value *values[] = { unused };
+      bench_requirement(state, &library, "unused", params, values,
+        n_axioms, NULL);
+      free_value(param);
+      free_value(unused);
+    }
+    free_fixture(&library);
+  }
+
+  free_value(s);
+  free_value(t);
+  free_value(phi);
+  free_value(psi);
+  free_value(x);
+  free_value(y);
+  free_value(z);
+  free_value(true_value);
+  free_value(false_value);
+  free_value(eq_xz);
+  free_value(eq_yz);
+  free_value(bound_leaf);
+}
+
+/* --- Symbols and strings --- */
+struct TableData
+{
+  sl_LogicState *logic;
+  const sl_SymbolPath *path;
+  const char *str;
+};
+
+static size_t
+op_get_symbol(void *data)
+{
+  struct TableData *d = data;
+  sink += (sl_logic_get_symbol(d->logic, d->path) != NULL);
+  return 1;
+}
+
+static size_t
+op_add_string(void *data)
+{
+  struct TableData *d = data;
+  sink += logic_state_add_string(d->logic, d->str);
+  return 1;
+}
+
+static void
+bench_tables(struct BenchState *state)
+{
+  for (size_t i = 0; i < N_PARAMS(table_sizes); ++i)
+  {
+    size_t n = table_sizes[i];
+    struct Fixture fix;
+    struct TableData d;
+    sl_SymbolPath *last = NULL;
+    char name[64];
+    init_fixture(&fix);
+    d.logic = fix.logic;
+
+    /* Look up the most recently added symbol. */
+    for (size_t j = 0; j < n; ++j)
+    {
+      snprintf(name, sizeof(name), "c%zu", j);
+      if (last != NULL)
+        sl_free_symbol_path(last);
+      last = make_path(fix.logic, name);
+      sl_logic_make_constant(fix.logic, last, fix.formula_type, NULL);
+    }
+    d.path = last;
+    run_bench(state, "sl_logic_get_symbol", n, &op_get_symbol, &d);
+    sl_free_symbol_path(last);
+
+    /* Intern a string that is already at the end of the table. */
+    for (size_t j = 0; j < n; ++j)
+    {
+      snprintf(name, sizeof(name), "s%zu", j);
+      logic_state_add_string(fix.logic, name);
+    }
+    d.str = name;
+    run_bench(state, "logic_state_add_string", n, &op_add_string, &d);
+
+    free_fixture(&fix);
+  }
+}
+
+/* --- Lexer --- */
+static const char *lexer_line =
+  "    step modus_ponens(implies($phi, $psi), not(F)); // comment\n";
+
+static size_t
+op_lex(void *data)
+{
+  const char *source = data;
+  size_t tokens = 0;
+  sl_TextInput *input = sl_input_from_string(source);
+  sl_LexerState *lex = sl_lexer_new_state_with_input(input);
+  while (sl_lexer_advance(lex) == 0)
+    ++tokens;
+  sl_lexer_free_state(lex);
+  sl_input_free(input);
+  return tokens;
+}
+
+static void
+bench_lexer(struct BenchState *state)
+{
+  const size_t line_counts[] = { 16, 256, 4096 };
+  size_t line_len = strlen(lexer_line);
+  for (size_t i = 0; i < N_PARAMS(line_counts); ++i)
+  {
+    size_t n = line_counts[i];
+    char *source = malloc(n * line_len + 1);
+    for (size_t j = 0; j < n; ++j)
+      memcpy(source + j * line_len, lexer_line, line_len);
+    source[n * line_len] = '\0';
+    run_bench(state, "sl_lexer_advance (per token)", n, &op_lex, source);
+    free(source);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  struct BenchState state;
+  struct Fixture fix;
+  init_bench_state(&state, argc, argv);
+
+  init_fixture(&fix);
+  bench_values(&state, &fix);
+  bench_requirements(&state, &fix);
+  free_fixture(&fix);
+
+  bench_tables(&state);
+  bench_lexer(&state);
+
+  cleanup_bench_state(&state);
+  return 0;
+}
@@ -9,14 +9,35 @@ main(int argc, char **argv)
     test_paths,
     test_namespaces,
     test_types,
+    test_forks,
+    test_symbol_lookup,
     test_blocks,
     test_constants,
     test_values,
     test_require,
+    test_argument_inference,
+    test_flat_values,
+    test_taking_values,
+    test_deep_values,
+    test_string_builder,
+    test_latex,
+    test_numerals,
+
+    test_natural,
+    test_integer,
 
     test_input,
     test_lexer,
-    test_parser
+    test_parser,
+
+    test_json,
+    test_serve,
+    test_lsp,
+    test_proof_cache,
+    test_watch,
+    test_batch,
+    test_module_artifacts,
+    test_term_index
   };
 
   struct TestState state;
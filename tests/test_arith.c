@@ -0,0 +1,252 @@
+#include "test_case.h"
+#include <common.h>
+#include <string.h>
+
+static int
+check_natural_string(sl_Natural n, const char *expected)
+{
+  char *str = sl_natural_to_string(n);
+  int result = strcmp(str, expected) != 0;
+  SL_FREE(str);
+  return result;
+}
+
+/* Deterministic pseudorandom decimal strings. */
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+static char *
+random_digits(size_t n)
+{
+  char *str = SL_MALLOC(n + 1);
+  for (size_t i = 0; i < n; ++i)
+  {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    str[i] = '0' + (char)(random_state % 10);
+  }
+  str[0] = '1' + (char)(random_state % 9);
+  str[n] = '\0';
+  return str;
+}
+
+/* Checks that (a b + c) / b = a and (a b + c) % b = c, for c < b, which
+   exercises multiplication and division against each other. */
+static int
+check_division_identity(sl_Natural a, sl_Natural b, sl_Natural c)
+{
+  sl_Natural product, sum, quotient, remainder;
+  int result = 0;
+  if (sl_natural_multiply(a, b, &product) != 0)
+    return 1;
+  sl_natural_add(product, c, &sum);
+  if (sl_natural_divide_with_remainder(sum, b, &quotient, &remainder) != 0)
+    return 1;
+  if (!sl_natural_equal(quotient, a) || !sl_natural_equal(remainder, c))
+    result = 1;
+  sl_natural_free(&product);
+  sl_natural_free(&sum);
+  sl_natural_free(&quotient);
+  sl_natural_free(&remainder);
+  return result;
+}
+
+static int
+run_test_natural(struct TestState *state)
+{
+  sl_Natural a, b, c, d;
+
+  /* Conversion to and from strings. */
+  const char *strings[] = { "0", "1", "18446744073709551615",
+    "18446744073709551616", "9999999999999999999", "10000000000000000000",
+    "340282366920938463463374607431768211456",
+    "1000000000000000000000000000000000000000000000000000000000007" };
+  for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i)
+  {
+    if (sl_natural_from_string(strings[i], &a) != 0)
+      return 1;
+    if (check_natural_string(a, strings[i]) != 0)
+      return 1;
+    sl_natural_free(&a);
+  }
+  if (sl_natural_from_string("", &a) == 0)
+    return 1;
+  if (sl_natural_from_string("12a", &a) == 0)
+    return 1;
+  sl_natural_from_string("000123", &a);
+  if (check_natural_string(a, "123") != 0)
+    return 1;
+  sl_natural_free(&a);
+
+  /* Carries and borrows across limbs. */
+  sl_natural_from_uint64_t(UINT64_MAX, &a);
+  sl_natural_from_uint64_t(1, &b);
+  sl_natural_add(a, b, &c);
+  if (check_natural_string(c, "18446744073709551616") != 0)
+    return 1;
+  sl_natural_subtract(c, b, &d);
+  if (!sl_natural_equal(d, a) || d.capacity != 0)
+    return 1;
+  sl_natural_free(&d);
+  if (sl_natural_subtract(b, c, &d) == 0)
+    return 1;
+  if (!sl_natural_less_than(a, c) || sl_natural_less_than(c, a)
+      || !sl_natural_greater_than_equal(c, c))
+    return 1;
+  sl_natural_multiply(c, c, &d);
+  if (check_natural_string(d, "340282366920938463463374607431768211456") != 0)
+    return 1;
+  sl_natural_free(&a);
+  sl_natural_free(&b);
+  sl_natural_free(&c);
+  sl_natural_free(&d);
+
+  /* (10^k - 1)^2 = 10^2k - 2 10^k + 1, large enough to use Karatsuba. */
+  {
+    size_t k = 1500;
+    char *nines = SL_MALLOC(k + 1);
+    char *expected = SL_MALLOC(2 * k + 1);
+    memset(nines, '9', k);
+    nines[k] = '\0';
+    memset(expected, '9', k - 1);
+    expected[k - 1] = '8';
+    memset(expected + k, '0', k - 1);
+    expected[2 * k - 1] = '1';
+    expected[2 * k] = '\0';
+    sl_natural_from_string(nines, &a);
+    sl_natural_multiply(a, a, &b);
+    if (check_natural_string(b, expected) != 0)
+      return 1;
+    sl_natural_free(&a);
+    sl_natural_free(&b);
+    SL_FREE(nines);
+    SL_FREE(expected);
+  }
+
+  /* Multiplication and division of various shapes: single limb, schoolbook,
+     Karatsuba, and unbalanced operands. */
+  {
+    const size_t sizes[][3] = {
+      { 5, 3, 2 }, { 40, 20, 19 }, { 40, 25, 3 }, { 400, 300, 250 },
+      { 2000, 1500, 1000 }, { 4000, 700, 600 }, { 3000, 3000, 20 }
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+      char *a_str = random_digits(sizes[i][0]);
+      char *b_str = random_digits(sizes[i][1]);
+      char *c_str = random_digits(sizes[i][2]);
+      sl_natural_from_string(a_str, &a);
+      sl_natural_from_string(b_str, &b);
+      sl_natural_from_string(c_str, &c);
+      if (check_division_identity(a, b, c) != 0)
+        return 1;
+      if (check_division_identity(b, a, c) != 0)
+        return 1;
+      if (check_natural_string(a, a_str) != 0)
+        return 1;
+      sl_natural_free(&a);
+      sl_natural_free(&b);
+      sl_natural_free(&c);
+      SL_FREE(a_str);
+      SL_FREE(b_str);
+      SL_FREE(c_str);
+    }
+  }
+
+  /* Divisors whose top limb is all ones, or just one bit, stress the
+     quotient estimate of long division. */
+  {
+    const char *divisors[] = { "340282366920938463463374607431768211455",
+      "340282366920938463463374607431768211456",
+      "170141183460469231731687303715884105728" };
+    for (size_t i = 0; i < sizeof(divisors) / sizeof(divisors[0]); ++i)
+    {
+      char *a_str = random_digits(120);
+      sl_natural_from_string(a_str, &a);
+      sl_natural_from_string(divisors[i], &b);
+      sl_natural_from_uint64_t(12345, &c);
+      if (check_division_identity(a, b, c) != 0)
+        return 1;
+      sl_natural_free(&a);
+      sl_natural_free(&b);
+      sl_natural_free(&c);
+      SL_FREE(a_str);
+    }
+  }
+
+  sl_natural_from_uint64_t(7, &a);
+  sl_natural_from_uint64_t(0, &b);
+  if (sl_natural_divide(a, b, &c) == 0)
+    return 1;
+  sl_natural_free(&a);
+  sl_natural_free(&c);
+  return 0;
+}
+
+static int
+check_integer_op(int (* op)(sl_Integer, sl_Integer, sl_Integer *),
+  const char *a_str, const char *b_str, const char *expected)
+{
+  sl_Integer a, b, result;
+  char *str;
+  int err = 0;
+  sl_integer_from_string(a_str, &a);
+  sl_integer_from_string(b_str, &b);
+  if (op(a, b, &result) != 0)
+    return 1;
+  str = sl_integer_to_string(result);
+  if (strcmp(str, expected) != 0)
+    err = 1;
+  SL_FREE(str);
+  sl_integer_free(&a);
+  sl_integer_free(&b);
+  sl_integer_free(&result);
+  return err;
+}
+
+static int
+run_test_integer(struct TestState *state)
+{
+  if (check_integer_op(&sl_integer_add, "5", "-7", "-2") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_add, "-5", "7", "2") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_add, "-5", "5", "0") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_subtract, "-18446744073709551615", "1",
+      "-18446744073709551616") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_multiply, "-3", "0", "0") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_multiply, "-3", "-4", "12") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_divide, "-7", "2", "-3") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_modulo, "-7", "2", "-1") != 0)
+    return 1;
+  if (check_integer_op(&sl_integer_modulo, "7", "-2", "1") != 0)
+    return 1;
+
+  sl_Integer a, b;
+  sl_integer_from_string("-0", &a);
+  sl_integer_from_int64_t(0, &b);
+  if (!sl_integer_equal(a, b))
+    return 1;
+  sl_integer_free(&a);
+  sl_integer_free(&b);
+
+  sl_integer_from_int64_t(INT64_MIN, &a);
+  char *str = sl_integer_to_string(a);
+  if (strcmp(str, "-9223372036854775808") != 0)
+    return 1;
+  SL_FREE(str);
+  sl_integer_negate(a, &b);
+  if (!sl_integer_greater_than(b, a))
+    return 1;
+  sl_integer_free(&a);
+  sl_integer_free(&b);
+  return 0;
+}
+
+struct TestCase test_natural = { "Natural", &run_test_natural };
+struct TestCase test_integer = { "Integer", &run_test_integer };
@@ -28,14 +28,37 @@ cleanup_test_state(struct TestState *state);
 extern struct TestCase test_paths;
 extern struct TestCase test_namespaces;
 extern struct TestCase test_types;
+extern struct TestCase test_forks;
+extern struct TestCase test_symbol_lookup;
 extern struct TestCase test_constants;
 extern struct TestCase test_blocks;
 extern struct TestCase test_values;
 extern struct TestCase test_require;
+extern struct TestCase test_argument_inference;
+extern struct TestCase test_flat_values;
+extern struct TestCase test_taking_values;
+extern struct TestCase test_deep_values;
+extern struct TestCase test_string_builder;
+extern struct TestCase test_latex;
+extern struct TestCase test_numerals;
+
+/* Test cases for arithmetic. */
+extern struct TestCase test_natural;
+extern struct TestCase test_integer;
 
 /* Test cases for parsing. */
 extern struct TestCase test_input;
 extern struct TestCase test_lexer;
 extern struct TestCase test_parser;
 
+/* Test cases for the verification server and the other tools. */
+extern struct TestCase test_json;
+extern struct TestCase test_serve;
+extern struct TestCase test_lsp;
+extern struct TestCase test_proof_cache;
+extern struct TestCase test_watch;
+extern struct TestCase test_batch;
+extern struct TestCase test_module_artifacts;
+extern struct TestCase test_term_index;
+
 #endif
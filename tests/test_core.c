@@ -1,6 +1,9 @@
 #include "test_case.h"
 #include <logic.h>
 #include <core.h>
+#include <parse.h>
+#include <render.h>
+#include <render_cache.h>
 #include <string.h>
 
 static int
@@ -72,7 +75,7 @@ run_test_paths(struct TestState *state)
   sl_free_symbol_path(path2);
   sl_free_symbol_path(path3);
   sl_free_logic_state(logic);
-  free(str);
+  SL_FREE(str);
   return 0;
 }
 
@@ -125,9 +128,9 @@ run_test_types(struct TestState *state)
   {
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "type1");
-    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE) != sl_LogicError_None)
+    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE, FALSE) != sl_LogicError_None)
       return 1;
-    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE)
+    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE, FALSE)
       != sl_LogicError_SymbolAlreadyExists)
       return 1;
     sl_free_symbol_path(path);
@@ -136,7 +139,7 @@ run_test_types(struct TestState *state)
   {
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "type2");
-    if (sl_logic_make_type(logic, path, TRUE, FALSE, FALSE)
+    if (sl_logic_make_type(logic, path, TRUE, FALSE, FALSE, FALSE)
         != sl_LogicError_None)
       return 1;
     sl_free_symbol_path(path);
@@ -145,12 +148,19 @@ run_test_types(struct TestState *state)
   {
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "type3");
-    if (sl_logic_make_type(logic, path, FALSE, TRUE, FALSE)
+    if (sl_logic_make_type(logic, path, FALSE, TRUE, FALSE, FALSE)
       != sl_LogicError_CannotBindNonAtomic)
       return 1;
-    if (sl_logic_make_type(logic, path, TRUE, TRUE, FALSE)
+    if (sl_logic_make_type(logic, path, TRUE, TRUE, FALSE, FALSE)
         != sl_LogicError_None)
       return 1;
+
+    /* The flags are also kept in the dense symbol tables. */
+    uint32_t id;
+    if (sl_logic_get_symbol_id(logic, path, &id) != sl_LogicError_None
+        || SYMBOL_FLAGS(logic, id) != (SYMBOL_ATOMIC | SYMBOL_BINDS)
+        || ARR_LENGTH(logic->tables.flags) != sl_logic_count_symbols(logic))
+      return 1;
     sl_free_symbol_path(path);
   }
 
@@ -158,7 +168,7 @@ run_test_types(struct TestState *state)
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "a");
     sl_push_symbol_path(logic, path, "b");
-    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE) != sl_LogicError_NoParent)
+    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE, FALSE) != sl_LogicError_NoParent)
       return 1;
     sl_free_symbol_path(path);
   }
@@ -167,7 +177,7 @@ run_test_types(struct TestState *state)
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "type3");
     sl_push_symbol_path(logic, path, "child");
-    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE)
+    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE, FALSE)
         != sl_LogicError_NoParent)
       return 1;
     sl_free_symbol_path(path);
@@ -181,7 +191,7 @@ run_test_types(struct TestState *state)
     sl_push_symbol_path(logic, type_path, "type");
     if (sl_logic_make_namespace(logic, namespace_path) != sl_LogicError_None)
       return 1;
-    if (sl_logic_make_type(logic, type_path, FALSE, FALSE, FALSE)
+    if (sl_logic_make_type(logic, type_path, FALSE, FALSE, FALSE, FALSE)
       != sl_LogicError_None)
       return 1;
     sl_free_symbol_path(namespace_path);
@@ -192,6 +202,169 @@ run_test_types(struct TestState *state)
   return 0;
 }
 
+/* Makes a type at `name` (a single segment) in `logic`. */
+static sl_LogicError
+make_test_type(sl_LogicState *logic, const char *name)
+{
+  sl_SymbolPath *path = sl_new_symbol_path();
+  sl_push_symbol_path(logic, path, name);
+  sl_LogicError err = sl_logic_make_type(logic, path, FALSE, FALSE, FALSE,
+    FALSE);
+  sl_free_symbol_path(path);
+  return err;
+}
+
+static bool
+has_test_symbol(sl_LogicState *logic, const char *name)
+{
+  sl_SymbolPath *path = sl_new_symbol_path();
+  sl_push_symbol_path(logic, path, name);
+  bool found = sl_logic_get_symbol(logic, path) != NULL;
+  sl_free_symbol_path(path);
+  return found;
+}
+
+static int
+run_test_forks(struct TestState *state)
+{
+  sl_LogicState *base = sl_new_logic_state(NULL);
+  if (make_test_type(base, "base_type") != sl_LogicError_None)
+    return 1;
+  size_t base_symbols = sl_logic_count_symbols(base);
+
+  /* Forks see the base, and not each other. */
+  sl_LogicState *first = sl_logic_state_fork(base, NULL);
+  sl_LogicState *second = sl_logic_state_fork(base, NULL);
+  if (!has_test_symbol(first, "base_type"))
+    return 1;
+  if (make_test_type(first, "base_type") != sl_LogicError_SymbolAlreadyExists)
+    return 1;
+  if (make_test_type(first, "extra") != sl_LogicError_None
+      || make_test_type(second, "extra") != sl_LogicError_None)
+    return 1;
+  if (make_test_type(first, "only_first") != sl_LogicError_None
+      || has_test_symbol(second, "only_first"))
+    return 1;
+  if (sl_logic_count_symbols(base) != base_symbols
+      || sl_logic_count_symbols(first) != base_symbols + 2)
+    return 1;
+
+  /* A fork can be rolled back as far as the base, but no further. */
+  sl_LogicCheckpoint empty;
+  memset(&empty, 0, sizeof(empty));
+  sl_logic_rollback(first, &empty);
+  if (sl_logic_count_symbols(first) != base_symbols
+      || !has_test_symbol(first, "base_type"))
+    return 1;
+  sl_free_logic_state(first);
+  sl_free_logic_state(second);
+
+  /* Once its forks are gone, the base is intact and can grow again. */
+  if (has_test_symbol(base, "extra")
+      || make_test_type(base, "extra") != sl_LogicError_None)
+    return 1;
+  sl_free_logic_state(base);
+  return 0;
+}
+
+/* Enough symbols and strings to grow the indices several times. */
+#define LOOKUP_TEST_SYMBOLS 300
+
+static int
+run_test_symbol_lookup(struct TestState *state)
+{
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  sl_SymbolPath *scope = sl_new_symbol_path();
+  sl_push_symbol_path(logic, scope, "scope");
+  if (sl_logic_make_namespace(logic, scope) != sl_LogicError_None)
+    return 1;
+  sl_LogicCheckpoint half;
+  char name[32];
+  for (size_t i = 0; i < LOOKUP_TEST_SYMBOLS; ++i)
+  {
+    if (i == LOOKUP_TEST_SYMBOLS / 2)
+      sl_logic_checkpoint(logic, &half);
+    sl_SymbolPath *path = sl_copy_symbol_path(scope);
+    snprintf(name, sizeof(name), "symbol%zu", i);
+    sl_push_symbol_path(logic, path, name);
+    if (sl_logic_make_namespace(logic, path) != sl_LogicError_None)
+      return 1;
+    sl_free_symbol_path(path);
+  }
+
+  /* A name is found in a scope without joining them, and only there. */
+  sl_SymbolPath *local = sl_new_symbol_path();
+  sl_push_symbol_path(logic, local, "symbol7");
+  sl_SymbolPath *found = find_occupied_path_in(logic, scope, local);
+  if (found == NULL || sl_get_symbol_path_length(found) != 2
+      || strcmp(sl_get_symbol_path_last_segment(logic, found), "symbol7") != 0)
+    return 1;
+  uint32_t id;
+  if (sl_logic_get_symbol_id(logic, found, &id) != sl_LogicError_None
+      || !sl_symbol_paths_equal(sl_logic_get_symbol_path_by_id(logic, id),
+        found))
+    return 1;
+  sl_free_symbol_path(found);
+  if (find_occupied_path_in(logic, NULL, local) != NULL
+      || !logic_state_path_occupied(logic, scope)
+      || logic_state_path_occupied(logic, NULL))
+    return 1;
+
+  /* Strings are still interned once. */
+  uint32_t string = logic_state_add_string(logic, "symbol7");
+  if (logic_state_add_string(logic, "symbol7") != string
+      || strcmp(logic_state_get_string(logic, string), "symbol7") != 0)
+    return 1;
+
+  /* A fork finds what the base has, and what it adds itself. */
+  sl_LogicState *fork = sl_logic_state_fork(logic, NULL);
+  sl_SymbolPath *fork_local = sl_new_symbol_path();
+  sl_push_symbol_path(fork, fork_local, "only_fork");
+  if (sl_logic_make_namespace(fork, fork_local) != sl_LogicError_None
+      || !logic_state_path_occupied(fork, fork_local)
+      || logic_state_path_occupied(logic, fork_local))
+    return 1;
+  found = find_occupied_path_in(fork, scope, local);
+  if (found == NULL)
+    return 1;
+  sl_free_symbol_path(found);
+  sl_free_symbol_path(fork_local);
+  sl_free_logic_state(fork);
+
+  /* Rolling back forgets the symbols and strings that were added after the
+     checkpoint, and they can be added again. */
+  sl_logic_rollback(logic, &half);
+  if (logic_state_add_string(logic, "symbol200") != half.strings)
+    return 1;
+  sl_free_symbol_path(local);
+  local = sl_new_symbol_path();
+  sl_push_symbol_path(logic, local, "symbol200");
+  if (find_occupied_path_in(logic, scope, local) != NULL)
+    return 1;
+  sl_free_symbol_path(local);
+  local = sl_new_symbol_path();
+  sl_push_symbol_path(logic, local, "symbol100");
+  found = find_occupied_path_in(logic, scope, local);
+  if (found == NULL)
+    return 1;
+  sl_free_symbol_path(found);
+  sl_free_symbol_path(local);
+  for (size_t i = LOOKUP_TEST_SYMBOLS / 2; i < LOOKUP_TEST_SYMBOLS; ++i)
+  {
+    sl_SymbolPath *path = sl_copy_symbol_path(scope);
+    snprintf(name, sizeof(name), "symbol%zu", i);
+    sl_push_symbol_path(logic, path, name);
+    if (sl_logic_make_namespace(logic, path) != sl_LogicError_None
+        || !logic_state_path_occupied(logic, path))
+      return 1;
+    sl_free_symbol_path(path);
+  }
+
+  sl_free_symbol_path(scope);
+  sl_free_logic_state(logic);
+  return 0;
+}
+
 static int run_test_blocks(struct TestState *state)
 {
   sl_LogicState *logic;
@@ -200,7 +373,7 @@ static int run_test_blocks(struct TestState *state)
   {
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "type1");
-    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE)
+    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE, FALSE)
         != sl_LogicError_None)
       return 1;
     sl_free_symbol_path(path);
@@ -209,7 +382,7 @@ static int run_test_blocks(struct TestState *state)
   {
     sl_SymbolPath *path = sl_new_symbol_path();
     sl_push_symbol_path(logic, path, "type2");
-    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE)
+    if (sl_logic_make_type(logic, path, FALSE, FALSE, FALSE, FALSE)
         != sl_LogicError_None)
       return 1;
     sl_free_symbol_path(path);
@@ -291,7 +464,7 @@ run_test_constants(struct TestState *state)
 
   type_path = sl_new_symbol_path();
   sl_push_symbol_path(logic, type_path, "type_A");
-  if (sl_logic_make_type(logic, type_path, FALSE, FALSE, FALSE)
+  if (sl_logic_make_type(logic, type_path, FALSE, FALSE, FALSE, FALSE)
       != sl_LogicError_None)
     return 1;
 
@@ -338,10 +511,624 @@ run_test_require(struct TestState *state)
   return 0;
 }
 
+#define INFERENCE_TEST_BASE \
+  "type Formula;\n" \
+  "expr Formula implies(phi : Formula, psi : Formula) { }\n" \
+  "axiom modus_ponens(phi : Formula, psi : Formula) {\n" \
+  "  assume $phi;\n" \
+  "  assume implies($phi, $psi);\n" \
+  "  infer $psi;\n" \
+  "}\n"
+
+/* A theorem that proves `$chi` from a chain of implications, with `%s`
+   standing for the arguments of both of its steps. */
+#define INFERENCE_TEST_CHAIN \
+  "theorem chain_%s(phi : Formula, psi : Formula, chi : Formula) {\n" \
+  "  assume $phi;\n" \
+  "  assume implies($phi, $psi);\n" \
+  "  assume implies($psi, $chi);\n" \
+  "  infer $chi;\n" \
+  "  step modus_ponens(%s);\n" \
+  "  step modus_ponens(%s);\n" \
+  "}\n"
+
+static int
+verify_chain(sl_LogicState *logic, const char *name, const char *first,
+  const char *second)
+{
+  char *text;
+  asprintf(&text, INFERENCE_TEST_CHAIN, name, first, second);
+  int err = sl_verify_and_add_string("./tmp_inference.sl", text, logic);
+  SL_FREE(text);
+  return err;
+}
+
+static int
+run_test_argument_inference(struct TestState *state)
+{
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_string("./tmp_inference_base.sl",
+      INFERENCE_TEST_BASE, logic) != 0)
+    return 1;
+
+  if (verify_chain(logic, "explicit", "$phi, $psi", "$psi, $chi") != 0
+      || verify_chain(logic, "placeholders", "_, _", "_, _") != 0
+      || verify_chain(logic, "empty", "", "") != 0
+      || verify_chain(logic, "mixed", "$phi, _", "_, $chi") != 0)
+    return 1;
+
+  /* The arguments that were left out are kept with the step. */
+  sl_SymbolPath *path = sl_new_symbol_path();
+  uint32_t id;
+  sl_push_symbol_path(logic, path, "chain_empty");
+  if (sl_logic_get_symbol_id(logic, path, &id) != sl_LogicError_None)
+    return 1;
+  const struct Theorem *theorem =
+    (const struct Theorem *)sl_logic_get_symbol_by_id(logic, id)->object;
+  const struct TheoremReference *step = ARR_GET(theorem->steps, 1);
+  Value *arg_value = value_from_flat(logic, *ARR_GET(step->arguments, 0));
+  char *arg = string_from_value(logic, arg_value);
+  if (ARR_LENGTH(step->arguments) != 2 || strcmp(arg, "$psi") != 0)
+    return 1;
+  SL_FREE(arg);
+  free_value(arg_value);
+  sl_free_symbol_path(path);
+
+  /* Nothing can be inferred that was not proven, and explicit arguments
+     must still be consistent. */
+  if (verify_chain(logic, "unproven", "_, _", "$chi, _") == 0
+      || verify_chain(logic, "inconsistent", "$psi, _", "_, _") == 0)
+    return 1;
+
+  sl_free_logic_state(logic);
+  return 0;
+}
+
+#define FLAT_VALUE_TEST_LIBRARY \
+  "type Formula;\n" \
+  "type Term numerals;\n" \
+  "const T : Formula {\n" \
+  "  latex \"\\\\top\";\n" \
+  "}\n" \
+  "expr Formula implies(phi : Formula, psi : Formula) { }\n" \
+  "expr Formula eq(a : Term, b : Term) { }\n" \
+  "axiom first(phi : Formula) {\n" \
+  "  infer implies(T, implies($phi, eq(18446744073709551617, 3)));\n" \
+  "}\n" \
+  "axiom second(phi : Formula) {\n" \
+  "  infer implies(T, implies($phi, eq(18446744073709551617, 4)));\n" \
+  "}\n"
+
+static const Value *
+get_first_inference(sl_LogicState *logic, const char *name)
+{
+  sl_SymbolPath *path = sl_new_symbol_path();
+  uint32_t id;
+  sl_push_symbol_path(logic, path, name);
+  sl_LogicError err = sl_logic_get_symbol_id(logic, path, &id);
+  sl_free_symbol_path(path);
+  if (err != sl_LogicError_None)
+    return NULL;
+  const struct Theorem *theorem =
+    (const struct Theorem *)sl_logic_get_symbol_by_id(logic, id)->object;
+  return *ARR_GET(theorem->inferences, 0);
+}
+
+static int
+run_test_flat_values(struct TestState *state)
+{
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_string("./tmp_flat_values.sl",
+      FLAT_VALUE_TEST_LIBRARY, logic) != 0)
+    return 1;
+  const Value *first = get_first_inference(logic, "first");
+  const Value *second = get_first_inference(logic, "second");
+  if (first == NULL || second == NULL)
+    return 1;
+
+  /* Equal values are stored as the same words. */
+  Value *copy = copy_value(first);
+  struct FlatValue *flat_first = new_flat_value(first);
+  struct FlatValue *flat_copy = new_flat_value(copy);
+  struct FlatValue *flat_second = new_flat_value(second);
+  if (flat_first->length != flat_value_length(first)
+      || !flat_values_equal(flat_first, flat_copy)
+      || flat_values_equal(flat_first, flat_second)
+      || hash_flat_value(SL_HASH_INIT, flat_first)
+        != hash_flat_value(SL_HASH_INIT, flat_copy)
+      || hash_flat_value(SL_HASH_INIT, flat_first)
+        == hash_flat_value(SL_HASH_INIT, flat_second))
+    return 1;
+
+  /* Values read back are the same, down to the LaTeX of constants. */
+  Value *read = value_from_flat(logic, flat_first);
+  if (read == NULL || !values_equal(read, first))
+    return 1;
+  char *latex = latex_render_value(logic,
+    *ARR_GET(read->content.composition.arguments, 0));
+  if (strcmp(latex, "\\top") != 0)
+    return 1;
+  SL_FREE(latex);
+
+  free_value(read);
+  free_value(copy);
+  free_flat_value(flat_first);
+  free_flat_value(flat_copy);
+  free_flat_value(flat_second);
+  sl_free_logic_state(logic);
+  return 0;
+}
+
+static sl_SymbolPath *
+new_root_path(sl_LogicState *logic, const char *name)
+{
+  sl_SymbolPath *path = sl_new_symbol_path();
+  sl_push_symbol_path(logic, path, name);
+  return path;
+}
+
+static int
+run_test_taking_values(struct TestState *state)
+{
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_string("./tmp_taking_values.sl",
+      FLAT_VALUE_TEST_LIBRARY, logic) != 0)
+    return 1;
+  sl_SymbolPath *t_path = new_root_path(logic, "T");
+  sl_SymbolPath *implies_path = new_root_path(logic, "implies");
+  sl_SymbolPath *eq_path = new_root_path(logic, "eq");
+  sl_SymbolPath *formula_path = new_root_path(logic, "Formula");
+
+  /* The arguments become those of the value, rather than being copied. */
+  Value *args[3];
+  args[0] = new_constant_value(logic, t_path);
+  args[1] = new_variable_value(logic, "phi", formula_path);
+  args[2] = NULL;
+  Value *value = new_composition_value_take(logic, implies_path, args);
+  if (value == NULL
+      || *ARR_GET(value->content.composition.arguments, 0) != args[0]
+      || *ARR_GET(value->content.composition.arguments, 1) != args[1]
+      || args[0]->parent != value || args[1]->parent != value)
+    return 1;
+
+  /* Arguments that do not fit are freed along with the value. */
+  args[0] = new_constant_value(logic, t_path);
+  args[1] = new_constant_value(logic, t_path);
+  if (new_composition_value_take(logic, eq_path, args) != NULL)
+    return 1;
+  args[0] = new_constant_value(logic, t_path);
+  args[1] = NULL;
+  if (new_composition_value_take(logic, implies_path, args) != NULL)
+    return 1;
+
+  /* An axiom keeps the statements it is given. */
+  struct PrototypeParameter param = { "phi", formula_path };
+  struct PrototypeParameter *params[] = { &param, NULL };
+  Value *req_args[] = { new_variable_value(logic, "phi", formula_path),
+    new_constant_value(logic, t_path), NULL };
+  struct PrototypeRequirement req = { "distinct", req_args };
+  struct PrototypeRequirement *reqs[] = { &req, NULL };
+  Value *assumptions[] = { NULL };
+  Value *inferences[] = { value, NULL };
+  struct PrototypeTheorem proto;
+  proto.theorem_path = new_root_path(logic, "kept");
+  proto.parameters = params;
+  proto.requirements = reqs;
+  proto.assumptions = assumptions;
+  proto.inferences = inferences;
+  proto.steps = NULL;
+  if (add_axiom_take(logic, proto) != sl_LogicError_None
+      || get_first_inference(logic, "kept") != value)
+    return 1;
+
+  /* And frees them if it is turned down. */
+  req_args[0] = new_variable_value(logic, "phi", formula_path);
+  req_args[1] = new_constant_value(logic, t_path);
+  inferences[0] = copy_value(value);
+  if (add_axiom_take(logic, proto) == sl_LogicError_None)
+    return 1;
+
+  sl_free_symbol_path(proto.theorem_path);
+  sl_free_symbol_path(t_path);
+  sl_free_symbol_path(implies_path);
+  sl_free_symbol_path(eq_path);
+  sl_free_symbol_path(formula_path);
+  sl_free_logic_state(logic);
+  return 0;
+}
+
+/* Far deeper than the call stack would allow for recursion. */
+#define DEEP_VALUE_TEST_DEPTH 100000
+
+#define DEEP_VALUE_TEST_LIBRARY \
+  "type Formula;\n" \
+  "type Term;\n" \
+  "type Variable atomic binds;\n" \
+  "const T : Formula { }\n" \
+  "expr Formula implies(phi : Formula, psi : Formula) {\n" \
+  "  latex \"(\" + $phi + \" > \" + $psi + \")\";\n" \
+  "}\n" \
+  "expr Formula not(phi : Formula) { }\n" \
+  "expr Formula or(phi : Formula, psi : Formula) {\n" \
+  "  as implies(not($phi), $psi);\n" \
+  "}\n" \
+  "expr Formula any(x : Variable, phi : Formula) {\n" \
+  "  bind $x;\n" \
+  "}\n" \
+  "expr Term t(x : Variable) { }\n" \
+  "expr Formula eq(a : Term, b : Term) { }\n" \
+  "axiom gen(x : Variable, phi : Formula) {\n" \
+  "  require not_free($x, $phi);\n" \
+  "  infer implies($phi, any($x, $phi));\n" \
+  "}\n" \
+  "axiom inst(x : Variable, phi : Formula, s : Term, phi_0 : Formula) {\n" \
+  "  require free_for($s, t($x), $phi);\n" \
+  "  require full_substitution(t($x), $phi, $s, $phi_0);\n" \
+  "  infer implies(any($x, $phi), $phi_0);\n" \
+  "}\n"
+
+struct DeepValueFixture
+{
+  sl_LogicState *logic;
+  sl_SymbolPath *t_path;
+  sl_SymbolPath *variable_path;
+  sl_SymbolPath *implies_path;
+  sl_SymbolPath *not_path;
+  sl_SymbolPath *or_path;
+  sl_SymbolPath *any_path;
+  sl_SymbolPath *term_path;
+  sl_SymbolPath *eq_path;
+};
+
+static Value *
+deep_composition(struct DeepValueFixture *fix, const sl_SymbolPath *expr,
+  Value *a, Value *b)
+{
+  Value *args[] = { a, b, NULL };
+  return new_composition_value_take(fix->logic, expr, args);
+}
+
+/* `eq(t($x), t($x))` */
+static Value *
+deep_leaf(struct DeepValueFixture *fix, const char *variable)
+{
+  return deep_composition(fix, fix->eq_path,
+    deep_composition(fix, fix->term_path,
+      new_variable_value(fix->logic, variable, fix->variable_path), NULL),
+    deep_composition(fix, fix->term_path,
+      new_variable_value(fix->logic, variable, fix->variable_path), NULL));
+}
+
+/* `connective(T, connective(T, ... leaf))`, taking `leaf`. */
+static Value *
+deep_chain(struct DeepValueFixture *fix, const sl_SymbolPath *connective,
+  Value *leaf)
+{
+  Value *chain = leaf;
+  for (size_t i = 0; i < DEEP_VALUE_TEST_DEPTH; ++i)
+  {
+    chain = deep_composition(fix, connective,
+      new_constant_value(fix->logic, fix->t_path), chain);
+  }
+  return chain;
+}
+
+/* Whether the requirements of the axiom `name` hold when its parameters are
+   given `values`. */
+static bool
+deep_requirements_hold(struct DeepValueFixture *fix, const char *name,
+  const char **parameters, Value **values)
+{
+  sl_SymbolPath *path = new_root_path(fix->logic, name);
+  struct ProofEnvironment *env = new_proof_environment();
+  uint32_t id;
+  ArgumentArray args;
+  bool hold = TRUE;
+  if (sl_logic_get_symbol_id(fix->logic, path, &id) != sl_LogicError_None)
+    return FALSE;
+  sl_free_symbol_path(path);
+  const struct Theorem *axiom = (const struct Theorem *)
+    sl_logic_get_symbol_by_id(fix->logic, id)->object;
+  ARR_INIT(args);
+  for (size_t i = 0; parameters[i] != NULL; ++i)
+  {
+    struct Argument arg;
+    arg.name_id = logic_state_add_string(fix->logic, parameters[i]);
+    arg.value = values[i];
+    ARR_APPEND(args, arg);
+  }
+  for (size_t i = 0; i < ARR_LENGTH(axiom->requirements) && hold; ++i)
+  {
+    hold = evaluate_requirement(fix->logic,
+      ARR_GET(axiom->requirements, i), args, env);
+  }
+  ARR_FREE(args);
+  free_proof_environment(env);
+  return hold;
+}
+
+static int
+run_test_deep_values(struct TestState *state)
+{
+  struct DeepValueFixture fix;
+  fix.logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_string("./tmp_deep_values.sl",
+      DEEP_VALUE_TEST_LIBRARY, fix.logic) != 0)
+    return 1;
+  fix.t_path = new_root_path(fix.logic, "T");
+  fix.variable_path = new_root_path(fix.logic, "Variable");
+  fix.implies_path = new_root_path(fix.logic, "implies");
+  fix.not_path = new_root_path(fix.logic, "not");
+  fix.or_path = new_root_path(fix.logic, "or");
+  fix.any_path = new_root_path(fix.logic, "any");
+  fix.term_path = new_root_path(fix.logic, "t");
+  fix.eq_path = new_root_path(fix.logic, "eq");
+
+  /* A deep statement is read, on a single line, into the same value. */
+  Value *phi = deep_chain(&fix, fix.implies_path, deep_leaf(&fix, "x"));
+  char *phi_str = string_from_value(fix.logic, phi);
+  sl_StringBuilder source;
+  sl_string_builder_init(&source);
+  sl_string_builder_printf(&source,
+    "axiom deep(x : Variable) {\n  infer %s;\n}", phi_str);
+  char *source_str = sl_string_builder_finish(&source);
+  if (sl_verify_and_add_string("./tmp_deep_statement.sl", source_str,
+      fix.logic) != 0)
+    return 1;
+  SL_FREE(source_str);
+  const Value *read = get_first_inference(fix.logic, "deep");
+  if (read == NULL || !values_equal(read, phi))
+    return 1;
+
+  /* Copying, printing and storing flat all go down to the bottom. */
+  Value *copy = copy_value(read);
+  char *copy_str = string_from_value(fix.logic, copy);
+  struct FlatValue *flat = new_flat_value(copy);
+  Value *from_flat = value_from_flat(fix.logic, flat);
+  if (!values_equal(copy, phi) || strcmp(copy_str, phi_str) != 0
+      || from_flat == NULL || !values_equal(from_flat, phi))
+    return 1;
+  SL_FREE(copy_str);
+  SL_FREE(phi_str);
+  free_flat_value(flat);
+
+  /* So do rendering to HTML and LaTeX, through the render cache. */
+  sl_RenderCache *render_cache = sl_new_render_cache();
+  sl_set_active_render_cache(render_cache);
+  char *html = html_render_value(fix.logic, read);
+  char *latex = latex_render_value(fix.logic, read);
+  sl_set_active_render_cache(NULL);
+  sl_free_render_cache(render_cache);
+  if (strncmp(html, "<a href=", 8) != 0
+      || strlen(latex) != 6 * DEEP_VALUE_TEST_DEPTH
+      || strncmp(latex, "(T > (T > ", 10) != 0
+      || latex[strlen(latex) - 1] != ')')
+    return 1;
+  SL_FREE(html);
+  SL_FREE(latex);
+  free_value(from_flat);
+  free_value(copy);
+
+  /* Every abbreviation is expanded. */
+  Value *ors = deep_chain(&fix, fix.or_path,
+    new_constant_value(fix.logic, fix.t_path));
+  Value *expanded = new_constant_value(fix.logic, fix.t_path);
+  for (size_t i = 0; i < DEEP_VALUE_TEST_DEPTH; ++i)
+  {
+    expanded = deep_composition(&fix, fix.implies_path,
+      deep_composition(&fix, fix.not_path,
+        new_constant_value(fix.logic, fix.t_path), NULL), expanded);
+  }
+  Value *reduced = reduce_expressions(fix.logic, ors);
+  if (!values_equal(reduced, expanded))
+    return 1;
+  free_value(ors);
+  free_value(expanded);
+  free_value(reduced);
+
+  /* Requirements are checked all the way down: `$x` is not free under a
+     binder at the bottom, and `t($y)` can replace `t($x)` throughout. */
+  Value *x = new_variable_value(fix.logic, "x", fix.variable_path);
+  Value *bound = deep_chain(&fix, fix.implies_path,
+    deep_composition(&fix, fix.any_path, copy_value(x), deep_leaf(&fix, "x")));
+  const char *gen_params[] = { "x", "phi", NULL };
+  Value *gen_values[] = { x, bound };
+  if (!deep_requirements_hold(&fix, "gen", gen_params, gen_values))
+    return 1;
+  gen_values[1] = phi;
+  if (deep_requirements_hold(&fix, "gen", gen_params, gen_values))
+    return 1;
+
+  Value *y_term = deep_composition(&fix, fix.term_path,
+    new_variable_value(fix.logic, "y", fix.variable_path), NULL);
+  Value *phi_y = deep_chain(&fix, fix.implies_path, deep_leaf(&fix, "y"));
+  const char *inst_params[] = { "x", "phi", "s", "phi_0", NULL };
+  Value *inst_values[] = { x, phi, y_term, phi_y };
+  if (!deep_requirements_hold(&fix, "inst", inst_params, inst_values))
+    return 1;
+  inst_values[3] = bound;
+  if (deep_requirements_hold(&fix, "inst", inst_params, inst_values))
+    return 1;
+
+  free_value(x);
+  free_value(bound);
+  free_value(phi);
+  free_value(y_term);
+  free_value(phi_y);
+  sl_free_symbol_path(fix.t_path);
+  sl_free_symbol_path(fix.variable_path);
+  sl_free_symbol_path(fix.implies_path);
+  sl_free_symbol_path(fix.not_path);
+  sl_free_symbol_path(fix.or_path);
+  sl_free_symbol_path(fix.any_path);
+  sl_free_symbol_path(fix.term_path);
+  sl_free_symbol_path(fix.eq_path);
+  sl_free_logic_state(fix.logic);
+  return 0;
+}
+
+static int
+run_test_string_builder(struct TestState *state)
+{
+  sl_StringBuilder builder;
+  char *str;
+
+  sl_string_builder_init(&builder);
+  str = sl_string_builder_finish(&builder);
+  if (strcmp(str, "") != 0)
+    return 1;
+  SL_FREE(str);
+
+  sl_string_builder_append(&builder, "implies(");
+  for (int i = 0; i < 100; ++i)
+    sl_string_builder_printf(&builder, "%s$x%d", (i > 0) ? ", " : "", i);
+  sl_string_builder_append_char(&builder, ')');
+  str = sl_string_builder_finish(&builder);
+  if (strncmp(str, "implies($x0, $x1, ", 18) != 0)
+    return 1;
+  if (strcmp(str + strlen(str) - 7, ", $x99)") != 0)
+    return 1;
+  SL_FREE(str);
+  if (builder.data != NULL || builder.length != 0)
+    return 1;
+  return 0;
+}
+
+static int
+check_latex_string(const char *src, const char *expected)
+{
+  char *str = latex_render_string(src);
+  int result = strcmp(str, expected) != 0;
+  SL_FREE(str);
+  return result;
+}
+
+static int
+run_test_latex(struct TestState *state)
+{
+  if (check_latex_string("x + y", "x + y") != 0)
+    return 1;
+  if (check_latex_string("alpha", "\\alpha") != 0)
+    return 1;
+  if (check_latex_string("phi(Psi)", "\\phi(\\Psi)") != 0)
+    return 1;
+  /* Only whole words are replaced. */
+  if (check_latex_string("alphabet theta2 beta", "alphabet \\theta2 \\beta")
+      != 0)
+    return 1;
+  /* Escapes are removed first, and a backslash prevents replacement. */
+  if (check_latex_string("\\\\pi \\{pi\\}", "\\pi {\\pi}") != 0)
+    return 1;
+  return 0;
+}
+
+static int
+run_test_numerals(struct TestState *state)
+{
+  sl_LogicState *logic;
+  sl_SymbolPath *type_path, *type_path2;
+  sl_Natural n;
+  Value *a, *b, *c;
+  char *str;
+  logic = sl_new_logic_state(NULL);
+
+  /* Numerals need a type to hold them, and only one type can. */
+  sl_natural_from_uint64_t(7, &n);
+  if (sl_logic_make_numeral_value(logic, &n) != NULL)
+    return 1;
+  sl_natural_free(&n);
+  type_path = sl_new_symbol_path();
+  sl_push_symbol_path(logic, type_path, "Term");
+  if (sl_logic_make_type(logic, type_path, FALSE, FALSE, FALSE, TRUE)
+      != sl_LogicError_None)
+    return 1;
+  type_path2 = sl_new_symbol_path();
+  sl_push_symbol_path(logic, type_path2, "Term2");
+  if (sl_logic_make_type(logic, type_path2, FALSE, FALSE, FALSE, TRUE)
+      != sl_LogicError_NumeralTypeExists)
+    return 1;
+
+  sl_natural_from_string("340282366920938463463374607431768211456", &n);
+  a = sl_logic_make_numeral_value(logic, &n);
+  sl_natural_free(&n);
+  if (a == NULL)
+    return 1;
+  b = copy_value(a);
+  sl_natural_from_string("340282366920938463463374607431768211457", &n);
+  c = sl_logic_make_numeral_value(logic, &n);
+  sl_natural_free(&n);
+  if (!values_equal(a, b) || values_equal(a, c))
+    return 1;
+  str = string_from_value(logic, b);
+  if (strcmp(str, "340282366920938463463374607431768211456") != 0)
+    return 1;
+  SL_FREE(str);
+
+  /* Taking a numeral moves its limbs into the value. */
+  free_value(b);
+  sl_natural_from_string("340282366920938463463374607431768211456", &n);
+  b = sl_logic_make_numeral_value_take(logic, &n);
+  if (b == NULL || !values_equal(a, b) || n.length != 0)
+    return 1;
+  sl_natural_free(&n);
+
+  /* Numerals in a file are read from their tokens, and given to the values
+     made from them. The requirement `successor` checks that m = n + 1 by
+     computing with the numerals themselves, so a fact about a concrete
+     number takes a single step rather than a chain of successors. */
+  if (sl_verify_and_add_string("numerals.sl",
+      "type Formula;\n"
+      "expr Formula eq(a : Term, b : Term) { }\n"
+      "expr Term zero() { }\n"
+      "expr Term succ(n : Term) { }\n"
+      "axiom numeral_zero() {\n"
+      "  infer eq(0, zero());\n"
+      "}\n"
+      "axiom numeral_successor(n : Term, m : Term) {\n"
+      "  require successor($n, $m);\n"
+      "  infer eq($m, succ($n));\n"
+      "}\n"
+      "theorem big_successor() {\n"
+      "  infer eq(340282366920938463463374607431768211456,\n"
+      "    succ(340282366920938463463374607431768211455));\n"
+      "  step numeral_successor(340282366920938463463374607431768211455,\n"
+      "    340282366920938463463374607431768211456);\n"
+      "}\n", logic) != 0)
+    return 1;
+  /* The requirement does not hold for numbers that are not successive. */
+  if (sl_verify_and_add_string("numerals_wrong.sl",
+      "theorem wrong_successor() {\n"
+      "  infer eq(12, succ(10));\n"
+      "  step numeral_successor(10, 12);\n"
+      "}\n", logic) == 0)
+    return 1;
+
+  free_value(a);
+  free_value(b);
+  free_value(c);
+  sl_free_symbol_path(type_path);
+  sl_free_symbol_path(type_path2);
+  sl_free_logic_state(logic);
+  return 0;
+}
+
 struct TestCase test_paths = { "Paths", &run_test_paths };
 struct TestCase test_namespaces = { "Namespaces", &run_test_namespaces };
 struct TestCase test_types = { "Types", &run_test_types };
+struct TestCase test_forks = { "Forks", &run_test_forks };
+struct TestCase test_symbol_lookup = { "Symbol Lookup",
+  &run_test_symbol_lookup };
 struct TestCase test_blocks = { "Blocks", &run_test_blocks };
 struct TestCase test_constants = { "Constants", &run_test_constants };
 struct TestCase test_values = { "Values", &run_test_values };
 struct TestCase test_require = { "Require", &run_test_require };
+struct TestCase test_argument_inference = { "Argument Inference",
+  &run_test_argument_inference };
+struct TestCase test_flat_values = { "Flat Values", &run_test_flat_values };
+struct TestCase test_taking_values = { "Taking Values",
+  &run_test_taking_values };
+struct TestCase test_deep_values = { "Deep Values", &run_test_deep_values };
+struct TestCase test_string_builder = { "String Builder",
+  &run_test_string_builder };
+struct TestCase test_latex = { "Latex", &run_test_latex };
+struct TestCase test_numerals = { "Numerals", &run_test_numerals };
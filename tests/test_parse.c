@@ -30,7 +30,7 @@ struct TokenValue
 
 static const struct TokenValue tokens[] = {
   { sl_LexerTokenType_Identifier, 0, 0, "identifier", FALSE, 0 },
-  { sl_LexerTokenType_Number, 0, 11, NULL, TRUE, 1234 },
+  { sl_LexerTokenType_Number, 0, 11, "1234", TRUE, 1234 },
   { sl_LexerTokenType_LineComment, 0, 16, NULL, FALSE, 0 },
   { sl_LexerTokenType_OpeningBlockComment, 0, 19, NULL, FALSE, 0 },
   { sl_LexerTokenType_ClosingBlockComment, 0, 22, NULL, FALSE, 0 },
@@ -67,7 +67,7 @@ static const struct TokenValue tokens[] = {
   { sl_LexerTokenType_Identifier, 4, 11, "a", FALSE, 0 },
   { sl_LexerTokenType_Identifier, 4, 13, "line", FALSE, 0 },
   { sl_LexerTokenType_Identifier, 4, 18, "comment", FALSE, 0 },
-  { sl_LexerTokenType_Unknown, 4, 25, NULL, FALSE, 0 },
+  { sl_LexerTokenType_Exclamation, 4, 25, NULL, FALSE, 0 },
   { sl_LexerTokenType_LineEnd, 4, 26, NULL, FALSE, 0 },
 };
 
@@ -124,6 +124,24 @@ run_test_input(struct TestState *state)
   return 0;
 }
 
+static int
+check_token_number(const sl_LexerState *state, bool is_number,
+  uint64_t expected)
+{
+  sl_Natural value, expected_value;
+  int err = 0;
+  if (sl_lexer_get_current_token_numerical_value(state, &value) != 0)
+    return is_number ? 1 : 0;
+  if (!is_number)
+    err = 1;
+  sl_natural_from_uint64_t(expected, &expected_value);
+  if (!sl_natural_equal(value, expected_value))
+    err = 1;
+  sl_natural_free(&value);
+  sl_natural_free(&expected_value);
+  return err;
+}
+
 static int
 lex_test_string(sl_LexerState *state)
 {
@@ -163,18 +181,10 @@ lex_test_string(sl_LexerState *state)
         i, sl_lexer_get_current_token_string_value(state).begin);
       return 1;
     }
-    else if (tokens[i].is_number !=
-      sl_lexer_get_current_token_numerical_value(state).is_number)
+    else if (check_token_number(state, tokens[i].is_number,
+      tokens[i].number_value) != 0)
     {
-      printf("Token %zu has the wrong numeric type.\n", i);
-      return 1;
-    }
-    else if (tokens[i].number_value !=
-      sl_lexer_get_current_token_numerical_value(state).value)
-    {
-      printf("Token %zu has the wrong numerical value %u (expected %u).\n",
-        i, sl_lexer_get_current_token_numerical_value(state).value,
-        tokens[i].number_value);
+      printf("Token %zu has the wrong numerical value.\n", i);
       return 1;
     }
   }
@@ -205,6 +215,28 @@ run_test_lexer(struct TestState *state)
     sl_input_free(input);
   }
 
+  /* Numbers are not truncated, however long they are. */
+  {
+    const char *digits = "340282366920938463463374607431768211456";
+    sl_TextInput *input =
+      sl_input_from_string("340282366920938463463374607431768211456\n");
+    sl_Natural value;
+    char *str;
+    lex_state = sl_lexer_new_state_with_input(input);
+    if (sl_lexer_advance(lex_state) != 0)
+      return 1;
+    if (sl_lexer_get_current_token_numerical_value(lex_state, &value) != 0)
+      return 1;
+    str = sl_natural_to_string(value);
+    err = strcmp(str, digits) != 0;
+    SL_FREE(str);
+    sl_natural_free(&value);
+    sl_lexer_free_state(lex_state);
+    sl_input_free(input);
+    if (err != 0)
+      return err;
+  }
+
   return 0;
 }
 
@@ -0,0 +1,737 @@
+#include "test_case.h"
+#include <artifact.h>
+#include <batch.h>
+#include <core.h>
+#include <json.h>
+#include <lsp.h>
+#include <parse.h>
+#include <serve.h>
+#include <string.h>
+#include <term_index.h>
+#include <unistd.h>
+#include <watch.h>
+
+#define TEST_BASE_FILENAME "./tmp_serve_base.sl"
+/* The document is never written, so its name only appears in its URI. */
+#define TEST_DOCUMENT_URI_NAME "tmp%20lsp%20document.sl"
+
+/* A theorem to be verified against the base, as the contents of a JSON
+   string with `%s` standing for the argument of its last step. */
+static const char *test_theorem = "namespace serve_test {\\n"
+  "  theorem quadruple_negation(phi : Formula) {\\n"
+  "    assume not(not(not(not($phi))));\\n"
+  "    step double_negation(not(not($phi)));\\n"
+  "    step double_negation(%s);\\n"
+  "    infer $phi;\\n"
+  "  }\\n"
+  "}\\n";
+
+static int
+write_test_base()
+{
+  FILE *f = fopen(TEST_BASE_FILENAME, "w");
+  if (f == NULL)
+    return 1;
+  fputs("namespace serve_test {\n"
+    "  type Formula;\n"
+    "  expr Formula not(phi : Formula) { }\n"
+    "  axiom double_negation(phi : Formula) {\n"
+    "    assume not(not($phi));\n"
+    "    infer $phi;\n"
+    "  }\n"
+    "}\n", f);
+  fclose(f);
+  return 0;
+}
+
+static int
+run_test_json(struct TestState *state)
+{
+  const char *text = " {\"id\": 12, \"path\": \"a\\\\b.sl\", \"ok\": true,"
+    " \"list\": [1.5, null, \"\\u00e9\\ud83d\\ude00\"], \"empty\": {}} ";
+  sl_JsonValue *json = sl_json_parse(text, strlen(text));
+  if (json == NULL || sl_json_get_type(json) != sl_JsonType_Object)
+    return 1;
+  if (sl_json_get_length(json) != 5)
+    return 1;
+  if (sl_json_get_number(sl_json_get_member(json, "id")) != 12.0)
+    return 1;
+  if (strcmp(sl_json_get_member_string(json, "path"), "a\\b.sl") != 0)
+    return 1;
+  if (!sl_json_get_bool(sl_json_get_member(json, "ok")))
+    return 1;
+  if (sl_json_get_member(json, "missing") != NULL)
+    return 1;
+
+  const sl_JsonValue *list = sl_json_get_member(json, "list");
+  if (sl_json_get_length(list) != 3)
+    return 1;
+  if (sl_json_get_number(sl_json_get_element(list, 0)) != 1.5)
+    return 1;
+  if (sl_json_get_type(sl_json_get_element(list, 1)) != sl_JsonType_Null)
+    return 1;
+  if (strcmp(sl_json_get_string(sl_json_get_element(list, 2)),
+      "\xc3\xa9\xf0\x9f\x98\x80") != 0)
+    return 1;
+  sl_json_free(json);
+
+  /* Malformed documents are rejected. */
+  const char *malformed[] = { "", "{", "{\"a\" 1}", "[1,]", "tru", "01",
+    "\"\\x\"", "{} {}", "\"\\ud83d\"" };
+  for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); ++i)
+  {
+    json = sl_json_parse(malformed[i], strlen(malformed[i]));
+    if (json != NULL)
+      return 1;
+  }
+  return 0;
+}
+
+/* Runs `requests` through a server, returning its replies. */
+static char *
+serve_requests(sl_Server *server, const char *requests)
+{
+  char *replies = NULL;
+  size_t replies_size = 0;
+  FILE *in = fmemopen((void *)requests, strlen(requests), "r");
+  FILE *out = open_memstream(&replies, &replies_size);
+  sl_server_serve_stream(server, in, out);
+  fclose(in);
+  fclose(out);
+  return replies;
+}
+
+static int
+run_test_serve(struct TestState *state)
+{
+  if (write_test_base() != 0)
+    return 1;
+
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  sl_Server *server = sl_new_server(logic);
+  if (sl_server_load_base(server, TEST_BASE_FILENAME) != 0)
+    return 1;
+  size_t base_symbols = sl_logic_count_symbols(logic);
+
+  /* The same theorem is added by two requests, which only works if the
+     first is rolled back. The third request has a broken proof, and the
+     fourth does not parse. */
+  char *good, *bad, *requests;
+  asprintf(&good, test_theorem, "$phi");
+  asprintf(&bad, test_theorem, "not($phi)");
+  asprintf(&requests,
+    "{\"id\": 1, \"path\": \"./tmp_serve_request.sl\", \"text\": \"%s\"}\n"
+    "{\"id\": 2, \"path\": \"./tmp_serve_request.sl\", \"text\": \"%s\"}\n"
+    "{\"id\": 3, \"path\": \"./tmp_serve_request.sl\", \"text\": \"%s\"}\n"
+    "{\"id\": 4, \"path\": \"./tmp_serve_request.sl\", \"text\": \"x {\"}\n"
+    "{\"id\": 5, \"command\": \"shutdown\"}\n"
+    "{\"id\": 6, \"command\": \"status\"}\n", good, good, bad);
+  char *replies = serve_requests(server, requests);
+
+  /* The first line describes the base, then each request has a reply, and
+     nothing is answered after the shutdown. */
+  char *line = replies;
+  const char *expected_valid[] = { "true", "true", "false", "false" };
+  line = strchr(line, '\n') + 1;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    char *end = strchr(line, '\n');
+    if (end == NULL)
+      return 1;
+    sl_JsonValue *reply = sl_json_parse(line, end - line);
+    if (reply == NULL)
+      return 1;
+    if (sl_json_get_number(sl_json_get_member(reply, "id")) != i + 1)
+      return 1;
+    const sl_JsonValue *valid = sl_json_get_member(reply, "valid");
+    if (valid == NULL
+        || sl_json_get_bool(valid) != (strcmp(expected_valid[i], "true") == 0))
+      return 1;
+    const sl_JsonValue *diagnostics = sl_json_get_member(reply, "diagnostics");
+    if ((sl_json_get_length(diagnostics) == 0) != sl_json_get_bool(valid))
+      return 1;
+    sl_json_free(reply);
+    line = end + 1;
+  }
+  if (strstr(line, "\"shutdown\":true") == NULL)
+    return 1;
+  if (strstr(line, "\"id\":6") != NULL)
+    return 1;
+  if (sl_logic_count_symbols(logic) != base_symbols)
+    return 1;
+
+  free(replies);
+  SL_FREE(good);
+  SL_FREE(bad);
+  SL_FREE(requests);
+  sl_free_server(server);
+  sl_free_logic_state(logic);
+  remove(TEST_BASE_FILENAME);
+  return 0;
+}
+
+/* Frames a message for the language server. */
+static void
+append_lsp_message(sl_StringBuilder *messages, const char *message)
+{
+  sl_string_builder_printf(messages, "Content-Length: %zu\r\n\r\n%s",
+    strlen(message), message);
+}
+
+/* Splits the messages written by the language server, returning how many
+   there are. */
+static size_t
+parse_lsp_messages(const char *text, sl_JsonValue **messages, size_t max)
+{
+  size_t n = 0;
+  const char *header = "Content-Length: ";
+  while (n < max && strncmp(text, header, strlen(header)) == 0)
+  {
+    size_t length = strtoul(text + strlen(header), NULL, 10);
+    const char *content = strstr(text, "\r\n\r\n");
+    if (content == NULL)
+      break;
+    content += 4;
+    messages[n++] = sl_json_parse(content, length);
+    text = content + length;
+  }
+  return n;
+}
+
+static int
+check_published_diagnostics(const sl_JsonValue *message, const char *uri,
+  size_t expected)
+{
+  const sl_JsonValue *params = sl_json_get_member(message, "params");
+  if (strcmp(sl_json_get_member_string(message, "method"),
+      "textDocument/publishDiagnostics") != 0)
+    return 1;
+  if (strcmp(sl_json_get_member_string(params, "uri"), uri) != 0)
+    return 1;
+  if (sl_json_get_length(sl_json_get_member(params, "diagnostics")) != expected)
+    return 1;
+  return 0;
+}
+
+static int
+run_test_lsp(struct TestState *state)
+{
+  if (write_test_base() != 0)
+    return 1;
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  sl_LanguageServer *server = sl_new_language_server(logic);
+  if (sl_language_server_load_base(server, TEST_BASE_FILENAME) != 0)
+    return 1;
+  size_t base_symbols = sl_logic_count_symbols(logic);
+
+  char cwd[4096];
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    return 1;
+  char *uri, *good, *edited, *bad;
+  asprintf(&uri, "file://%s/%s", cwd, TEST_DOCUMENT_URI_NAME);
+  asprintf(&good, test_theorem, "$phi");
+  asprintf(&edited, "\\n\\n%s", good);
+  asprintf(&bad, test_theorem, "not($phi)");
+
+  /* The document is opened, edited without touching the theorem, broken,
+     and closed. */
+  sl_StringBuilder input;
+  sl_string_builder_init(&input);
+  const char *texts[] = { good, edited, bad };
+  append_lsp_message(&input, "{\"jsonrpc\":\"2.0\",\"id\":1,"
+    "\"method\":\"initialize\",\"params\":{}}");
+  append_lsp_message(&input, "{\"jsonrpc\":\"2.0\","
+    "\"method\":\"initialized\",\"params\":{}}");
+  for (size_t i = 0; i < 3; ++i)
+  {
+    char *message;
+    if (i == 0)
+      asprintf(&message, "{\"jsonrpc\":\"2.0\","
+        "\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":"
+        "{\"uri\":\"%s\",\"languageId\":\"sl\",\"version\":0,"
+        "\"text\":\"%s\"}}}", uri, texts[i]);
+    else
+      asprintf(&message, "{\"jsonrpc\":\"2.0\","
+        "\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":"
+        "{\"uri\":\"%s\",\"version\":%zu},"
+        "\"contentChanges\":[{\"text\":\"%s\"}]}}", uri, i, texts[i]);
+    append_lsp_message(&input, message);
+    SL_FREE(message);
+  }
+  char *close;
+  asprintf(&close, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didClose\","
+    "\"params\":{\"textDocument\":{\"uri\":\"%s\"}}}", uri);
+  append_lsp_message(&input, close);
+  SL_FREE(close);
+  append_lsp_message(&input, "{\"jsonrpc\":\"2.0\",\"id\":2,"
+    "\"method\":\"textDocument/hover\",\"params\":{}}");
+  append_lsp_message(&input, "{\"jsonrpc\":\"2.0\",\"id\":3,"
+    "\"method\":\"shutdown\"}");
+  append_lsp_message(&input, "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+  char *requests = sl_string_builder_finish(&input);
+
+  char *replies = NULL;
+  size_t replies_size = 0;
+  FILE *in = fmemopen(requests, strlen(requests), "r");
+  FILE *out = open_memstream(&replies, &replies_size);
+  if (sl_language_server_serve_stream(server, in, out) != 0)
+    return 1;
+  fclose(in);
+  fclose(out);
+
+  sl_JsonValue *messages[8];
+  if (parse_lsp_messages(replies, messages, 8) != 7)
+    return 1;
+  const sl_JsonValue *capabilities = sl_json_get_member(
+    sl_json_get_member(messages[0], "result"), "capabilities");
+  if (sl_json_get_number(sl_json_get_member(capabilities,
+      "textDocumentSync")) != 1.0)
+    return 1;
+  if (check_published_diagnostics(messages[1], uri, 0) != 0
+      || check_published_diagnostics(messages[2], uri, 0) != 0
+      || check_published_diagnostics(messages[3], uri, 1) != 0
+      || check_published_diagnostics(messages[4], uri, 0) != 0)
+    return 1;
+
+  /* The broken proof is reported at the step that failed, with the reason
+     it failed. */
+  const sl_JsonValue *diagnostic = sl_json_get_element(sl_json_get_member(
+    sl_json_get_member(messages[3], "params"), "diagnostics"), 0);
+  const sl_JsonValue *start = sl_json_get_member(
+    sl_json_get_member(diagnostic, "range"), "start");
+  if (sl_json_get_number(sl_json_get_member(diagnostic, "severity")) != 1.0)
+    return 1;
+  if (sl_json_get_number(sl_json_get_member(start, "line")) != 4.0)
+    return 1;
+  const char *detail = sl_json_get_member_string(diagnostic, "message");
+  if (detail == NULL || strstr(detail, "is not satisfied") == NULL)
+    return 1;
+
+  if (sl_json_get_number(sl_json_get_member(sl_json_get_member(messages[5],
+      "error"), "code")) != -32601.0)
+    return 1;
+  if (sl_json_get_number(sl_json_get_member(messages[6], "id")) != 3.0
+      || sl_json_get_type(sl_json_get_member(messages[6], "result"))
+      != sl_JsonType_Null)
+    return 1;
+
+  /* The edit that left the theorem alone did not check its proof again, and
+     the state is back to the base. */
+  uint64_t hits, misses;
+  sl_proof_cache_get_stats(sl_language_server_get_proof_cache(server),
+    &hits, &misses);
+  if (hits != 1 || misses != 2)
+    return 1;
+  if (sl_logic_count_symbols(logic) != base_symbols)
+    return 1;
+
+  for (size_t i = 0; i < 7; ++i)
+    sl_json_free(messages[i]);
+  free(replies);
+  SL_FREE(requests);
+  SL_FREE(uri);
+  SL_FREE(good);
+  SL_FREE(edited);
+  SL_FREE(bad);
+  sl_free_language_server(server);
+  sl_free_logic_state(logic);
+  remove(TEST_BASE_FILENAME);
+  return 0;
+}
+
+static int
+run_test_proof_cache(struct TestState *state)
+{
+  sl_ProofCache *cache = sl_new_proof_cache();
+  sl_proof_cache_set_limit(cache, 4);
+  for (uint64_t i = 1; i <= 100; ++i)
+  {
+    sl_proof_cache_add(cache, i);
+    /* Looking the first one up keeps it from being dropped. */
+    if (!sl_proof_cache_contains(cache, 1))
+      return 1;
+  }
+  if (sl_proof_cache_count(cache) > 8)
+    return 1;
+  if (sl_proof_cache_contains(cache, 2)
+      || !sl_proof_cache_contains(cache, 100))
+    return 1;
+  sl_free_proof_cache(cache);
+  return 0;
+}
+
+static int
+write_test_file(const char *path, const char *text)
+{
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return 1;
+  fputs(text, f);
+  fclose(f);
+  return 0;
+}
+
+#define WATCH_LEFT_TEXT \
+  "import \"tmp_serve_base.sl\";\n" \
+  "namespace serve_test {\n" \
+  "  theorem left(phi : Formula) {\n" \
+  "    assume not(not(not(not($phi))));\n" \
+  "    step double_negation(not(not($phi)));\n" \
+  "    step double_negation(%s);\n" \
+  "    infer $phi;\n" \
+  "  }\n" \
+  "}\n"
+
+static int
+run_test_watch(struct TestState *state)
+{
+  const char *left_path = "./tmp_watch_left.sl";
+  const char *right_path = "./tmp_watch_right.sl";
+  const char *main_path = "./tmp_watch_main.sl";
+  char *left, *broken_left;
+  asprintf(&left, WATCH_LEFT_TEXT, "$phi");
+  asprintf(&broken_left, WATCH_LEFT_TEXT, "not($phi)");
+  if (write_test_base() != 0
+      || write_test_file(left_path, left) != 0
+      || write_test_file(right_path, "import \"tmp_serve_base.sl\";\n"
+        "namespace serve_test {\n"
+        "  theorem right(phi : Formula) {\n"
+        "    assume not(not($phi));\n"
+        "    step double_negation($phi);\n"
+        "    infer $phi;\n"
+        "  }\n"
+        "}\n") != 0
+      || write_test_file(main_path, "import \"tmp_watch_left.sl\";\n"
+        "import \"tmp_watch_right.sl\";\n"
+        "namespace serve_test {\n"
+        "  theorem both(phi : Formula) {\n"
+        "    assume not(not(not(not($phi))));\n"
+        "    step left($phi);\n"
+        "    infer $phi;\n"
+        "  }\n"
+        "}\n") != 0)
+    return 1;
+
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  sl_Watcher *watcher = sl_new_watcher(logic);
+  sl_watcher_add_root(watcher, main_path);
+  if (sl_watcher_verify_all(watcher) != 0
+      || sl_watcher_count_verified(watcher) != 4)
+    return 1;
+  size_t symbols = sl_logic_count_symbols(logic);
+
+  /* Only the changed file and the files importing it are verified again,
+     and nothing is lost or added twice. */
+  const char *changed[] = { right_path };
+  if (sl_watcher_update(watcher, changed, 1) != 0
+      || sl_watcher_count_verified(watcher) != 2
+      || sl_logic_count_symbols(logic) != symbols)
+    return 1;
+
+  /* Files loaded after the changed one are verified again, even if they do
+     not depend on it. */
+  changed[0] = left_path;
+  if (sl_watcher_update(watcher, changed, 1) != 0
+      || sl_watcher_count_verified(watcher) != 3
+      || sl_logic_count_symbols(logic) != symbols)
+    return 1;
+
+  /* A broken import makes the root invalid until it is fixed. */
+  if (write_test_file(left_path, broken_left) != 0
+      || sl_watcher_update(watcher, changed, 1) == 0)
+    return 1;
+  if (write_test_file(left_path, left) != 0
+      || sl_watcher_update(watcher, changed, 1) != 0
+      || sl_logic_count_symbols(logic) != symbols)
+    return 1;
+
+  changed[0] = TEST_BASE_FILENAME;
+  if (sl_watcher_update(watcher, changed, 1) != 0
+      || sl_watcher_count_verified(watcher) != 4
+      || sl_logic_count_symbols(logic) != symbols)
+    return 1;
+
+  /* Files that nothing imports do not matter. */
+  changed[0] = "./tmp_watch_unrelated.sl";
+  if (sl_watcher_update(watcher, changed, 1) != 0
+      || sl_watcher_count_verified(watcher) != 0)
+    return 1;
+
+  sl_free_watcher(watcher);
+  sl_free_logic_state(logic);
+  SL_FREE(left);
+  SL_FREE(broken_left);
+  remove(left_path);
+  remove(right_path);
+  remove(main_path);
+  remove(TEST_BASE_FILENAME);
+  return 0;
+}
+
+static int
+run_test_batch(struct TestState *state)
+{
+  /* The first two files add the same theorem, which only works if each is
+     verified on its own. The third has a broken proof. */
+  const char *paths[] = { "./tmp_batch_a.sl", "./tmp_batch_b.sl",
+    "./tmp_batch_broken.sl" };
+  char *good, *broken;
+  asprintf(&good, WATCH_LEFT_TEXT, "$phi");
+  asprintf(&broken, WATCH_LEFT_TEXT, "not($phi)");
+  if (write_test_base() != 0
+      || write_test_file(paths[0], good) != 0
+      || write_test_file(paths[1], good) != 0
+      || write_test_file(paths[2], broken) != 0)
+    return 1;
+
+  sl_LogicState *base = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_file(TEST_BASE_FILENAME, base) != 0)
+    return 1;
+  size_t base_symbols = sl_logic_count_symbols(base);
+
+  sl_Batch *batch = sl_new_batch(base);
+  for (size_t i = 0; i < 3; ++i)
+    sl_batch_add_file(batch, paths[i]);
+  if (sl_batch_verify(batch, 2) == 0
+      || sl_batch_count_files(batch) != 3
+      || !sl_batch_file_valid(batch, 0)
+      || !sl_batch_file_valid(batch, 1)
+      || sl_batch_file_valid(batch, 2))
+    return 1;
+
+  /* Each file's messages are kept with it, and the base is left as it was. */
+  if (strcmp(sl_batch_get_path(batch, 2), paths[2]) != 0
+      || strstr(sl_batch_get_output(batch, 0), "Error") != NULL
+      || strstr(sl_batch_get_output(batch, 2), "Error in") == NULL
+      || sl_logic_count_symbols(base) != base_symbols)
+    return 1;
+
+  sl_free_batch(batch);
+  sl_free_logic_state(base);
+
+  /* The workers take on the artifact setting and the proof cache of the
+     thread that verifies the batch. Over an empty base, both files import
+     the base file themselves. */
+  const char *base_artifact_path = "./tmp_serve_base.slc";
+  remove(base_artifact_path);
+  sl_ProofCache *cache = sl_new_proof_cache();
+  sl_set_use_module_artifacts(TRUE);
+  sl_set_active_proof_cache(cache);
+  base = sl_new_logic_state(NULL);
+  batch = sl_new_batch(base);
+  for (size_t i = 0; i < 2; ++i)
+    sl_batch_add_file(batch, paths[i]);
+  int err = sl_batch_verify(batch, 2);
+  sl_set_use_module_artifacts(FALSE);
+  sl_set_active_proof_cache(NULL);
+  uint64_t hits, misses;
+  sl_proof_cache_get_stats(cache, &hits, &misses);
+  if (err != 0 || access(base_artifact_path, F_OK) != 0
+      || hits + misses == 0)
+    return 1;
+
+  sl_free_batch(batch);
+  sl_free_logic_state(base);
+  sl_free_proof_cache(cache);
+  SL_FREE(good);
+  SL_FREE(broken);
+  for (size_t i = 0; i < 3; ++i)
+    remove(paths[i]);
+  remove(base_artifact_path);
+  remove(TEST_BASE_FILENAME);
+  return 0;
+}
+
+static int
+run_test_module_artifacts(struct TestState *state)
+{
+  const char *left_path = "./tmp_artifact_left.sl";
+  const char *main_path = "./tmp_artifact_main.sl";
+  const char *artifact_paths[] = { "./tmp_serve_base.slc",
+    "./tmp_artifact_left.slc" };
+  char *left, *broken_left;
+  asprintf(&left, WATCH_LEFT_TEXT, "$phi");
+  asprintf(&broken_left, WATCH_LEFT_TEXT, "not($phi)");
+  if (write_test_base() != 0
+      || write_test_file(left_path, left) != 0
+      || write_test_file(main_path, "import \"tmp_artifact_left.sl\";\n"
+        "namespace serve_test {\n"
+        "  theorem main(phi : Formula) {\n"
+        "    assume not(not(not(not($phi))));\n"
+        "    step left($phi);\n"
+        "    infer $phi;\n"
+        "  }\n"
+        "}\n") != 0)
+    return 1;
+  for (size_t i = 0; i < 2; ++i)
+    remove(artifact_paths[i]);
+
+  /* Verifying from source writes an artifact for each imported file, but
+     not for the file at the top. */
+  sl_set_use_module_artifacts(TRUE);
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_file(main_path, logic) != 0
+      || access(artifact_paths[0], F_OK) != 0
+      || access(artifact_paths[1], F_OK) != 0
+      || access("./tmp_artifact_main.slc", F_OK) == 0)
+    return 1;
+  size_t symbols = sl_logic_count_symbols(logic);
+  sl_free_logic_state(logic);
+
+  sl_ModuleArtifact *artifact = sl_read_module_artifact(left_path);
+  if (artifact == NULL
+      || sl_module_artifact_count_imports(artifact) != 1
+      || strcmp(sl_module_artifact_get_import(artifact, 0),
+        "tmp_serve_base.sl") != 0)
+    return 1;
+
+  /* An artifact only fits a state that has its imports. */
+  logic = sl_new_logic_state(NULL);
+  size_t empty_symbols = sl_logic_count_symbols(logic);
+  if (sl_module_artifact_add_to_state(artifact, logic) == 0
+      || sl_logic_count_symbols(logic) != empty_symbols)
+    return 1;
+  if (sl_verify_and_add_file(TEST_BASE_FILENAME, logic) != 0
+      || sl_module_artifact_add_to_state(artifact, logic) != 0
+      || sl_logic_count_symbols(logic) != symbols - 1)
+    return 1;
+  sl_free_logic_state(logic);
+  sl_free_module_artifact(artifact);
+
+  /* Loading from the artifacts adds the same symbols. */
+  logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_file(main_path, logic) != 0
+      || sl_logic_count_symbols(logic) != symbols)
+    return 1;
+  sl_free_logic_state(logic);
+
+  /* Once its source changes, an artifact is no longer used. */
+  if (write_test_file(left_path, broken_left) != 0
+      || sl_read_module_artifact(left_path) != NULL)
+    return 1;
+  logic = sl_new_logic_state(NULL);
+  if (sl_verify_and_add_file(main_path, logic) == 0)
+    return 1;
+  sl_free_logic_state(logic);
+  sl_set_use_module_artifacts(FALSE);
+
+  SL_FREE(left);
+  SL_FREE(broken_left);
+  remove(left_path);
+  remove(main_path);
+  remove(TEST_BASE_FILENAME);
+  for (size_t i = 0; i < 2; ++i)
+    remove(artifact_paths[i]);
+  return 0;
+}
+
+#define TERM_INDEX_TEST_LIBRARY \
+  "namespace index_test {\n" \
+  "  type Formula;\n" \
+  "  expr Formula implies(phi : Formula, psi : Formula) { }\n" \
+  "  expr Formula not(phi : Formula) { }\n" \
+  "  axiom simplification(phi : Formula, psi : Formula) {\n" \
+  "    infer implies($phi, implies($psi, $phi));\n" \
+  "  }\n" \
+  "  axiom identity(phi : Formula) {\n" \
+  "    infer implies($phi, $phi);\n" \
+  "  }\n" \
+  "  axiom contraposition(phi : Formula, psi : Formula) {\n" \
+  "    infer implies(implies(not($phi), not($psi)), implies($psi, $phi));\n" \
+  "  }\n" \
+  "  axiom anything(phi : Formula) {\n" \
+  "    infer $phi;\n" \
+  "  }\n" \
+  "}\n"
+
+/* Queries the index, returning the names of the theorems that were found,
+   separated by spaces, or NULL if the pattern cannot be read. */
+static char *
+query_term_index(sl_LogicState *logic, const sl_TermIndex *index,
+  const char *text, sl_TermQueryMode mode)
+{
+  Value *pattern = sl_parse_term_pattern(logic, text);
+  if (pattern == NULL)
+    return NULL;
+  sl_TermQueryResults results;
+  ARR_INIT(results);
+  sl_term_index_query(index, logic, pattern, mode, &results);
+  free_value(pattern);
+
+  char *names = NULL;
+  size_t names_size = 0;
+  FILE *out = open_memstream(&names, &names_size);
+  for (size_t i = 0; i < ARR_LENGTH(results); ++i)
+  {
+    const struct sl_TermQueryResult *result = ARR_GET(results, i);
+    const sl_SymbolPath *path = sl_logic_get_symbol_by_id(logic,
+      result->theorem_id)->path;
+    char *name = sl_string_from_symbol_path(logic, path);
+    fprintf(out, "%s%s", (i > 0) ? " " : "", name);
+    SL_FREE(name);
+  }
+  fclose(out);
+  ARR_FREE(results);
+  return names;
+}
+
+static int
+check_term_query(sl_LogicState *logic, const sl_TermIndex *index,
+  const char *text, sl_TermQueryMode mode, const char *expected)
+{
+  char *names = query_term_index(logic, index, text, mode);
+  int result = (names == NULL || strcmp(names, expected) != 0);
+  free(names);
+  return result;
+}
+
+static int
+run_test_term_index(struct TestState *state)
+{
+  sl_LogicState *logic = sl_new_logic_state(NULL);
+  sl_TermIndex *index = sl_new_term_index();
+  if (sl_verify_and_add_string("./tmp_term_index.sl",
+      TERM_INDEX_TEST_LIBRARY, logic) != 0)
+    return 1;
+  sl_term_index_update(index, logic);
+  if (sl_term_index_count_statements(index) != 4)
+    return 1;
+
+  if (check_term_query(logic, index, "implies($a, implies($b, $a))",
+        sl_TermQueryMode_Instances, "index_test.simplification") != 0
+      || check_term_query(logic, index, "implies(not($x), not($x))",
+        sl_TermQueryMode_Instances, "") != 0
+      || check_term_query(logic, index, "implies(not($x), not($x))",
+        sl_TermQueryMode_Generalizations,
+        "index_test.identity index_test.anything") != 0
+      || check_term_query(logic, index, "implies($a, $a)",
+        sl_TermQueryMode_Unifiable,
+        "index_test.identity index_test.anything") != 0)
+    return 1;
+
+  /* Paths may be written in full, or by their last segments. */
+  if (check_term_query(logic, index,
+        "index_test.implies(implies($a, $b), $c)",
+        sl_TermQueryMode_Unifiable,
+        "index_test.simplification index_test.identity "
+        "index_test.contraposition index_test.anything") != 0
+      || query_term_index(logic, index, "missing($a)",
+        sl_TermQueryMode_Unifiable) != NULL
+      || query_term_index(logic, index, "implies($a)",
+        sl_TermQueryMode_Unifiable) != NULL)
+    return 1;
+
+  sl_free_term_index(index);
+  sl_free_logic_state(logic);
+  return 0;
+}
+
+struct TestCase test_json = { "JSON", &run_test_json };
+struct TestCase test_serve = { "Serve", &run_test_serve };
+struct TestCase test_lsp = { "Language Server", &run_test_lsp };
+struct TestCase test_proof_cache = { "Proof Cache", &run_test_proof_cache };
+struct TestCase test_watch = { "Watch", &run_test_watch };
+struct TestCase test_batch = { "Batch", &run_test_batch };
+struct TestCase test_module_artifacts = { "Module Artifacts",
+  &run_test_module_artifacts };
+struct TestCase test_term_index = { "Term Index", &run_test_term_index };